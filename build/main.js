@@ -1,7 +1,7 @@
 //spell-checker:words submenu, pasteandmatchstyle, statusvisible, taskbar, colorpicker, mailto, forecolor, tinymce, unmaximize
 //spell-checker:ignore prefs, partyhealth, combathealth, commandinput, limbsmenu, limbhealth, selectall, editoronly, limbarmor, maximizable, minimizable
 //spell-checker:ignore limbsarmor, lagmeter, buttonsvisible, connectbutton, charactersbutton, Editorbutton, zoomin, zoomout, unmaximize, resizable
-const { app, BrowserWindow, WebContentsView, shell, screen, Tray, dialog, Menu, MenuItem, ipcMain, systemPreferences, nativeImage } = require('electron');
+const { app, BrowserWindow, WebContentsView, webContents, shell, screen, Tray, dialog, Menu, MenuItem, ipcMain, systemPreferences, nativeImage, utilityProcess, MessageChannelMain, Notification } = require('electron');
 const path = require('path');
 const fs = require('fs');
 const URL = require('url');
@@ -136,6 +136,8 @@ let tray = null;
 let _focused = false;
 let _reloading = false;
 const stateMap = new Map();
+let _sessionHost = null;
+const _sessionAttach = new Map();
 
 process.on('uncaughtException', logError);
 process.on('unhandledRejection', (reason, promise) => {
@@ -369,7 +371,8 @@ function createWindow(options) {
             const cl = windows[windowId].clients.length;
             for (var idx = 0; idx < cl; idx++) {
                 window.webContents.send('new-client', { id: windows[windowId].clients[idx], current: windows[windowId].current === windows[windowId].clients[idx] });
-                clients[windows[windowId].clients[idx]].view.webContents.send('window-reloaded');
+                if (clients[windows[windowId].clients[idx]].view)
+                    clients[windows[windowId].clients[idx]].view.webContents.send('window-reloaded');
             }
             window.webContents.send('switch-client', windows[windowId].current);
         });
@@ -432,11 +435,15 @@ function createWindow(options) {
             const id = windows[windowId].clients[idx];
             //close any child windows linked to view
             closeClientWindows(id);
-            if (!window.isDestroyed())
-                window.contentView.removeChildView(clients[id].view);
-            idMap.delete(clients[id].view);
-            if (clients[id].view.webContents)
-                clients[id].view.webContents.destroy();
+            if (clients[id].parked)
+                removeParkedClient(id);
+            else {
+                if (!window.isDestroyed())
+                    window.contentView.removeChildView(clients[id].view);
+                idMap.delete(clients[id].view);
+                if (clients[id].view.webContents)
+                    clients[id].view.webContents.destroy();
+            }
             if (clients[id].name)
                 delete names[clients[id].name];
             clients[id] = null;
@@ -1196,6 +1203,7 @@ app.on('before-quit', async (e) => {
         e.preventDefault();
         return;
     }
+    saveSettings(true);
     //wait until save is done before continue just to be safe
     //only saved if not already been saved somewhere else and was loaded with no errors
     if (_loaded && !_saved) {
@@ -1224,7 +1232,7 @@ ipcMain.on('error', (event, err, id) => {
 
 function sendClient(channel, msg, id) {
     let client = id ? clients[id] : getActiveClient();
-    if (client && client.view.webContents) {
+    if (client && client.view && client.view.webContents) {
         client.view.webContents.send(channel, msg);
         return true;
     }
@@ -1309,6 +1317,8 @@ ipcMain.on('set-global', (event, key, value) => {
             global.noCloseAll = value;
             break;
     }
+    if (_sessionHost)
+        _sessionHost.postMessage({ type: 'globals', globals: getSessionHostGlobals() });
 });
 
 ipcMain.on('get-setting', (event, key) => {
@@ -1328,9 +1338,51 @@ ipcMain.on('set-setting', (event, key, value) => {
     setSetting(key, value);
 });
 
+//settings changed since last save, reapplied if the file is reloaded before the save happens
+let _settingsChanges = {};
+let _settingsTimer = 0;
+
 function setSetting(key, value) {
-    if (_settings && _settings.setValue(key, value))
-        _settings.save(global.settingsFile);
+    if (_settings && _settings.setValue(key, value)) {
+        _settingsChanges[key] = value;
+        settingsChanged(key);
+        saveSettings();
+    }
+}
+
+/**
+ * Save settings, writes are coalesced and only done once no changes have happened for a short time
+ * 
+ * @param {boolean} now Save right away and cancel any pending save
+ */
+function saveSettings(now) {
+    if (_settingsTimer)
+        clearTimeout(_settingsTimer);
+    _settingsTimer = 0;
+    if (now) {
+        if (_settings && Object.keys(_settingsChanges).length)
+            _settings.save(global.settingsFile);
+        _settingsChanges = {};
+        return;
+    }
+    _settingsTimer = setTimeout(() => saveSettings(true), 500);
+}
+
+/**
+ * Let all renderers know a setting changed so they can drop it from their settings mirror
+ * 
+ * @param {string} key The setting that changed, null for all settings
+ */
+function settingsChanged(key) {
+    const contents = webContents.getAllWebContents();
+    const cl = contents.length;
+    for (let c = 0; c < cl; c++) {
+        if (!contents[c].isDestroyed())
+            contents[c].send('setting-changed', key);
+    }
+    //the session host has no settings mirror so send the current settings
+    if (_sessionHost)
+        _sessionHost.postMessage({ type: 'settings', settings: _settings });
 }
 
 ipcMain.on('get-pid', (event) => {
@@ -1430,15 +1482,17 @@ ipcMain.on('reload-profiles', event => {
         windows[window].menubar.updateItem('Profiles', { submenu: buildProfileMenu(windows[window].window) });
     }
     for (clientId in clients) {
-        if (!Object.prototype.hasOwnProperty.call(clients, clientId))
+        if (!Object.prototype.hasOwnProperty.call(clients, clientId) || !clients[clientId].view)
             continue;
         clients[clientId].view.webContents.send('reload-profiles');
     }
+    if (_sessionHost)
+        _sessionHost.postMessage({ type: 'reload-profiles' });
 });
 
 ipcMain.on('reload-profile', (event, profile) => {
     for (clientId in clients) {
-        if (!Object.prototype.hasOwnProperty.call(clients, clientId))
+        if (!Object.prototype.hasOwnProperty.call(clients, clientId) || !clients[clientId].view)
             continue;
         clients[clientId].view.webContents.send('reload-profile', profile);
     }
@@ -1448,7 +1502,7 @@ ipcMain.on('import-characters', (event, file, id, backup, replace) => {
     openCharacters();
     _characters.import(file, backup, replace);
     for (clientId in clients) {
-        if (!Object.prototype.hasOwnProperty.call(clients, clientId) || parseInt(clientId, 10) === id)
+        if (!Object.prototype.hasOwnProperty.call(clients, clientId) || parseInt(clientId, 10) === id || !clients[clientId].view)
             continue;
         clients[clientId].view.webContents.send('characters-imported');
     }
@@ -1469,7 +1523,7 @@ ipcMain.on('update-character', (event, character, id, noReload) => {
     openCharacters();
     _characters.updateCharacter(character);
     for (clientId in clients) {
-        if (!Object.prototype.hasOwnProperty.call(clients, clientId) || parseInt(clientId, 10) === id)
+        if (!Object.prototype.hasOwnProperty.call(clients, clientId) || parseInt(clientId, 10) === id || !clients[clientId].view)
             continue;
         clients[clientId].view.webContents.send('character-updated', character.ID, noReload);
     }
@@ -1488,7 +1542,7 @@ ipcMain.on('update-character-time', (event, data, id) => {
     */
     _characters.updateCharacter(data);
     for (clientId in clients) {
-        if (!Object.prototype.hasOwnProperty.call(clients, clientId) || parseInt(clientId, 10) === id)
+        if (!Object.prototype.hasOwnProperty.call(clients, clientId) || parseInt(clientId, 10) === id || !clients[clientId].view)
             continue;
         clients[clientId].view.webContents.send('character-updated', character.ID, true);
     }
@@ -1500,7 +1554,7 @@ ipcMain.on('add-character', (event, character) => {
     event.returnValue = id;
     character.ID = id;
     for (clientId in clients) {
-        if (!Object.prototype.hasOwnProperty.call(clients, clientId))
+        if (!Object.prototype.hasOwnProperty.call(clients, clientId) || !clients[clientId].view)
             continue;
         clients[clientId].view.webContents.send('character-added', character);
     }
@@ -1820,7 +1874,7 @@ ipcMain.on('window-info', (event, info, id, ...args) => {
 
 ipcMain.on('cancel-close', event => {
     for (clientId in clients) {
-        if (!Object.prototype.hasOwnProperty.call(clients, clientId))
+        if (!Object.prototype.hasOwnProperty.call(clients, clientId) || !clients[clientId].view)
             continue;
         clients[clientId].view.webContents.send('cancel-close');
     }
@@ -1843,6 +1897,7 @@ ipcMain.on('switch-client', (event, id, offset) => {
             //Probably wanting to dock from 1 window to another, so just ignore
             return;
         }
+        unparkClient(id);
         const bounds = window.getContentBounds();
         clients[id].view.setBounds({
             x: 0,
@@ -1928,6 +1983,7 @@ ipcMain.on('dock-client', (event, id, options) => {
     if (!clients[id]) return;
     //tab from a different instant, can not transfer due to process structure
     if (options && 'pid' in options && options.pid !== process.pid) return;
+    unparkClient(id);
     let window = windowFromContents(event.sender);
     let windowId = getWindowId(window);
     const oldWindow = clients[id].parent;
@@ -2058,22 +2114,46 @@ ipcMain.on('close-window', (event, id) => {
 });
 
 ipcMain.on('execute-client', (event, id, code) => {
+    executeClient(id, code);
+});
+
+ipcMain.on('execute-all-clients', (event, code) => {
+    executeAllClients(code);
+});
+
+/**
+ * Run code in a client page or the session host if the client is parked
+ * 
+ * @param {number|string} id The client id or name
+ * @param {string} code The code to run
+ */
+function executeClient(id, code) {
     if (typeof id === 'string')
         id = names[id];
-    if (clients[id])
+    if (!clients[id]) return;
+    if (clients[id].parked)
+        _sessionHost.postMessage({ type: 'execute', id: id, code: code });
+    else
         executeScript(code, clients[id].view);
-});
+}
 
-ipcMain.on('execute-all-clients', (event, code) => {
+/**
+ * Run code in all clients, including any parked in the session host
+ * 
+ * @param {string} code The code to run
+ */
+function executeAllClients(code) {
     for (id in clients) {
-        if (!Object.prototype.hasOwnProperty.call(clients, id) || getClientId(clients[id].view) === clientId)
+        if (!Object.prototype.hasOwnProperty.call(clients, id) || !clients[id].view || getClientId(clients[id].view) === clientId)
             continue;
         executeScript(code, clients[id].view);
     }
-});
+    if (_sessionHost)
+        _sessionHost.postMessage({ type: 'execute', code: code });
+}
 
 ipcMain.on('update-client', (event, id, offset) => {
-    if (clients[id]) {
+    if (clients[id] && clients[id].view) {
         offset = offset || 0;
         var bounds = windowFromContents(event.sender).getContentBounds();
         clients[id].view.setBounds({
@@ -2086,6 +2166,220 @@ ipcMain.on('update-client', (event, id, offset) => {
 });
 //#endregion
 
+//#region Session host
+/**
+ * Get the session host, starting it if needed
+ * 
+ * @returns {Electron.UtilityProcess} The session host process
+ */
+function getSessionHost() {
+    if (_sessionHost) return _sessionHost;
+    _sessionHost = utilityProcess.fork(path.join(__dirname, 'js', 'session.host.js'), [], { serviceName: 'jiMUD Session Host' });
+    _sessionHost.on('message', sessionHostMessage);
+    _sessionHost.on('exit', code => {
+        _sessionHost = null;
+        if (code)
+            logError(`Session host exited, exitCode ${code}\n`, true);
+        //any attach still waiting will never get a reply
+        _sessionAttach.forEach(resolve => resolve(null));
+        _sessionAttach.clear();
+        //parked sessions are gone, bring the pages back so they can reconnect
+        for (id in clients) {
+            if (!Object.prototype.hasOwnProperty.call(clients, id) || !clients[id].parked)
+                continue;
+            clients[id].parked.lost = true;
+            unparkClient(parseInt(id, 10));
+        }
+    });
+    _sessionHost.postMessage({ type: 'init', templates: getTemplates(), globals: getSessionHostGlobals(), settings: _settings });
+    return _sessionHost;
+}
+
+function getSessionHostGlobals() {
+    return {
+        editorOnly: global.editorOnly,
+        settingsFile: global.settingsFile,
+        mapFile: global.mapFile,
+        debug: global.debug,
+        errorLog: errorLog
+    };
+}
+
+function sessionHostMessage(msg) {
+    if (!msg) return;
+    switch (msg.type) {
+        case 'attached':
+            if (_sessionAttach.has(msg.id)) {
+                _sessionAttach.get(msg.id)(msg);
+                _sessionAttach.delete(msg.id);
+            }
+            break;
+        case 'connected':
+            if (clients[msg.id] && clients[msg.id].parked)
+                clients[msg.id].parked.connected = msg.connected;
+            break;
+        case 'closed':
+            //the page handles disconnect and reconnecting so bring it back
+            if (clients[msg.id] && clients[msg.id].parked)
+                unparkClient(msg.id);
+            break;
+        case 'notify':
+            if (clients[msg.id])
+                showSessionNotification(msg.id, msg.title, msg.message, msg.options || {});
+            break;
+        case 'execute-client':
+            executeClient(msg.id, msg.code);
+            break;
+        case 'execute-all-clients':
+            executeAllClients(msg.code);
+            break;
+    }
+}
+
+/**
+ * Show a notification for a parked client, same as the page notify handler
+ * 
+ * @param {number} id The client id
+ * @param {string} title The notification title
+ * @param {string} message The notification message
+ * @param {object} options The notification options
+ */
+function showSessionNotification(id, title, message, options) {
+    let body = message || '';
+    if (body.length > 127)
+        body = body.substr(0, 127) + '...';
+    const notify = new Notification({
+        title: title,
+        body: body,
+        silent: Object.prototype.hasOwnProperty.call(options, 'silent') ? options.silent : true,
+        icon: parseTemplate(options.icon || '{assets}\\icons\\png\\128x128.png')
+    });
+    notify.on('click', () => {
+        if (_sessionHost)
+            _sessionHost.postMessage({ type: 'notify-clicked', id: id, title: title, message: message });
+    });
+    notify.on('close', () => {
+        if (_sessionHost)
+            _sessionHost.postMessage({ type: 'notify-closed', id: id, title: title, message: message });
+    });
+    notify.show();
+}
+
+/**
+ * Move a hidden client in to the session host and close its page
+ * 
+ * @param {number} id The client id
+ */
+async function parkClient(id) {
+    const client = clients[id];
+    if (!client || !client.view || client.parked || !getSetting('sessionHost'))
+        return;
+    delete client.parkTimer;
+    const view = client.view;
+    //child windows and dev tools need the page
+    if (view.getVisible() || client.windows.length || view.webContents.isDevToolsOpened())
+        return;
+    const state = await executeScript('if(typeof parkSession === "function") parkSession(); else (function() { return null; })();', view);
+    if (!state) return;
+    //shown, closed or given a window while the page was handing off so keep it
+    if (clients[id] !== client || client.view !== view || view.getVisible() || client.windows.length) {
+        if (!view.webContents.isDestroyed())
+            executeScript('resumeSession()', view).catch(logError);
+        return;
+    }
+    client.parked = {
+        data: state.data,
+        title: view.webContents.getTitle(),
+        bounds: view.getBounds(),
+        connected: state.connected
+    };
+    getSessionHost().postMessage({ type: 'park', id: id, session: state.session, logger: state.logger, settings: state.data ? state.data.settings : null });
+    if (client.parent && !client.parent.isDestroyed())
+        client.parent.contentView.removeChildView(view);
+    idMap.delete(view);
+    view.webContents.close();
+    client.view = null;
+}
+
+/**
+ * Bring a parked client back to a page
+ * 
+ * @param {number} id The client id
+ * @returns {Promise} Resolves when the page has restored the session
+ */
+function unparkClient(id) {
+    const client = clients[id];
+    if (!client) return Promise.resolve();
+    if (!client.parked) return client.restored || Promise.resolve();
+    const parked = client.parked;
+    const states = client.states;
+    delete client.parked;
+    //host gone so the page starts fresh
+    if (parked.lost || !_sessionHost)
+        client.session = Promise.resolve(null);
+    else
+        client.session = new Promise(resolve => {
+            _sessionAttach.set(id, resolve);
+            _sessionHost.postMessage({ type: 'attach', id: id });
+        });
+    client.restored = new Promise(resolve => client.restore = resolve);
+    createClient({ parent: client.parent, id: id, data: { data: parked.data, states: states, windows: [], state: { bounds: parked.bounds } } });
+    //keep the same entry so any one holding it sees the new view
+    clients[id] = Object.assign(client, clients[id]);
+    client.states = states;
+    setClientVisible(id, windows[getWindowId(client.parent)].current === id);
+    client.parent.contentView.addChildView(client.view);
+    return client.restored;
+}
+
+/**
+ * Remove a parked client from the session host
+ * 
+ * @param {number} id The client id
+ */
+function removeParkedClient(id) {
+    if (clients[id])
+        delete clients[id].parked;
+    if (_sessionHost)
+        _sessionHost.postMessage({ type: 'remove', id: id });
+}
+
+/**
+ * Get a client title, parked clients use the title from when they were parked
+ * 
+ * @param {number} id The client id
+ * @returns {string} The title
+ */
+function getClientTitle(id) {
+    if (clients[id].parked)
+        return clients[id].parked.title;
+    return clients[id].view.webContents.getTitle();
+}
+
+ipcMain.on('session-host-socket', (event, attach) => {
+    const { port1, port2 } = new MessageChannelMain();
+    getSessionHost().postMessage({ type: 'socket', id: getClientId(viewFromContents(event.sender)), attach: attach }, [port1]);
+    event.sender.postMessage('session-host-port', null, [port2]);
+});
+
+ipcMain.handle('get-session', async event => {
+    const client = clientFromContents(event.sender);
+    if (!client || !client.session) return null;
+    const msg = await client.session;
+    delete client.session;
+    if (!msg || !msg.session) return null;
+    return { session: msg.session, logger: msg.logger, closed: msg.closed };
+});
+
+ipcMain.on('session-restored', event => {
+    const client = clientFromContents(event.sender);
+    if (!client || !client.restore) return;
+    client.restore();
+    delete client.restore;
+    delete client.restored;
+});
+//#endregion
+
 //#region Quit/close related functions
 ipcMain.on('quit', quitApp)
 
@@ -2180,11 +2474,18 @@ ipcMain.on('get-preference', (event, preference) => {
 
 ipcMain.on('set-preference', (event, preference, value) => {
     _settings[preference] = value;
+    settingsChanged(preference);
 });
 
 ipcMain.on('reload-options', (events, preferences, clientId) => {
     if (preferences === global.settingsFile) {
         _settings = Settings.load(global.settingsFile);
+        //keep any changes not yet saved
+        for (const key in _settingsChanges) {
+            if (Object.prototype.hasOwnProperty.call(_settingsChanges, key))
+                _settings.setValue(key, _settingsChanges[key]);
+        }
+        settingsChanged(null);
         for (window in windows) {
             if (!Object.prototype.hasOwnProperty.call(windows, window))
                 continue;
@@ -2192,7 +2493,7 @@ ipcMain.on('reload-options', (events, preferences, clientId) => {
             updateWebContents(windows[window].window.webContents, { enableBackgroundThrottling: getSetting('enableBackgroundThrottling') });
         }
         for (id in clients) {
-            if (!Object.prototype.hasOwnProperty.call(clients, id) || getClientId(clients[id].view) === clientId)
+            if (!Object.prototype.hasOwnProperty.call(clients, id) || !clients[id].view || getClientId(clients[id].view) === clientId)
                 continue;
             clients[id].view.webContents.send('reload-options', preferences, preferences === global.settingsFile);
             updateWebContents(clients[id].view.webContents, { enableBackgroundThrottling: getSetting('enableBackgroundThrottlingClients') });
@@ -2208,16 +2509,20 @@ ipcMain.on('reload-options', (events, preferences, clientId) => {
     }
     else {
         for (id in clients) {
-            if (!Object.prototype.hasOwnProperty.call(clients, id) || getClientId(clients[id].view) === clientId)
+            if (!Object.prototype.hasOwnProperty.call(clients, id) || !clients[id].view || getClientId(clients[id].view) === clientId)
                 continue;
             clients[id].view.webContents.send('reload-options', preferences, preferences === global.settingsFile);
         }
     }
+    if (_sessionHost)
+        _sessionHost.postMessage({ type: 'reload-options', file: preferences, global: preferences === global.settingsFile });
 });
 
 ipcMain.on('reload-map', (events, file) => {
-    for (id in clients)
-        clients[id].view.webContents.send('reload-map', file, file === global.mapFile);
+    for (id in clients) {
+        if (clients[id].view)
+            clients[id].view.webContents.send('reload-map', file, file === global.mapFile);
+    }
 });
 
 ipcMain.on('get-client-id', (event, name) => {
@@ -2290,10 +2595,10 @@ ipcMain.on('get-windows-and-clients', event => {
             });
         }
         for (let c = 0, cl = windows[window].clients.length; c < cl; c++) {
-            if (!clients[windows[window].clients[c]] || !clients[windows[window].clients[c]].view) continue;
+            if (!clients[windows[window].clients[c]]) continue;
             client = {
                 id: windows[window].clients[c],
-                title: clients[windows[window].clients[c]].view.webContents.getTitle(),
+                title: getClientTitle(windows[window].clients[c]),
                 overlay: clients[windows[window].clients[c]].overlay,
                 windows: []
             };
@@ -2328,7 +2633,7 @@ ipcMain.on('get-window-title', (event, id) => {
 
 ipcMain.on('get-client-title', (event, id) => {
     if (clients[id])
-        event.returnValue = clients[id].view.webContents.getTitle();
+        event.returnValue = getClientTitle(id);
     else
         event.returnValue = '';
 });
@@ -2342,7 +2647,10 @@ ipcMain.on('get-client-parent-id', (event, id) => {
 
 ipcMain.on('set-client-bounds', (event, id, bounds) => {
     if (!id || !clients[id] || !bounds) return;
-    clients[id].view.setBounds(bounds);
+    if (clients[id].parked)
+        clients[id].parked.bounds = bounds;
+    else
+        clients[id].view.setBounds(bounds);
 });
 
 ipcMain.on('get-window-content-bounds', (event, id) => {
@@ -2586,18 +2894,22 @@ async function removeClient(id) {
     }
     client.parent = null;
     delete client.parent;
-    idMap.delete(client.view);
-    //close the view, not used in clients but leave in case added in future
-    //await executeCloseHooks(client.view);    
-    //due to a bug in electron it does not fire the unload event, so we fake it to ensure cleanup code is called
-    //await executeScript('window.dispatchEvent(new Event("beforeunload"))', client.view).catch(logError);
-    //use a function in stead of beforeunload in case the bug is fixed to prevent double executing
-    await executeScript('closed();', client.view).catch(logError);
-    //close the client as if closed from browser to ensure any events are triggered
-    client.view.webContents.close();
-    //remove the view to avoid crashing window
-    window.contentView.removeChildView(client.view);
-    client.view.webContents.destroy();
+    if (client.parked)
+        removeParkedClient(id);
+    else {
+        idMap.delete(client.view);
+        //close the view, not used in clients but leave in case added in future
+        //await executeCloseHooks(client.view);    
+        //due to a bug in electron it does not fire the unload event, so we fake it to ensure cleanup code is called
+        //await executeScript('window.dispatchEvent(new Event("beforeunload"))', client.view).catch(logError);
+        //use a function in stead of beforeunload in case the bug is fixed to prevent double executing
+        await executeScript('closed();', client.view).catch(logError);
+        //close the client as if closed from browser to ensure any events are triggered
+        client.view.webContents.close();
+        //remove the view to avoid crashing window
+        window.contentView.removeChildView(client.view);
+        client.view.webContents.destroy();
+    }
     if (clients[id].name)
         delete names[clients[id].name];
     clients[id] = null;
@@ -2641,7 +2953,7 @@ function clientsChanged() {
     if (!clients) return;
     const windowLength = Object.keys(windows).length;
     for (clientId in clients) {
-        if (!Object.prototype.hasOwnProperty.call(clients, clientId) || !clients[clientId].view.webContents || clients[clientId].view.webContents.isDestroyed())
+        if (!Object.prototype.hasOwnProperty.call(clients, clientId) || !clients[clientId].view || !clients[clientId].view.webContents || clients[clientId].view.webContents.isDestroyed())
             continue;
         const windowId = getWindowId(clients[clientId].parent);
         clients[clientId].view.webContents.send('clients-changed', windowLength, (windows[windowId] && windows[windowId].clients) ? windows[windowId].clients.length : 0);
@@ -2654,6 +2966,12 @@ function clientsChanged() {
 
 async function canCloseClient(id, warn, all, allWindows) {
     const client = clients[id];
+    if (client.parked) {
+        //nothing to confirm with out a connection, otherwise bring the page back so it can ask
+        if (!client.parked.connected)
+            return true;
+        await unparkClient(id);
+    }
     //main client can not close so no need to check children
     if (await executeScript(`if(typeof closeable === "function") closeable(${all}, ${allWindows || false}); else (function() { return true; })();`, client.view) === false)
         return false;
@@ -2887,6 +3205,9 @@ async function executeCloseHooksClients(windowId) {
         //await executeCloseHooks(clients[windows[windowId].clients[idx]].view);
         //due to a bug in electron it does not fire the unload event, so we fake it to ensure cleanup code is called
         //await executeScript('window.dispatchEvent(new Event("beforeunload"))', clients[windows[windowId].clients[idx]].view).catch(logError);
+        //parked clients are closed by the session host when the window closes
+        if (clients[windows[windowId].clients[idx]].parked)
+            continue;
         //use a function in stead of beforeunload in case the bug is fixed to prevent double executing
         await executeScript('closed();', clients[windows[windowId].clients[idx]].view).catch(logError);
     }
@@ -2995,6 +3316,22 @@ ipcMain.on('parseTemplate', (event, str, data) => {
     event.returnValue = parseTemplate(str, data);
 });
 
+//template tables for renderers to parse and create template paths with out a round trip for each call
+ipcMain.on('get-templates', (event) => {
+    event.returnValue = getTemplates();
+});
+
+function getTemplates() {
+    const templates = { parse: [], paths: [] };
+    let t, tl;
+    const parse = ['{home}', '{path}', '{appData}', '{data}', '{temp}', '{desktop}', '{documents}', '{downloads}', '{music}', '{pictures}', '{videos}', '{characters}', '{profiles}', '{themes}', '{assets}'];
+    for (t = 0, tl = parse.length; t < tl; t++)
+        templates.parse.push([parse[t], parseTemplate(parse[t])]);
+    for (t = 0, tl = _templatePaths.length; t < tl; t++)
+        templates.paths.push([_templatePaths[t], getFilePath(parseTemplate(_templatePaths[t]))]);
+    return templates;
+}
+
 function parseTemplate(str, data) {
     if (!str) return str;
     str = str.replace(/{home}/g, app.getPath('home'));
@@ -3027,24 +3364,26 @@ ipcMain.on('templatePath', (event, p) => {
     event.returnValue = templatePath(p);
 });
 
+const _templatePaths = [
+    '{characters}',
+    '{themes}',
+    '{assets}',
+    '{data}',
+    '{home}',
+    '{path}',
+    '{appData}',
+    '{temp}',
+    '{desktop}',
+    '{documents}',
+    '{downloads}',
+    '{music}',
+    '{pictures}',
+    '{videos}',
+    '{profiles}'
+];
+
 function templatePath(p) {
-    const paths = [
-        '{characters}',
-        '{themes}',
-        '{assets}',
-        '{data}',
-        '{home}',
-        '{path}',
-        '{appData}',
-        '{temp}',
-        '{desktop}',
-        '{documents}',
-        '{downloads}',
-        '{music}',
-        '{pictures}',
-        '{videos}',
-        '{profiles}'
-    ];
+    const paths = _templatePaths;
     const sl = paths.length;
     //cache the path for some speed boost 
     const testPath = getFilePath(p);
@@ -3633,7 +3972,7 @@ function getClientId(client) {
 function viewFromContents(contents) {
     if (!contents) return null
     for (clientId in clients) {
-        if (!Object.prototype.hasOwnProperty.call(clients, clientId))
+        if (!Object.prototype.hasOwnProperty.call(clients, clientId) || !clients[clientId].view)
             continue;
         if (clients[clientId].view.webContents === contents)
             return clients[clientId].view;
@@ -3643,22 +3982,45 @@ function viewFromContents(contents) {
 
 function setVisibleClient(windowId, clientId) {
     if (!windows[windowId] || !clients[clientId]) return;
+    unparkClient(clientId);
     const view = clients[clientId].view;
     const current = windows[windowId].current;
-    clients[clientId].view.setVisible(true);
+    setClientVisible(clientId, true);
     //z-ordering to move view to top most
     windows[windowId].window.contentView.addChildView(clients[clientId].view);
     //clients[clientId].view.webContents.invalidate();
     //if current is client skip hiding old to avoid flicker/cpu/gpu changes
     if (clients[current] && current !== clientId)
-        clients[current].view.setVisible(false);
+        setClientVisible(current, false);
     windows[windowId].current = clientId;
 }
 
+/**
+ * Show or hide a client view, the client is told so it can stop rendering while hidden, when the session
+ * host is enabled a client hidden long enough is parked
+ * 
+ * @param {number} clientId The client id
+ * @param {boolean} visible Show or hide the client
+ */
+function setClientVisible(clientId, visible) {
+    const view = clients[clientId].view;
+    if (!view) return;
+    clearTimeout(clients[clientId].parkTimer);
+    delete clients[clientId].parkTimer;
+    if (!visible && getSetting('sessionHost'))
+        clients[clientId].parkTimer = setTimeout(() => parkClient(clientId).catch(logError), getSetting('sessionHostIdle') * 1000);
+    view.setVisible(visible);
+    onContentsLoaded(view.webContents).then(() => {
+        //send current state in case it changed again before loading finished
+        if (!view.webContents.isDestroyed())
+            view.webContents.send('client-visible', view.getVisible());
+    });
+}
+
 function clientIdFromContents(contents) {
     if (!contents) return null
     for (clientId in clients) {
-        if (!Object.prototype.hasOwnProperty.call(clients, clientId))
+        if (!Object.prototype.hasOwnProperty.call(clients, clientId) || !clients[clientId].view)
             continue;
         if (clients[clientId].view.webContents === contents)
             return clientId;
@@ -3680,7 +4042,7 @@ function windowFromContents(contents) {
 function clientFromContents(contents) {
     if (!contents) return null
     for (clientId in clients) {
-        if (!Object.prototype.hasOwnProperty.call(clients, clientId))
+        if (!Object.prototype.hasOwnProperty.call(clients, clientId) || !clients[clientId].view)
             continue;
         if (clients[clientId].view.webContents === contents)
             return clients[clientId];
@@ -3758,7 +4120,7 @@ function updateAll(options) {
         updateWebContents(windows[idx].webContents);
     }
     for (id in clients) {
-        if (!Object.prototype.hasOwnProperty.call(clients, id))
+        if (!Object.prototype.hasOwnProperty.call(clients, id) || !clients[id].view)
             continue;
         updateWebContents(clients[id].view.webContents, options);
     }
@@ -3867,7 +4229,7 @@ async function newClientWindow(caller, connection, data, name) {
             id = createClient({ parent: window.window, name: d === 0 ? name : null, bounds: window.window.getContentBounds(), data: { data: data[d] } });
             window.clients.push(id);
             window.window.contentView.addChildView(clients[id].view);
-            clients[id].view.setVisible(id === window.current);
+            setClientVisible(id, id === window.current);
         }
         focusedClient = id;
         for (var c = 0, cl = window.clients.length; c < cl; c++) {
@@ -4065,6 +4427,23 @@ async function saveWindowLayout(file, locked) {
         for (id in clients) {
             if (!Object.prototype.hasOwnProperty.call(clients, id))
                 continue;
+            //parked clients have no page so save what was kept when parked
+            if (clients[id].parked) {
+                data.clients.push({
+                    id: parseInt(id, 10),
+                    parent: clients[id].parent ? getWindowId(clients[id].parent) : -1,
+                    file: clients[id].file,
+                    windows: [],
+                    state: {
+                        bounds: clients[id].parked.bounds,
+                        devTools: false
+                    },
+                    data: templateObject(JSON.parse(JSON.stringify(clients[id].parked.data))),
+                    states: clients[id].states,
+                    name: clients[id].name
+                });
+                continue;
+            }
             const cData = {
                 id: getClientId(clients[id].view), //use function to ensure proper id data type
                 parent: clients[id].parent ? getWindowId(clients[id].parent) : -1,
@@ -4242,11 +4621,11 @@ function loadWindowLayout(file, charData) {
         for (var c = 0, cl = window.clients.length; c < cl; c++) {
             const clientId = window.clients[c];
             window.window.contentView.addChildView(clients[clientId].view);
-            clients[clientId].view.setVisible(true);
+            setClientVisible(clientId, true);
             clients[clientId].view.webContents.send('clients-changed', Object.keys(windows).length, window.clients.length);
             onContentsLoaded(clients[clientId].view.webContents).then(() => {
                 clients[clientId].view.webContents.send('clients-changed', Object.keys(windows).length, window.clients.length);
-                clients[clientId].view.setVisible(clientId === current);
+                setClientVisible(clientId, clientId === current);
             });
         }
         onContentsLoaded(window.window.webContents).then(() => {
@@ -5385,7 +5764,8 @@ ipcMain.on('reset-windows', (event, id) => {
             if (!Object.prototype.hasOwnProperty.call(clients, client))
                 continue;
             clients[client].states = {};
-            executeScript('resetWindows()', clients[client].view);
+            if (clients[client].view)
+                executeScript('resetWindows()', clients[client].view);
         }
     }
     event.returnValue = true;
@@ -5621,7 +6001,10 @@ async function createTray() {
         for (clientId in clients) {
             if (!Object.prototype.hasOwnProperty.call(clients, clientId))
                 continue;
-            clients[clientId].view.webContents.send('tray-click');
+            if (clients[clientId].parked)
+                executeClient(parseInt(clientId, 10), 'client.raise("tray-click");');
+            else
+                clients[clientId].view.webContents.send('tray-click');
         }
     });
 
@@ -5668,14 +6051,17 @@ async function createTray() {
         for (clientId in clients) {
             if (!Object.prototype.hasOwnProperty.call(clients, clientId))
                 continue;
-            clients[clientId].view.webContents.send('tray-double-click');
+            if (clients[clientId].parked)
+                executeClient(parseInt(clientId, 10), 'client.raise("tray-double-click");');
+            else
+                clients[clientId].view.webContents.send('tray-double-click');
         }
     });
 }
 
 function getClientConnectionState(clientId) {
     //STATE as NAME from/on DEV
-    let title = clients[clientId].view.webContents.getTitle();
+    let title = getClientTitle(clientId);
     //find if on dev
     let dev = title.split(/ on| from/);
     //if length 2 means on dev
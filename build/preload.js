@@ -18,8 +18,34 @@ window.setFullscreen = (state) => { ipcRenderer.invoke("window", "setFullscreen"
 window.showContext = (template, options, show, close) => ipcRenderer.invoke('show-context', template, options, show, close);
 window.getGlobal = (variable) => ipcRenderer.sendSync('get-global', variable);
 window.setGlobal = (variable, value) => ipcRenderer.send('set-global', variable, value);
-window.getSetting = (variable) => ipcRenderer.sendSync('get-setting', variable);
-window.setSetting = (variable, value) => ipcRenderer.send('set-setting', variable, value);
+//local mirror of simple setting values, main sends setting-changed when a value is changed so it can be fetched again
+const _settings = new Map();
+const invalidateSetting = (variable) => {
+    if (!variable) {
+        _settings.clear();
+        return;
+    }
+    _settings.delete(variable);
+    //parent or child of a dot notation setting
+    for (const key of _settings.keys()) {
+        if (key.startsWith(variable + '.') || variable.startsWith(key + '.'))
+            _settings.delete(key);
+    }
+};
+ipcRenderer.on('setting-changed', (event, variable) => invalidateSetting(variable));
+window.getSetting = (variable) => {
+    if (_settings.has(variable))
+        return _settings.get(variable);
+    const value = ipcRenderer.sendSync('get-setting', variable);
+    //objects are not cached as callers may alter the returned value
+    if (value === null || typeof value !== 'object')
+        _settings.set(variable, value);
+    return value;
+};
+window.setSetting = (variable, value) => {
+    invalidateSetting(variable);
+    ipcRenderer.send('set-setting', variable, value);
+};
 window.error = (error) => ipcRenderer.send('error', error);
 window.logError = (error, skipClient, title) => ipcRenderer.send('log-error', error, skipClient, title);
 window.debug = (message) => ipcRenderer.send('debug', message);
@@ -6,11 +6,13 @@ import { BackupSelection, Log } from './types';
 import { ProfileCollection, Profile, Alias, Macro, Button, Trigger, Context } from './profile';
 const fs = require('fs');
 const path = require('path');
-const sqlite3 = require('better-sqlite3');
 const LZString = require('lz-string');
 import { Settings, SettingProperties } from './settings';
 const { ipcRenderer } = require('electron');
 
+//marker the background worker prefixes to the first chunk of a streamed backup, must match backup.background.ts
+const STREAM_MARKER = 'JZ1:';
+
 /**
  * Control loading and saving system for ShadowMUD remote storage protocols
  *
@@ -25,6 +27,19 @@ export class Backup extends EventEmitter {
     //private _action;
     private _save;
     private _port;
+    private _url: string;
+    private _worker: Worker;
+    private _retries: number = 0;
+
+    /**
+     * Number of times to retry a failed request before aborting, for saves this is the total for the whole upload
+     */
+    public retries: number = 3;
+
+    /**
+     * Raw bytes per uploaded chunk, must be a multiple of 3, 0 to use the worker default
+     */
+    public chunkSize: number = 0;
 
     public mapFile: string = path.join(parseTemplate('{data}'), 'map.sqlite');
 
@@ -32,11 +47,20 @@ export class Backup extends EventEmitter {
     public saveSelection: BackupSelection = BackupSelection.All;
 
     get URL(): string {
+        if (this._url)
+            return this._url;
         if (this._port === 1035)
             return 'http://shadowmud.com:1132/client';
         return 'http://shadowmud.com:1130/client';
     }
 
+    /**
+     * Override the backup endpoint, eg a local server for testing, set to empty to use the default ShadowMUD endpoint
+     */
+    set URL(value: string) {
+        this._url = value;
+    }
+
     constructor(client: Client, map?: string) {
         super();
         if (!client)
@@ -50,6 +74,7 @@ export class Backup extends EventEmitter {
                 this.emit('close');
             this._save = 0;
             this._abort = false;
+            this.stopWorker();
         });
 
         this.client.on('closed', () => {
@@ -58,10 +83,11 @@ export class Backup extends EventEmitter {
                 this.emit('close');
             this._save = 0;
             this._abort = false;
+            this.stopWorker();
         });
 
-        this.client.on('received-GMCP', async (mod, obj) => {
-            if (mod.toLowerCase() !== 'client' || !obj) return;
+        this.client.onGMCP('Client', (mod, obj) => {
+            if (!obj) return;
             switch (obj.action) {
                 case 'save':
                     if (this._abort) return;
@@ -76,6 +102,7 @@ export class Backup extends EventEmitter {
                     this._abort = false;
                     this._user = obj.user;
                     //this._action = obj.action;
+                    this._retries = 0;
                     this._save = [obj.chunks || 1, obj.chunk || 0, obj.size, ''];
                     this.emit('progress-start', 'Loading data');
                     //this.getChunk();
@@ -93,9 +120,6 @@ export class Backup extends EventEmitter {
 
     public save(version?: number) {
         this.client.debug('Map file: ' + this.mapFile);
-        const _db = new sqlite3(this.mapFile);
-        const rows = _db.prepare('Select * FROM Rooms left join exits on Exits.ID = Rooms.ID').all();
-        _db.close();
         const data = {
             version: version,
             profiles: {},
@@ -199,48 +223,8 @@ export class Backup extends EventEmitter {
         for (p = 0, pl = props.length; p < pl; p++) {
             this.getProperty(this.client.options, data.settings, props[p], '', data.inherited);
         }
-        const rooms = {};
-        if (rows) {
-            const rl = rows.length;
-            for (let r = 0; r < rl; r++) {
-                if (!rows[r].ID || rows[r].ID.length === 0) continue;
-                rows[r].ID = parseInt(rows[r].ID, 10);
-                if (rooms[rows[r].ID]) {
-                    rooms[rows[r].ID].exits[rows[r].Exit] = {
-                        num: parseInt(rows[r].DestID, 10),
-                        isdoor: rows[r].IsDoor,
-                        isclosed: rows[r].IsClosed
-                    };
-                }
-                else {
-                    rooms[rows[r].ID] = { num: rows[r].ID };
-                    for (prop in rows[r]) {
-                        if (prop === 'ID')
-                            continue;
-                        if (!rows[r].hasOwnProperty(prop)) {
-                            continue;
-                        }
-                        rooms[rows[r].ID][prop.toLowerCase()] = rows[r][prop];
-                    }
-                    rooms[rows[r].ID].exits = {};
-                    if (rows[r].Exit) {
-                        rooms[rows[r].ID].exits[rows[r].Exit] = {
-                            num: parseInt(rows[r].DestID, 10),
-                            isdoor: rows[r].IsDoor,
-                            isclosed: rows[r].IsClosed
-                        };
-                    }
-                }
-            }
-            this.client.debug('Total mapper room/exits: ' + rows.length);
-        }
-        else
-            this.client.debug('No mapper data to save.');
-        data.map = rooms;
-        if ((this.saveSelection & BackupSelection.Map) !== BackupSelection.Map) {
-            delete data.map;
+        if ((this.saveSelection & BackupSelection.Map) !== BackupSelection.Map)
             this.client.debug('Setting for no mapper data enabled.');
-        }
         if ((this.saveSelection & BackupSelection.Profiles) !== BackupSelection.Profiles) {
             delete data.profiles;
             this.client.debug('Setting for no profiles enabled.');
@@ -258,11 +242,51 @@ export class Backup extends EventEmitter {
                 data.settings = <any>{ windows: windows };
             this.client.debug('Setting for no settings data enabled.');
         }
-        let jData = JSON.stringify(data);
-        jData = LZString.compressToEncodedURIComponent(jData);
-        this._save = [jData.match(/((\S|\s|.){1,20000})/g), 0, 0];
-        this._save[3] = this._save[0].length;
-        this.saveChunk();
+        //serialize each section on its own and let the worker stream them, along with the map rooms, through deflate
+        const sections = [];
+        const keys = Object.keys(data);
+        const kl = keys.length;
+        for (let k = 0; k < kl; k++) {
+            if (keys[k] === 'profiles' || keys[k] === 'map' || typeof data[keys[k]] === 'undefined')
+                continue;
+            sections.push(JSON.stringify(keys[k]) + ':' + JSON.stringify(data[keys[k]]));
+        }
+        let profiles;
+        if (data.profiles) {
+            profiles = [];
+            for (prop in data.profiles) {
+                if (!data.profiles.hasOwnProperty(prop))
+                    continue;
+                profiles.push(JSON.stringify(prop) + ':' + JSON.stringify(data.profiles[prop]));
+            }
+        }
+        this._retries = 0;
+        this._save = {
+            chunks: new Map<number, string>(), produced: 0, sent: 0, total: -1, retries: 0, progress: 0, busy: false,
+            request: {
+                action: 'save',
+                sections: sections,
+                profiles: profiles,
+                map: (this.saveSelection & BackupSelection.Map) === BackupSelection.Map ? this.mapFile : null,
+                chunkSize: this.chunkSize
+            }
+        };
+        this.startSave();
+    }
+
+    /**
+     * Start or restart producing chunks from the first one, the first chunk is sent with append
+     * off so the server replaces anything stored by an earlier attempt
+     */
+    private startSave() {
+        this._save.chunks.clear();
+        this._save.produced = 0;
+        this._save.sent = 0;
+        this._save.total = -1;
+        this._save.progress = 0;
+        this._save.busy = false;
+        this.startWorker();
+        this._worker.postMessage(this._save.request);
     }
 
     public abort(err?) {
@@ -273,6 +297,7 @@ export class Backup extends EventEmitter {
         this.emit('abort', err);
         this._save = 0;
         this._abort = true;
+        this.stopWorker();
         $.ajax({
             type: 'POST',
             url: this.URL,
@@ -288,6 +313,7 @@ export class Backup extends EventEmitter {
         this.emit('close');
         this._save = 0;
         this._abort = false;
+        this.stopWorker();
         $.ajax({
             type: 'POST',
             url: this.URL,
@@ -313,7 +339,7 @@ export class Backup extends EventEmitter {
                 },
                 dataType: 'json',
                 success: (data) => {
-                    if (this._abort) return;
+                    if (this._abort || !this._save) return;
                     if (!data)
                         this.abort('No data returned');
                     else if (data.error)
@@ -321,8 +347,9 @@ export class Backup extends EventEmitter {
                     else if (data.msg)
                         this.abort(data.msg || 'Error');                    
                     else {
+                        this._retries = 0;
                         this._save[1] = data.chunk || 0;
-                        this._save[3] += data.data || '';
+                        this.appendChunk(data.data || '');
                         this.client.debug('Got client chunk ' + this._save[1]);
                         this.emit('progress', (this._save[1] + 1) / this._save[0] * 100);
                         if (this._save[1] >= this._save[0] - 1)
@@ -332,12 +359,57 @@ export class Backup extends EventEmitter {
                     }
                 },
                 error: (data, error, errorThrown) => {
-                    this.abort(error);
+                    if (this._abort || !this._save) return;
+                    //resume from the same chunk index
+                    if (this._retries < this.retries) {
+                        this._retries++;
+                        this._save[1]--;
+                        this.client.debug(`Retrying client chunk ${this._save[1] + 1}, attempt ${this._retries}`);
+                        setTimeout(() => this.getChunk(), this._retries * 1000);
+                    }
+                    else
+                        this.abort(error);
                 }
             });
     }
 
+    /**
+     * Append a loaded chunk, stream backups are passed to the worker to inflate as they arrive
+     *
+     * @param chunk The chunk data
+     */
+    private appendChunk(chunk: string) {
+        if (typeof this._save[4] === 'undefined') {
+            this._save[4] = chunk.startsWith(STREAM_MARKER);
+            if (this._save[4]) {
+                this.startWorker();
+                this._worker.postMessage({ action: 'inflate-start' });
+            }
+        }
+        if (this._save[4])
+            this._worker.postMessage({ action: 'inflate', data: chunk });
+        else
+            this._save[3] += chunk;
+    }
+
+    /**
+     * Upload the next produced chunk, chunks are dropped once the server confirms them
+     *
+     * A failed request may still have been appended by the server, so only the first chunk, which
+     * replaces the stored data, is resent, any later failure restarts the whole upload
+     */
     public saveChunk() {
+        if (!this._save || this._save.busy || this._abort) return;
+        if (!this._save.chunks.has(this._save.sent)) {
+            //all produced chunks uploaded and worker finished
+            if (this._save.total !== -1 && this._save.sent >= this._save.total) {
+                this.emit('finish-save');
+                this.close();
+            }
+            return;
+        }
+        const index = this._save.sent;
+        this._save.busy = true;
         $.ajax(
             {
                 type: 'POST',
@@ -346,34 +418,102 @@ export class Backup extends EventEmitter {
                 {
                     user: this._user,
                     a: 'save',
-                    data: this._save[0].shift(),
-                    append: (this._save[1] > 0 ? 1 : 0)
+                    data: this._save.chunks.get(index),
+                    append: (index > 0 ? 1 : 0),
+                    c: index
                 },
                 dataType: 'json',
                 success: (data) => {
+                    if (!this._save || this._abort) return;
+                    this._save.busy = false;
                     if (!data)
                         this.abort('No data returned');
                     else if (data.msg !== 'Successfully saved')
                         this.abort(data.msg || 'Error');
                     else if (data.error)
-                        this.abort(data.error);                    
-                    else if (this._save[0].length > 0) {
-                        this.emit('progress', this._save[1] / this._save[3] * 100);
-                        this._save[1]++;
-                        this.saveChunk();
-                    }
+                        this.abort(data.error);
                     else {
-                        if (typeof (this._save[2]) === 'function') this._save[2]();
-                        this.emit('finish-save');
-                        this.close();
+                        this._save.chunks.delete(index);
+                        this._save.sent++;
+                        this._worker.postMessage({ action: 'ack', index: index });
+                        if (this._save.total !== -1)
+                            this.emit('progress', this._save.sent / this._save.total * 100);
+                        else
+                            this.emit('progress', this._save.progress * this._save.sent / this._save.produced * 100);
+                        this.saveChunk();
                     }
                 },
                 error: (data, error, errorThrown) => {
-                    this.abort(error);
+                    if (!this._save || this._abort) return;
+                    this._save.busy = false;
+                    if (this._retries < this.retries) {
+                        this._retries++;
+                        if (index === 0) {
+                            this.client.debug(`Retrying client chunk 0, attempt ${this._retries}`);
+                            setTimeout(() => this.saveChunk(), this._retries * 1000);
+                        }
+                        else {
+                            //stop producing until the restart so no chunk is sent out of order
+                            this.stopWorker();
+                            this._save.busy = true;
+                            this.client.debug(`Restarting save after client chunk ${index} failed, attempt ${this._retries}`);
+                            setTimeout(() => {
+                                if (this._save && !this._abort)
+                                    this.startSave();
+                            }, this._retries * 1000);
+                        }
+                    }
+                    else
+                        this.abort(error);
                 }
             });
     }
 
+    private startWorker() {
+        this.stopWorker();
+        this._worker = new Worker('./js/backup.background.js');
+        this._worker.onmessage = (e) => {
+            if (!this._save) return;
+            switch (e.data.event) {
+                case 'chunk':
+                    this._save.chunks.set(e.data.index, e.data.data);
+                    this._save.produced = e.data.index + 1;
+                    this.saveChunk();
+                    break;
+                case 'progress':
+                    this._save.progress = e.data.value;
+                    if (e.data.hasOwnProperty('rooms'))
+                        this.client.debug('Total mapper rooms: ' + e.data.rooms);
+                    break;
+                case 'done':
+                    this._save.total = e.data.chunks;
+                    this.client.debug('Total client chunks: ' + e.data.chunks);
+                    this.saveChunk();
+                    break;
+                case 'inflated':
+                    this._save[3] = '';
+                    try {
+                        this.loadData(e.data.data);
+                    }
+                    catch (err) {
+                        this.emit('error', err);
+                        this.abort(err.message || err);
+                    }
+                    break;
+                case 'error':
+                    this.emit('error', e.data.error);
+                    this.abort(e.data.error);
+                    break;
+            }
+        };
+    }
+
+    private stopWorker() {
+        if (!this._worker) return;
+        this._worker.terminate();
+        this._worker = null;
+    }
+
     /*
     public reset() {
 
@@ -382,8 +522,14 @@ export class Backup extends EventEmitter {
 
     public finishLoad() {
         this.client.debug('Got last chunk, processing data');
-        let data = LZString.decompressFromEncodedURIComponent(this._save[3]);
-        data = JSON.parse(data);
+        if (this._save[4]) {
+            this._worker.postMessage({ action: 'inflate-end' });
+            return;
+        }
+        this.loadData(JSON.parse(LZString.decompressFromEncodedURIComponent(this._save[3])));
+    }
+
+    private loadData(data) {
         if (data.version === 2) {
             if (data.map && (this.loadSelection & BackupSelection.Map) === BackupSelection.Map)
                 this.emit('import-map', data.map);
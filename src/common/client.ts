@@ -3,19 +3,23 @@
 
 import { EventEmitter } from 'events';
 import { Telnet, TelnetOption } from './telnet';
-import { ParserLine, ProfileSaveType } from './types';
+import { ParserLine, ProfileSaveType, Size } from './types';
 import { AnsiColorCode } from './ansi';
 import { parseTemplate, SortItemArrayByPriority, existsSync } from './library';
 import { Settings } from './settings';
 import { Input } from './input';
 import { ProfileCollection, Alias, Trigger, Alarm, Macro, Profile, Button, Context, TriggerType, SubTriggerTypes } from './profile';
 import { MSP } from './msp';
-import { Display } from './display';
+import { Display, HeadlessDisplay } from './display';
+import { Tracer, TracePipeline } from './tracer';
 const { version } = require('../../package.json');
 const path = require('path');
 const fs = require('fs');
 const moment = require('moment');
 
+//state modules only the latest value matters for, merged and dispatched once per frame
+const GMCP_COALESCE = new Set<string>(['char.vitals', 'omud.ac', 'omud.limb']);
+
 interface ItemCache {
     alarmPatterns: any[];
     alarms: Trigger[];
@@ -53,6 +57,18 @@ export class Client extends EventEmitter {
     private _profileSaves = {}; //store profile to save/change flag
     private _profileSaveTimeout: NodeJS.Timeout = null; //track timeout
     private _optionCache = {};
+    private _gmcpRoutes = new Map<string, ((mod: string, data: any) => void)[]>();
+    private _gmcpPending = new Map<string, any>();
+    private _gmcpFrame: number = 0;
+    private _gmcpQueue = [];
+    private _gmcpParsing = new Map<number, any>();
+    private _gmcpID: number = 0;
+    private _gmcpWorker: Worker;
+
+    /**
+     * GMCP payloads this size or larger are parsed in a background worker
+     */
+    public gmcpWorkerSize: number = 16384;
 
     public MSP: MSP;
 
@@ -64,6 +80,8 @@ export class Client extends EventEmitter {
     public options: Settings;
 
     public telnet: Telnet;
+    //stage timings from socket to paint and key press to send, only recorded when enabled
+    public tracer: Tracer = new Tracer();
     public profiles: ProfileCollection;
     public connectTime: number = 0;
     public disconnectTime: number = 0;
@@ -402,6 +420,30 @@ export class Client extends EventEmitter {
         return this._input.commandHistory;
     }
 
+    public get profiling() {
+        return this._input.profiling;
+    }
+
+    public set profiling(value: boolean) {
+        this._input.profiling = value;
+    }
+
+    public resetProfiling() {
+        this._input.resetProfiling();
+    }
+
+    public getProfilingReport() {
+        return this._input.getProfilingReport();
+    }
+
+    public get parseStats() {
+        return this.display.parseStats;
+    }
+
+    public resetParseStats() {
+        this.display.resetParseStats();
+    }
+
     public get indices() {
         return this._input.indices;
     }
@@ -955,7 +997,12 @@ export class Client extends EventEmitter {
             throw new Error('Missing command input');
         }
 
-        this.display = new Display(display);
+        //the session host has no page so uses a display that only keeps the lines
+        if (display instanceof HeadlessDisplay)
+            this.display = <any>display;
+        else
+            this.display = new Display(display);
+        this.display.tracer = this.tracer;
 
         this.display.click((event) => {
             if (this.getOption('CommandonClick'))
@@ -1012,6 +1059,7 @@ export class Client extends EventEmitter {
         this.commandInput.focus();
 
         this.telnet = new Telnet();
+        this.telnet.tracer = this.tracer;
         this.telnet.terminal = 'jiMUD';
         this.telnet.version = version;
         this.telnet.on('error', (err) => {
@@ -1088,22 +1136,14 @@ export class Client extends EventEmitter {
         });
 
         this.telnet.on('received-GMCP', (data) => {
-            let val: string = data.value;
-            let mod: string;
-            let idx: number = 0;
-            const dl: number = val.length;
-            let c;
-            if (dl === 0) return;
-            for (idx = 0; idx < dl; idx++) {
-                c = val.charAt(idx);
-                if (c === ' ' || c === '{' || c === '[')
-                    break;
-            }
-            mod = val.substr(0, idx).trim();
-            val = val.substr(idx).trim();
+            const mod: string = data.module;
+            const val: string = data.data;
+            let obj;
+            if (mod.length === 0) return;
             this.debug('GMCP Module: ' + mod);
             this.debug('GMCP Data: ' + val);
-            let obj;
+            //nothing wants the module so skip parsing it
+            if (!this.hasGMCPListener(mod)) return;
             if (mod.toLowerCase() === 'client.gui') {
                 obj = val.split('/n');
                 if (val.length >= 2) {
@@ -1120,7 +1160,12 @@ export class Client extends EventEmitter {
                 }
                 else
                     obj = { version: obj, url: '' };
-                this.emit('received-GMCP', mod, obj);
+                this.queueGMCP({ module: mod, data: obj, ready: true });
+                return;
+            }
+            //large payloads are parsed in the background, smaller ones queue behind them to keep order
+            if (val.length >= this.gmcpWorkerSize) {
+                this.parseGMCP(mod, val);
                 return;
             }
             try {
@@ -1131,7 +1176,9 @@ export class Client extends EventEmitter {
                 this.error('Invalid GMCP');
                 return;
             }
-            this.emit('received-GMCP', mod, obj);
+            this.queueGMCP({ module: mod, data: obj, ready: true });
+        });
+        this.onGMCP('Client.Media.*', (mod, obj) => {
             this.MSP.processGMCP(mod, obj);
         });
 
@@ -1177,6 +1224,17 @@ export class Client extends EventEmitter {
         this.display.on('parse-done', () => {
             this.emit('parse-done');
         });
+        //stop reading from the host while the parser works through a large backlog
+        this.display.on('backpressure', (paused, backlog) => {
+            if (paused) {
+                this.telnet.pause();
+                this.debug('Input paused, ' + backlog + ' characters waiting to be parsed');
+            }
+            else {
+                this.telnet.resume();
+                this.debug('Input resumed');
+            }
+        });
         this.display.on('set-title', (title, type) => {
             if (typeof title === 'undefined' || title == null || title.length === 0)
                 this.emit('set-title', this.getOption('title').replace('$t', this.defaultTitle) || this.defaultTitle);
@@ -1242,6 +1300,7 @@ export class Client extends EventEmitter {
         this.display.enableColors = this.getOption('display.enableColors');
         this.display.enableBackgroundColors = this.getOption('display.enableBackgroundColors');
         this.display.defaultMXPState = this.getOption('display.defaultMXPState');
+        this.display.hotLines = this.getOption('display.hotLines');
         const colors = this.getOption('colors');
         if (colors && colors.length > 0) {
             let c;
@@ -1450,6 +1509,160 @@ export class Client extends EventEmitter {
         this.lastSendTime = Date.now();
     }
 
+    /**
+     * Subscribe to a GMCP module, state modules are merged and dispatched once per frame
+     *
+     * @param mod The module name, case insensitive, Package.* matches every module in a package
+     * @param handler The function to call with the module name and data
+     */
+    public onGMCP(mod: string, handler: (mod: string, data: any) => void) {
+        mod = mod.toLowerCase();
+        const handlers = this._gmcpRoutes.get(mod);
+        if (handlers)
+            handlers.push(handler);
+        else
+            this._gmcpRoutes.set(mod, [handler]);
+    }
+
+    /**
+     * Remove a GMCP module subscription
+     *
+     * @param mod The module name used to subscribe
+     * @param handler The function to remove
+     */
+    public offGMCP(mod: string, handler: (mod: string, data: any) => void) {
+        mod = mod.toLowerCase();
+        const handlers = this._gmcpRoutes.get(mod);
+        if (!handlers) return;
+        const idx = handlers.indexOf(handler);
+        if (idx !== -1)
+            handlers.splice(idx, 1);
+        if (handlers.length === 0)
+            this._gmcpRoutes.delete(mod);
+    }
+
+    /**
+     * Get the handlers subscribed to a module, including package wildcards
+     *
+     * @param mod The lower case module name
+     */
+    private gmcpHandlers(mod: string) {
+        let handlers = this._gmcpRoutes.get(mod) || [];
+        let idx = mod.lastIndexOf('.');
+        while (idx !== -1) {
+            mod = mod.substring(0, idx);
+            if (this._gmcpRoutes.has(mod + '.*'))
+                handlers = handlers.concat(this._gmcpRoutes.get(mod + '.*'));
+            idx = mod.lastIndexOf('.');
+        }
+        return handlers;
+    }
+
+    private hasGMCPListener(mod: string) {
+        return this.listenerCount('received-GMCP') !== 0 || this.gmcpHandlers(mod.toLowerCase()).length !== 0;
+    }
+
+    /**
+     * Send a large GMCP payload to the background parser, holding its place in the queue
+     *
+     * @param mod The module name
+     * @param data The json text
+     */
+    private parseGMCP(mod: string, data: string) {
+        if (!this._gmcpWorker) {
+            this._gmcpWorker = new Worker('./js/gmcp.background.js');
+            this._gmcpWorker.onmessage = (e) => {
+                const item = this._gmcpParsing.get(e.data.id);
+                if (!item) return;
+                this._gmcpParsing.delete(e.data.id);
+                if (e.data.event === 'error') {
+                    this.error('Invalid GMCP');
+                    item.module = null;
+                }
+                else
+                    item.data = e.data.data;
+                item.ready = true;
+                this.queueGMCP(null);
+            };
+            this._gmcpWorker.onerror = (e) => {
+                //fail any pending parses so the queue is not stuck
+                this._gmcpParsing.forEach(item => {
+                    item.module = null;
+                    item.ready = true;
+                });
+                this._gmcpParsing.clear();
+                this.error(e);
+                this.queueGMCP(null);
+            };
+        }
+        const item = { module: mod, data: null, ready: false };
+        this._gmcpParsing.set(++this._gmcpID, item);
+        this._gmcpWorker.postMessage({ action: 'parse', id: this._gmcpID, data: data });
+        this._gmcpQueue.push(item);
+    }
+
+    /**
+     * Add a parsed GMCP message and dispatch all ready messages in arrival order
+     *
+     * @param item The message to add, or null to just dispatch
+     */
+    private queueGMCP(item) {
+        if (item) {
+            //nothing waiting on the worker so skip the queue
+            if (this._gmcpQueue.length === 0) {
+                this.dispatchGMCP(item.module, item.data);
+                return;
+            }
+            this._gmcpQueue.push(item);
+        }
+        while (this._gmcpQueue.length && this._gmcpQueue[0].ready) {
+            item = this._gmcpQueue.shift();
+            if (item.module)
+                this.dispatchGMCP(item.module, item.data);
+        }
+    }
+
+    /**
+     * Dispatch a parsed GMCP message to received-GMCP listeners and module subscribers
+     *
+     * @param mod The module name
+     * @param obj The parsed data
+     */
+    public dispatchGMCP(mod: string, obj) {
+        const lower = mod.toLowerCase();
+        let handlers;
+        let h;
+        let hl;
+        this.emit('received-GMCP', mod, obj);
+        if (GMCP_COALESCE.has(lower)) {
+            //merge so partial updates like single limbs are not lost, only latest value of each key matters
+            if (this._gmcpPending.has(lower) && obj && typeof obj === 'object' && !Array.isArray(obj))
+                Object.assign(this._gmcpPending.get(lower).data, obj);
+            else
+                this._gmcpPending.set(lower, { module: mod, data: obj && typeof obj === 'object' && !Array.isArray(obj) ? Object.assign({}, obj) : obj });
+            if (!this._gmcpFrame)
+                this._gmcpFrame = window.requestAnimationFrame(() => this.flushGMCP());
+            return;
+        }
+        handlers = this.gmcpHandlers(lower);
+        for (h = 0, hl = handlers.length; h < hl; h++)
+            handlers[h](mod, obj);
+    }
+
+    private flushGMCP() {
+        let handlers;
+        let h;
+        let hl;
+        this._gmcpFrame = 0;
+        const pending = this._gmcpPending;
+        this._gmcpPending = new Map<string, any>();
+        pending.forEach((item, mod) => {
+            handlers = this.gmcpHandlers(mod);
+            for (h = 0, hl = handlers.length; h < hl; h++)
+                handlers[h](item.module, item.data);
+        });
+    }
+
     public debug(str: string, style?) {
         const data = { value: str };
         this.emit('debug', data);
@@ -1476,7 +1689,9 @@ export class Client extends EventEmitter {
         if (!txt.endsWith('\n'))
             txt = txt + '\n';
         const data = { value: txt, handled: false, comments: comments };
+        const start = this.tracer.enabled ? performance.now() : 0;
         this.emit('parse-command', data);
+        if (start) this.tracer.record('aliases', TracePipeline.Input, start);
         if (data == null || typeof data === 'undefined') return;
         if (data.handled || data.value == null || typeof data.value === 'undefined') return;
         if (data.value.length > 0)
@@ -1527,6 +1742,96 @@ export class Client extends EventEmitter {
         this.telnet.close();
     }
 
+    /**
+     * Get the state of the session so another client can take over the connection
+     *
+     * @returns {Object} The session state
+     */
+    public getSession() {
+        const profiles = [];
+        const keys = this.profiles.keys;
+        const kl = keys.length;
+        for (let k = 0; k < kl; k++)
+            profiles.push(this.profiles.items[keys[k]].toData());
+        const input = this._input.getSession();
+        const session = {
+            variables: this.variables,
+            triggerStates: input.triggerStates,
+            commandHistory: input.commandHistory,
+            profiles: profiles,
+            profileSaves: this._profileSaves,
+            connectTime: this.connectTime,
+            disconnectTime: this.disconnectTime,
+            lastSendTime: this.lastSendTime,
+            telnet: this.telnet.saveState(),
+            lines: this.display.model.saveLines(),
+            windowSize: { width: this.display.WindowSize.width, height: this.display.WindowSize.height }
+        };
+        //pending saves move with the session
+        this.clearProfileSaves();
+        return session;
+    }
+
+    /**
+     * Continue a session that was not handed off, restarts any pending profile saves
+     */
+    public resumeSession() {
+        if (Object.keys(this._profileSaves).length)
+            this.doProfileSave();
+    }
+
+    /**
+     * Take over a session from another client
+     *
+     * @param {Object} state The state from getSession
+     * @param {object} socket The socket still connected to the host
+     */
+    public restoreSession(state, socket?) {
+        if (!state) return;
+        this.variables = state.variables || {};
+        this.clearProfileSaves();
+        this.profiles = new ProfileCollection();
+        const pl = state.profiles ? state.profiles.length : 0;
+        for (let p = 0; p < pl; p++)
+            this.profiles.add(Profile.load(state.profiles[p]), true);
+        if (!this.profiles.contains('default'))
+            this.profiles.add(Profile.Default, true);
+        this.profiles.update();
+        this.clearCache();
+        //trigger states are cleared with the cache so restore after
+        this._input.restoreSession(state);
+        this.startAlarms();
+        this.emit('profiles-loaded');
+        this._profileSaves = state.profileSaves || {};
+        if (Object.keys(this._profileSaves).length)
+            this.doProfileSave();
+        //a page sizes from its own window, the host keeps the size it was last shown at
+        if (state.windowSize && this.display instanceof HeadlessDisplay)
+            this.display.WindowSize = new Size(state.windowSize.width, state.windowSize.height);
+        this.display.restoreLines(state.lines || []);
+        this.telnet.restoreState(state.telnet, socket);
+        this.connecting = false;
+        this.connectTime = state.connectTime;
+        this.disconnectTime = state.disconnectTime;
+        this.lastSendTime = state.lastSendTime;
+        this.display.scrollDisplay(true);
+    }
+
+    /**
+     * Stop timers and events so a client with out a page can be released
+     */
+    public dispose() {
+        this.clearProfileSaves();
+        if (this._alarm) {
+            clearInterval(this._alarm);
+            this._alarm = null;
+        }
+        this._input.clearCaches();
+        this.telnet.removeAllListeners();
+        this.display.removeAllListeners();
+        this.removeAllListeners();
+    }
+
     public connect() {
         this.errored = false;
         this.emit('connecting');
@@ -15,7 +15,7 @@ export interface DataGridOptions {
     rows?: any[];
 }
 
-export enum UpdateType { none = 0, columns = 1, rows = 2, resize = 4, sort = 8, resizeHeight = 16, resizeWidth = 32, buildRows = 64, buildColumns = 128, headerWidth = 256 }
+export enum UpdateType { none = 0, columns = 1, rows = 2, resize = 4, sort = 8, resizeHeight = 16, resizeWidth = 32, buildRows = 64, buildColumns = 128, headerWidth = 256, renderRows = 512 }
 
 export class Column {
     public label = '';
@@ -117,6 +117,21 @@ export class DataGrid extends EventEmitter {
     private $enterMoveNext: boolean | Function = true;
     private $enterMoveFirst: boolean | Function = true;
     private $enterMoveNew: boolean | Function = true;
+    private $virtual = false;
+    private $rowHeight = 0;
+    private $measuredHeight = 0;
+    //rows laid out in virtual mode as [row, dataIndex, parent, child]
+    private $virtualRows = [];
+    //first and last row rendered between the spacers
+    private $renderStart = 0;
+    private $renderEnd = -1;
+    //rendered rows released when they left the view, filled again before creating new rows
+    private $rowPool: HTMLElement[] = [];
+
+    /**
+     * Number of extra rows to render above and below the visible area in virtual mode
+     */
+    public overscan = 10;
 
     get enterMoveNext() {
         if (typeof this.$enterMoveNext === 'function')
@@ -148,6 +163,36 @@ export class DataGrid extends EventEmitter {
         this.$enterMoveNew = value;
     }
 
+    /**
+     * Only render rows that are visible, rows above and below are stood in for by two fixed height spacers
+     */
+    get virtual() {
+        return this.$virtual;
+    }
+    set virtual(value) {
+        if (value === this.$virtual) return;
+        this.$virtual = value;
+        this.$virtualRows = [];
+        this.$rowPool = [];
+        this.$renderStart = 0;
+        this.$renderEnd = -1;
+        this.doUpdate(UpdateType.buildRows);
+    }
+
+    /**
+     * Fixed row height for virtual mode, 0 to measure the first row
+     */
+    get rowHeight() {
+        return this.$rowHeight;
+    }
+    set rowHeight(value) {
+        if (value === this.$rowHeight) return;
+        this.$rowHeight = value;
+        this.$measuredHeight = 0;
+        if (this.$virtual)
+            this.doUpdate(UpdateType.buildRows);
+    }
+
     get showChildren() {
         return this.$children;
     }
@@ -191,7 +236,8 @@ export class DataGrid extends EventEmitter {
         if (!this.$allowMultiSelection && this.$selected.length > 1) {
             Array.from(this.$body.querySelectorAll('.selected'), a => a.classList.remove('selected'));
             this.$selected = this.$selected.slice(0, 1);
-            (<HTMLElement>this.$body.firstChild).children[this.$selected[0]].classList.add('selected');
+            if (this.rowElement(this.$selected[0]))
+                this.rowElement(this.$selected[0]).classList.add('selected');
         }
     }
     get allowMultipleSelection() { return this.$allowMultiSelection; }
@@ -250,7 +296,7 @@ export class DataGrid extends EventEmitter {
                         if (this.$focused === -1) {
                             this.$focused = 0;
                         }
-                        el = (<HTMLElement>this.$body.firstChild).children[this.$focused];
+                        el = this.ensureRow(this.$focused);
                         el.classList.add('focused');
                         this.scrollToRow(el);
                         if (el.classList.contains('selected')) {
@@ -273,27 +319,27 @@ export class DataGrid extends EventEmitter {
                     }
                     break;
                 case 37: //left
-                    if (this.$focused >= 0 && this.$focused < (<HTMLElement>this.$body.firstChild).children.length) {
-                        el = (<HTMLElement>this.$body.firstChild).children[this.$focused];
+                    if (this.$focused >= 0 && this.$focused < this.rowCount) {
+                        el = this.ensureRow(this.$focused);
                         if (el) {
                             this.collapseRows(+el.dataset.row).then(() => {
                                 el = this.$body.firstElementChild.querySelector('[data-row="' + el.dataset.row + '"][data-parent="-1"]');
-                                idx = [...el.parentElement.children].indexOf(el);
+                                idx = this.rowIndex(el);
                                 if (idx !== this.$focused) {
                                     Array.from(this.$body.querySelectorAll('.focused'), a => a.classList.remove('focused'));
                                     Array.from(this.$body.querySelectorAll('.selected'), a => a.classList.remove('selected'));
                                     this.$focused = idx;
                                     this.$selected = [this.$focused];
-                                    (<HTMLElement>this.$body.firstChild).children[this.$focused].classList.add('selected', 'focused');
-                                    this.scrollToRow((<HTMLElement>this.$body.firstChild).children[this.$focused]);
+                                    this.rowElement(this.$focused).classList.add('selected', 'focused');
+                                    this.scrollToRow(this.rowElement(this.$focused));
                                 }
                             });
                         }
                     }
                     break;
                 case 39: //right
-                    if (this.$focused >= 0 && this.$focused < (<HTMLElement>this.$body.firstChild).children.length) {
-                        el = (<HTMLElement>this.$body.firstChild).children[this.$focused];
+                    if (this.$focused >= 0 && this.$focused < this.rowCount) {
+                        el = this.ensureRow(this.$focused);
                         if (el)
                             this.expandRows(+el.dataset.row);
                     }
@@ -304,11 +350,11 @@ export class DataGrid extends EventEmitter {
                         this.$focused = 0;
                     else if (this.$focused > 0) {
                         this.$focused--;
-                        while (this.$focused > 0 && (<HTMLElement>(<HTMLElement>this.$body.firstChild).children[this.$focused]).style.display !== '')
+                        while (this.$focused > 0 && this.rowHidden(this.$focused))
                             this.$focused--;
                     }
                     if (e.ctrlKey) {
-                        el = (<HTMLElement>this.$body.firstChild).children[this.$focused];
+                        el = this.ensureRow(this.$focused);
                         el.classList.add('focused');
                         this.scrollToRow(el);
                     }
@@ -320,7 +366,7 @@ export class DataGrid extends EventEmitter {
                             start = this.$shiftStart;
                         else
                             start = this.$selected[0];
-                        el = (<HTMLElement>this.$body.firstChild).children[this.$focused];
+                        el = this.ensureRow(this.$focused);
                         el.classList.add('focused');
                         this.$selected = [];
                         if (!this.$allowMultiSelection) {
@@ -334,7 +380,7 @@ export class DataGrid extends EventEmitter {
                             cnt = end - start + 1;
                             for (; end >= start; end--)
                                 this.$selected.push(end);
-                            while (el && cnt--) {
+                            while (el && el.classList.contains('datagrid-row') && cnt--) {
                                 el.classList.add('selected');
                                 el = <HTMLElement>el.nextSibling;
                             }
@@ -345,7 +391,7 @@ export class DataGrid extends EventEmitter {
                             this.$shiftStart = start;
                             for (; start <= end; start++)
                                 this.$selected.push(start);
-                            while (el && cnt--) {
+                            while (el && el.classList.contains('datagrid-row') && cnt--) {
                                 el.classList.add('selected');
                                 el = <HTMLElement>el.previousSibling;
                             }
@@ -354,22 +400,22 @@ export class DataGrid extends EventEmitter {
                     else {
                         Array.from(this.$body.querySelectorAll('.selected'), a => a.classList.remove('selected'));
                         this.$selected = [this.$focused];
-                        (<HTMLElement>this.$body.firstChild).children[this.$focused].classList.add('selected', 'focused');
-                        this.scrollToRow((<HTMLElement>this.$body.firstChild).children[this.$focused]);
+                        this.ensureRow(this.$focused).classList.add('selected', 'focused');
+                        this.scrollToRow(this.rowElement(this.$focused));
                         this.$shiftStart = this.$focused;
                     }
                     this.emit('selection-changed');
                     break;
                 case 40: //down
                     Array.from(this.$body.querySelectorAll('.focused'), a => a.classList.remove('focused'));
-                    if (this.$focused < (<HTMLElement>this.$body.firstChild).children.length - 1) {
+                    if (this.$focused < this.rowCount - 1) {
                         this.$focused++;
-                        const l = (<HTMLElement>this.$body.firstChild).children.length - 1;
-                        while (this.$focused <= l && (<HTMLElement>(<HTMLElement>this.$body.firstChild).children[this.$focused]).style.display !== '')
+                        const l = this.rowCount - 1;
+                        while (this.$focused <= l && this.rowHidden(this.$focused))
                             this.$focused++;
                     }
                     if (e.ctrlKey) {
-                        el = (<HTMLElement>this.$body.firstChild).children[this.$focused];
+                        el = this.ensureRow(this.$focused);
                         el.classList.add('focused');
                         this.scrollToRow(el);
                     }
@@ -379,7 +425,7 @@ export class DataGrid extends EventEmitter {
                             start = this.$focused !== -1 ? this.$focused : 0;
                         else
                             start = this.$selected[0];
-                        el = (<HTMLElement>this.$body.firstChild).children[this.$focused];
+                        el = this.ensureRow(this.$focused);
                         el.classList.add('focused');
                         if (!this.$allowMultiSelection) {
                             this.$selected = [this.$focused];
@@ -391,7 +437,7 @@ export class DataGrid extends EventEmitter {
                             cnt = end - start + 1;
                             for (; end >= start; end--)
                                 this.$selected.push(end);
-                            while (el && cnt--) {
+                            while (el && el.classList.contains('datagrid-row') && cnt--) {
                                 el.classList.add('selected');
                                 el = <HTMLElement>el.nextSibling;
                             }
@@ -401,7 +447,7 @@ export class DataGrid extends EventEmitter {
                             cnt = end - start + 1;
                             for (; start <= end; start++)
                                 this.$selected.push(start);
-                            while (el && cnt--) {
+                            while (el && el.classList.contains('datagrid-row') && cnt--) {
                                 el.classList.add('selected');
                                 el = <HTMLElement>el.previousSibling;
                             }
@@ -410,8 +456,8 @@ export class DataGrid extends EventEmitter {
                     else {
                         Array.from(this.$body.querySelectorAll('.selected'), a => a.classList.remove('selected'));
                         this.$selected = [this.$focused];
-                        (<HTMLElement>this.$body.firstChild).children[this.$focused].classList.add('selected', 'focused');
-                        this.scrollToRow((<HTMLElement>this.$body.firstChild).children[this.$focused]);
+                        this.ensureRow(this.$focused).classList.add('selected', 'focused');
+                        this.scrollToRow(this.rowElement(this.$focused));
                     }
                     this.emit('selection-changed');
                     break;
@@ -439,7 +485,7 @@ export class DataGrid extends EventEmitter {
         });
 
         this.$parent.addEventListener('keyup', e => {
-            if ((e.key === 'Enter' || e.key === 'F2') && this.$focused >= 0 && this.$focused < (<HTMLElement>this.$body.firstChild).children.length) {
+            if ((e.key === 'Enter' || e.key === 'F2') && this.$focused >= 0 && this.$focused < this.rowCount) {
                 this.beginEditRow(this.$focused);
                 e.preventDefault();
                 e.stopPropagation();
@@ -509,6 +555,8 @@ export class DataGrid extends EventEmitter {
             this.$header.style.transform = 'translate(-' + (<HTMLElement>e.currentTarget).scrollLeft + 'px,0)';
             if (this.$editor && this.$editor.editors.length > 0)
                 this.$editor.editors.forEach(ed => ed.editor.scroll());
+            if (this.$virtual)
+                this.doUpdate(UpdateType.renderRows);
         });
         el.addEventListener('contextmenu', (e) => {
             (<any>e).editor = this.$editor;
@@ -540,7 +588,7 @@ export class DataGrid extends EventEmitter {
                         if (this.$editor && this.$editor.el !== eRow && !this.clearEditor())
                             return;
                         //var sIdx = +eRow.dataset.row;
-                        this.beginEditRow([...eRow.parentElement.children].indexOf(eRow));
+                        this.beginEditRow(this.rowIndex(eRow));
                     }
                 });
             }
@@ -982,8 +1030,9 @@ export class DataGrid extends EventEmitter {
         Array.from(this.$body.querySelectorAll('.selected'), a => a.classList.remove('selected'));
         this.$selected = rows;
         this.$selected.forEach(r => {
-            const el = <HTMLElement>(<HTMLElement>this.$body.firstChild).children[r];
-            el.classList.add('selected');
+            const el = this.rowElement(r);
+            if (el)
+                el.classList.add('selected');
         });
         if (scroll)
             this.scrollToRow(this.$selected[0]);
@@ -1004,10 +1053,10 @@ export class DataGrid extends EventEmitter {
             indexes = [indexes[0]];
         Array.from(this.$body.querySelectorAll('.selected'), a => a.classList.remove('selected'));
         this.$selected = indexes.map(i => this.$sortedRows.indexOf(i));
-        const rows = <HTMLElement>(<HTMLElement>this.$body.firstChild);
+        const count = this.rowCount;
         this.$selected.forEach(r => {
-            if (r < 0 || r >= rows.children.length) return;
-            const el = rows.children[r];
+            if (r < 0 || r >= count) return;
+            const el = this.rowElement(r);
             if (el)
                 el.classList.add('selected');
         });
@@ -1130,11 +1179,22 @@ export class DataGrid extends EventEmitter {
         let parent;
         let child;
         while (sl--) {
-            el = (<HTMLElement>(<HTMLElement>this.$body.firstChild).children[this.$selected[sl]]);
-            if (!el) continue;
-            dataIndex = +el.dataset.dataIndex;
-            parent = +el.dataset.parent;
-            child = +el.dataset.child;
+            //virtual rows that are not rendered have no element
+            if (this.$virtual) {
+                const vRow = this.$virtualRows[this.$selected[sl]];
+                if (!vRow) continue;
+                el = this.rowElement(this.$selected[sl]);
+                dataIndex = vRow[1];
+                parent = vRow[2];
+                child = vRow[3];
+            }
+            else {
+                el = this.rowElement(this.$selected[sl]);
+                if (!el) continue;
+                dataIndex = +el.dataset.dataIndex;
+                parent = +el.dataset.parent;
+                child = +el.dataset.child;
+            }
             if (parent === -1)
                 rows.unshift({
                     data: this.$rows[dataIndex],
@@ -1172,18 +1232,18 @@ export class DataGrid extends EventEmitter {
             return;
         }
         if (typeof cEl === 'number')
-            cEl = (<HTMLElement>(<HTMLElement>this.$body.firstChild).children[cEl]);
-        else if (!cEl)
+            cEl = this.ensureRow(cEl);
+        if (!cEl)
             return;
-        const row = [...cEl.parentElement.children].indexOf(cEl);
+        const row = this.rowIndex(cEl);
         const e = { preventDefault: false, el: cEl, parent: +cEl.dataset.parent, child: +cEl.dataset.child, row: row, dataIndex: +cEl.dataset.dataIndex };
         this.emit('edit', e);
         if (e.preventDefault)
             return;
         if (row !== e.row) {
-            if (e.row < 0 || e.row >= (<HTMLElement>this.$body.firstChild).children.length)
+            if (e.row < 0 || e.row >= this.rowCount)
                 return;
-            cEl = (<HTMLElement>(<HTMLElement>this.$body.firstChild).children[row]);
+            cEl = this.ensureRow(row);
         }
         const dataIndex = +cEl.dataset.dataIndex;
         const parent = +cEl.dataset.parent;
@@ -1215,7 +1275,7 @@ export class DataGrid extends EventEmitter {
         }
         Array.from(this.$body.querySelectorAll('.focused'), a => a.classList.remove('focused'));
         this.$focused = row;
-        const el = <HTMLElement>(<HTMLElement>this.$body.firstChild).children[row];
+        const el = this.ensureRow(row);
         el.classList.add('selected', 'focused');
         this.scrollToRow(row);
         this.createEditor(el, col);
@@ -1237,13 +1297,24 @@ export class DataGrid extends EventEmitter {
             child = this.$rows[parent].children.indexOf(child);
         if (child < 0 || parent >= this.$rows[parent].length)
             return;
-        let e = this.$body.firstElementChild.querySelector('[data-parent="' + parent + '"][data-child="' + child + '"]');
-        if (!e) {
-            this.expandRows(this.$sortedRows.indexOf(parent));
-            e = this.$body.firstElementChild.querySelector('[data-parent="' + parent + '"][data-child="' + child + '"]');
-            if (!e) return;
+        let sIdx;
+        if (this.$virtual) {
+            sIdx = this.virtualChildIndex(parent, child);
+            if (sIdx === -1) {
+                this.expandRows(this.$sortedRows.indexOf(parent));
+                sIdx = this.virtualChildIndex(parent, child);
+                if (sIdx === -1) return;
+            }
+        }
+        else {
+            let e = this.$body.firstElementChild.querySelector('[data-parent="' + parent + '"][data-child="' + child + '"]');
+            if (!e) {
+                this.expandRows(this.$sortedRows.indexOf(parent));
+                e = this.$body.firstElementChild.querySelector('[data-parent="' + parent + '"][data-child="' + child + '"]');
+                if (!e) return;
+            }
+            sIdx = [...e.parentElement.children].indexOf(e);
         }
-        const sIdx = [...e.parentElement.children].indexOf(e);
         if (this.$selected.indexOf(sIdx) === -1) {
             Array.from(this.$body.querySelectorAll('.selected'), a => a.classList.remove('selected'));
             this.$selected = [sIdx];
@@ -1251,7 +1322,7 @@ export class DataGrid extends EventEmitter {
         }
         Array.from(this.$body.querySelectorAll('.focused'), a => a.classList.remove('focused'));
         this.$focused = sIdx;
-        const el = <HTMLElement>(<HTMLElement>this.$body.firstChild).children[sIdx];
+        const el = this.ensureRow(sIdx);
         el.classList.add('selected', 'focused');
         this.scrollToRow(sIdx);
         this.createEditor(el, col);
@@ -1371,6 +1442,13 @@ export class DataGrid extends EventEmitter {
     }
 
     private updateRows() {
+        if (this.$virtual) {
+            this.buildVirtualRows();
+            this.$dataWidth = this.$body.children[0].clientWidth;
+            this.$dataHeight = this.$body.children[0].clientHeight;
+            this.doUpdate(UpdateType.resize);
+            return;
+        }
         while (this.$body.children[0].firstChild)
             this.$body.children[0].removeChild(this.$body.children[0].firstChild);
         const rows = this.$rows;
@@ -1399,8 +1477,10 @@ export class DataGrid extends EventEmitter {
     }
 
     private buildRows() {
-        while (this.$body.children[0].firstChild)
-            this.$body.children[0].removeChild(this.$body.children[0].firstChild);
+        if (!this.$virtual) {
+            while (this.$body.children[0].firstChild)
+                this.$body.children[0].removeChild(this.$body.children[0].firstChild);
+        }
         while (this.$body.children[1].firstChild)
             this.$body.children[1].removeChild(this.$body.children[1].firstChild);
         const cols = this.$cols;
@@ -1416,18 +1496,23 @@ export class DataGrid extends EventEmitter {
         let childLen;
         let cnt = 0;
         const l = sorted.length;
-        for (let r = 0; r < l; r++) {
-            data = rows[sorted[r]];
-            frag.appendChild(this.generateRow(cnt, data, r, sorted[r]));
-            cnt++;
-            if (this.$children && data.children && this.$viewState[sorted[r]]) {
-                for (child = 0, childLen = data.children.length; child < childLen; child++) {
-                    frag.appendChild(this.generateRow(cnt, data.children[child], r, sorted[r], r, child));
-                    cnt++;
+        if (this.$virtual)
+            this.buildVirtualRows();
+        else {
+            const selected = new Set<number>(this.$selected);
+            for (let r = 0; r < l; r++) {
+                data = rows[sorted[r]];
+                frag.appendChild(this.generateRow(cnt, data, r, sorted[r], -1, -1, null, selected));
+                cnt++;
+                if (this.$children && data.children && this.$viewState[sorted[r]]) {
+                    for (child = 0, childLen = data.children.length; child < childLen; child++) {
+                        frag.appendChild(this.generateRow(cnt, data.children[child], r, sorted[r], r, child, null, selected));
+                        cnt++;
+                    }
                 }
             }
+            this.$body.children[0].appendChild(frag);
         }
-        this.$body.children[0].appendChild(frag);
         (row = document.createElement('tr')).classList.add('datagrid-row-spring');
         const sCol = this.$sort.column;
         let w;
@@ -1462,148 +1547,480 @@ export class DataGrid extends EventEmitter {
         this.doUpdate(UpdateType.resize);
     }
 
-    private generateRow(cnt, data, r, dataIdx, parent = -1, child = -1) {
+    private get virtualRowHeight() {
+        if (this.$rowHeight > 0)
+            return this.$rowHeight;
+        if (this.$measuredHeight > 0)
+            return this.$measuredHeight;
+        const body = <HTMLElement>this.$body.firstChild;
+        if (this.$sortedRows.length === 0 || !body.isConnected)
+            return 20;
+        //render a real row off to the side to get the height every row should use
+        const row = this.generateRow(-1, this.$rows[this.$sortedRows[0]], 0, this.$sortedRows[0]);
+        row.style.visibility = 'hidden';
+        body.appendChild(row);
+        const h = row.offsetHeight;
+        body.removeChild(row);
+        if (h <= 0)
+            return 20;
+        return this.$measuredHeight = h;
+    }
+
+    /**
+     * Number of rows laid out, in virtual mode this includes rows that are not rendered
+     */
+    private get rowCount() {
+        if (this.$virtual)
+            return this.$virtualRows.length;
+        return (<HTMLElement>this.$body.firstChild).children.length;
+    }
+
+    /**
+     * Get the element for a row
+     *
+     * @param idx The row index
+     * @returns The row element, in virtual mode null if the row is not rendered
+     */
+    private rowElement(idx): HTMLElement {
+        if (!this.$virtual)
+            return <HTMLElement>(<HTMLElement>this.$body.firstChild).children[idx];
+        if (idx < this.$renderStart || idx > this.$renderEnd)
+            return null;
+        //first child is the top spacer
+        return <HTMLElement>(<HTMLElement>this.$body.firstChild).children[idx - this.$renderStart + 1];
+    }
+
+    /**
+     * Get the element for a row, in virtual mode the row is scrolled into view and rendered if needed
+     *
+     * @param idx The row index
+     */
+    private ensureRow(idx): HTMLElement {
+        if (!this.$virtual || idx < 0 || idx >= this.$virtualRows.length)
+            return this.rowElement(idx);
+        if (idx < this.$renderStart || idx > this.$renderEnd) {
+            this.scrollToRow(idx);
+            this.renderRows(idx);
+        }
+        return this.rowElement(idx);
+    }
+
+    /**
+     * Get the row index of a row element
+     *
+     * @param el The row element
+     */
+    private rowIndex(el: HTMLElement) {
+        const idx = [...el.parentElement.children].indexOf(el);
+        if (!this.$virtual || idx === -1)
+            return idx;
+        return this.$renderStart + idx - 1;
+    }
+
+    /**
+     * Check if a row is a collapsed child, virtual mode only lays out shown rows
+     *
+     * @param idx The row index
+     */
+    private rowHidden(idx) {
+        if (this.$virtual)
+            return false;
+        return (<HTMLElement>(<HTMLElement>this.$body.firstChild).children[idx]).style.display !== '';
+    }
+
+    /**
+     * Find the row index of a child row in virtual mode
+     *
+     * @param parent The parent row
+     * @param child The child index
+     * @returns The row index or -1 if the parent is collapsed
+     */
+    private virtualChildIndex(parent, child) {
+        const vl = this.$virtualRows.length;
+        for (let v = 0; v < vl; v++) {
+            if (this.$virtualRows[v][2] === parent && this.$virtualRows[v][3] === child)
+                return v;
+        }
+        return -1;
+    }
+
+    /**
+     * Lay out the rows for virtual mode as [row, dataIndex, parent, child], only the rows in view
+     * are rendered between a top and bottom spacer sized to the rows they stand in for
+     */
+    private buildVirtualRows() {
+        const body = <HTMLElement>this.$body.firstChild;
+        const rows = this.$rows;
+        const sorted = this.$sortedRows;
+        const l = sorted.length;
+        const vRows = [];
+        let data;
+        let child;
+        let childLen;
+        for (let r = 0; r < l; r++) {
+            data = rows[sorted[r]];
+            vRows.push([r, sorted[r], -1, -1]);
+            if (this.$children && data.children && this.$viewState[sorted[r]]) {
+                for (child = 0, childLen = data.children.length; child < childLen; child++)
+                    vRows.push([r, sorted[r], r, child]);
+            }
+        }
+        this.$virtualRows = vRows;
+        if (!body.firstElementChild || !body.firstElementChild.classList.contains('datagrid-row-spacer')) {
+            while (body.firstChild)
+                body.removeChild(body.firstChild);
+            body.appendChild(this.createSpacer());
+            body.appendChild(this.createSpacer());
+            this.$renderStart = 0;
+            this.$renderEnd = -1;
+        }
+        //the data behind each index may have changed so fill every row again
+        else
+            this.releaseRows(this.$renderStart, this.$renderEnd);
+        this.renderRows();
+    }
+
+    private createSpacer() {
+        const row = document.createElement('tr');
+        row.classList.add('datagrid-row-spacer');
+        row.appendChild(document.createElement('td'));
+        return row;
+    }
+
+    /**
+     * Find the row at an offset, rows are a fixed height in virtual mode
+     *
+     * @param y offset from top of data body
+     */
+    private rowAtOffset(y) {
+        const idx = Math.floor(y / this.virtualRowHeight);
+        if (idx < 0)
+            return 0;
+        if (idx >= this.$virtualRows.length)
+            return this.$virtualRows.length - 1;
+        return idx;
+    }
+
+    /**
+     * Render the rows in view plus overscan, only the rows entering or leaving the range are changed
+     *
+     * @param include A row that must be rendered even if the scroll position has not caught up yet
+     */
+    private renderRows(include?: number) {
+        if (!this.$virtual) return;
+        const body = <HTMLElement>this.$body.firstChild;
+        const top = <HTMLElement>body.firstElementChild;
+        const bottom = <HTMLElement>body.lastElementChild;
+        if (!top || top === bottom) return;
+        const count = this.$virtualRows.length;
+        const height = this.virtualRowHeight;
+        const scroll = this.$body.parentElement;
+        let start = this.rowAtOffset(scroll.scrollTop);
+        let end = this.rowAtOffset(scroll.scrollTop + scroll.clientHeight);
+        let r;
+        if (typeof include === 'number' && (include < start || include > end)) {
+            end = include + end - start;
+            start = include;
+        }
+        start = Math.max(0, start - this.overscan);
+        end = Math.min(count - 1, end + this.overscan);
+        //the editor row has to stay rendered, so end the edit once it leaves the range
+        if (this.$editor && (this.$editor.row < start || this.$editor.row > end) && !this.clearEditor()) {
+            start = Math.min(start, this.$editor.row);
+            end = Math.max(end, this.$editor.row);
+        }
+        if (count === 0 || end < this.$renderStart || start > this.$renderEnd)
+            this.releaseRows(this.$renderStart, this.$renderEnd);
+        else {
+            if (start > this.$renderStart)
+                this.releaseRows(this.$renderStart, start - 1);
+            if (end < this.$renderEnd)
+                this.releaseRows(end + 1, this.$renderEnd);
+        }
+        const selected = new Set<number>(this.$selected);
+        let rendered = false;
+        if (count > 0) {
+            if (this.$renderEnd < this.$renderStart) {
+                for (r = start; r <= end; r++)
+                    body.insertBefore(this.renderRow(r, selected), bottom);
+                rendered = end >= start;
+            }
+            else {
+                for (r = Math.min(this.$renderStart, end + 1) - 1; r >= start; r--) {
+                    body.insertBefore(this.renderRow(r, selected), top.nextSibling);
+                    rendered = true;
+                }
+                for (r = Math.max(this.$renderEnd + 1, start); r <= end; r++) {
+                    body.insertBefore(this.renderRow(r, selected), bottom);
+                    rendered = true;
+                }
+            }
+            this.$renderStart = start;
+            this.$renderEnd = end;
+        }
+        else {
+            this.$renderStart = 0;
+            this.$renderEnd = -1;
+        }
+        let cols = this.$springCols.length === 0 ? 1 : 0;
+        let c = this.$cols.length;
+        while (c--)
+            if (this.$cols[c].visible) cols++;
+        (<HTMLTableCellElement>top.firstChild).colSpan = cols;
+        (<HTMLTableCellElement>bottom.firstChild).colSpan = cols;
+        top.style.height = (this.$renderStart * height) + 'px';
+        top.style.display = this.$renderStart > 0 ? '' : 'none';
+        bottom.style.height = Math.max(0, count - this.$renderEnd - 1) * height + 'px';
+        bottom.style.display = count - this.$renderEnd - 1 > 0 ? '' : 'none';
+        if (rendered && this.$springCols.length)
+            this.doUpdate(UpdateType.resizeWidth);
+    }
+
+    /**
+     * Fill a row for a virtual row index, reusing a released row element if there is one
+     *
+     * @param idx The row index
+     * @param selected The selected rows
+     */
+    private renderRow(idx, selected: Set<number>) {
+        const vRow = this.$virtualRows[idx];
+        const data = vRow[2] === -1 ? this.$rows[vRow[1]] : this.$rows[vRow[1]].children[vRow[3]];
+        const row = this.generateRow(idx, data, vRow[0], vRow[1], vRow[2], vRow[3], this.$rowPool.pop(), selected);
+        if (idx === this.$focused)
+            row.classList.add('focused');
+        if (vRow[2] === -1 && this.$children && data.children && this.$viewState[vRow[1]])
+            row.dataset.children = 'true';
+        row.style.height = this.virtualRowHeight + 'px';
+        return row;
+    }
+
+    /**
+     * Remove rendered rows and keep the elements to reuse
+     *
+     * @param start First row index to release
+     * @param end Last row index to release
+     */
+    private releaseRows(start, end) {
+        if (end < start) return;
+        const body = <HTMLElement>this.$body.firstChild;
+        let row = this.rowElement(start);
+        let next;
+        for (let r = start; r <= end && row; r++) {
+            next = <HTMLElement>row.nextElementSibling;
+            body.removeChild(row);
+            this.$rowPool.push(row);
+            row = next;
+        }
+        if (start === this.$renderStart && end === this.$renderEnd) {
+            this.$renderStart = 0;
+            this.$renderEnd = -1;
+        }
+        else if (start === this.$renderStart)
+            this.$renderStart = end + 1;
+        else if (end === this.$renderEnd)
+            this.$renderEnd = start - 1;
+    }
+
+    /**
+     * Show or hide the children of a parent row in virtual mode, selection and focus are moved to
+     * follow the rows they were on
+     *
+     * @param r The sorted parent row
+     * @param expand Show the children
+     */
+    private toggleVirtualChildren(r, expand: boolean) {
+        const dataIdx = this.$sortedRows[r];
+        const data = this.$rows[dataIdx];
+        if (!this.$children || !data || !data.children || data.children.length === 0) return;
+        if (!!this.$viewState[dataIdx] === expand) return;
+        const vl = this.$virtualRows.length;
+        let idx = 0;
+        while (idx < vl && (this.$virtualRows[idx][0] !== r || this.$virtualRows[idx][2] !== -1))
+            idx++;
+        const childLen = data.children.length;
+        this.$viewState[dataIdx] = expand;
+        if (expand) {
+            this.$selected = this.$selected.map(s => s > idx ? s + childLen : s);
+            if (this.$focused > idx)
+                this.$focused += childLen;
+        }
+        else {
+            this.$selected = this.$selected.filter(s => s <= idx || s > idx + childLen).map(s => s > idx ? s - childLen : s);
+            if (this.$focused > idx + childLen)
+                this.$focused -= childLen;
+            else if (this.$focused > idx)
+                this.$focused = idx;
+        }
+        this.buildVirtualRows();
+        this.$dataWidth = this.$body.children[0].clientWidth;
+        this.$dataHeight = this.$body.children[0].clientHeight;
+        this.doUpdate(UpdateType.resize | UpdateType.resizeWidth);
+    }
+
+    /**
+     * Create a row and its cells
+     *
+     * @param cnt The row index
+     * @param data The row data
+     * @param r The sorted row
+     * @param dataIdx The data index
+     * @param parent The parent row or -1
+     * @param child The child index or -1
+     * @param row A released row to fill again instead of creating one, it already has its listeners
+     * @param selected The selected rows when filling many rows
+     */
+    private generateRow(cnt, data, r, dataIdx, parent = -1, child = -1, row?: HTMLElement, selected?: Set<number>) {
         const cols = this.$cols;
         let c;
         const cl = cols.length;
         let w;
         let cell;
         const sCol = this.$sort.column;
-        const row = document.createElement('tr');
-        row.classList.add('datagrid-row');
+        const reused = !!row;
+        if (reused) {
+            while (row.firstChild)
+                row.removeChild(row.firstChild);
+            row.removeAttribute('style');
+            delete row.dataset.children;
+        }
+        else
+            row = document.createElement('tr');
+        row.className = 'datagrid-row';
         if (r % 2 === 0)
             row.classList.add('datagrid-row-even');
         else
             row.classList.add('datagrid-row-odd');
-        if (this.$selected.indexOf(cnt) !== -1)
+        if (selected ? selected.has(cnt) : this.$selected.indexOf(cnt) !== -1)
             row.classList.add('selected');
         row.dataset.row = '' + r;
         row.dataset.parent = '' + parent;
         row.dataset.child = '' + child;
         row.dataset.dataIndex = '' + dataIdx;
 
-        row.addEventListener('click', (e) => {
-            if (e.defaultPrevented || e.cancelBubble)
-                return;
-            let eRow = <HTMLElement>e.currentTarget;
-            if (this.$editor && this.$editor.el !== eRow && !this.clearEditor())
-                return;
-            //var sIdx = +eRow.dataset.row;
-            let sIdx = [...eRow.parentElement.children].indexOf(eRow);
-            //var rowIdx = +(<HTMLElement>e.currentTarget);
-            const eR = this.$sortedRows[sIdx];
-            let el;
-            this.emit('row-click', e, { row: this.$rows[eR], rowIndex: eR });
-            Array.from(this.$body.querySelectorAll('.focused'), a => a.classList.remove('focused'));
-            if (e.ctrlKey) {
-                this.$focused = sIdx;
-                if (eRow.classList.contains('selected')) {
-                    eRow.classList.remove('selected');
-                    if (this.$allowMultiSelection) {
-                        sIdx = this.$selected.indexOf(sIdx);
-                        this.$selected.splice(sIdx, 1);
+        if (!reused) {
+            row.addEventListener('click', (e) => {
+                if (e.defaultPrevented || e.cancelBubble)
+                    return;
+                let eRow = <HTMLElement>e.currentTarget;
+                if (this.$editor && this.$editor.el !== eRow && !this.clearEditor())
+                    return;
+                //var sIdx = +eRow.dataset.row;
+                let sIdx = this.rowIndex(eRow);
+                //var rowIdx = +(<HTMLElement>e.currentTarget);
+                const eR = this.$sortedRows[sIdx];
+                let el;
+                this.emit('row-click', e, { row: this.$rows[eR], rowIndex: eR });
+                Array.from(this.$body.querySelectorAll('.focused'), a => a.classList.remove('focused'));
+                if (e.ctrlKey) {
+                    this.$focused = sIdx;
+                    if (eRow.classList.contains('selected')) {
+                        eRow.classList.remove('selected');
+                        if (this.$allowMultiSelection) {
+                            sIdx = this.$selected.indexOf(sIdx);
+                            this.$selected.splice(sIdx, 1);
+                        }
+                        else {
+                            this.$selected = [];
+                            Array.from(this.$body.querySelectorAll('.selected'), a => a.classList.remove('selected'));
+                        }
                     }
-                    else {
-                        this.$selected = [];
+                    else if (!this.$allowMultiSelection) {
                         Array.from(this.$body.querySelectorAll('.selected'), a => a.classList.remove('selected'));
+                        eRow.classList.add('selected');
+                        this.$selected = [sIdx];
                     }
+                    else {
+                        eRow.classList.add('selected');
+                        this.$selected.push(sIdx);
+                    }
+                    eRow.classList.add('focused');
+                    this.$shiftStart = this.$focused;
                 }
-                else if (!this.$allowMultiSelection) {
+                else if (e.shiftKey) {
+                    let start;
+                    let end;
+                    if (this.$selected.length === 0)
+                        start = this.$focused !== -1 ? this.$focused : 0;
+                    else if (this.$shiftStart !== -1)
+                        start = this.$shiftStart;
+                    else
+                        start = this.$selected[0];
                     Array.from(this.$body.querySelectorAll('.selected'), a => a.classList.remove('selected'));
-                    eRow.classList.add('selected');
-                    this.$selected = [sIdx];
-                }
-                else {
-                    eRow.classList.add('selected');
-                    this.$selected.push(sIdx);
-                }
-                eRow.classList.add('focused');
-                this.$shiftStart = this.$focused;
-            }
-            else if (e.shiftKey) {
-                let start;
-                let end;
-                if (this.$selected.length === 0)
-                    start = this.$focused !== -1 ? this.$focused : 0;
-                else if (this.$shiftStart !== -1)
-                    start = this.$shiftStart;
-                else
-                    start = this.$selected[0];
-                Array.from(this.$body.querySelectorAll('.selected'), a => a.classList.remove('selected'));
-                this.$selected = [];
-                let eCnt;
-                if (!this.$allowMultiSelection) {
-                    this.$selected = [sIdx];
-                    eRow.classList.add('selected');
-                }
-                else if (start > sIdx) {
-                    end = start;
-                    start = sIdx;
-                    this.$shiftStart = end;
-                    eCnt = end - start + 1;
-                    for (; end >= start; end--)
-                        this.$selected.push(end);
-
-                    while (eRow && eCnt--) {
+                    this.$selected = [];
+                    let eCnt;
+                    if (!this.$allowMultiSelection) {
+                        this.$selected = [sIdx];
                         eRow.classList.add('selected');
-                        eRow = <HTMLElement>eRow.nextSibling;
                     }
+                    else if (start > sIdx) {
+                        end = start;
+                        start = sIdx;
+                        this.$shiftStart = end;
+                        eCnt = end - start + 1;
+                        for (; end >= start; end--)
+                            this.$selected.push(end);
+
+                        while (eRow && eRow.classList.contains('datagrid-row') && eCnt--) {
+                            eRow.classList.add('selected');
+                            eRow = <HTMLElement>eRow.nextSibling;
+                        }
+                    }
+                    else {
+                        end = sIdx;
+                        eCnt = end - start + 1;
+                        this.$shiftStart = start;
+                        for (; start <= end; start++)
+                            this.$selected.push(start);
+                        while (eRow && eRow.classList.contains('datagrid-row') && eCnt--) {
+                            eRow.classList.add('selected');
+                            eRow = <HTMLElement>eRow.previousSibling;
+                        }
+                    }
+                    this.$focused = sIdx;
+                    el = this.rowElement(this.$focused);
+                    el.classList.add('focused');
                 }
                 else {
-                    end = sIdx;
-                    eCnt = end - start + 1;
-                    this.$shiftStart = start;
-                    for (; start <= end; start++)
-                        this.$selected.push(start);
-                    while (eRow && eCnt--) {
-                        eRow.classList.add('selected');
-                        eRow = <HTMLElement>eRow.previousSibling;
-                    }
+                    Array.from(this.$body.querySelectorAll('.selected'), a => a.classList.remove('selected'));
+                    this.$selected = [sIdx];
+                    eRow.classList.add('selected', 'focused');
+                    this.$focused = sIdx;
+                    this.$shiftStart = this.$focused;
                 }
-                this.$focused = sIdx;
-                el = (<HTMLElement>this.$body.firstChild).children[this.$focused];
-                el.classList.add('focused');
-            }
-            else {
+                this.emit('selection-changed');
+            });
+            row.addEventListener('dblclick', (e) => {
+                if (e.defaultPrevented || e.cancelBubble)
+                    return;
+                const sIdx = +(<HTMLElement>e.currentTarget).dataset.row;
+                const eR = +(<HTMLElement>e.currentTarget).dataset.dataIndex;
+                const el = <HTMLElement>e.currentTarget;
+                this.emit('row-dblclick', e, { row: this.$rows[eR], rowIndex: sIdx, parent: +el.dataset.parent, child: +el.dataset.child, dataIndex: eR });
+                if (e.defaultPrevented || e.cancelBubble)
+                    return;
                 Array.from(this.$body.querySelectorAll('.selected'), a => a.classList.remove('selected'));
                 this.$selected = [sIdx];
-                eRow.classList.add('selected', 'focused');
                 this.$focused = sIdx;
-                this.$shiftStart = this.$focused;
-            }
-            this.emit('selection-changed');
-        });
-        row.addEventListener('dblclick', (e) => {
-            if (e.defaultPrevented || e.cancelBubble)
-                return;
-            const sIdx = +(<HTMLElement>e.currentTarget).dataset.row;
-            const eR = +(<HTMLElement>e.currentTarget).dataset.dataIndex;
-            const el = <HTMLElement>e.currentTarget;
-            this.emit('row-dblclick', e, { row: this.$rows[eR], rowIndex: sIdx, parent: +el.dataset.parent, child: +el.dataset.child, dataIndex: eR });
-            if (e.defaultPrevented || e.cancelBubble)
-                return;
-            Array.from(this.$body.querySelectorAll('.selected'), a => a.classList.remove('selected'));
-            this.$selected = [sIdx];
-            this.$focused = sIdx;
-            el.classList.add('selected', 'focused');
-            this.createEditor(<HTMLElement>e.currentTarget, e.srcElement);
-        });
-        row.addEventListener('mousedown', (e) => {
-            this.$editorClick = e.currentTarget;
-            if (this.$editor && this.$editor.editors)
-                this.$editor.editors.forEach(ed => ed.editorClick = this.$editorClick);
-        });
-        row.addEventListener('mouseup', (e) => {
-            this.$editorClick = null;
-            if (this.$editor && this.$editor.editors)
-                this.$editor.editors.forEach(ed => ed.editorClick = null);
-        });
-        row.addEventListener('contextmenu', (e) => {
-            const sIdx = +(<HTMLElement>e.currentTarget).dataset.row;
-            const eR = +(<HTMLElement>e.currentTarget).dataset.dataIndex;
-            const el = <HTMLElement>e.currentTarget;
-            this.emit('row-contextmenu', e, { row: this.$rows[eR], rowIndex: sIdx, parent: +el.dataset.parent, child: +el.dataset.child, dataIndex: eR });
-        });
+                el.classList.add('selected', 'focused');
+                this.createEditor(<HTMLElement>e.currentTarget, e.srcElement);
+            });
+            row.addEventListener('mousedown', (e) => {
+                this.$editorClick = e.currentTarget;
+                if (this.$editor && this.$editor.editors)
+                    this.$editor.editors.forEach(ed => ed.editorClick = this.$editorClick);
+            });
+            row.addEventListener('mouseup', (e) => {
+                this.$editorClick = null;
+                if (this.$editor && this.$editor.editors)
+                    this.$editor.editors.forEach(ed => ed.editorClick = null);
+            });
+            row.addEventListener('contextmenu', (e) => {
+                const sIdx = +(<HTMLElement>e.currentTarget).dataset.row;
+                const eR = +(<HTMLElement>e.currentTarget).dataset.dataIndex;
+                const el = <HTMLElement>e.currentTarget;
+                this.emit('row-contextmenu', e, { row: this.$rows[eR], rowIndex: sIdx, parent: +el.dataset.parent, child: +el.dataset.child, dataIndex: eR });
+            });
+        }
         for (c = 0; c < cl; c++) {
             if (!cols[c].visible) continue;
             w = cols[c].width;
@@ -1673,6 +2090,10 @@ export class DataGrid extends EventEmitter {
                     e.stopPropagation();
                     const eCurr = (<HTMLElement>e.currentTarget);
                     const rowEl = eCurr.parentElement.parentElement;
+                    if (this.$virtual) {
+                        this.toggleVirtualChildren(+eCurr.dataset.parent, !this.$viewState[this.$sortedRows[+eCurr.dataset.parent]]);
+                        return;
+                    }
                     let eR: any = +eCurr.dataset.parent;
                     let sib = <HTMLElement>rowEl.nextElementSibling;
                     if (this.$viewState[this.$sortedRows[eR]]) {
@@ -1935,6 +2356,8 @@ export class DataGrid extends EventEmitter {
         }
         this.resizeWidth();
         this.resizeHeight();
+        if (this.$virtual)
+            this.doUpdate(UpdateType.renderRows);
     }
 
     private resizeWidth() {
@@ -2075,6 +2498,10 @@ export class DataGrid extends EventEmitter {
                 this.buildRows();
                 this._updating &= ~UpdateType.buildRows;
             }
+            if ((this._updating & UpdateType.renderRows) === UpdateType.renderRows) {
+                this.renderRows();
+                this._updating &= ~UpdateType.renderRows;
+            }
             if ((this._updating & UpdateType.resize) === UpdateType.resize) {
                 this.resize();
                 this._updating &= ~UpdateType.resize;
@@ -2109,7 +2536,11 @@ export class DataGrid extends EventEmitter {
             return r;
         });
         rows.forEach(r => {
-            const e = this.$body.firstElementChild.querySelector('[data-row="' + r + '"][data-parent="-1"]');
+            if (this.$virtual) {
+                this.toggleVirtualChildren(r, !this.$viewState[this.$sortedRows[r]]);
+                return;
+            }
+            const e = <HTMLElement>this.$body.firstElementChild.querySelector('[data-row="' + r + '"][data-parent="-1"]');
             if (!e) return;
             const nl = e.children[0].getElementsByClassName('datagrid-collapse');
             if (nl.length > 0)
@@ -2135,8 +2566,12 @@ export class DataGrid extends EventEmitter {
             rows.forEach(r => {
                 if (this.$viewState[this.$sortedRows[r]])
                     return;
+                if (this.$virtual) {
+                    this.toggleVirtualChildren(r, true);
+                    return;
+                }
                 //const e = this.$body.firstElementChild.children[r];
-                const e = this.$body.firstElementChild.querySelector('[data-row="' + r + '"][data-parent="-1"]');
+                const e = <HTMLElement>this.$body.firstElementChild.querySelector('[data-row="' + r + '"][data-parent="-1"]');
                 if (!e || e.children.length === 0) return;
                 const nl = e.children[0].getElementsByClassName('datagrid-collapse');
                 if (nl.length > 0)
@@ -2164,7 +2599,11 @@ export class DataGrid extends EventEmitter {
             rows.forEach(r => {
                 if (!this.$viewState[this.$sortedRows[r]])
                     return;
-                const e = this.$body.firstElementChild.querySelector('[data-row="' + r + '"][data-parent="-1"]');
+                if (this.$virtual) {
+                    this.toggleVirtualChildren(r, false);
+                    return;
+                }
+                const e = <HTMLElement>this.$body.firstElementChild.querySelector('[data-row="' + r + '"][data-parent="-1"]');
                 if (!e || e.children.length === 0) return;
                 const nl = e.children[0].getElementsByClassName('datagrid-collapse');
                 if (nl.length > 0)
@@ -2186,11 +2625,20 @@ export class DataGrid extends EventEmitter {
             }, 10);
             return;
         }
-        if (typeof row === 'number')
-            row = this.$body.firstElementChild.children[row];
-        if (!row) return;
-        const top = row.offsetTop;
-        const height = row.offsetHeight;
+        let top;
+        let height;
+        //virtual rows are a fixed height so the row does not need to be rendered
+        if (typeof row === 'number' && this.$virtual) {
+            height = this.virtualRowHeight;
+            top = row * height;
+        }
+        else {
+            if (typeof row === 'number')
+                row = this.$body.firstElementChild.children[row];
+            if (!row) return;
+            top = row.offsetTop;
+            height = row.offsetHeight;
+        }
         const sTop = this.$body.parentElement.scrollTop;
         const sHeight = this.$body.parentElement.clientHeight;
         if (top + height >= sTop + sHeight)
@@ -2233,7 +2681,17 @@ export class DataGrid extends EventEmitter {
         if (eEvt.preventDefault)
             return false;
 
-        if (next && this.enterMoveNext) {
+        if (next && this.enterMoveNext && this.$virtual) {
+            //move by index as the next row may not be rendered
+            next = this.$editor.row + 1;
+            if (next >= this.rowCount && this.enterMoveNew)
+                next = true;
+            else if (next >= this.rowCount && this.enterMoveFirst)
+                next = 0;
+            else if (next >= this.rowCount)
+                next = null;
+        }
+        else if (next && this.enterMoveNext) {
             next = this.$editor.el.nextSibling;
             if (!next && this.enterMoveNew)
                 next = true;
@@ -2304,7 +2762,7 @@ export class DataGrid extends EventEmitter {
                     if (parent !== -1) {
                         const ep = this.$body.firstElementChild.querySelector('[data-data-index="' + parent + '"][data-parent="-1"]');
                         if (ep) {
-                            const pIdx = [...ep.parentElement.children].indexOf(ep);
+                            const pIdx = this.rowIndex(<HTMLElement>ep);
                             ep.children[editor.column].innerHTML = col.formatter({ row: this.$rows[parent], cell: field ? (this.$rows[parent][field]) : (idx >= 0 && idx < this.$rows[parent].length) ? this.$rows[parent][idx] : null, index: idx, column: +editor.el.dataset.column, rowIndex: pIdx, field: field, parent: -1, child: -1, dataIndex: parent });
                         }
                     }
@@ -2387,7 +2845,7 @@ export class DataGrid extends EventEmitter {
 
     public createEditor(el: HTMLElement, fCol: any = 0) {
         if (!el) return;
-        const row = [...el.parentElement.children].indexOf(el);
+        const row = this.rowIndex(el);
         if (fCol)
             fCol = [...fCol.parentElement.children].indexOf(fCol);
         const cols = this.$cols;
@@ -12,8 +12,17 @@ import { Parser } from './parser';
 import { htmlEncode, formatUnit } from './library';
 import { Finder } from './finder';
 import { DisplayOptions, OverlayRange, Point } from './types';
+import { Scrollback, SCROLLBACK_BLOCK_SIZE } from './scrollback';
+import { Tracer, TracePipeline } from './tracer';
 const moment = require('moment');
 
+//selections with more lines than this are exported in a background worker
+const SELECTION_WORKER_LINES = 2000;
+//max characters of any one export format, larger selections are truncated
+const SELECTION_EXPORT_MAX = 33554432;
+//color classes kept in the style sheet, colors past this are styled inline
+const MAX_COLOR_CLASSES = 4096;
+
 //const CONTAINS_RTL = /(?:[\u05BE\u05C0\u05C3\u05C6\u05D0-\u05F4\u0608\u060B\u060D\u061B-\u064A\u066D-\u066F\u0671-\u06D5\u06E5\u06E6\u06EE\u06EF\u06FA-\u0710\u0712-\u072F\u074D-\u07A5\u07B1-\u07EA\u07F4\u07F5\u07FA-\u0815\u081A\u0824\u0828\u0830-\u0858\u085E-\u08BD\u200F\uFB1D\uFB1F-\uFB28\uFB2A-\uFD3D\uFD50-\uFDFC\uFE70-\uFEFC]|\uD802[\uDC00-\uDD1B\uDD20-\uDE00\uDE10-\uDE33\uDE40-\uDEE4\uDEEB-\uDF35\uDF40-\uDFFF]|\uD803[\uDC00-\uDCFF]|\uD83A[\uDC00-\uDCCF\uDD00-\uDD43\uDD50-\uDFFF]|\uD83B[\uDC00-\uDEBB])/;
 //const CONTAINS_LTR = /(?:[A-Za-z\u00C0-\u00D6\u00D8-\u00F6\u00F8-\u02B8\u0300-\u0590\u0800-\u1FFF'+'\u2C00-\uFB1C\uFDFE-\uFE6F\uFEFD-\uFFFF])/;
 //https://www.compart.com/en/unicode/bidiclass
@@ -22,8 +31,34 @@ const moment = require('moment');
 //const CONTAINS_RTL = /(?:[\u05BE\u05BF\u05C0\u05C3\u05C6\u05D0-\u05F4\u0608\u060B\u060D\u061B-\u064A\u066D-\u066F\u0671-\u06D5\u06E5\u06E6\u06EE\u06EF\u06FA-\u0710\u0712-\u072F\u074D-\u07A5\u07B1-\u07EA\u07F4\u07F5\u07FA-\u0815\u081A\u0824\u0828\u0830-\u0858\u085E-\u08BD\u200F\uFB1D\uFB1F-\uFB28\uFB2A-\uFD3D\uFD50-\uFDFC\uFE70-\uFEFC]|\uD802[\uDC00-\uDD1B\uDD20-\uDE00\uDE10-\uDE33\uDE40-\uDEE4\uDEEB-\uDF35\uDF40-\uDFFF]|\uD803[\uDC00-\uDCFF]|\uD83A[\uDC00-\uDCCF\uDD00-\uDD43\uDD50-\uDFFF]|\uD83B[\uDC00-\uDEBB])/;
 //const CONTAINS_RTL2 = /[\u0590-\u05ff\u0600-\u06ff]/u;
 
+interface OverlayRecord {
+    //index of the source range, used for the span id
+    r: number;
+    sL: number;
+    eL: number;
+    s: number;
+    e: number;
+}
+
+interface OverlayLayer {
+    cls: string;
+    records: OverlayRecord[];
+    //single line ranges grouped by line
+    lines: Map<number, OverlayRecord[]>;
+    //multi line ranges sorted by start line
+    spans: OverlayRecord[];
+    //highest end line of spans[0..i], allows binary searching for spans that contain a line
+    spanEnds: number[];
+    //last line any range touches
+    last: number;
+    //lines trimmed from the top since the layer was built, layer line = display line + offset
+    offset: number;
+    //rendered markup by layer line, only built once a line is visible
+    html: Map<number, string>;
+}
+
 interface Overlays {
-    selection: any[];
+    [type: string]: OverlayLayer;
 }
 
 interface Selection extends OverlayRange {
@@ -61,6 +96,21 @@ export enum UpdateType {
     calculateLines = 1 << 13
 }
 
+export enum LineEditType { Color = 0, RemoveStyle = 1, Highlight = 2 }
+
+/**
+ * A queued change to part of a line's formats, ranges are like javascript.substring
+ */
+export interface LineEdit {
+    type: LineEditType;
+    start?: number;
+    end?: number;
+    fore?: any;         //color: the fore color
+    back?: any;         //color: the back color
+    style?: FontStyle;  //color: style to add, remove style: style to remove
+    color?: boolean;    //highlight: brighten color instead of bold
+}
+
 enum CornerType {
     Flat = 0,
     Extern = 1,
@@ -115,6 +165,9 @@ interface LineData {
  * @todo Add MXP image height - requires variable line height support
  * @todo Add/fix MXP image selection highlighting
  */
+//count of displays created, used to scope each display's color classes
+let _palettes = 0;
+
 export class Display extends EventEmitter {
     private _model: DisplayModel;
 
@@ -159,9 +212,7 @@ export class Display extends EventEmitter {
     private _maxLines: number = 5000;
     private _charHeight: number;
     private _charWidth: number;
-    private _overlays: Overlays = {
-        selection: []
-    };
+    private _overlays: Overlays = {};
     private _overlayRanges = {};
     private _VScroll: ScrollBar;
     private _HScroll: ScrollBar;
@@ -198,8 +249,16 @@ export class Display extends EventEmitter {
     private _canvas: HTMLCanvasElement;
     private _context: CanvasRenderingContext2D;
     private _contextFont: string;
+    //measured width of each character cluster by font
+    private _glyphWidths: Map<string, Map<string, number>> = new Map<string, Map<string, number>>();
     private _ruler: HTMLElement;
     private _styles: HTMLStyleElement;
+    //color class index for each format color, rules are added to the palette sheet as colors are first seen
+    private _colorClasses: Map<string | number, number> = new Map<string | number, number>();
+    private _colorStyles: HTMLStyleElement;
+    private _palette: number;
+    //marks format styles cached by this display, formats can be shared with other displays that have their own color classes
+    private _styleKey = {};
 
     private _innerWidth;
     private _innerHeight;
@@ -213,6 +272,38 @@ export class Display extends EventEmitter {
     private _enableColors = true;
     private _enableBackgroundColors = true;
     private _linesMap: Map<number, WrapLine[]> = new Map<number, WrapLine[]>();
+    //lines still using wraps from before the last recalculate, tracked by line id
+    private _rewrap: { below: number, last: number, above: number } = null;
+    private _rewrapTimer = 0;
+    private _scrollAnchor: { id: number, rows: number } = null;
+    //number of lines at the end of the model not wrapped yet while detached
+    private _backlog: number = 0;
+    private _detached: boolean = false;
+    //rewraps asked for while detached, done once attached, full rewrap or single lines by id
+    private _wrapDirty: boolean = false;
+    private _dirtyWraps: Set<number> = new Set<number>();
+    private _tracer: Tracer = null;
+    //trigger edits waiting to be applied by line id
+    private _lineEdits: Map<number, LineEdit[]> = new Map();
+    private _lineEditTimer = null;
+    //background selection exports waiting on the worker by id
+    private _exportWorker: Worker = null;
+    private _exports: Map<number, any> = new Map<number, any>();
+    private _exportId: number = 0;
+
+    /**
+     * Detach the display while not visible, new lines are only added to the model and are wrapped and
+     * rendered in one pass when attached again
+     */
+    get detached(): boolean { return this._detached; }
+    set detached(value: boolean) {
+        if (value === this._detached) return;
+        this._detached = value;
+        if (!value) {
+            this.flushWraps();
+            this.doUpdate(UpdateType.display);
+        }
+    }
 
     get model() { return this._model; }
     set model(value: DisplayModel) {
@@ -227,28 +318,12 @@ export class Display extends EventEmitter {
         this._model.on('add-line', data => { this.emit('add-line', data); });
         this._model.on('add-line-done', data => { this.emit('add-line-done', data); });
         this._model.on('line-added', (data, noUpdate) => {
-            const idx = this._model.lines.length - 1;
-            const t = this.calculateWrapLines(idx, 0, this._indent, (this._timestamp ? this._timestampWidth : 0));
-            //track wrapped lines to line to make it easier ot lookup all wrapped lines and allow indexOf and other build in functions
-            this._linesMap.set(this._model.getLineID(idx), t);
-            if (data.formats[0].hr) {
-                t[0].hr = true;
-                this._maxWidth = Math.max(this._maxWidth, this._maxView);
-                this._maxHeight = Math.max(this._maxHeight, this._charHeight);
-            }
-            else {
-                this._maxWidth = Math.max(this._maxWidth, t[0].width);
-                this._maxHeight = Math.max(this._maxHeight, t[0].height);
-            }
-            if (this._lines.length > 0)
-                t[0].top = this._lines[this._lines.length - 1].top + this._lines[this._lines.length - 1].height;
-            for (let l = 1, ll = t.length; l < ll; l++) {
-                t[l].top = t[l - 1].top + t[l - 1].height;
-                this._maxWidth = Math.max(this._maxWidth, t[l].width + ((this._indent || 0) * this._charWidth));
-                this._maxHeight = Math.max(this._maxHeight, t[l].height);
+            //while detached only track how many lines need to be wrapped once attached
+            if (this._detached) {
+                this._backlog++;
+                return;
             }
-            this._lines.push(...t);
-
+            this.wrapLine(this._model.lines.length - 1);
             if (this.split) this.split.dirty = true;
             //if (!noUpdate)
             //this.doUpdate(UpdateType.display);
@@ -262,6 +337,9 @@ export class Display extends EventEmitter {
         this._model.on('parse-done', () => {
             this.emit('parse-done');
         });
+        this._model.on('backpressure', (paused, backlog) => {
+            this.emit('backpressure', paused, backlog);
+        });
 
         this._model.on('set-title', (title, type) => {
             this.emit('set-title', title, type);
@@ -294,6 +372,7 @@ export class Display extends EventEmitter {
         if (value === this._timestamp) return;
         this._timestamp = value;
         this._viewCache = {};
+        this.clearOverlayCache();
         if (this.split)
             this.split.viewCache = {};
         this.doUpdate(UpdateType.display);
@@ -305,6 +384,7 @@ export class Display extends EventEmitter {
         this._timestampFormat = value;
         this._timestampWidth = this.textWidth(moment().format(this._timestampFormat));
         this._viewCache = {};
+        this.clearOverlayCache();
         if (this.split)
             this.split.viewCache = {};
         this.doUpdate(UpdateType.display);
@@ -436,14 +516,7 @@ export class Display extends EventEmitter {
                     const bLines = [];
                     let start = this.split._viewRange.start;
                     const end = this.split._viewRange.end;
-                    const overlays = [];
-                    let ol;
-                    for (ol in this._overlays) {
-                        if (!this._overlays.hasOwnProperty(ol) || ol === 'selection')
-                            continue;
-                        overlays.push.apply(overlays, this._overlays[ol].slice(start, end + 1));
-                    }
-                    overlays.push.apply(overlays, this._overlays['selection'].slice(start, end + 1));
+                    const overlays = this.buildOverlays(start, end);
                     const mw = '' + (this._maxWidth === 0 ? 0 : Math.max((this._timestamp ? this._timestampWidth : 0) + this._maxWidth, this._maxView));
                     const mv = '' + this._maxView;
                     this.split.view.style.width = (this._timestamp ? this._timestampWidth : 0) + this._maxWidth + 'px';
@@ -469,14 +542,7 @@ export class Display extends EventEmitter {
                 if (this.split.shown && this._VScroll.scrollSize >= 0 && this._lines.length > 0) {
                     const start = this.split._viewRange.start;
                     const end = this.split._viewRange.end;
-                    const overlays = [];
-                    let ol;
-                    for (ol in this._overlays) {
-                        if (!this._overlays.hasOwnProperty(ol) || ol === 'selection')
-                            continue;
-                        overlays.push.apply(overlays, this._overlays[ol].slice(start, end + 1));
-                    }
-                    overlays.push.apply(overlays, this._overlays['selection'].slice(start, end + 1));
+                    const overlays = this.buildOverlays(start, end);
                     this.split.overlay.innerHTML = overlays.join('');
                 }
             };
@@ -627,11 +693,16 @@ export class Display extends EventEmitter {
         this._canvas.style.position = 'absolute';
         this._canvas.style.left = '-1000px';
         this._styles = document.createElement('style');
+        this._colorStyles = document.createElement('style');
+        //scope color classes to this display as each can have its own palette
+        this._palette = ++_palettes;
+        this._el.dataset.palette = '' + this._palette;
 
         this._innerHeight = this._el.clientHeight;
         this._innerWidth = this._el.clientWidth;
         const fragment = document.createDocumentFragment();
         fragment.appendChild(this._styles);
+        fragment.appendChild(this._colorStyles);
         this._background = document.createElement('div');
         this._background.id = this._el.id + '-background';
         this._background.classList.add('background');
@@ -1061,14 +1132,80 @@ export class Display extends EventEmitter {
         this._finder.location = value;
     }
 
+    /**
+     * Calculate and append the wrapped lines for a model line added to the end
+     *
+     * @param idx The model line index
+     */
+    private wrapLine(idx: number) {
+        const t = this.calculateWrapLines(idx, 0, this._indent, (this._timestamp ? this._timestampWidth : 0));
+        //track wrapped lines to line to make it easier ot lookup all wrapped lines and allow indexOf and other build in functions
+        this._linesMap.set(this._model.getLineID(idx), t);
+        if (this._model.lines[idx].formats[0].hr) {
+            t[0].hr = true;
+            this._maxWidth = Math.max(this._maxWidth, this._maxView);
+            this._maxHeight = Math.max(this._maxHeight, this._charHeight);
+        }
+        else {
+            this._maxWidth = Math.max(this._maxWidth, t[0].width);
+            this._maxHeight = Math.max(this._maxHeight, t[0].height);
+        }
+        if (this._lines.length > 0)
+            t[0].top = this._lines[this._lines.length - 1].top + this._lines[this._lines.length - 1].height;
+        for (let l = 1, ll = t.length; l < ll; l++) {
+            t[l].top = t[l - 1].top + t[l - 1].height;
+            this._maxWidth = Math.max(this._maxWidth, t[l].width + ((this._indent || 0) * this._charWidth));
+            this._maxHeight = Math.max(this._maxHeight, t[l].height);
+        }
+        this._lines.push(...t);
+    }
+
+    /**
+     * Wrap any lines added while detached
+     */
+    private wrapBacklog() {
+        if (!this._backlog) return;
+        const ll = this._model.lines.length;
+        let l = Math.max(0, ll - this._backlog);
+        this._backlog = 0;
+        for (; l < ll; l++)
+            this.wrapLine(l);
+        if (this.split) this.split.dirty = true;
+    }
+
+    /**
+     * Do any rewraps marked dirty while detached and wrap the backlog
+     */
+    private flushWraps() {
+        if (this._wrapDirty) {
+            this._wrapDirty = false;
+            this._dirtyWraps.clear();
+            this.reCalculateLines();
+            return;
+        }
+        this.wrapBacklog();
+        if (!this._dirtyWraps.size) return;
+        const ids = [...this._dirtyWraps];
+        this._dirtyWraps.clear();
+        for (let i = 0, il = ids.length; i < il; i++) {
+            const idx = this._model.getLineFromID(ids[i]);
+            if (idx !== -1)
+                this.reCalculateWrapLines(idx, 0, this._indent, (this._timestamp ? this._timestampWidth : 0));
+        }
+    }
+
     private doUpdate(type?: UpdateType) {
         if (!type) return;
         this._updating |= type;
         if (this._updating === UpdateType.none)
             return;
+        //nothing is rendered while detached, flags are kept until attached
+        if (this._detached)
+            return;
         window.requestAnimationFrame(() => {
             if (this._updating === UpdateType.none)
                 return;
+            const start = this._tracer && this._tracer.enabled ? performance.now() : 0;
             if ((this._updating & UpdateType.layout) === UpdateType.layout) {
                 this.updateLayout();
                 this._updating &= ~UpdateType.layout;
@@ -1159,10 +1296,14 @@ export class Display extends EventEmitter {
                 this._updating &= ~UpdateType.update;
                 this._updating &= ~UpdateType.scrollbars;
             }
+            //only restore once the view has been sized for the new wraps
+            if (this._scrollAnchor && (this._updating & (UpdateType.display | UpdateType.view | UpdateType.scrollbars)) === 0)
+                this.restoreScrollAnchor();
             if ((this._updating & UpdateType.scrollEnd) === UpdateType.scrollEnd) {
                 this.scrollDisplay();
                 this._updating &= ~UpdateType.scrollEnd;
             }
+            if (start) this._tracer.painted(start);
             this.doUpdate(this._updating);
         });
     }
@@ -1208,6 +1349,14 @@ export class Display extends EventEmitter {
         return this._model.parseQueueEndOfLine;
     }
 
+    get parseStats() {
+        return this._model.parseStats;
+    }
+
+    public resetParseStats() {
+        this._model.resetParseStats();
+    }
+
     get EndOfLineLength(): number {
         if (this._lines.length === 0)
             return 0;
@@ -1233,7 +1382,22 @@ export class Display extends EventEmitter {
     }
     get defaultMXPState(): boolean {
         return this._model.defaultMXPState;
-    }    
+    }
+
+    set hotLines(value: number) {
+        this._model.hotLines = value;
+    }
+    get hotLines(): number {
+        return this._model.hotLines;
+    }
+
+    set tracer(value: Tracer) {
+        this._tracer = value;
+        this._model.tracer = value;
+    }
+    get tracer(): Tracer {
+        return this._tracer;
+    }
 
     set showInvalidMXPTags(value: boolean) {
         this._model.showInvalidMXPTags = value;
@@ -1312,12 +1476,28 @@ export class Display extends EventEmitter {
         this.emit('update-window', width, height);
     }
 
+    /**
+     * Replace the lines with ones from DisplayModel.saveLines and redraw
+     *
+     * @param lines The lines
+     */
+    public restoreLines(lines) {
+        this.clear();
+        this._model.restoreLines(lines);
+        this.reCalculateLines();
+        this.doUpdate(UpdateType.display);
+    }
+
     public clear() {
         this._model.clear();
-        this._overlays = {
-            selection: []
-        };
+        this._overlays = {};
         this._viewCache = {};
+        this._backlog = 0;
+        this._wrapDirty = false;
+        this._dirtyWraps.clear();
+        this._lineEdits.clear();
+        this.cancelRewrap();
+        this._scrollAnchor = null;
 
         this._lines = [];
 
@@ -1368,6 +1548,8 @@ export class Display extends EventEmitter {
 
             this._contextFont = `${size} ${font}`;
             this._context.font = this._contextFont;
+            this._glyphWidths.clear();
+            this.clearOverlayCache();
             //recalculate height/width of characters so display can be calculated
             this._charHeight = parseFloat(window.getComputedStyle(this._character).height);
             this._charWidth = parseFloat(window.getComputedStyle(this._character).width);
@@ -1450,15 +1632,49 @@ export class Display extends EventEmitter {
             start = this._viewRange.start;
         if (end === undefined)
             end = this._viewRange.end;
+        this._overlay.innerHTML = this.buildOverlays(start, end).join('');
+    }
+
+    /**
+     * Build the overlay markup for a range of wrapped lines, selection is always drawn last
+     *
+     * @param start The first wrapped line
+     * @param end The last wrapped line
+     * @returns Array of overlay-line markup
+     */
+    private buildOverlays(start: number, end: number): string[] {
         const overlays = [];
         let ol;
         for (ol in this._overlays) {
             if (!this._overlays.hasOwnProperty(ol) || ol === 'selection')
                 continue;
-            overlays.push.apply(overlays, this._overlays[ol].slice(start, end + 1));
+            this.buildOverlayLayer(this._overlays[ol], ol, start, end, overlays);
+        }
+        if (this._overlays.selection)
+            this.buildOverlayLayer(this._overlays.selection, 'selection', start, end, overlays);
+        return overlays;
+    }
+
+    private buildOverlayLayer(layer: OverlayLayer, type: string, start: number, end: number, overlays: string[]) {
+        if (end >= this._lines.length)
+            end = this._lines.length - 1;
+        if (start < 0)
+            start = 0;
+        //only visible lines are ever cached, so if it grows too large the user has scrolled a lot, start over
+        if (layer.html.size > 2000)
+            layer.html.clear();
+        for (let line = start; line <= end; line++) {
+            const ll = line + layer.offset;
+            if (ll > layer.last)
+                break;
+            let html = layer.html.get(ll);
+            if (html === undefined) {
+                html = this.buildOverlayLine(layer, type, line);
+                layer.html.set(ll, html);
+            }
+            if (html.length)
+                overlays.push(`<div style="top: ${line * this._charHeight}px;height:${this._charHeight}px;" class="overlay-line">${html}</div>`);
         }
-        overlays.push.apply(overlays, this._overlays['selection'].slice(start, end + 1));
-        this._overlay.innerHTML = overlays.join('');
     }
 
     private updateDisplay() {
@@ -1513,6 +1729,7 @@ export class Display extends EventEmitter {
 
     public removeLine(line: number, noSelectionChange?: boolean) {
         if (line < 0 || line >= this.lines.length) return;
+        this.wrapBacklog();
         this.emit('line-removed', line, this.lines[line].text);
         const lineID = this._model.getLineID(line);
         const wrapIndex = this._lines.findIndex(l => l.id === lineID);
@@ -1577,12 +1794,7 @@ export class Display extends EventEmitter {
                 this._currentSelection.end.lineOffset = this._currentSelection.end.x + this._lines[this._currentSelection.end.y].startOffset;
             }
         }
-        let ol;
-        for (ol in this._overlays) {
-            if (!this._overlays.hasOwnProperty(ol) || this._overlays[ol].length === 0 || line >= this._overlays[ol].length)
-                continue;
-            this._overlays[ol].splice(wrapIndex, amt);
-        }
+        this.removeOverlayLines(wrapIndex, amt);
         if (this.split) this.split.dirty = true;
         this.updateTops(wrapIndex);
         this.doUpdate(UpdateType.view | UpdateType.scrollbars | UpdateType.overlays | UpdateType.selection);
@@ -1591,6 +1803,7 @@ export class Display extends EventEmitter {
     public removeLines(line: number, amt: number) {
         if (line < 0 || line >= this.lines.length) return;
         if (amt < 1) amt = 1;
+        this.wrapBacklog();
         this.emit('lines-removed', line, this._lines.slice(line, line + amt - 1));
         const lineID = this._model.getLineID(line);
         const wrapIndex = this._lines.findIndex(l => l.id === lineID);
@@ -1659,12 +1872,7 @@ export class Display extends EventEmitter {
                 this._currentSelection.end.lineOffset = this._currentSelection.end.x + this._lines[this._currentSelection.end.y].startOffset;
             }
         }
-        let ol;
-        for (ol in this._overlays) {
-            if (!this._overlays.hasOwnProperty(ol) || this._overlays[ol].length === 0 || line >= this._overlays[ol].length)
-                continue;
-            this._overlays[ol].splice(wrapIndex, wrapAmt);
-        }
+        this.removeOverlayLines(wrapIndex, wrapAmt);
         if (this.split) this.split.dirty = true;
         this.updateTops(wrapIndex);
         this.doUpdate(UpdateType.view | UpdateType.scrollbars | UpdateType.overlays | UpdateType.selection);
@@ -1708,8 +1916,104 @@ export class Display extends EventEmitter {
         this.reCalculateWrapLines(idx, 0, this._indent, (this._timestamp ? this._timestampWidth : 0));
     }
 
+    /**
+     * Queue an edit for a line, edits queued while triggers run are applied together so each
+     * line has its formats split, pruned and rewrapped once no matter how many triggers touched it
+     *
+     * @param idx The line index
+     * @param edit The edit to apply
+     */
+    public queueLineEdit(idx: number, edit: LineEdit) {
+        if (idx < 0 || idx >= this._model.lines.length) return;
+        const id = this._model.getLineID(idx);
+        const edits = this._lineEdits.get(id);
+        if (edits)
+            edits.push(edit);
+        else
+            this._lineEdits.set(id, [edit]);
+        if (!this._lineEditTimer)
+            this._lineEditTimer = setTimeout(() => this.flushLineEdits(), 0);
+    }
+
+    /**
+     * Apply all queued line edits now
+     */
+    public flushLineEdits() {
+        clearTimeout(this._lineEditTimer);
+        this._lineEditTimer = null;
+        if (!this._lineEdits.size) return;
+        const lines = this._lineEdits;
+        this._lineEdits = new Map();
+        const ids = [...lines.keys()].sort((a, b) => a - b);
+        const il = ids.length;
+        for (let i = 0; i < il; i++) {
+            //line may have been gagged or trimmed since the edit was queued
+            const idx = this._model.nearestLineFromID(ids[i]);
+            if (this._model.getLineID(idx) !== ids[i])
+                continue;
+            //only update if something changed
+            if (!this._model.applyLineEdits(idx, lines.get(ids[i])))
+                continue;
+            //rebuild wraps in case a format was removed
+            this.reCalculateWrapLines(idx, 0, this._indent, (this._timestamp ? this._timestampWidth : 0));
+        }
+    }
+
     public SetColor(code: number, color) {
         this._model.SetColor(code, color);
+        this.buildColorStyleSheet();
+    }
+
+    /**
+     * Get the class index for a format color, adding a rule for it if new
+     *
+     * @param color The color code or css color
+     * @returns The index used for the cf and cb classes, -1 if too many colors and it should be styled inline
+     */
+    private colorClass(color: string | number): number {
+        let idx = this._colorClasses.get(color);
+        if (idx !== undefined)
+            return idx;
+        //formats keep their class so rules can not be dropped, stop adding once full
+        if (this._colorClasses.size >= MAX_COLOR_CLASSES)
+            return -1;
+        idx = this._colorClasses.size;
+        this._colorClasses.set(color, idx);
+        this.addColorRules(color, idx);
+        return idx;
+    }
+
+    /**
+     * Get a color as css for an inline style
+     *
+     * @param color The color code or css color
+     */
+    private inlineColor(color: string | number): string {
+        return (typeof color === 'number' ? this._model.GetColor(color) : color).replace(/[";<>]/g, '');
+    }
+
+    private addColorRules(color: string | number, idx: number) {
+        const sheet = this._colorStyles.sheet as CSSStyleSheet;
+        const css = typeof color === 'number' ? this._model.GetColor(color) : color;
+        const scope = `[data-palette="${this._palette}"] `;
+        //not attached yet so build the text and let the browser parse it once added
+        if (!sheet) {
+            this._colorStyles.appendChild(document.createTextNode(`${scope}.cf${idx} { color: ${css}; } ${scope}.cb${idx} { background: ${css}; }`));
+            return;
+        }
+        try {
+            sheet.insertRule(`${scope}.cf${idx} { color: ${css}; }`, sheet.cssRules.length);
+            sheet.insertRule(`${scope}.cb${idx} { background: ${css}; }`, sheet.cssRules.length);
+        }
+        catch (e) {
+            //invalid css color, leave unstyled like an invalid inline style
+        }
+    }
+
+    //palette changed so regenerate the rules for existing classes, formats keep their class indexes
+    private buildColorStyleSheet() {
+        this._colorStyles.textContent = '';
+        this._colorClasses.forEach((idx, color) => this.addColorRules(color, idx));
     }
 
     public ClearMXP() {
@@ -1751,6 +2055,9 @@ export class Display extends EventEmitter {
             }
             this._lines.splice(0, wrapAmt);
             this._model.removeLines(0, amt);
+            //backlog lines are always the newest so only trimmed if every wrapped line was
+            if (this._backlog > this._model.lines.length)
+                this._backlog = this._model.lines.length;
             if (this.hasSelection) {
                 this._currentSelection.start.y -= amt;
                 this._currentSelection.end.y -= amt;
@@ -1775,10 +2082,13 @@ export class Display extends EventEmitter {
                 this.emit('selection-done');
             }
             let ol;
+            //overlays are indexed by their own line numbers, just shift the offset instead of moving every line
             for (ol in this._overlays) {
-                if (!this._overlays.hasOwnProperty(ol) || this._overlays[ol].length === 0)
+                if (!this._overlays.hasOwnProperty(ol))
                     continue;
-                this._overlays[ol].splice(0, amt);
+                this._overlays[ol].offset += amt;
+                //new first line may now have ranges clipped at the top, so its corners change
+                this._overlays[ol].html.delete(this._overlays[ol].offset);
             }
 
             let m = 0;
@@ -1898,27 +2208,31 @@ export class Display extends EventEmitter {
 
     public getWrapOffset(line, offset) {
         if (line < 0 || line >= this._model.lines.length) return { x: 0, y: 0 };
+        this.wrapBacklog();
         const lineID = this._model.getLineID(line);
         const t = this._linesMap.get(lineID);
+        const row = this.wrapIndexOf(lineID);
         for (let l = 0, ll = t.length; l < ll; l++) {
             if (offset >= t[l].startOffset && offset < t[l].endOffset)
-                return { x: offset - t[l].startOffset, y: this._lines.indexOf(t[l]) };
+                return { x: offset - t[l].startOffset, y: row + l };
             else if (offset === t[l].endOffset)
-                return { x: offset - t[l].startOffset, y: this._lines.indexOf(t[l]) };
+                return { x: offset - t[l].startOffset, y: row + l };
         }
-        return { x: offset - t[t.length - 1].startOffset, y: this._lines.indexOf(t[t.length - 1]) };
+        return { x: offset - t[t.length - 1].startOffset, y: row + t.length - 1 };
     }
 
     public getWrapOffsetByLineID(lineID, offset) {
+        this.wrapBacklog();
         const t = this._linesMap.get(lineID);
         if (!t) return this._model.getLineFromID(lineID);
+        const row = this.wrapIndexOf(lineID);
         for (let l = 0, ll = t.length; l < ll; l++) {
             if (offset >= t[l].startOffset && offset < t[l].endOffset)
-                return { x: offset - t[l].startOffset, y: this._lines.indexOf(t[l]) };
+                return { x: offset - t[l].startOffset, y: row + l };
             else if (offset === t[l].endOffset)
-                return { x: offset - t[l].startOffset, y: this._lines.indexOf(t[l]) };
+                return { x: offset - t[l].startOffset, y: row + l };
         }
-        return { x: offset - t[t.length - 1].startOffset, y: this._lines.indexOf(t[t.length - 1]) };
+        return { x: offset - t[t.length - 1].startOffset, y: row + t.length - 1 };
     }
 
     public getWordFromPosition(position) {
@@ -2038,18 +2352,86 @@ export class Display extends EventEmitter {
         };
     }
 
+    /**
+     * Get the width of text, each character cluster is measured once per font and cached
+     *
+     * @param txt The text to measure
+     * @param font The css font to use, defaults to display font
+     * @param style The font style flags
+     */
     private textWidth(txt, font?, style?) {
         if (!txt || txt.length === 0) return 0;
         font = font || this._contextFont;
-        const canvas = this._canvas || (this._canvas = document.createElement('canvas'));
-        const context = this._context || (this._context = canvas.getContext('2d', { alpha: false }));
+        const plain = font === this._contextFont && !style && this._charWidth > 0;
         if ((style & FontStyle.Bold) === FontStyle.Bold)
             font = "bold " + font;
         if ((style & FontStyle.Italic) === FontStyle.Italic)
             font = "italic " + font;
-        context.font = font;
-        const metrics = context.measureText(txt);
-        return metrics.width;
+        let widths = this._glyphWidths.get(font);
+        if (!widths || widths.size > 10000) {
+            widths = new Map<string, number>();
+            this._glyphWidths.set(font, widths);
+        }
+        const tl = txt.length;
+        let context;
+        let width = 0;
+        let s = 0;
+        let e;
+        let code;
+        let glyph;
+        let w;
+        while (s < tl) {
+            code = txt.charCodeAt(s);
+            //ascii in the display font is always the character width
+            if (plain && code > 31 && code < 127) {
+                width += this._charWidth;
+                s++;
+                continue;
+            }
+            e = this.glyphEnd(txt, s, tl);
+            glyph = txt.substring(s, e);
+            w = widths.get(glyph);
+            if (w === undefined) {
+                //only set font once for all unknown glyphs
+                if (!context) {
+                    const canvas = this._canvas || (this._canvas = document.createElement('canvas'));
+                    context = this._context || (this._context = canvas.getContext('2d', { alpha: false }));
+                    context.font = font;
+                }
+                w = context.measureText(glyph).width;
+                widths.set(glyph, w);
+            }
+            width += w;
+            s = e;
+        }
+        return width;
+    }
+
+    /**
+     * Find the end of the character cluster starting at an offset, including surrogate pairs, combining marks, variants,
+     * zero width joined characters and emoji skin tones
+     *
+     * @param txt The text
+     * @param s The start of the cluster
+     * @param tl The length of the text
+     */
+    private glyphEnd(txt: string, s: number, tl: number) {
+        let e = s + 1;
+        let code;
+        while (e < tl) {
+            code = txt.charCodeAt(e);
+            if (this.isUnicodeModifierCode(code))
+                e++;
+            //zero width joiner, joins the next character
+            else if (code === 0x200D)
+                e += 2;
+            //emoji skin tone modifiers U+1F3FB - U+1F3FF
+            else if (code === 0xD83C && e + 1 < tl && txt.charCodeAt(e + 1) >= 0xDFFB && txt.charCodeAt(e + 1) <= 0xDFFF)
+                e += 2;
+            else
+                break;
+        }
+        return e > tl ? tl : e;
     }
 
     private textHeight(txt, font?, size?) {
@@ -2187,234 +2569,349 @@ export class Display extends EventEmitter {
     public clearOverlay(type?: string) {
         if (!type)
             type = 'default';
-        if (!this._overlays[type] || this._overlays[type].length === 0) return;
-        this._overlays[type] = [];
+        if (!this._overlays[type]) return;
+        delete this._overlays[type];
         delete this._overlayRanges[type];
         if (this.split) this.split.dirty = true;
         this.doUpdate(UpdateType.overlays);
     }
 
-    //TODO add font support, as different blocks of text could have different font formats, need to not just measure with but measure based on format block data
+    /**
+     * Add a set of ranges as an overlay type, replacing any existing ranges of that type
+     *
+     * Ranges are only indexed by line here, markup is built as lines become visible
+     *
+     * @param ranges The ranges to add
+     * @param rangeCls The css class to draw the ranges with
+     * @param type The overlay type
+     */
     public addOverlays(ranges: OverlayRange[], rangeCls?: string, type?: string) {
-        let s;
-        let e;
-        let sL;
-        let eL;
-        let w;
         let r;
         let range;
         const rl = ranges.length;
+        const len = this._lines.length;
+        const records: OverlayRecord[] = [];
         if (!type)
             type = 'default';
         if (!rangeCls || rangeCls.length === 0)
             rangeCls = 'overlay-default';
-        this._overlays[type] = [];
-        const fl = Math.trunc;
-        const mw = Math.max((this._timestamp ? this._timestampWidth : 0) + this._maxWidth, this._maxView);
-        const len = this._lines.length;
         this._overlayRanges[type] = { ranges: ranges, cls: rangeCls };
         for (r = 0; r < rl; r++) {
             range = ranges[r];
-            if (range.start.y > range.end.y) {
-                sL = range.end.y;
-                eL = range.start.y;
-                s = range.end.x;
-                e = range.start.x;
-            }
-            else if (range.start.y < range.end.y) {
-                sL = range.start.y;
-                eL = range.end.y;
-                s = range.start.x;
-                e = range.end.x;
-            }
-            else if (range.start.x === range.end.x) {
-                //empty range
-                if (this.split) {//} && (range.start.y >= this.split._viewRange.start)) {
-                    this.split.dirty = true;
-                    this.doUpdate(UpdateType.scrollViewOverlays);
-                }
-                this.doUpdate(UpdateType.overlays);
+            if (range.start.y > range.end.y)
+                records.push({ r: r, sL: range.end.y, eL: range.start.y, s: range.end.x, e: range.start.x });
+            else if (range.start.y < range.end.y)
+                records.push({ r: r, sL: range.start.y, eL: range.end.y, s: range.start.x, e: range.end.x });
+            //empty range or invalid view
+            else if (range.start.x === range.end.x || range.start.y < 0 || range.start.y >= len)
                 continue;
-            }
-            else {
-                sL = range.start.y;
-                //invalid view
-                if (sL < 0 || sL >= this._lines.length)
-                    continue;
+            else
+                records.push({ r: r, sL: range.start.y, eL: range.start.y, s: Math.min(range.start.x, range.end.x), e: Math.max(range.start.x, range.end.x) });
+        }
+        const layer: OverlayLayer = {
+            cls: rangeCls,
+            records: null,
+            lines: null,
+            spans: null,
+            spanEnds: null,
+            last: -1,
+            offset: 0,
+            html: null
+        };
+        this.indexOverlays(layer, records);
+        this._overlays[type] = layer;
+        if (this.split) {
+            this.split.dirty = true;
+            this.doUpdate(UpdateType.scrollViewOverlays);
+        }
+        this.doUpdate(UpdateType.overlays);
+    }
 
-                if (this._lines[sL].hr) {
-                    s = 0;
-                    e = mw;
-                }
-                else {
-                    s = Math.min(range.start.x, range.end.x);
-                    e = Math.max(range.start.x, range.end.x);
-                    if (s < 0) s = 0;
-                    if (e > this.getLineText(sL).length)
-                        e = this.getLineText(sL).length;
-                    e = this.wrapLineWidth(sL, s, e);
-                    s = this.wrapLineWidth(sL, 0, s);
-                }
-                s += (this._timestamp ? this._timestampWidth : 0);
-                if (this._lines[sL].indent)
-                    s += this._indent * this._charWidth;
-                if (!this._overlays[type][sL])
-                    this._overlays[type][sL] = [];
-                if (this._roundedRanges)
-                    this._overlays[type][sL].push(`<span id="${type}-${r}" class="${rangeCls} trc tlc brc blc" style="left: ${s}px;width: ${e}px"></span>`);
-                else
-                    this._overlays[type][sL].push(`<span id="${type}-${r}" class="${rangeCls}" style="left: ${s}px;width: ${e}px"></span>`);
+    private indexOverlays(layer: OverlayLayer, records: OverlayRecord[]) {
+        const rl = records.length;
+        layer.records = records;
+        layer.lines = new Map();
+        layer.spans = [];
+        layer.spanEnds = [];
+        layer.last = -1;
+        layer.html = new Map();
+        for (let r = 0; r < rl; r++) {
+            const record = records[r];
+            if (record.eL > layer.last)
+                layer.last = record.eL;
+            if (record.sL !== record.eL) {
+                layer.spans.push(record);
                 continue;
             }
+            const line = layer.lines.get(record.sL);
+            if (line)
+                line.push(record);
+            else
+                layer.lines.set(record.sL, [record]);
+        }
+        const sl = layer.spans.length;
+        if (sl > 1)
+            layer.spans.sort((a, b) => a.sL - b.sL || a.r - b.r);
+        for (let s = 0, m = -1; s < sl; s++) {
+            if (layer.spans[s].eL > m)
+                m = layer.spans[s].eL;
+            layer.spanEnds.push(m);
+        }
+    }
 
-            if (sL < 0)
-                sL = 0;
-            if (eL >= len) {
-                eL = len - 1;
-                e = this.getLineText(eL).length;
-            }
-            if (s < 0)
-                s = 0;
-            if (e > this.getLineText(eL).length)
-                e = this.getLineText(eL).length;
-            for (let line = sL; line < eL + 1; line++) {
-                const startStyle = {
-                    top: CornerType.Extern,
-                    bottom: CornerType.Extern
-                };
-                const endStyle = {
-                    top: CornerType.Extern,
-                    bottom: CornerType.Extern
-                };
-                let cls = rangeCls;
-                let cl = 0;
-                if (sL === line) {
-                    const tLine = this.getLineText(line);
-                    if (s >= tLine.length)
-                        cl = tLine.length;
-                    else
-                        cl = s;
-                }
-                if (this._lines[line].hr)
-                    w = mw;
-                else if (sL === line)
-                    w = this.wrapLineWidth(line, s) + this._charWidth;
-                else if (eL === line)
-                    w = this.wrapLineWidth(line, 0, e);
-                else
-                    w = this._lines[line].width + this._charWidth;
-                cl = this.wrapLineWidth(line, 0, cl);
-                if (this._lines[line].indent)
-                    cl += this._indent * this._charWidth;
-                cl = fl(cl);
-                if (this._roundedRanges) {
-                    let cr;
-                    if (this._lines[line].hr)
-                        cr = mw;
-                    else if (this._lines[line].indent)
-                        cr = fl((eL === line ? this.wrapLineWidth(line, 0, e) : (this._lines[line].width + this._charWidth)) + this._indent * this._charWidth);
-                    else
-                        cr = fl(eL === line ? this.wrapLineWidth(line, 0, e) : (this._lines[line].width + this._charWidth));
-                    if (line > sL) {
-                        let plIndent = this._lines[line - 1].indent ? this._indent * this._charWidth : 0;
-                        let pl = fl(plIndent);
-                        if (sL === line - 1) {
-                            if (this._lines[line - 1].hr)
-                                pl = 0;
-                            else if (fl(this.wrapLineWidth(sL, 0, s) + plIndent) >= fl(this._lines[line - 1].width + this._charWidth + plIndent))
-                                pl = fl(this._lines[line - 1].width + plIndent) + this._charWidth;
-                            else
-                                pl = fl(this.wrapLineWidth(sL, 0, s) + plIndent);
-                        }
-                        const pr = this._lines[line - 1].hr ? mw : fl(this._lines[line - 1].width + this._charWidth + plIndent);
-
-                        if (cl === pl)
-                            startStyle.top = CornerType.Flat;
-                        else if (cl > pl)
-                            startStyle.top = CornerType.Intern;
-                        if (cr === pr)
-                            endStyle.top = CornerType.Flat;
-                        else if (pl < cr && cr < pr)
-                            endStyle.top = CornerType.Intern;
-                        else if (cr === 0 && line === eL)
-                            endStyle.top = CornerType.Intern;
-                    }
-
-                    if (line < eL) {
-                        let nr;
-                        let nrIndent = this._lines[line + 1].indent ? this._indent * this._charWidth : 0;
-                        if (this._lines[line + 1].hr)
-                            nr = mw;
-                        else
-                            nr = fl(eL === line + 1 ? (this.wrapLineWidth(line + 1, 0, e) + nrIndent) : (this._lines[line + 1].width + this._charWidth + nrIndent));
-                        if (cl === fl(nrIndent))
-                            startStyle.bottom = CornerType.Flat;
-                        else if (fl(nrIndent) < cl && cl < nr)
-                            startStyle.bottom = CornerType.Intern;
-
-                        if (cr === nr)
-                            endStyle.bottom = CornerType.Flat;
-                        else if (cr < nr)
-                            endStyle.bottom = CornerType.Intern;
-                    }
-
-                    if (startStyle.top === CornerType.Extern) {
-                        cls += ' tlc';
-                    }
-                    if (startStyle.bottom === CornerType.Extern) {
-                        cls += ' blc';
-                    }
-                    if (endStyle.top === CornerType.Extern) {
-                        cls += ' trc';
-                    }
-                    if (endStyle.bottom === CornerType.Extern) {
-                        cls += ' brc';
-                    }
-                }
-
-                if (!this._overlays[type][line])
-                    this._overlays[type][line] = [];
-                this._overlays[type][line].push(`<span id="${type}-${r}" class="${cls}" style="left:${(this._timestamp ? this._timestampWidth : 0) + cl}px;width: ${w}px;"></span>`);
-                if (startStyle.top === CornerType.Intern)
-                    this._overlays[type][line].push(`<span class="${rangeCls} ist" style="top:$0px;left:${(this._timestamp ? this._timestampWidth : 0) + (cl - 7)}px;"></span>`);
-                if (startStyle.bottom === CornerType.Intern)
-                    this._overlays[type][line].push(`<span class="${rangeCls} isb" style="top:${this._charHeight - 7}px;left:${(this._timestamp ? this._timestampWidth : 0) + (cl - 7)}px;"></span>`);
-                if (endStyle.top === CornerType.Intern)
-                    this._overlays[type][line].push(`<span class="${rangeCls} iet" style="top:0px;left:${(this._timestamp ? this._timestampWidth : 0) + (cl) + w}px;"></span>`);
-                if (endStyle.bottom === CornerType.Intern)
-                    this._overlays[type][line].push(`<span class="${rangeCls} ieb" style="top:${this._charHeight - 7}px;left:${(this._timestamp ? this._timestampWidth : 0) + (cl) + w}px;"></span>`);
-            }
+    /**
+     * Drop the rendered markup of every overlay layer, markup is cached by line and depends on
+     * the wrapped lines, widths and font so has to be rebuilt when any of those change
+     */
+    private clearOverlayCache() {
+        let ol;
+        for (ol in this._overlays) {
+            if (!this._overlays.hasOwnProperty(ol))
+                continue;
+            this._overlays[ol].html.clear();
         }
+    }
+
+    /**
+     * Remove wrapped lines from all overlays, ranges after the lines are moved up
+     *
+     * @param wrapIndex The first wrapped line removed
+     * @param amt The number of wrapped lines removed
+     */
+    private removeOverlayLines(wrapIndex: number, amt: number) {
         let ol;
-        for (ol in this._overlays[type]) {
-            if (!this._overlays[type].hasOwnProperty(ol))
+        for (ol in this._overlays) {
+            if (!this._overlays.hasOwnProperty(ol))
                 continue;
-            this._overlays[type][ol] = `<div style="top: ${(+ol || 0) * this._charHeight}px;height:${this._charHeight}px;" class="overlay-line">${this._overlays[type][ol].join('')}</div>`;
-            if (this.split) { //&& ol >= this.split._viewRange.start) {
-                this.split.dirty = true;
-                this.doUpdate(UpdateType.scrollViewOverlays);
+            const layer = this._overlays[ol];
+            const start = wrapIndex + layer.offset;
+            const end = start + amt;
+            //nothing at or after the removed lines
+            if (layer.last < start)
+                continue;
+            const records = [];
+            const rl = layer.records.length;
+            for (let r = 0; r < rl; r++) {
+                const record = layer.records[r];
+                const sL = record.sL >= end ? record.sL - amt : (record.sL >= start ? start : record.sL);
+                const eL = record.eL >= end ? record.eL - amt : (record.eL >= start ? start - 1 : record.eL);
+                //range was completely inside the removed lines
+                if (eL < sL)
+                    continue;
+                if (sL === record.sL && eL === record.eL)
+                    records.push(record);
+                else
+                    records.push({ r: record.r, sL: sL, eL: eL, s: record.s, e: record.e });
             }
+            this.indexOverlays(layer, records);
         }
-        this.doUpdate(UpdateType.overlays);
     }
 
     //TODO add font support, as different blocks of text could have different font formats, need to not just measure with but measure based on format block data
-    private updateSelection() {
-        this.addOverlays([{ start: this._currentSelection.start, end: this._currentSelection.end }], 'select-text', 'selection');
+    private buildOverlayLine(layer: OverlayLayer, type: string, line: number): string {
+        const parts = [];
+        const ll = line + layer.offset;
+        const records = layer.lines.get(ll);
+        const spans = layer.spans;
+        const sl = spans.length;
+        let r;
+        if (records) {
+            for (r = 0; r < records.length; r++)
+                this.buildOverlayRange(parts, layer, type, records[r], line);
+        }
+        if (!sl || layer.spanEnds[sl - 1] < ll)
+            return parts.join('');
+        //find the first span that could reach this line, spans are sorted by start so stop once they start after it
+        let lo = 0;
+        let hi = sl - 1;
+        while (lo < hi) {
+            const mid = (lo + hi) >> 1;
+            if (layer.spanEnds[mid] < ll)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        for (r = lo; r < sl && spans[r].sL <= ll; r++) {
+            if (spans[r].eL >= ll)
+                this.buildOverlayRange(parts, layer, type, spans[r], line);
+        }
+        return parts.join('');
     }
 
-    get hasSelection(): boolean {
-        const sel = this._currentSelection;
-        if (sel.start.x === sel.end.x && sel.start.y === sel.end.y)
-            return false;
-        return true;
-    }
+    private buildOverlayRange(parts: string[], layer: OverlayLayer, type: string, record: OverlayRecord, line: number) {
+        let s = record.s;
+        let e = record.e;
+        let sL = record.sL - layer.offset;
+        let eL = record.eL - layer.offset;
+        let w;
+        const rangeCls = layer.cls;
+        const r = record.r;
+        const fl = Math.trunc;
+        const mw = Math.max((this._timestamp ? this._timestampWidth : 0) + this._maxWidth, this._maxView);
+        const len = this._lines.length;
+        if (sL === eL) {
+            if (this._lines[sL].hr) {
+                s = 0;
+                e = mw;
+            }
+            else {
+                if (s < 0) s = 0;
+                if (e > this.getLineText(sL).length)
+                    e = this.getLineText(sL).length;
+                e = this.wrapLineWidth(sL, s, e);
+                s = this.wrapLineWidth(sL, 0, s);
+            }
+            s += (this._timestamp ? this._timestampWidth : 0);
+            if (this._lines[sL].indent)
+                s += this._indent * this._charWidth;
+            if (this._roundedRanges)
+                parts.push(`<span id="${type}-${r}" class="${rangeCls} trc tlc brc blc" style="left: ${s}px;width: ${e}px"></span>`);
+            else
+                parts.push(`<span id="${type}-${r}" class="${rangeCls}" style="left: ${s}px;width: ${e}px"></span>`);
+            return;
+        }
 
-    get selection(): string {
-        if (this._lines.length === 0) return '';
-        const sel = this._currentSelection;
-        let s = sel.start.x;
-        let e = sel.end.x;
+        //start was trimmed off the top, range now starts at the beginning of the first line and continues above it
+        const clipped = sL < 0;
+        if (clipped) {
+            sL = 0;
+            s = 0;
+        }
+        if (eL >= len) {
+            eL = len - 1;
+            e = this.getLineText(eL).length;
+        }
+        if (s < 0)
+            s = 0;
+        if (e > this.getLineText(eL).length)
+            e = this.getLineText(eL).length;
+        const startStyle = {
+            top: CornerType.Extern,
+            bottom: CornerType.Extern
+        };
+        const endStyle = {
+            top: CornerType.Extern,
+            bottom: CornerType.Extern
+        };
+        let cls = rangeCls;
+        let cl = 0;
+        if (sL === line) {
+            const tLine = this.getLineText(line);
+            if (s >= tLine.length)
+                cl = tLine.length;
+            else
+                cl = s;
+        }
+        if (this._lines[line].hr)
+            w = mw;
+        else if (sL === line)
+            w = this.wrapLineWidth(line, s) + this._charWidth;
+        else if (eL === line)
+            w = this.wrapLineWidth(line, 0, e);
+        else
+            w = this._lines[line].width + this._charWidth;
+        cl = this.wrapLineWidth(line, 0, cl);
+        if (this._lines[line].indent)
+            cl += this._indent * this._charWidth;
+        cl = fl(cl);
+        if (this._roundedRanges) {
+            let cr;
+            if (this._lines[line].hr)
+                cr = mw;
+            else if (this._lines[line].indent)
+                cr = fl((eL === line ? this.wrapLineWidth(line, 0, e) : (this._lines[line].width + this._charWidth)) + this._indent * this._charWidth);
+            else
+                cr = fl(eL === line ? this.wrapLineWidth(line, 0, e) : (this._lines[line].width + this._charWidth));
+            if (line > sL) {
+                let plIndent = this._lines[line - 1].indent ? this._indent * this._charWidth : 0;
+                let pl = fl(plIndent);
+                if (sL === line - 1) {
+                    if (this._lines[line - 1].hr)
+                        pl = 0;
+                    else if (fl(this.wrapLineWidth(sL, 0, s) + plIndent) >= fl(this._lines[line - 1].width + this._charWidth + plIndent))
+                        pl = fl(this._lines[line - 1].width + plIndent) + this._charWidth;
+                    else
+                        pl = fl(this.wrapLineWidth(sL, 0, s) + plIndent);
+                }
+                const pr = this._lines[line - 1].hr ? mw : fl(this._lines[line - 1].width + this._charWidth + plIndent);
+
+                if (cl === pl)
+                    startStyle.top = CornerType.Flat;
+                else if (cl > pl)
+                    startStyle.top = CornerType.Intern;
+                if (cr === pr)
+                    endStyle.top = CornerType.Flat;
+                else if (pl < cr && cr < pr)
+                    endStyle.top = CornerType.Intern;
+                else if (cr === 0 && line === eL)
+                    endStyle.top = CornerType.Intern;
+            }
+            //nothing drawn above a clipped range so no start corners
+            else if (clipped && line === sL) {
+                startStyle.top = CornerType.Flat;
+                endStyle.top = CornerType.Flat;
+            }
+
+            if (line < eL) {
+                let nr;
+                let nrIndent = this._lines[line + 1].indent ? this._indent * this._charWidth : 0;
+                if (this._lines[line + 1].hr)
+                    nr = mw;
+                else
+                    nr = fl(eL === line + 1 ? (this.wrapLineWidth(line + 1, 0, e) + nrIndent) : (this._lines[line + 1].width + this._charWidth + nrIndent));
+                if (cl === fl(nrIndent))
+                    startStyle.bottom = CornerType.Flat;
+                else if (fl(nrIndent) < cl && cl < nr)
+                    startStyle.bottom = CornerType.Intern;
+
+                if (cr === nr)
+                    endStyle.bottom = CornerType.Flat;
+                else if (cr < nr)
+                    endStyle.bottom = CornerType.Intern;
+            }
+
+            if (startStyle.top === CornerType.Extern) {
+                cls += ' tlc';
+            }
+            if (startStyle.bottom === CornerType.Extern) {
+                cls += ' blc';
+            }
+            if (endStyle.top === CornerType.Extern) {
+                cls += ' trc';
+            }
+            if (endStyle.bottom === CornerType.Extern) {
+                cls += ' brc';
+            }
+        }
+
+        parts.push(`<span id="${type}-${r}" class="${cls}" style="left:${(this._timestamp ? this._timestampWidth : 0) + cl}px;width: ${w}px;"></span>`);
+        if (startStyle.top === CornerType.Intern)
+            parts.push(`<span class="${rangeCls} ist" style="top:$0px;left:${(this._timestamp ? this._timestampWidth : 0) + (cl - 7)}px;"></span>`);
+        if (startStyle.bottom === CornerType.Intern)
+            parts.push(`<span class="${rangeCls} isb" style="top:${this._charHeight - 7}px;left:${(this._timestamp ? this._timestampWidth : 0) + (cl - 7)}px;"></span>`);
+        if (endStyle.top === CornerType.Intern)
+            parts.push(`<span class="${rangeCls} iet" style="top:0px;left:${(this._timestamp ? this._timestampWidth : 0) + (cl) + w}px;"></span>`);
+        if (endStyle.bottom === CornerType.Intern)
+            parts.push(`<span class="${rangeCls} ieb" style="top:${this._charHeight - 7}px;left:${(this._timestamp ? this._timestampWidth : 0) + (cl) + w}px;"></span>`);
+    }
+
+    //TODO add font support, as different blocks of text could have different font formats, need to not just measure with but measure based on format block data
+    private updateSelection() {
+        this.addOverlays([{ start: this._currentSelection.start, end: this._currentSelection.end }], 'select-text', 'selection');
+    }
+
+    get hasSelection(): boolean {
+        const sel = this._currentSelection;
+        if (sel.start.x === sel.end.x && sel.start.y === sel.end.y)
+            return false;
+        return true;
+    }
+
+    get selection(): string {
+        if (this._lines.length === 0) return '';
+        const sel = this._currentSelection;
+        let s = sel.start.x;
+        let e = sel.end.x;
         let sL = sel.start.y;
         let eL = sel.end.y;
         if ((sL === -1 && eL === -1) || sL === null || eL === null)
@@ -2571,6 +3068,176 @@ export class Display extends EventEmitter {
         return txt.join('\n');
     }
 
+    /**
+     * Get the current selection in model lines and text offsets, ordered start to end
+     *
+     * @returns The start line and offset and end line and offset, or null if nothing is selected
+     */
+    private getSelectionRange() {
+        const sel = this._currentSelection;
+        const ll = this._lines.length;
+        if (ll === 0 || sel.start.y === null || sel.end.y === null || (sel.start.y === -1 && sel.end.y === -1))
+            return null;
+        let start = sel.start;
+        let end = sel.end;
+        if (start.y > end.y || (start.y === end.y && start.x > end.x)) {
+            start = sel.end;
+            end = sel.start;
+        }
+        const sL = Math.min(Math.max(start.y, 0), ll - 1);
+        const eL = Math.min(Math.max(end.y, 0), ll - 1);
+        let e = end.x;
+        if (end.y >= ll || e > this.getLineText(eL).length)
+            e = this.getLineText(eL).length;
+        const range = {
+            start: this._model.getLineFromID(this._lines[sL].id),
+            startOffset: this._lines[sL].startOffset + Math.max(start.x, 0),
+            end: this._model.getLineFromID(this._lines[eL].id),
+            endOffset: this._lines[eL].startOffset + Math.max(e, 0)
+        };
+        if (range.start === -1 || range.end === -1 || (range.start === range.end && range.startOffset === range.endOffset))
+            return null;
+        return range;
+    }
+
+    /**
+     * Export the selection as text and optionally html and ansi, large selections are built in a background
+     * worker so the display stays responsive, emits selection-export-progress with the percent done
+     *
+     * @param html Include the selection as html
+     * @param ansi Include the selection as ansi escaped text
+     * @returns Promise resolving to the text, html, ansi and if the export was truncated
+     */
+    public exportSelection(html?: boolean, ansi?: boolean): Promise<{ text: string, html?: string, ansi?: string, truncated: boolean }> {
+        const range = this.getSelectionRange();
+        if (!range)
+            return Promise.resolve({ text: '', html: html ? '' : undefined, ansi: ansi ? '' : undefined, truncated: false });
+        //small selections are quicker to build here than to copy to the worker
+        if (!ansi && range.end - range.start < SELECTION_WORKER_LINES)
+            return Promise.resolve({ text: this.selection, html: html ? this.selectionAsHTML : undefined, truncated: false });
+        const lines = [];
+        const colors = {};
+        const model = this._model;
+        const mLines = model.lines;
+        let l;
+        let f;
+        let fl;
+        let format;
+        //only text and formats are needed, palette colors are resolved once each here as the worker has no color table
+        for (l = range.start; l <= range.end; l++) {
+            let formats = mLines[l].formats;
+            //plain text only needs to know if the line is a hr
+            if (!html && !ansi)
+                formats = formats.length && formats[0].hr ? [formats[0]] : [];
+            else if (l === range.start || l === range.end)
+                formats = this.selectionFormats(formats, l === range.start ? range.startOffset : 0, l === range.end ? range.endOffset : mLines[l].text.length);
+            for (f = 0, fl = formats.length; f < fl; f++) {
+                format = formats[f];
+                if (typeof format.color === 'number' && !(format.color in colors))
+                    colors[format.color] = model.GetColor(format.color);
+                if (typeof format.background === 'number' && !(format.background in colors))
+                    colors[format.background] = model.GetColor(format.background);
+            }
+            lines.push({ text: mLines[l].text, formats: formats });
+        }
+        if (!this._exportWorker) {
+            this._exportWorker = new Worker('./js/selection.background.js');
+            this._exportWorker.onmessage = (e) => {
+                const request = this._exports.get(e.data.id);
+                if (!request) return;
+                switch (e.data.event) {
+                    case 'progress':
+                        this.emit('selection-export-progress', e.data.percent);
+                        break;
+                    case 'done':
+                        this._exports.delete(e.data.id);
+                        this.emit('selection-export-progress', 100);
+                        request.resolve({ text: e.data.text, html: e.data.html, ansi: e.data.ansi, truncated: e.data.truncated });
+                        break;
+                    case 'error':
+                        this._exports.delete(e.data.id);
+                        request.reject(new Error(e.data.error));
+                        break;
+                }
+            };
+            this._exportWorker.onerror = (e) => {
+                this.failExports(e.message || 'Selection export failed');
+            };
+            this._exportWorker.onmessageerror = () => {
+                this.failExports('Selection export failed');
+            };
+        }
+        const id = ++this._exportId;
+        return new Promise((resolve, reject) => {
+            this._exports.set(id, { resolve: resolve, reject: reject });
+            this.emit('selection-export-progress', 0);
+            this._exportWorker.postMessage({
+                action: 'export',
+                id: id,
+                lines: lines,
+                start: range.startOffset,
+                end: range.endOffset,
+                colors: colors,
+                html: html,
+                ansi: ansi,
+                max: SELECTION_EXPORT_MAX,
+                enableFlashing: this.enableFlashing,
+                linkFunction: this.linkFunction,
+                mxpLinkFunction: this.mxpLinkFunction,
+                mxpSendFunction: this.mxpSendFunction,
+                mxpTooltipFunction: this.mxpTooltipFunction,
+                charWidth: this._charWidth,
+                charHeight: this._charHeight
+            });
+        });
+    }
+
+    /**
+     * Get the formats of a partly selected line that are needed to export the selected part, formats before
+     * the last normal format starting before the selection and formats starting after it are left out
+     *
+     * @param formats The line formats
+     * @param start The selection start offset in the line
+     * @param end The selection end offset in the line
+     * @returns The formats to export
+     */
+    private selectionFormats(formats: any[], start: number, end: number): any[] {
+        let first = 0;
+        let last = formats.length;
+        if (!last || formats[0].hr)
+            return formats;
+        //the normal format sets the style of any links that follow so it is kept
+        for (let f = 0; f < last && formats[f].offset < start; f++) {
+            if (formats[f].formatType === FormatType.Normal)
+                first = f;
+        }
+        while (last > first + 1 && formats[last - 1].offset > end)
+            last--;
+        if (first === 0 && last === formats.length)
+            return formats;
+        return formats.slice(first, last);
+    }
+
+    /**
+     * Reject every pending selection export and reset the worker, used when the worker fails or is disposed
+     *
+     * @param error The error to reject with
+     */
+    private failExports(error: string) {
+        if (this._exportWorker) {
+            this._exportWorker.terminate();
+            this._exportWorker = null;
+        }
+        if (!this._exports.size) return;
+        const exports = [...this._exports.values()];
+        this._exports.clear();
+        const el = exports.length;
+        for (let e = 0; e < el; e++)
+            exports[e].reject(new Error(error));
+        //clear the progress display
+        this.emit('selection-export-progress', 100);
+    }
+
     private clampPosition(point: Point): Point {
         if (point.y < 0) {
             point.y = 0;
@@ -2632,6 +3299,7 @@ export class Display extends EventEmitter {
         this._maxViewHeight = this._el.clientHeight - this._padding[0] - this._padding[2] - this._HScroll.size;
         //resized so new width needs a recalculate
         this._viewCache = {};
+        this.clearOverlayCache();
         if (this.split) {
             this.split.viewCache = {};
             this.split._innerHeight = this.split.clientHeight;
@@ -2660,8 +3328,10 @@ export class Display extends EventEmitter {
         const formats = this.lines[line].formats;
         let offset = 0;
         let bStyle: any = '';
+        let bColor: any = '';
         let fStyle: any = '';
         let fCls: any = '';
+        let cls;
         const ch = this._charHeight;
         const cw = this._charWidth;
         const len = formats.length;
@@ -2707,23 +3377,31 @@ export class Display extends EventEmitter {
             let width = this._lines[idx].formatWidths[f] || format.width;
             if (format.formatType === FormatType.Normal) {
                 eText = text.substring(offset, end);
-                if (format.bStyle) {
+                if (format.styleKey === this._styleKey && typeof format.fCls === 'string') {
                     bStyle = format.bStyle;
+                    bColor = format.bColor;
                     fStyle = format.fStyle;
                     fCls = format.fCls;
                 }
                 else {
-                    bStyle = [];
+                    bStyle = '';
+                    bColor = '';
                     fStyle = [];
                     fCls = [];
-                    if (typeof format.background === 'number')
-                        bStyle.push('background:', this._model.GetColor(format.background), ';');
-                    else if (format.background)
-                        bStyle.push('background:', format.background, ';');
-                    if (typeof format.color === 'number')
-                        fStyle.push('color:', this._model.GetColor(format.color), ';');
-                    else if (format.color)
-                        fStyle.push('color:', format.color, ';');
+                    if (format.background || format.background === 0) {
+                        cls = this.colorClass(format.background);
+                        if (cls === -1)
+                            bColor = 'background:' + this.inlineColor(format.background) + ';';
+                        else
+                            bStyle = ' class="cb' + cls + '"';
+                    }
+                    if (format.color || format.color === 0) {
+                        cls = this.colorClass(format.color);
+                        if (cls === -1)
+                            fStyle.push('color:', this.inlineColor(format.color), ';');
+                        else
+                            fCls.push('cf' + cls);
+                    }
 
                     //TODO variable character height is not supported
                     //TODO once supported update parser support tag to add font
@@ -2754,7 +3432,9 @@ export class Display extends EventEmitter {
                         if ((format.style & FontStyle.Strikeout) === FontStyle.Strikeout)
                             fCls.push('s');
                     }
-                    format.bStyle = bStyle = bStyle.join('');
+                    format.styleKey = this._styleKey;
+                    format.bStyle = bStyle;
+                    format.bColor = bColor;
                     format.fStyle = fStyle = fStyle.join('');
                     if (fCls.length !== 0)
                         format.fCls = fCls = ' class="' + fCls.join(' ') + '"';
@@ -2763,11 +3443,11 @@ export class Display extends EventEmitter {
                 }
                 if (f < startFormat) continue;
                 if (format.hr) {
-                    back.push('<span style="left:0;width:', mw, 'px;', bStyle, '"></span>');
+                    back.push('<span style="left:0;width:', mw, 'px;', bColor, '"', bStyle, '></span>');
                     fore.push('<span style="left:0;width:', mw, 'px;', fStyle, '"', fCls, '><div class="hr" style="background-color:', (typeof format.color === 'number' ? this._model.GetColor(format.color) : format.color), '"></div></span>');
                 }
                 else if (end - offset !== 0) {
-                    back.push('<span style="left:', left, 'px;width:', width, 'px;', bStyle, '"></span>');
+                    back.push('<span style="left:', left, 'px;width:', width, 'px;', bColor, '"', bStyle, '></span>');
                     fore.push('<span style="left:', left, 'px;width:', width, 'px;', fStyle, '"', fCls, '>', htmlEncode(eText), '</span>');
                     left += width;
                 }
@@ -2778,7 +3458,7 @@ export class Display extends EventEmitter {
                 fore.push('<a draggable="false" class="URLLink" href="javascript:void(0);" title="', format.href.replace(/"/g, '&quot;'), '" onclick="', this.linkFunction, '(\'', format.href.replace(/\\/g, '\\\\').replace(/"/g, '&quot;'), '\');return false;">');
                 if (end - offset === 0) continue;
                 eText = text.substring(offset, end);
-                back.push('<span style="left:', left, 'px;width:', width, 'px;', bStyle, '"></span>');
+                back.push('<span style="left:', left, 'px;width:', width, 'px;', bColor, '"', bStyle, '></span>');
                 fore.push('<span style="left:', left, 'px;width:', width, 'px;', fStyle, '"', fCls, '>', htmlEncode(eText), '</span>');
                 left += width;
             }
@@ -2793,7 +3473,7 @@ export class Display extends EventEmitter {
                 fore.push('<a draggable="false" data-id="', id, '" class="MXPLink" data-href="', format.href, '" href="javascript:void(0);" title="', format.hint.replace(/"/g, '&quot;'), '" onclick="', this.mxpLinkFunction, '(this, \'', format.href.replace(/\\/g, '\\\\').replace(/"/g, '&quot;'), '\');return false;">');
                 if (end - offset === 0) continue;
                 eText = text.substring(offset, end);
-                back.push('<span style="left:', left, 'px;width:', width, 'px;', bStyle, '"></span>');
+                back.push('<span style="left:', left, 'px;width:', width, 'px;', bColor, '"', bStyle, '></span>');
                 fore.push('<span style="left:', left, 'px;width:', width, 'px;', fStyle, '"', fCls, '>', htmlEncode(eText), '</span>');
                 left += width;
             }
@@ -2803,14 +3483,14 @@ export class Display extends EventEmitter {
                 fore.push('<a draggable="false" data-id="', id, '" class="MXPLink" href="javascript:void(0);" title="', format.hint.replace(/"/g, '&quot;'), '" onmouseover="', this.mxpTooltipFunction, '(this);"', ' onclick="', this.mxpSendFunction, '(event||window.event, this, ', format.href.replace(/\\/g, '\\\\').replace(/"/g, '&quot;'), ', ', format.prompt ? 1 : 0, ', ', format.tt.replace(/\\/g, '\\\\').replace(/"/g, '&quot;'), ');return false;">');
                 if (end - offset === 0) continue;
                 eText = text.substring(offset, end);
-                back.push('<span style="left:', left, 'px;width:', width, 'px;', bStyle, '" ></span>');
+                back.push('<span style="left:', left, 'px;width:', width, 'px;', bColor, '"', bStyle, ' ></span>');
                 fore.push('<span style="left:', left, 'px;width:', width, 'px;', fStyle, '"', fCls, '>', htmlEncode(eText), '</span>');
                 left += width;
             }
             else if (format.formatType === FormatType.MXPExpired && end - offset !== 0) {
                 if (f < startFormat) continue;
                 eText = text.substring(offset, end);
-                back.push('<span style="left:', left, 'px;width:', width, 'px;', bStyle, '"></span>');
+                back.push('<span style="left:', left, 'px;width:', width, 'px;', bColor, '"', bStyle, '></span>');
                 fore.push('<span style="left:', left, 'px;width:', width, 'px;', fStyle, '"', fCls, '>', htmlEncode(eText), '</span>');
                 left += width;
             }
@@ -2891,8 +3571,12 @@ export class Display extends EventEmitter {
         const formats = this.lines[idx].formats;
         const fLen = formats.length;
         let right = false;
+        let link = false;
         for (let f = 0; f < fLen; f++) {
             const format = formats[f];
+            //rest of the line is after the range, any open link is closed below
+            if (format.offset > len)
+                break;
             let nFormat;
             let end;
             const td = [];
@@ -2970,6 +3654,7 @@ export class Display extends EventEmitter {
             else if (format.formatType === FormatType.Link) {
                 if (offset < start || end < start)
                     continue;
+                link = true;
                 parts.push('<a draggable="false" class="URLLink" href="javascript:void(0);" title="');
                 parts.push(format.href.replace(/"/g, '&quot;'));
                 parts.push('" onclick="', this.linkFunction, '(\'', format.href.replace(/\\/g, '\\\\').replace(/"/g, '&quot;'), '\');return false;">');
@@ -2981,11 +3666,13 @@ export class Display extends EventEmitter {
             else if (format.formatType === FormatType.LinkEnd || format.formatType === FormatType.MXPLinkEnd || format.formatType === FormatType.MXPSendEnd) {
                 if (offset < start || end < start)
                     continue;
+                link = false;
                 parts.push('</a>');
             }
             else if (format.formatType === FormatType.MXPLink) {
                 if (offset < start || end < start)
                     continue;
+                link = true;
                 parts.push('<a draggable="false" class="MXPLink" href="javascript:void(0);" title="');
                 parts.push(format.href.replace(/"/g, '&quot;'));
                 parts.push('"');
@@ -2998,6 +3685,7 @@ export class Display extends EventEmitter {
             else if (format.formatType === FormatType.MXPSend) {
                 if (offset < start || end < start)
                     continue;
+                link = true;
                 parts.push('<a draggable="false" class="MXPLink" href="javascript:void(0);" title="');
                 parts.push(format.hint.replace(/"/g, '&quot;'));
                 parts.push('"');
@@ -3074,6 +3762,8 @@ export class Display extends EventEmitter {
                 parts.push(`src="${tmp}"/>`);
             }
         }
+        if (link)
+            parts.push('</a>');
         if (right && len < this.lines[idx].text.length)
             return `<span class="line" style="min-width:100%">${parts.join('')}</span>`;
         if (right)
@@ -3083,36 +3773,221 @@ export class Display extends EventEmitter {
         return `<span class="line">${parts.join('')}<br></span>`;
     }
 
+    /**
+     * Rewrap all lines, when there are a lot of lines only the lines around the view are wrapped right away and the
+     * rest keep their old wraps as an approximation until rewrapped during idle time
+     */
     public reCalculateLines() {
         const ll = this.lines.length;
-        this._lines = [];
-        this._linesMap.clear();
+        this.cancelRewrap();
+        //nothing is shown while detached so wait and rewrap everything once attached
+        if (this._detached) {
+            this._wrapDirty = true;
+            return;
+        }
+        this._backlog = 0;
         this._maxWidth = 0;
         this._maxHeight = 0
         //only recalculate if have lines
-        if (ll === 0) return;
-        let t: WrapLine[] = this.calculateWrapLines(0, 0, this._indent, (this._timestamp ? this._timestampWidth : 0), true);
-        if (this.lines[0].formats[0].hr) {
+        if (ll === 0) {
+            this._lines = [];
+            this._linesMap.clear();
+            return;
+        }
+        const anchor = this.getScrollAnchor();
+        let start = 0;
+        let end = ll;
+        if (ll > 1000) {
+            //wrap view and a margin either side, the rest is done in idle time
+            const rows = this.WindowHeight + 100;
+            if (!anchor) {
+                start = Math.max(0, ll - rows);
+                end = ll;
+            }
+            else {
+                start = Math.max(0, this._model.nearestLineFromID(anchor.id) - 100);
+                end = Math.min(ll, start + rows + 100);
+            }
+        }
+        if (start === 0 && end === ll) {
+            this._linesMap.clear();
+            this.rebuildLines();
+            this._scrollAnchor = anchor;
+            this.updateWrapOffsets();
+            return;
+        }
+        //only the wraps of the view lines are replaced, the full rebuild is done once all lines are rewrapped
+        const wraps = [];
+        for (let l = start; l < end; l++)
+            wraps.push(this.wrapLines(l));
+        this.replaceWraps(start, wraps);
+        this._scrollAnchor = anchor;
+        this._rewrap = {
+            below: end < ll ? this._model.getLineID(end) : -1,
+            last: this._model.getLineID(ll - 1),
+            above: start > 0 ? this._model.getLineID(start - 1) : -1
+        };
+        this._rewrapTimer = window.requestIdleCallback(deadline => this.rewrapSlice(deadline));
+    }
+
+    /**
+     * Wrap a model line
+     *
+     * @param idx The model line index
+     * @returns The wrapped lines
+     */
+    private wrapLines(idx: number): WrapLine[] {
+        const t = this.calculateWrapLines(idx, 0, this._indent, (this._timestamp ? this._timestampWidth : 0), true);
+        if (this.lines[idx].formats[0].hr)
             t[0].hr = true;
-            this._maxWidth = Math.max(this._maxWidth, this._maxView);
-            this._maxHeight = Math.max(this._maxHeight, this._charHeight);
+        return t;
+    }
+
+    /**
+     * Rebuild the wrapped lines from the wrap map, updating tops and max sizes, lines with out wraps are wrapped
+     */
+    private rebuildLines() {
+        const ll = this.lines.length;
+        const lines = [];
+        //new map so wraps of trimmed lines are dropped
+        const map = new Map<number, WrapLine[]>();
+        const indent = (this._indent || 0) * this._charWidth;
+        let maxWidth = 0;
+        let maxHeight = 0;
+        let top = 0;
+        let t;
+        let id;
+        for (let l = 0; l < ll; l++) {
+            id = this._model.getLineID(l);
+            t = this._linesMap.get(id) || this.wrapLines(l);
+            map.set(id, t);
+            if (t[0].hr) {
+                maxWidth = Math.max(maxWidth, this._maxView);
+                maxHeight = Math.max(maxHeight, this._charHeight);
+            }
+            else {
+                maxWidth = Math.max(maxWidth, t[0].width);
+                maxHeight = Math.max(maxHeight, t[0].height);
+            }
+            t[0].top = top;
+            top += t[0].height;
+            lines.push(t[0]);
+            for (let w = 1, wl = t.length; w < wl; w++) {
+                t[w].top = top;
+                top += t[w].height;
+                maxWidth = Math.max(maxWidth, t[w].width + indent);
+                maxHeight = Math.max(maxHeight, t[w].height);
+                lines.push(t[w]);
+            }
         }
-        else {
-            this._maxWidth = Math.max(this._maxWidth, t[0].width);
-            this._maxHeight = Math.max(this._maxHeight, t[0].height);
+        this._lines = lines;
+        this._linesMap = map;
+        this._maxWidth = maxWidth;
+        this._maxHeight = maxHeight;
+        this._viewCache = {};
+        this.clearOverlayCache();
+        if (this.split) {
+            this.split.viewCache = {};
+            this.split.dirty = true;
         }
-        for (let l = 1, ll = t.length; l < ll; l++) {
-            t[l].top = t[l - 1].top + t[l - 1].height;
-            this._maxWidth = Math.max(this._maxWidth, t[l].width + ((this._indent || 0) * this._charWidth));
-            this._maxHeight = Math.max(this._maxHeight, t[l].height);
+    }
+
+    /**
+     * Rewrap lines left by reCalculateLines until out of idle time, lines below the view first then lines above
+     * working away from the view, each slice only replaces the wraps it changed and lines are rebuilt once at the end
+     *
+     * @param deadline The idle deadline
+     */
+    private rewrapSlice(deadline: IdleDeadline) {
+        this._rewrapTimer = 0;
+        const rewrap = this._rewrap;
+        if (!rewrap) return;
+        const anchor = this.getScrollAnchor();
+        let l;
+        let ll;
+        let start;
+        let wraps;
+        //always do at least some lines so a busy display still finishes
+        let count = 0;
+        if (rewrap.below !== -1) {
+            l = this._model.nearestLineFromID(rewrap.below);
+            start = l;
+            wraps = [];
+            ll = this.lines.length;
+            for (; l < ll && (count < 50 || deadline.timeRemaining() > 1); l++, count++) {
+                //lines added after the recalculate are already wrapped
+                if (this._model.getLineID(l) > rewrap.last) break;
+                wraps.push(this.wrapLines(l));
+            }
+            this.replaceWraps(start, wraps);
+            rewrap.below = l < ll && this._model.getLineID(l) <= rewrap.last ? this._model.getLineID(l) : -1;
         }
-        this._linesMap.set(t[0].id, t);
-        this._lines.push(...t);
+        if (rewrap.below === -1 && rewrap.above !== -1) {
+            l = this._model.nearestLineFromID(rewrap.above);
+            //line removed so start at the one before it
+            if (l >= this.lines.length || this._model.getLineID(l) !== rewrap.above)
+                l--;
+            wraps = [];
+            for (; l >= 0 && (count < 50 || deadline.timeRemaining() > 1); l--, count++)
+                wraps.push(this.wrapLines(l));
+            wraps.reverse();
+            this.replaceWraps(l + 1, wraps);
+            rewrap.above = l >= 0 ? this._model.getLineID(l) : -1;
+        }
+        if (rewrap.below === -1 && rewrap.above === -1) {
+            this._rewrap = null;
+            //tops and max sizes are only approximate until now
+            this.rebuildLines();
+            this.updateWrapOffsets();
+        }
+        else
+            this._rewrapTimer = window.requestIdleCallback(d => this.rewrapSlice(d));
+        //keep the view on the same text as lines above change size
+        this._scrollAnchor = anchor;
+        this.doUpdate(UpdateType.view | UpdateType.scrollbars);
+    }
 
-        for (let l = 1; l < ll; l++) {
-            const t = this.calculateWrapLines(l, 0, this._indent, (this._timestamp ? this._timestampWidth : 0), true);
-            if (this.lines[l].formats[0].hr) {
-                t[0].hr = true;
+    /**
+     * Get the index of the first wrapped line of a line id, wrapped lines are in line id order so can be binary searched
+     *
+     * @param id The line id
+     * @returns The wrapped line index, or the wrapped line count if no line at or after the id
+     */
+    private wrapIndexOf(id: number) {
+        let low = 0;
+        let high = this._lines.length;
+        let mid;
+        while (low < high) {
+            mid = (low + high) >> 1;
+            if (this._lines[mid].id < id)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+        return low;
+    }
+
+    /**
+     * Replace the wrapped lines of a run of model lines in one splice, tops are only set for the new wraps and
+     * selection and overlay offsets are shifted instead of looked up again
+     *
+     * @param start The first model line
+     * @param wraps The new wraps of each line in the run
+     */
+    private replaceWraps(start: number, wraps: WrapLine[][]) {
+        const wl = wraps.length;
+        if (!wl) return;
+        const end = start + wl;
+        const first = this.wrapIndexOf(this._model.getLineID(start));
+        const last = end < this.lines.length ? this.wrapIndexOf(this._model.getLineID(end)) : this._lines.length;
+        const indent = (this._indent || 0) * this._charWidth;
+        const lines = [];
+        let top = first > 0 ? this._lines[first - 1].top + this._lines[first - 1].height : 0;
+        let t;
+        for (let w = 0; w < wl; w++) {
+            t = wraps[w];
+            this._linesMap.set(t[0].id, t);
+            if (t[0].hr) {
                 this._maxWidth = Math.max(this._maxWidth, this._maxView);
                 this._maxHeight = Math.max(this._maxHeight, this._charHeight);
             }
@@ -3120,15 +3995,105 @@ export class Display extends EventEmitter {
                 this._maxWidth = Math.max(this._maxWidth, t[0].width);
                 this._maxHeight = Math.max(this._maxHeight, t[0].height);
             }
-            this._linesMap.set(t[0].id, t);
-            t[0].top = this._lines[this._lines.length - 1].top + this._lines[this._lines.length - 1].height;
-            for (let l = 1, ll = t.length; l < ll; l++) {
-                t[l].top = t[l - 1].top + t[l - 1].height;
-                this._maxWidth = Math.max(this._maxWidth, t[l].width + ((this._indent || 0) * this._charWidth));
-                this._maxHeight = Math.max(this._maxHeight, t[l].height);
+            for (let r = 0, rl = t.length; r < rl; r++) {
+                if (r) {
+                    this._maxWidth = Math.max(this._maxWidth, t[r].width + indent);
+                    this._maxHeight = Math.max(this._maxHeight, t[r].height);
+                }
+                t[r].top = top;
+                top += t[r].height;
+                lines.push(t[r]);
+            }
+        }
+        this._lines.splice(first, last - first, ...lines);
+        this._viewCache = {};
+        this.clearOverlayCache();
+        if (this.split) {
+            this.split.viewCache = {};
+            this.split.dirty = true;
+        }
+        if (lines.length !== last - first)
+            this.shiftWrapOffsets(first, last, lines.length - (last - first));
+    }
+
+    /**
+     * Move selection and overlay offsets after wraps were replaced, offsets in the replaced rows are looked up and
+     * those after are moved by the change in rows
+     *
+     * @param first The first replaced row
+     * @param last The row after the last replaced row before replacing
+     * @param amount The number of rows added or removed
+     */
+    private shiftWrapOffsets(first: number, last: number, amount: number) {
+        const shift = point => {
+            if (point.y === null || point.y < first) return;
+            if (point.y >= last) {
+                point.y += amount;
+                return;
+            }
+            //find ranges are not tracked by line and are redone by the finder
+            if (!this._linesMap.has(point.lineID)) return;
+            const offset = this.getWrapOffsetByLineID(point.lineID, point.lineOffset);
+            point.y = offset.y;
+            point.x = offset.x;
+        };
+        shift(this._currentSelection.start);
+        shift(this._currentSelection.end);
+        let ol;
+        for (ol in this._overlayRanges) {
+            if (!this._overlayRanges.hasOwnProperty(ol) || !this._overlayRanges[ol] || ol === 'selection')
+                continue;
+            const ranges = this._overlayRanges[ol].ranges;
+            const rangesLength = ranges.length;
+            for (let r = 0; r < rangesLength; r++) {
+                shift(ranges[r].start);
+                shift(ranges[r].end);
             }
-            this._lines.push(...t);
         }
+        this.doUpdate(UpdateType.selection | UpdateType.overlays);
+    }
+
+    private cancelRewrap() {
+        if (this._rewrapTimer)
+            window.cancelIdleCallback(this._rewrapTimer);
+        this._rewrapTimer = 0;
+        this._rewrap = null;
+    }
+
+    /**
+     * Get the line at the top of the view and how many rows in to it the view starts, null if scrolled to the end
+     */
+    private getScrollAnchor() {
+        if (!this._lines.length || this._VScroll.atBottom)
+            return null;
+        let row = Math.trunc(this._VScroll.position / this._charHeight);
+        if (row < 0) row = 0;
+        if (row >= this._lines.length) return null;
+        const id = this._lines[row].id;
+        let rows = 0;
+        while (row - rows > 0 && this._lines[row - rows - 1].id === id)
+            rows++;
+        return { id: id, rows: rows };
+    }
+
+    /**
+     * Scroll back to the anchor line once the view and scrollbars have been updated for the new wraps
+     */
+    private restoreScrollAnchor() {
+        const anchor = this._scrollAnchor;
+        this._scrollAnchor = null;
+        if (!anchor) return;
+        const t = this._linesMap.get(anchor.id);
+        if (!t) return;
+        const row = this.wrapIndexOf(anchor.id);
+        if (row < this._lines.length)
+            this._VScroll.scrollTo((row + Math.min(anchor.rows, t.length - 1)) * this._charHeight);
+    }
+
+    /**
+     * Update selection and overlay positions after lines have been rewrapped
+     */
+    private updateWrapOffsets() {
         let offset;
         if (this._currentSelection.start.y !== null) {
             offset = this.getWrapOffsetByLineID(this._currentSelection.start.lineID, this._currentSelection.start.lineOffset)
@@ -3320,6 +4285,10 @@ export class Display extends EventEmitter {
     }
 
     public dispose() {
+        this.cancelRewrap();
+        clearTimeout(this._lineEditTimer);
+        this._model.dispose();
+        this.failExports('Display disposed');
         this._finder.dispose();
         this._HScroll.dispose();
         this._VScroll.dispose();
@@ -3366,6 +4335,13 @@ export class Display extends EventEmitter {
     }
 
     public reCalculateWrapLines(line: number, width?: number, indent?: number, left?: number, force?: boolean) {
+        //while detached only mark the line, backlog lines are wrapped fresh and a full rewrap covers every line
+        if (this._detached) {
+            if (!this._wrapDirty && line < this._model.lines.length - this._backlog)
+                this._dirtyWraps.add(this._model.getLineID(line));
+            return;
+        }
+        this.wrapBacklog();
         const wraps = this.calculateWrapLines(line, width, indent, left, force);
         const lineID = this._model.getLineID(line);
         const wrapIndex = this._lines.findIndex(l => l.id === lineID);
@@ -3373,7 +4349,8 @@ export class Display extends EventEmitter {
         this._lines.splice(wrapIndex, wrapAmount, ...wraps);
         this._linesMap.delete(lineID);
         this._linesMap.set(lineID, wraps);
-        //clear cache
+        //clear cache, overlay markup is by wrapped line so any line after this one may have moved
+        this.clearOverlayCache();
         for (let a = 0; a < wrapAmount; a++) {
             if (this._viewCache[wrapIndex + a])
                 delete this._viewCache[wrapIndex + a];
@@ -4382,6 +5359,35 @@ export class DisplayModel extends EventEmitter {
     private lineIDs: number[] = [];
     private _expire = {};
     private _expire2 = [];
+    //lines at the start of lines that have been paged out to the scrollback store
+    private _cold = 0;
+    private _hotLines = 0;
+    private _scrollback: Scrollback = null;
+    private _tracer: Tracer = null;
+
+    /**
+     * Number of recent lines kept in memory, older lines are paged out to a temporary
+     * database in blocks and read back in when used, 0 keeps all lines in memory
+     */
+    get hotLines(): number {
+        return this._hotLines;
+    }
+
+    set hotLines(value: number) {
+        this._hotLines = value > 0 ? Math.max(value, SCROLLBACK_BLOCK_SIZE) : 0;
+    }
+
+    get coldLines(): number {
+        return this._cold;
+    }
+
+    set tracer(value: Tracer) {
+        this._tracer = value;
+        this._parser.tracer = value;
+    }
+    get tracer(): Tracer {
+        return this._tracer;
+    }
 
     get enableDebug() {
         return this._parser.enableDebug;
@@ -4415,6 +5421,14 @@ export class DisplayModel extends EventEmitter {
         return this._parser.parseQueueEndOfLine;
     }
 
+    get parseStats() {
+        return this._parser.parseStats;
+    }
+
+    public resetParseStats() {
+        this._parser.resetParseStats();
+    }
+
     set enableFlashing(value: boolean) {
         this._parser.enableFlashing = value;
     }
@@ -4494,6 +5508,9 @@ export class DisplayModel extends EventEmitter {
 
     constructor(options: DisplayOptions) {
         super();
+        //with out a display the model is used, eg headless
+        if (!options.display)
+            options.display = this;
         this._parser = new Parser(options);
         this._parser.on('debug', (msg) => { this.emit(msg); });
 
@@ -4543,6 +5560,10 @@ export class DisplayModel extends EventEmitter {
             this.emit('parse-done');
         });
 
+        this._parser.on('backpressure', (paused, backlog) => {
+            this.emit('backpressure', paused, backlog);
+        });
+
         this._parser.on('set-title', (title, type) => {
             this.emit('set-title', title, type);
         });
@@ -4567,6 +5588,7 @@ export class DisplayModel extends EventEmitter {
         this.emit('add-line-done', data);
         if (data.gagged)
             return;
+        const start = this._tracer && this._tracer.enabled ? performance.now() : 0;
         const line: LineData = {
             text: (data.line === '\n' || data.line.length === 0) ? '' : data.line,
             raw: data.raw,
@@ -4578,7 +5600,60 @@ export class DisplayModel extends EventEmitter {
         this.lineIDs.push(this._lineID);
         this._lineID++;
         this.buildLineExpires(this.lines.length - 1);
+        if (this._hotLines && this.lines.length - this._cold >= this._hotLines + SCROLLBACK_BLOCK_SIZE)
+            this.pageOut();
         this.emit('line-added', data, noUpdate);
+        if (start) this._tracer.record('append', TracePipeline.Output, start);
+    }
+
+    /**
+     * Page the oldest block of in memory lines out to the scrollback store
+     */
+    private pageOut() {
+        try {
+            if (!this._scrollback)
+                this._scrollback = new Scrollback();
+            const lines = this._scrollback.write(this.lines.slice(this._cold, this._cold + SCROLLBACK_BLOCK_SIZE));
+            const ll = lines.length;
+            for (let l = 0; l < ll; l++)
+                this.lines[this._cold + l] = lines[l];
+            this._cold += ll;
+        }
+        catch (err) {
+            //store could not be used so keep everything in memory
+            this._hotLines = 0;
+            if (this.enableDebug) this.emit('debug', err);
+        }
+    }
+
+    /**
+     * Tell the scrollback store paged out lines are being removed
+     *
+     * @param line The first line removed
+     * @param amt The number of lines removed
+     */
+    private releaseLines(line: number, amt: number) {
+        const end = Math.min(line + amt, this._cold);
+        if (line >= end) return;
+        let block = (<any>this.lines[line]).block;
+        let count = 0;
+        for (let l = line; l < end; l++) {
+            if ((<any>this.lines[l]).block !== block) {
+                this._scrollback.release(block, count);
+                block = (<any>this.lines[l]).block;
+                count = 0;
+            }
+            count++;
+        }
+        this._scrollback.release(block, count);
+        this._cold -= end - line;
+    }
+
+    public dispose() {
+        if (this._scrollback)
+            this._scrollback.close();
+        this._scrollback = null;
+        this._cold = 0;
     }
 
     private expireLineLinkFormat(formats, idx: number) {
@@ -4614,11 +5689,16 @@ export class DisplayModel extends EventEmitter {
                     n++;
             }
         }
+        //assign back so paged out lines keep the change
+        this.lines[idx].formats = this.lines[idx].formats;
         this.emit('expire-link-line', idx);
     }
 
     public clear() {
         this._parser.Clear();
+        if (this._scrollback)
+            this._scrollback.close();
+        this._cold = 0;
         this.lines = [];
         this._expire = {};
         this._expire2 = [];
@@ -4626,6 +5706,36 @@ export class DisplayModel extends EventEmitter {
         this._lineID = 0;
     }
 
+    /**
+     * Copy of the lines as plain data, paged out lines are read back in
+     *
+     * @returns The lines
+     */
+    public saveLines(): LineData[] {
+        const lines = [];
+        const ll = this.lines.length;
+        for (let l = 0; l < ll; l++)
+            lines.push({ text: this.lines[l].text, raw: this.lines[l].raw, formats: this.lines[l].formats, id: this.lines[l].id, timestamp: this.lines[l].timestamp });
+        return lines;
+    }
+
+    /**
+     * Replace the lines with ones from saveLines, no line events are fired as the lines have already been processed
+     *
+     * @param lines The lines
+     */
+    public restoreLines(lines: LineData[]) {
+        this.clear();
+        const ll = lines.length;
+        for (let l = 0; l < ll; l++) {
+            this.lines.push(lines[l]);
+            this.lineIDs.push(lines[l].id);
+        }
+        this._lineID = ll ? lines[ll - 1].id + 1 : 0;
+        while (this._hotLines && this.lines.length - this._cold >= this._hotLines + SCROLLBACK_BLOCK_SIZE)
+            this.pageOut();
+    }
+
     public IncreaseColor(color, percent) {
         return this._parser.IncreaseColor(color, percent);
     }
@@ -4663,12 +5773,14 @@ export class DisplayModel extends EventEmitter {
     }
 
     public removeLine(line: number) {
+        this.releaseLines(line, 1);
         this.lines.splice(line, 1);
         this.lineIDs.splice(line, 1);
         this._expire2.splice(line, 1);
     }
 
     public removeLines(line: number, amt: number) {
+        this.releaseLines(line, amt);
         this.lines.splice(line, amt);
         this.lineIDs.splice(line, amt);
         this._expire2.splice(line, amt);
@@ -4692,6 +5804,26 @@ export class DisplayModel extends EventEmitter {
         return this.lineIDs.indexOf(id);
     }
 
+    /**
+     * Find the index of a line id, or the line after it if removed, as ids only increase they can be binary searched
+     *
+     * @param id The line id
+     * @returns The line index, or the line count if no line at or after the id
+     */
+    public nearestLineFromID(id: number) {
+        let low = 0;
+        let high = this.lineIDs.length;
+        let mid;
+        while (low < high) {
+            mid = (low + high) >> 1;
+            if (this.lineIDs[mid] < id)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+        return low;
+    }
+
     private buildLineExpires(idx) {
         if (idx === undefined)
             idx = this.lines.length - 1;
@@ -4731,131 +5863,7 @@ export class DisplayModel extends EventEmitter {
 
     //color like javascript.substring using 0 index for start and end
     public colorSubStringByLine(idx: number, fore, back?, start?: number, end?: number, style?: FontStyle) {
-        //invalid line bail
-        if (idx < 0 || idx >= this.lines.length) return false;
-        const lineLength = this.lines[idx].text.length;
-        //passed line skip
-        if (start >= lineLength) return false;
-        if (!start || start < 0) start = 0;
-        if (!end || end > lineLength)
-            end = lineLength;
-        if (start === end)
-            return false;
-        const formats = this.lines[idx].formats;
-        let len = formats.length;
-        let found: boolean = false;
-        //whole line so just do everything
-        if (start === 0 && end >= lineLength) {
-            for (let f = 0; f < len; f++) {
-                const format = formats[f];
-                //only worry about normal types
-                if (format.formatType !== FormatType.Normal)
-                    continue;
-                found = true;
-                if (format.bStyle) {
-                    format.bStyle = 0;
-                    format.fStyle = 0;
-                    format.fCls = 0;
-                }
-                format.color = fore || format.color;
-                format.background = back || format.background;
-                format.style |= style || FontStyle.None;
-            }
-            //found no text block must create one
-            if (!found) {
-                formats.unshift({
-                    formatType: FormatType.Normal,
-                    offset: 0,
-                    color: fore || 0,
-                    background: back || 0,
-                    size: 0,
-                    font: 0,
-                    style: style || FontStyle.None,
-                    unicode: false
-                });
-            }
-        }
-        else {
-            let nFormat;
-            let formatEnd;
-            for (let f = 0; f < len; f++) {
-                const format = formats[f];
-                //only worry about normal types
-                if (format.formatType !== FormatType.Normal)
-                    continue;
-                //find the end of he format
-                if (f < len - 1) {
-                    let nF = f + 1;
-                    nFormat = formats[nF];
-                    //skip empty blocks
-                    if (format.offset === nFormat.offset && nFormat.formatType === format.formatType)
-                        continue;
-                    //find next block that is not same offset
-                    while (format.offset === nFormat.offset && nFormat.formatType === format.formatType && nF < len - 1)
-                        nFormat = formats[++nF];
-                    //last block same offset use total length
-                    if (nF === len && format.offset === nFormat.offset)
-                        formatEnd = lineLength;
-                    else
-                        formatEnd = nFormat.offset;
-                }
-                else
-                    formatEnd = lineLength;
-                if (start < format.offset) continue;
-                //passed end so try next block
-                if (start >= formatEnd) continue;
-                //after this block move on.
-                //not offset so need to insert a new block
-                found = true;
-                if (format.bStyle) {
-                    format.bStyle = 0;
-                    format.fStyle = 0;
-                    format.fCls = 0;
-                }
-                //if end middle of block, add new block with old info to split
-                if (end < formatEnd) {
-                    format.width = 0;
-                    formats.splice(f + 1, 0, {
-                        formatType: format.formatType,
-                        offset: end,
-                        color: format.color,
-                        background: format.background,
-                        size: format.size,
-                        font: format.font,
-                        style: format.style,
-                        unicode: format.unicode
-                    });
-                    len++;
-                }
-                if (start != format.offset) {
-                    //clean old width
-                    format.width = 0;
-                    //insert new block with new colors
-                    formats.splice(f + 1, 0, {
-                        formatType: format.formatType,
-                        offset: start,
-                        color: fore || format.color,
-                        background: back || format.background,
-                        size: format.size,
-                        font: format.font,
-                        style: format.style | (style || FontStyle.None),
-                        unicode: format.unicode
-                    });
-                    len++;
-                }
-                else {
-                    format.color = fore || format.color;
-                    format.background = back || format.background;
-                    format.style |= (style || FontStyle.None);
-                }
-                //not end so shift start to next block
-                if (end > formatEnd)
-                    start = formatEnd;
-            }
-            //clean out duplicates and other no longer needed blocks
-            this.lines[idx].formats = this.pruneFormats(formats, this.textLength);
-        }
-        return true;
+        return this.applyLineEdits(idx, [{ type: LineEditType.Color, start: start, end: end, fore: fore, back: back, style: style }]);
     }
 
     public removeStyleSubStrByLine(idx: number, style: FontStyle, start?: number, len?: number) {
@@ -4864,126 +5872,7 @@ export class DisplayModel extends EventEmitter {
 
     //color like javascript.substring using 0 index for start and end
     public removeStyleSubStringByLine(idx: number, style: FontStyle, start?: number, end?: number) {
-        //invalid line bail
-        if (idx < 0 || idx >= this.lines.length) return false;
-        const lineLength = this.lines[idx].text.length;
-        //passed line skip
-        if (start >= lineLength) return false;
-        if (!start || start < 0) start = 0;
-        if (!end || end > lineLength)
-            end = lineLength;
-
-        const formats = this.lines[idx].formats;
-        let len = formats.length;
-        let found: boolean = false;
-        //whole line so just do everything
-        if (start === 0 && end >= lineLength) {
-            for (let f = 0; f < len; f++) {
-                const format = formats[f];
-                //only worry about normal types
-                if (format.formatType !== FormatType.Normal)
-                    continue;
-                found = true;
-                if (format.bStyle) {
-                    format.bStyle = 0;
-                    format.fStyle = 0;
-                    format.fCls = 0;
-                }
-                format.style &= ~(style || FontStyle.None);
-            }
-            //found no text block must create one
-            if (!found) {
-                formats.unshift({
-                    formatType: FormatType.Normal,
-                    offset: 0,
-                    color: 0,
-                    background: 0,
-                    size: 0,
-                    font: 0,
-                    style: FontStyle.None,
-                    unicode: false
-                });
-            }
-        }
-        else {
-            let nFormat;
-            let formatEnd;
-            for (let f = 0; f < len; f++) {
-                const format = formats[f];
-                //only worry about normal types
-                if (format.formatType !== FormatType.Normal)
-                    continue;
-                //find the end of he format
-                if (f < len - 1) {
-                    let nF = f + 1;
-                    nFormat = formats[nF];
-                    //skip empty blocks
-                    if (format.offset === nFormat.offset && nFormat.formatType === format.formatType)
-                        continue;
-                    //find next block that is not same offset
-                    while (format.offset === nFormat.offset && nFormat.formatType === format.formatType && nF < len - 1)
-                        nFormat = formats[++nF];
-                    //last block same offset use total length
-                    if (nF === len && format.offset === nFormat.offset)
-                        formatEnd = lineLength;
-                    else
-                        formatEnd = nFormat.offset;
-                }
-                else
-                    formatEnd = lineLength;
-                if (start < format.offset) continue;
-                //passed end so try next block
-                if (start >= formatEnd) continue;
-                //after this block move on.
-                //not offset so need to insert a new block
-                found = true;
-                if (format.bStyle) {
-                    format.bStyle = 0;
-                    format.fStyle = 0;
-                    format.fCls = 0;
-                }
-                //if end middle of block, add new block with old info to split
-                if (end < formatEnd) {
-                    format.width = 0;
-                    formats.splice(f + 1, 0, {
-                        formatType: format.formatType,
-                        offset: end,
-                        color: format.color,
-                        background: format.background,
-                        size: format.size,
-                        font: format.font,
-                        style: format.style,
-                        unicode: format.unicode
-                    });
-                    len++;
-                }
-                if (start != format.offset) {
-                    //clean old width
-                    format.width = 0;
-                    //insert new block with new colors
-                    formats.splice(f + 1, 0, {
-                        formatType: format.formatType,
-                        offset: start,
-                        color: format.color,
-                        background: format.background,
-                        size: format.size,
-                        font: format.font,
-                        style: format.style & ~(style || FontStyle.None),
-                        unicode: format.unicode
-                    });
-                    len++;
-                }
-                else {
-                    format.style &= ~(style || FontStyle.None);
-                }
-                //not end so shift start to next block
-                if (end > formatEnd)
-                    start = formatEnd;
-            }
-            //clean out duplicates and other no longer needed blocks
-            this.lines[idx].formats = this.pruneFormats(formats, this.textLength);
-        }
-        return true;
+        return this.applyLineEdits(idx, [{ type: LineEditType.RemoveStyle, start: start, end: end, style: style }]);
     }
 
     public highlightSubStrByLine(idx: number, start?: number, len?: number) {
@@ -4992,148 +5881,146 @@ export class DisplayModel extends EventEmitter {
 
     //color like javascript.substring using 0 index for start and end
     public highlightStyleSubStringByLine(idx: number, start?: number, end?: number, color?: boolean) {
+        return this.applyLineEdits(idx, [{ type: LineEditType.Highlight, start: start, end: end, color: color }]);
+    }
+
+    /**
+     * Apply a list of edits to a line's formats in one sweep, normal blocks are split once at every
+     * edit boundary then each piece has the edits covering it applied in the order given
+     *
+     * @param idx The line index
+     * @param edits The edits to apply, ranges are like javascript.substring
+     * @returns True if any edit changed the line
+     */
+    public applyLineEdits(idx: number, edits: LineEdit[]) {
         //invalid line bail
-        if (idx < 0 || idx >= this.lines.length) return false;
+        if (idx < 0 || idx >= this.lines.length || !edits || !edits.length) return false;
         const lineLength = this.lines[idx].text.length;
-        //passed line skip
-        if (start >= lineLength) return false;
-        if (!start || start < 0) start = 0;
-        if (!end || end > lineLength)
-            end = lineLength;
-
+        const ranges = [];
+        const cuts = [];
+        let e;
+        let el = edits.length;
+        let start;
+        let end;
+        for (e = 0; e < el; e++) {
+            start = edits[e].start;
+            end = edits[e].end;
+            //passed line skip
+            if (start >= lineLength) continue;
+            if (!start || start < 0) start = 0;
+            if (!end || end > lineLength)
+                end = lineLength;
+            if (start === end && edits[e].type === LineEditType.Color)
+                continue;
+            ranges.push({ edit: edits[e], start: start, end: end });
+            cuts.push(start, end);
+        }
+        if (!ranges.length) return false;
+        el = ranges.length;
+        cuts.sort((a, b) => a - b);
         const formats = this.lines[idx].formats;
-        let len = formats.length;
-        let found: boolean = false;
-        //whole line so just do everything
-        if (start === 0 && end >= lineLength) {
-            for (let f = 0; f < len; f++) {
-                const format = formats[f];
-                //only worry about normal types
-                if (format.formatType !== FormatType.Normal)
-                    continue;
-                found = true;
-                if (format.bStyle) {
-                    format.bStyle = 0;
-                    format.fStyle = 0;
-                    format.fCls = 0;
-                }
-                if (color || (format.style & FontStyle.Bold) === FontStyle.Bold) {
-                    if (typeof format.color === 'number')
-                        format.color = this._parser.IncreaseColor(this._parser.GetColor(format.color), 0.25);
-                    else
-                        format.color = this._parser.IncreaseColor(format.color, 0.25);
-                }
-                else
-                    format.style |= FontStyle.Bold;
-            }
-            //found no text block must create one
-            if (!found) {
-                formats.unshift({
-                    formatType: FormatType.Normal,
-                    offset: 0,
-                    color: color ? 370 : 0,
-                    background: 0,
-                    size: 0,
-                    font: 0,
-                    style: color ? FontStyle.None : FontStyle.Bold,
-                    unicode: false
-                });
+        const fl = formats.length;
+        const nF = [];
+        let f;
+        let c = 0;
+        let found = false;
+        let format;
+        let formatEnd;
+        let segment;
+        let segmentEnd;
+        let orig;
+        for (f = 0; f < fl; f++) {
+            format = formats[f];
+            nF.push(format);
+            //only worry about normal types
+            if (format.formatType !== FormatType.Normal)
+                continue;
+            found = true;
+            //block ends where the next one starts
+            formatEnd = f < fl - 1 ? formats[f + 1].offset : lineLength;
+            //empty block, pruned below
+            if (formatEnd <= format.offset)
+                continue;
+            //cuts are sorted and blocks are in offset order so only move forward
+            while (c < cuts.length && cuts[c] <= format.offset)
+                c++;
+            //pieces copy the block as it was before any edit
+            orig = { color: format.color, background: format.background, style: format.style };
+            segment = format;
+            while (segment) {
+                segmentEnd = c < cuts.length && cuts[c] < formatEnd ? cuts[c] : formatEnd;
+                this.applySegmentEdits(segment, segmentEnd, ranges, el);
+                if (segmentEnd >= formatEnd)
+                    break;
+                //clean old width
+                segment.width = 0;
+                segment = {
+                    formatType: format.formatType,
+                    offset: segmentEnd,
+                    color: orig.color,
+                    background: orig.background,
+                    size: format.size,
+                    font: format.font,
+                    style: orig.style,
+                    unicode: format.unicode
+                };
+                nF.push(segment);
+                while (c < cuts.length && cuts[c] <= segmentEnd)
+                    c++;
             }
         }
-        else {
-            let nFormat;
-            let formatEnd;
-            for (let f = 0; f < len; f++) {
-                const format = formats[f];
-                //only worry about normal types
-                if (format.formatType !== FormatType.Normal)
-                    continue;
-                //find the end of he format
-                if (f < len - 1) {
-                    let nF = f + 1;
-                    nFormat = formats[nF];
-                    //skip empty blocks
-                    if (format.offset === nFormat.offset && nFormat.formatType === format.formatType)
-                        continue;
-                    //find next block that is not same offset
-                    while (format.offset === nFormat.offset && nFormat.formatType === format.formatType && nF < len - 1)
-                        nFormat = formats[++nF];
-                    //last block same offset use total length
-                    if (nF === len && format.offset === nFormat.offset)
-                        formatEnd = lineLength;
-                    else
-                        formatEnd = nFormat.offset;
-                }
-                else
-                    formatEnd = lineLength;
-                if (start < format.offset) continue;
-                //passed end so try next block
-                if (start >= formatEnd) continue;
-                //after this block move on.
-                //not offset so need to insert a new block
-                found = true;
-                if (format.bStyle) {
-                    format.bStyle = 0;
-                    format.fStyle = 0;
-                    format.fCls = 0;
-                }
-                //if end middle of block, add new block with old info to split
-                if (end < formatEnd) {
-                    format.width = 0;
-                    formats.splice(f + 1, 0, {
-                        formatType: format.formatType,
-                        offset: end,
-                        color: format.color,
-                        background: format.background,
-                        size: format.size,
-                        font: format.font,
-                        style: format.style,
-                        unicode: format.unicode
-                    });
-                    len++;
-                }
-                if (start != format.offset) {
-                    //clean old width
-                    format.width = 0;
-                    //insert new block with new colors
-                    nFormat = {
-                        formatType: format.formatType,
-                        offset: start,
-                        color: format.color,
-                        background: format.background,
-                        size: format.size,
-                        font: format.font,
-                        style: format.style,
-                        unicode: format.unicode
-                    }
-                    if (color || (format.style & FontStyle.Bold) === FontStyle.Bold) {
-                        if (typeof format.color === 'number')
-                            nFormat.color = this._parser.IncreaseColor(this._parser.GetColor(format.color), 0.25);
-                        else
-                            nFormat.color = this._parser.IncreaseColor(format.color, 0.25);
-                    }
-                    else
-                        nFormat.style |= FontStyle.Bold;
-                    formats.splice(f + 1, 0, nFormat);
-                    len++;
-                }
-                else if (color || (format.style & FontStyle.Bold) === FontStyle.Bold) {
-                    if (typeof format.color === 'number')
-                        format.color = this._parser.IncreaseColor(this._parser.GetColor(format.color), 0.25);
-                    else
-                        format.color = this._parser.IncreaseColor(format.color, 0.25);
-                }
-                else
-                    format.style |= FontStyle.Bold;
+        //found no text block must create one
+        if (!found) {
+            format = {
+                formatType: FormatType.Normal,
+                offset: 0,
+                color: 0,
+                background: 0,
+                size: 0,
+                font: 0,
+                style: FontStyle.None,
+                unicode: false
+            };
+            this.applySegmentEdits(format, lineLength, ranges, el);
+            nF.unshift(format);
+        }
+        //clean out duplicates and other no longer needed blocks
+        this.lines[idx].formats = this.pruneFormats(nF, this.textLength);
+        return true;
+    }
 
-                //not end so shift start to next block
-                if (end > formatEnd)
-                    start = formatEnd;
+    private applySegmentEdits(format, end: number, ranges, rl: number) {
+        let range;
+        let edit;
+        for (let r = 0; r < rl; r++) {
+            range = ranges[r];
+            //pieces never cross an edit boundary so either fully covered or not at all
+            if (range.start > format.offset || range.end < end || range.start === range.end)
+                continue;
+            edit = range.edit;
+            if (typeof format.fCls === 'string') {
+                format.bStyle = 0;
+                format.bColor = 0;
+                format.fStyle = 0;
+                format.fCls = 0;
+            }
+            switch (edit.type) {
+                case LineEditType.Color:
+                    format.color = edit.fore || format.color;
+                    format.background = edit.back || format.background;
+                    format.style |= edit.style || FontStyle.None;
+                    break;
+                case LineEditType.RemoveStyle:
+                    format.style &= ~(edit.style || FontStyle.None);
+                    break;
+                case LineEditType.Highlight:
+                    if (edit.color || (format.style & FontStyle.Bold) === FontStyle.Bold)
+                        format.color = this._parser.AdjustColor(format.color, 0.25);
+                    else
+                        format.style |= FontStyle.Bold;
+                    break;
             }
-            //clean out duplicates and other no longer needed blocks
-            this.lines[idx].formats = this.pruneFormats(formats, this.textLength);
         }
-        return true;
     }
 
     private pruneFormats(formats, textLen) {
@@ -5199,4 +6086,90 @@ export class DisplayModel extends EventEmitter {
             return this.lines[line].text.substring(start);
         return this.lines[line].text.substring(start, end);
     }
-}
\ No newline at end of file
+}
+/**
+ * Display for clients with out a page, used by the session host so parsing, triggers and scripts run the same
+ * as in a window, only the model is kept and anything that draws does nothing
+ */
+export class HeadlessDisplay extends DisplayModel {
+    private _maxLines: number = 5000;
+    private _windowSize: Size = new Size(80, 24);
+
+    public scrollLock: boolean = false;
+    public split = null;
+    public enableSplit: boolean = false;
+    public splitHeight: number = -1;
+    public splitLive: boolean = false;
+    public showSplitButton: boolean = true;
+    public roundedRanges: boolean = true;
+    public hideTrailingEmptyLine: boolean = true;
+    public enableColors: boolean = true;
+    public enableBackgroundColors: boolean = true;
+    public showTimestamp: boolean = false;
+    public timestampFormat: string = '';
+    public wordWrap: boolean = false;
+    public wrapAt: number = 0;
+    public indent: number = 4;
+    public MatchCase: boolean = false;
+    public MatchWord: boolean = false;
+    public Reverse: boolean = false;
+    public RegularExpression: boolean = false;
+    public Highlight: boolean = false;
+    public finderLocation = null;
+
+    constructor(options?: DisplayOptions) {
+        super(options || {});
+        this.on('line-added', () => this.trimLines());
+    }
+
+    get model() { return this; }
+
+    get maxLines(): number { return this._maxLines; }
+    set maxLines(value: number) {
+        if (value === this._maxLines) return;
+        this._maxLines = value;
+        this.trimLines();
+    }
+
+    /**
+     * Size of the window the client was last shown in, used for NAWS and wrapping in scripts
+     */
+    get WindowSize(): Size { return this._windowSize; }
+    set WindowSize(value: Size) {
+        this._windowSize = value || new Size(80, 24);
+    }
+
+    get EndOfLineLength(): number {
+        if (this.lines.length === 0)
+            return 0;
+        return this.lines[this.lines.length - 1].text.length;
+    }
+
+    get scrollAtBottom(): boolean { return true; }
+
+    public updateWindow(width?, height?) {
+        if (width === undefined) {
+            width = this._windowSize.width;
+            height = this._windowSize.height;
+        }
+        super.updateWindow(width, height);
+        this.emit('update-window', width, height);
+    }
+
+    public trimLines() {
+        if (this._maxLines === -1 || this.lines.length <= this._maxLines)
+            return;
+        this.removeLines(0, this.lines.length - this._maxLines);
+    }
+
+    //nothing is queued as nothing is drawn
+    public queueLineEdit(idx: number, edit: LineEdit) {
+        this.applyLineEdits(idx, [edit]);
+    }
+
+    public click(callback) { }
+    public updateFont(font?: string, size?: string) { }
+    public scrollDisplay(force?: boolean) { }
+    public scrollUp() { }
+    public scrollDown() { }
+}
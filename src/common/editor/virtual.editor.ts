@@ -194,6 +194,129 @@ export class Room {
     }
 }
 
+/**
+ * Parsed virtual map data stored as flat typed arrays, one cell per room
+ *
+ * Keeps the raw row text each cell was parsed from so rebuilds only need to
+ * reparse rows that actually changed
+ */
+export class RoomGrid {
+    public width = 0;
+    public height = 0;
+    public depth = 0;
+    public exits: Uint16Array;
+    public terrain: Int32Array;
+    public item: Int32Array;
+    public state: Int32Array;
+    public ee: Uint16Array;
+    public mapLines: string[] = [];
+    public terrainLines: string[] = [];
+    public stateLines: string[] = [];
+
+    constructor(width, height, depth) {
+        const size = width * height * depth;
+        this.width = width;
+        this.height = height;
+        this.depth = depth;
+        this.exits = new Uint16Array(size);
+        this.terrain = new Int32Array(size);
+        this.item = new Int32Array(size);
+        this.state = new Int32Array(size);
+        this.ee = new Uint16Array(size);
+    }
+
+    public get size() {
+        return this.exits.length;
+    }
+
+    public index(x, y, z) {
+        return x + (y + z * this.height) * this.width;
+    }
+
+    public matches(width, height, depth) {
+        return this.width === width && this.height === height && this.depth === depth;
+    }
+
+    /**
+     * Compare a row against the text it was last parsed from
+     *
+     * @param li raw line index of the row
+     * @param line map raw text
+     * @param terrainLine terrain raw text
+     * @param stateLine state raw text
+     * @returns true if any of the raw text differs
+     */
+    public rowChanged(li, line, terrainLine, stateLine) {
+        return this.mapLines[li] !== line || this.terrainLines[li] !== terrainLine || this.stateLines[li] !== stateLine;
+    }
+
+    /**
+     * Parse a single row of map, terrain and state raw text into the grid
+     *
+     * @param y row
+     * @param z level
+     * @param li raw line index of the row
+     * @param line map raw text
+     * @param terrainLine terrain raw text
+     * @param stateLine state raw text
+     */
+    public parseRow(y, z, li, line: string, terrainLine: string, stateLine: string) {
+        const mData = line.length > 0 ? line.split(' ') : [];
+        const tData = terrainLine.length > 0 ? terrainLine.split(' ') : [];
+        const sData = stateLine.length > 0 ? stateLine.split(' ') : [];
+        const ml = mData.length;
+        const tl = tData.length;
+        const sl = sData.length;
+        const xl = this.width;
+        let idx = this.index(0, y, z);
+        let rd;
+        let e;
+        let t;
+        let i;
+        let s;
+        this.mapLines[li] = line;
+        this.terrainLines[li] = terrainLine;
+        this.stateLines[li] = stateLine;
+        for (let x = 0; x < xl; x++, idx++) {
+            if (x >= ml) {
+                e = 0;
+                t = 0;
+                i = 0;
+                s = 0;
+            }
+            else {
+                rd = mData[x].split(':');
+                e = rd.length > 0 ? +rd[0] : 0;
+                t = rd.length > 1 ? +rd[1] : 0;
+                i = rd.length > 2 ? +rd[2] : t;
+                s = rd.length > 3 ? +rd[3] : 0;
+                if (x < tl) {
+                    rd = tData[x].split(':');
+                    t = rd.length > 0 ? +rd[0] : 0;
+                    i = rd.length > 1 ? +rd[1] : t;
+                    s = rd.length > 2 ? +rd[2] : 0;
+                }
+                if (x < sl)
+                    s = +sData[x];
+            }
+            //typed arrays store NaN as 0 which matches the Room constructor
+            this.exits[idx] = e;
+            this.terrain[idx] = t;
+            this.item[idx] = i;
+            this.state[idx] = s;
+        }
+    }
+
+    public get maxTerrain() {
+        const terrain = this.terrain;
+        let max = 0;
+        let t = terrain.length;
+        while (t--)
+            if (terrain[t] > max) max = terrain[t];
+        return max;
+    }
+}
+
 enum View {
     map,
     terrains,
@@ -285,6 +408,9 @@ export class VirtualEditor extends EditorBase {
     private $mapSize;
 
     private $rooms: Room[][][];
+    private $grid: RoomGrid;
+    private $roomFiles: Set<string>;
+    private $partialBuild: boolean = false;
     private $maxTerrain;
     private $mousePrevious: MousePosition = {
         x: 0,
@@ -682,6 +808,7 @@ export class VirtualEditor extends EditorBase {
         el.style.display = 'none';
         frag.appendChild(el);
         this.$descriptionGrid = new DataGrid(el);
+        this.$descriptionGrid.virtual = true;
         this.$descriptionGrid.enterMoveFirst = this.enterMoveFirst;
         this.$descriptionGrid.enterMoveNext = this.enterMoveNext;
         this.$descriptionGrid.enterMoveNew = this.enterMoveNew;
@@ -1080,6 +1207,7 @@ export class VirtualEditor extends EditorBase {
         el.style.display = 'none';
         frag.appendChild(el);
         this.$itemGrid = new DataGrid(el);
+        this.$itemGrid.virtual = true;
         this.$itemGrid.enterMoveFirst = this.enterMoveFirst;
         this.$itemGrid.enterMoveNext = this.enterMoveNext;
         //this.$itemGrid.enterMoveNew = this.enterMoveNew;
@@ -1432,6 +1560,7 @@ export class VirtualEditor extends EditorBase {
         el.style.display = 'none';
         frag.appendChild(el);
         this.$exitGrid = new DataGrid(el);
+        this.$exitGrid.virtual = true;
         this.$exitGrid.enterMoveFirst = this.enterMoveFirst;
         this.$exitGrid.enterMoveNext = this.enterMoveNext;
         this.$exitGrid.enterMoveNew = this.enterMoveNew;
@@ -4429,6 +4558,8 @@ export class VirtualEditor extends EditorBase {
         this.emit('watch-stop', [root]);
         this.$files = {};
         this.$opened = {};
+        this.$grid = null;
+        this.$roomFiles = null;
         this.$opened[this.filename] = new Date().getTime();
         this.$files['virtual.terrain'] = isFileSync(path.join(root, 'virtual.terrain'));
         this.$files['terrain.desc'] = isFileSync(path.join(root, 'terrain.desc'));
@@ -5942,6 +6073,13 @@ export class VirtualEditor extends EditorBase {
             }
         }
         if ((/^\d+,\d+(,\d+)?\.c$/).test(base)) {
+            //keep the file list current for every room file, rooms outside the grid read it when the grid changes
+            if (this.$roomFiles && (action === 'add' || action === 'change' || action === 'unlink')) {
+                if (isFileSync(file))
+                    this.$roomFiles.add(base);
+                else
+                    this.$roomFiles.delete(base);
+            }
             if (details && details.mtimeMs < this.$opened[this.filename])
                 return;
             const c = base.substring(0, base.length - 2).split(',');
@@ -7101,7 +7239,7 @@ export class VirtualEditor extends EditorBase {
         let f = false;
         if (!this.$drawCache)
             this.$drawCache = {};
-        const key = indoors + ',' + room.terrain + ',' + ee + ',' + (room.exits | room.climbs);
+        const key = indoors + ',' + room.terrain + ',' + ee + ',' + (room.exits | room.climbs) + ',' + room.ef;
         //ctx.save();
         if (c) {
             ctx.fillStyle = 'white';
@@ -9215,41 +9353,26 @@ export class VirtualEditor extends EditorBase {
         let z = 0;
         let zl;
         let line;
-        let terrainLine;
-        let stateLine;
         let dl;
         let r;
         let ry;
         let rz;
-        let s;
         let sl;
         let tl;
-        let rd;
-        let rt;
+        let idx;
         const data = this.$mapRaw.value.split('\n');
         const terrainData = this.$terrainRaw.value.split('\n');
         const stateData = this.$stateRaw.value.split('\n');
         const exitData = this.$externalRaw.value.split('\n');
-        const root = path.dirname(this.file);
-        const files = fs.readdirSync(root);
-        const ee = {};
-        this.$roomCount = 0;
-        this.$maxTerrain = 0;
-        this.$colorCache = 0;
-        this.$drawCache = null;
-        if (exitData.length > 0) {
-            for (x = 0, xl = exitData.length; x < xl; x++) {
-                line = exitData[x].split(':');
-                if (line.length > 2)
-                    ee[line[0]] = line[1];
-            }
-        }
-
-        this.$rooms = [];
+        //only read the area directory once, watch() keeps it current after that
+        if (!this.$roomFiles)
+            this.$roomFiles = new Set<string>(fs.readdirSync(path.dirname(this.file)));
+        const files = this.$roomFiles;
+        this.$partialBuild = false;
         if (data.length > 0) {
             line = data.shift().split(' ');
-            terrainLine = terrainData.shift().split(' ');
-            stateLine = stateData.shift().split(' ');
+            terrainData.shift();
+            stateData.shift();
             dl = data.length;
             sl = stateData.length;
             tl = terrainData.length;
@@ -9272,80 +9395,113 @@ export class VirtualEditor extends EditorBase {
             this.$mapSize.depth = zl;
             this.$mapSize.right = this.$mapSize.width * 32;
             this.$mapSize.bottom = this.$mapSize.height * 32;
-            let e;
-            let t;
-            let i;
-            let li;
             const selected = this.$selectedRooms.slice();
-            this.$selectedRooms.length = 0;
             if (xl > 0 && yl > 0 && zl > 0) {
-                const rooms = this.$rooms;
-                let roomCount = 0;
-                let maxTerrain = 0;
+                //same size as last build, so only rows or external exits that changed need new rooms
+                const partial = this.$grid && this.$rooms && this.$grid.matches(xl, yl, zl) ? true : false;
+                const grid = partial ? this.$grid : new RoomGrid(xl, yl, zl);
+                const ee = new Uint16Array(grid.size);
+                const changed = [];
+                let roomCount = partial ? this.$roomCount : 0;
                 let cname;
-                for (; z < zl; z++) {
+                let mLine;
+                let tLine;
+                let sLine;
+                let rowChanged;
+                let old;
+                let si;
+                for (let e = 0, el = exitData.length; e < el; e++) {
+                    line = exitData[e].split(':');
+                    if (line.length < 3) continue;
+                    cname = line[0].split(',');
+                    if (cname.length !== (zl > 1 ? 3 : 2)) continue;
+                    x = +cname[0];
+                    y = +cname[1];
+                    z = zl > 1 ? +cname[2] : 0;
+                    if (x < 0 || x >= xl || y < 0 || y >= yl || z < 0 || z >= zl)
+                        continue;
+                    //only exact room names match, eg disabled exits start with #
+                    if ((zl > 1 ? x + ',' + y + ',' + z : x + ',' + y) !== line[0])
+                        continue;
+                    ee[grid.index(x, y, z)] = RoomExits[line[1]] || 0;
+                }
+                if (!partial) {
+                    this.$rooms = [];
+                    this.$selectedRooms.length = 0;
+                    this.$colorCache = 0;
+                    this.$drawCache = null;
+                }
+                const rooms = this.$rooms;
+                for (z = 0; z < zl; z++) {
                     if (!rooms[z]) rooms[z] = [];
                     rz = rooms[z];
                     for (y = 0; y < yl; y++) {
                         if (!rz[y])
                             rz[y] = [];
                         ry = rz[y];
-                        li = y + z * (yl + 1);
-                        if (li < dl && data[li].length > 0)
-                            line = data[li].split(' ');
-                        else
-                            line = [];
-
-                        if (li < tl && terrainData[li].length > 0)
-                            terrainLine = terrainData[li].split(' ');
-                        else
-                            terrainLine = [];
-
-                        if (li < sl && stateData[li].length > 0)
-                            stateLine = stateData[li].split(' ');
-                        else
-                            stateLine = [];
-
-                        for (x = 0; x < xl; x++) {
-                            if (x >= line.length) {
-                                t = 0;
-                                s = 0;
-                                i = 0;
+                        idx = y + z * (yl + 1);
+                        mLine = idx < dl ? data[idx] : '';
+                        tLine = idx < tl ? terrainData[idx] : '';
+                        sLine = idx < sl ? stateData[idx] : '';
+                        rowChanged = !partial || grid.rowChanged(idx, mLine, tLine, sLine);
+                        if (rowChanged)
+                            grid.parseRow(y, z, idx, mLine, tLine, sLine);
+                        idx = grid.index(0, y, z);
+                        for (x = 0; x < xl; x++, idx++) {
+                            old = ry[x];
+                            if (!rowChanged && old && grid.ee[idx] === ee[idx])
+                                continue;
+                            r = new Room(x, y, z, grid.exits[idx], grid.terrain[idx], grid.item[idx], grid.state[idx]);
+                            if (!partial) {
+                                if (selected.length > 0 && selected.filter(sR => sR.at(r.x, r.y, r.z)).length > 0)
+                                    this.$selectedRooms.push(r);
                             }
                             else {
-                                rd = line[x].split(':');
-                                e = rd.length > 0 ? +rd[0] : 0;
-                                t = rd.length > 1 ? +rd[1] : 0;
-                                i = rd.length > 2 ? +rd[2] : t;
-                                s = rd.length > 3 ? +rd[3] : 0;
-                                if (x < terrainLine.length) {
-                                    rt = terrainLine[x].split(':');
-                                    t = rt.length > 0 ? +rt[0] : 0;
-                                    i = rt.length > 1 ? +rt[1] : t;
-                                    s = rt.length > 2 ? +rt[2] : 0;
-                                }
-                                if (x < stateLine.length)
-                                    s = stateLine[x];
-                                if (t > maxTerrain) maxTerrain = t;
+                                if (old && old.exits) roomCount--;
+                                si = old ? this.$selectedRooms.indexOf(old) : -1;
+                                if (si !== -1)
+                                    this.$selectedRooms[si] = r;
+                                changed.push(r);
                             }
-                            r = new Room(x, y, z, e, t, i, s);
-                            if (selected.length > 0 && selected.filter(sR => sR.at(r.x, r.y, r.z)).length > 0)
-                                this.$selectedRooms.push(r);
                             cname = x + ',' + y;
                             if (zl > 1)
                                 cname += ',' + z;
-                            if (ee[cname])
-                                r.ee |= RoomExits[ee[cname]];
-                            r.ef = files.indexOf(cname + '.c') !== -1;
+                            r.ee = ee[idx];
+                            r.ef = files.has(cname + '.c');
+                            ry[x] = r;
                             this.loadRoom(r);
-                            ry.push(r);
                             if (r.exits) roomCount++;
                         }
                     }
                 }
+                grid.ee = ee;
+                this.$grid = grid;
                 this.$roomCount = roomCount;
+                const maxTerrain = grid.maxTerrain;
+                //terrain colors are scaled by max terrain so a change means every room has to be redrawn
+                if (partial && maxTerrain === this.$maxTerrain && this.$mapContext) {
+                    this.$partialBuild = true;
+                    let cl = changed.length;
+                    while (cl--) {
+                        if (changed[cl].z === this.$depth)
+                            this.DrawRoom(this.$mapContext, changed[cl], true, changed[cl].at(this.$mouse.rx, this.$mouse.ry));
+                    }
+                }
+                else if (partial) {
+                    this.$colorCache = 0;
+                    this.$drawCache = null;
+                }
                 this.$maxTerrain = maxTerrain;
             }
+            else {
+                this.$rooms = [];
+                this.$grid = null;
+                this.$selectedRooms.length = 0;
+                this.$roomCount = 0;
+                this.$maxTerrain = 0;
+                this.$colorCache = 0;
+                this.$drawCache = null;
+            }
             if (selected.length !== 0 || this.$selectedRooms.length !== 0)
                 this.ChangeSelection();
             if (this.$focusedRoom) {
@@ -9356,6 +9512,12 @@ export class VirtualEditor extends EditorBase {
             }
         }
         else {
+            this.$rooms = [];
+            this.$grid = null;
+            this.$roomCount = 0;
+            this.$maxTerrain = 0;
+            this.$colorCache = 0;
+            this.$drawCache = null;
             this.$mapSize = {
                 width: 0,
                 height: 0,
@@ -9370,7 +9532,11 @@ export class VirtualEditor extends EditorBase {
 
     private BuildMap() {
         Timer.start();
-        this.$drawCache = null;
+        //BuildRooms only redrew changed rooms and map size has not changed so no need to redraw everything
+        const partial = this.$partialBuild;
+        this.$partialBuild = false;
+        if (!partial)
+            this.$drawCache = null;
         if (this.$depth >= this.$mapSize.depth)
             this.$depth = this.$mapSize.depth - 1;
         if (this.$mapSize.right !== this.$map.width || this.$map.height !== this.$mapSize.bottom) {
@@ -9382,7 +9548,8 @@ export class VirtualEditor extends EditorBase {
                 this.DrawMap();
             }, 250);
         }
-        this.doUpdate(UpdateType.drawMap);
+        if (!partial)
+            this.doUpdate(UpdateType.drawMap);
         const cols = this.$exitGrid.columns;
         if (this.$mapSize.depth < 2) {
             this.$depth = 0;
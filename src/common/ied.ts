@@ -11,9 +11,9 @@ import { FileInfo, IEDError, IEDCmdStatus, TempType } from './types';
 const fs = require('fs');
 const path = require('path');
 const tmp = require('tmp');
+const zlib = require('zlib');
 
 const ZLIB: any = require('./../../lib/inflate_stream.min.js').Zlib;
-const dZLIB: any = require('./../../lib/deflate.min.js').Zlib;
 
 tmp.setGracefulCleanup();
 
@@ -48,6 +48,10 @@ export class IED extends EventEmitter {
     public compressUpload: boolean;
     public compressDownload: boolean;
     public compressDir: boolean;
+    /**
+     * Number of upload chunks to read and encode ahead of server requests
+     */
+    public inFlight: number = 3;
 
     get useTemp(): TempType { return this._temp; }
     set useTemp(value: TempType) {
@@ -72,11 +76,12 @@ export class IED extends EventEmitter {
         }
         this._worker = new Worker('./js/ied.background.js');
         this._worker.onmessage = (e) => {
+            let item;
             if (e.data.event === 'decoded-dir') {
                 let files;
                 try {
                     const z = new ZLIB.InflateStream();
-                    files = Buffer.from(z.decompress(Buffer.from(e.data.data, 'binary'))).toString();
+                    files = Buffer.from(z.decompress(new Uint8Array(e.data.data))).toString();
                     files = JSON.parse(files);
                     this.emit('dir', e.data.path, files, e.data.tag || 'dir', e.data.local);
                 }
@@ -94,9 +99,9 @@ export class IED extends EventEmitter {
             switch (e.data.event) {
                 case 'decoded':
                     if (e.data.download) {
-                        this.active.currentSize += e.data.data.length;
+                        this.active.currentSize += e.data.data.byteLength;
                         try {
-                            this.active.write(e.data.data);
+                            this.active.write(new Uint8Array(e.data.data));
                         }
                         catch (err) {
                             this.emit('error', err);
@@ -125,9 +130,12 @@ export class IED extends EventEmitter {
                     }
                     break;
                 case 'encoded':
-                    this.emit('send-gmcp', 'IED.upload.chunk ' + JSON.stringify({ path: path.dirname(this.active.remote), file: path.basename(this.active.remote), tag: this.active.ID, data: e.data.data, last: e.data.last ? 1 : 0, compressed: e.data.compressed ? 1 : 0 }));
-                    if (!e.data.last)
-                        this.emit('update', this.active);
+                    item = this.getItem(e.data.tag);
+                    if (!item) break;
+                    item.encoding--;
+                    item.encoded.push({ data: e.data.data, last: e.data.last, compressed: e.data.compressed, size: e.data.size });
+                    this.sendChunk(item);
+                    this.encodeChunks(item);
                     break;
             }
         };
@@ -435,6 +443,8 @@ export class IED extends EventEmitter {
                                     return;
                                 }
                                 this.active.state = ItemState.done;
+                                this.active.currentSize += this.active.unacknowledged;
+                                this.active.unacknowledged = 0;
                                 this.emit('upload-finished', this.active);
                                 if (this.active)
                                     this.emit('message', 'Upload complete: ' + this.active.remote);
@@ -1086,37 +1096,79 @@ export class IED extends EventEmitter {
 
     public uploadChunk(obj) {
         if (!obj) return;
-        let data;
-        let size = obj.chunksize;
         const item = this.getItem(obj.tag);
         if (!item) return;
         if (item.state !== ItemState.working)
             return;
         item.obj = obj;
-        if (this.bufferSize > 0 && this.bufferSize < size)
-            size = this.bufferSize;
-        try {
-            data = item.read(size);
-        }
-        catch (err) {
-            this.emit('error', err);
-            this.nextGMCP();
+        item.requested = true;
+        //a new request means the server has the last chunk sent
+        item.currentSize += item.unacknowledged;
+        item.unacknowledged = 0;
+        this.sendChunk(item);
+        this.encodeChunks(item);
+    }
+
+    /**
+     * Send the next encoded chunk if the server has requested one
+     *
+     * @param item The item being uploaded
+     */
+    private sendChunk(item: Item) {
+        if (!item.requested || !item.encoded.length || item.state !== ItemState.working || !item.obj)
             return;
+        const chunk = item.encoded.shift();
+        const obj = item.obj;
+        item.requested = false;
+        item.sent++;
+        item.unacknowledged = chunk.size;
+        this.emit('send-gmcp', 'IED.upload.chunk ' + JSON.stringify({ path: path.dirname(item.remote), file: path.basename(item.remote), tag: item.ID, data: chunk.data, last: chunk.last ? 1 : 0, compressed: chunk.compressed ? 1 : 0 }));
+        if (chunk.last)
+            this.emit('message', 'Upload last chunk: ' + obj.path + '/' + obj.file);
+        else {
+            this.emit('message', 'Upload chunk ' + item.sent + ': ' + obj.path + '/' + obj.file);
+            this.emit('update', item);
         }
-        item.currentSize += data.length;
-        item.chunks++;
-        this._worker.postMessage({
-            action: 'encode',
-            file: obj.path + '/' + obj.file,
-            download: false,
-            last: (data.length < size || item.currentSize === item.totalSize),
-            data: data,
-            compress: item.compress
+    }
+
+    /**
+     * Read and queue chunks to the worker for encoding until inFlight chunks are ahead of the server
+     *
+     * @param item The item being uploaded
+     */
+    private encodeChunks(item: Item) {
+        if (item.reading || item.readDone || !item.obj || item.state !== ItemState.working || item.encoded.length + item.encoding >= this.inFlight)
+            return;
+        //chunks read ahead use the last requested size, the server keeps the size the same for a transfer
+        let size = item.obj.chunksize;
+        if (this.bufferSize > 0 && this.bufferSize < size)
+            size = this.bufferSize;
+        item.reading = true;
+        item.read(size, (err, data: Buffer, last: boolean) => {
+            item.reading = false;
+            if (err) {
+                this.emit('error', err);
+                this.nextGMCP();
+                return;
+            }
+            if (!this.getItem(item.ID)) return;
+            item.chunks++;
+            item.readDone = last;
+            item.encoding++;
+            //copy into its own buffer as reads may be views of a shared pool, which can not be transferred
+            const bytes = new Uint8Array(data);
+            this._worker.postMessage({
+                action: 'encode',
+                file: item.obj.path + '/' + item.obj.file,
+                tag: item.ID,
+                download: false,
+                last: last,
+                data: bytes.buffer,
+                size: data.length,
+                compress: item.compress
+            }, [bytes.buffer]);
+            this.encodeChunks(item);
         });
-        if (data.length < size || item.currentSize === item.totalSize)
-            this.emit('message', 'Upload last chunk: ' + obj.path + '/' + obj.file);
-        else
-            this.emit('message', 'Upload chunk ' + item.chunks + ': ' + obj.path + '/' + obj.file);
     }
 }
 
@@ -1135,6 +1187,12 @@ export class Item {
     private append = false;
     private stream;
     private _zStream: any = 0;
+    private _deflate: any = 0;
+    private _zBuffers: Buffer[] = [];
+    private _zSize: number = 0;
+    private _zEnded: boolean = false;
+    private _zRead = null;
+    private _position: number = 0;
 
     public obj;
     public remote: string = '';
@@ -1151,6 +1209,15 @@ export class Item {
     public error: string;
     public compress: boolean;
     public originalSize: number;
+    //upload pipeline state, chunks read/encoded ahead of server requests
+    public requested: boolean = false;
+    public reading: boolean = false;
+    public readDone: boolean = false;
+    public encoding: number = 0;
+    public sent: number = 0;
+    //bytes of the last chunk sent that the server has not confirmed with a new request yet
+    public unacknowledged: number = 0;
+    public encoded: { data: string, last: boolean, compressed: boolean, size: number }[] = [];
 
     constructor(id: string, download?: boolean) {
         this.ID = id;
@@ -1188,31 +1255,80 @@ export class Item {
         return this.totalSize ? (Math.round(this.currentSize / this.totalSize * 100) / 100) : 0;
     }
 
-    public read(size: number, callback?: any) {
-        const position = this.currentSize;
+    /**
+     * Read the next chunk of the file, compressed files are streamed through deflate as they are read
+     *
+     * @param size The max size of the chunk
+     * @param callback Called with any error, the chunk data and if it is the last chunk
+     */
+    public read(size: number, callback: (err, data?: Buffer, last?: boolean) => void) {
         if (this.compress) {
-            if (!this._zStream) {
-                this._zStream = Buffer.from(new dZLIB.Deflate(fs.readFileSync(this._local)).compress());
-                this.totalSize = this._zStream.length;
-            }
-            return this._zStream.toString('binary', position, position + size);
+            if (!this._deflate)
+                this.startDeflate();
+            this._zRead = [size, callback];
+            this.readDeflate();
+            return;
         }
         if (!this.stream)
             this.stream = fs.openSync(this._local, 'r+');
-        let buffer: Buffer;
-        let br;
-        if (position + size > this.totalSize) {
-            buffer = Buffer.alloc(this.totalSize - position);
-            br = fs.readSync(this.stream, buffer, 0, this.totalSize - position, position);
-        }
-        else {
-            buffer = Buffer.alloc(size);
-            br = fs.readSync(this.stream, buffer, 0, size, position);
+        const buffer = Buffer.alloc(Math.max(0, Math.min(size, this.totalSize - this._position)));
+        fs.read(this.stream, buffer, 0, buffer.length, this._position, (err, br) => {
+            if (err) {
+                callback(err);
+                return;
+            }
+            this._position += br;
+            callback(null, br < buffer.length ? buffer.subarray(0, br) : buffer, br < size || this._position >= this.totalSize);
+        });
+    }
+
+    private startDeflate() {
+        this._zBuffers = [];
+        this._zSize = 0;
+        this._zEnded = false;
+        this._deflate = fs.createReadStream(this._local).pipe(zlib.createDeflate());
+        this._deflate.on('data', chunk => {
+            this._zBuffers.push(chunk);
+            this._zSize += chunk.length;
+            //only buffer a few chunks ahead, resumed once read
+            if (this._zSize >= 65536)
+                this._deflate.pause();
+            this.readDeflate();
+        });
+        this._deflate.on('end', () => {
+            this._zEnded = true;
+            this.readDeflate();
+        });
+        this._deflate.on('error', err => {
+            const read = this._zRead;
+            this._zRead = null;
+            if (read) read[1](err);
+        });
+    }
+
+    private readDeflate() {
+        if (!this._zRead || !this._deflate) return;
+        const size = this._zRead[0];
+        //wait for more than a full chunk so the last chunk is always known
+        if (this._zSize <= size && !this._zEnded) {
+            this._deflate.resume();
+            return;
         }
-        return buffer.toString();
+        const callback = this._zRead[1];
+        this._zRead = null;
+        const buffer = this._zBuffers.length === 1 ? this._zBuffers[0] : Buffer.concat(this._zBuffers);
+        const length = Math.min(size, buffer.length);
+        this._zBuffers = length < buffer.length ? [buffer.subarray(length)] : [];
+        this._zSize -= length;
+        this._position += length;
+        if (this._zEnded && this._zSize === 0)
+            this.totalSize = this._position;
+        else if (this._zSize < 65536)
+            this._deflate.resume();
+        callback(null, buffer.subarray(0, length), this._zEnded && this._zSize === 0);
     }
 
-    public write(data: string) {
+    public write(data: Uint8Array) {
         if (!this.stream) {
             if (this.mkdir) {
                 const parts = path.dirname(this._local).split(path.sep);
@@ -1240,8 +1356,7 @@ export class Item {
         if (this.compress) {
             if (!this._zStream)
                 this._zStream = new ZLIB.InflateStream();
-            data = this._zStream.decompress(Buffer.from(data, 'binary'));
-            fs.writeSync(this.stream, data);
+            fs.writeSync(this.stream, this._zStream.decompress(data));
         }
         else
             fs.writeSync(this.stream, data);
@@ -1263,6 +1378,13 @@ export class Item {
     public clean() {
         if (this._zStream)
             this._zStream = 0;
+        if (this._deflate) {
+            this._deflate.destroy();
+            this._deflate = 0;
+        }
+        this._zBuffers = [];
+        this._zSize = 0;
+        this._zRead = null;
         if (this.stream)
             this.stream = fs.closeSync(this.stream);
     }
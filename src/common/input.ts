@@ -15,6 +15,8 @@ import { Tests } from './test';
 import { NewLineType, ProfileSaveType, ScriptEngineType, TabCompletion, FunctionEvent } from './types';
 import { SettingList } from './settings';
 import { getAnsiColorCode, getColorCode, isMXPColor, getAnsiCode } from './ansi';
+import { LineEditType } from './display';
+import { TracePipeline } from './tracer';
 
 declare let getCharacterNotes;
 declare let getId;
@@ -55,6 +57,31 @@ const moment = require('moment');
  */
 const fs = require('fs');
 
+//compiled script bodies keyed by source, shared by triggers, aliases and macros and kept when profiles change
+const _scriptCache = new Map<string, Function>();
+const SCRIPT_CACHE_SIZE = 1000;
+
+/**
+ * Get the compiled function for a script item body, only compiling the first time a body is seen
+ * @param {string} body - The script source, including any variable declarations
+ * @returns {Function}
+ */
+function _compileScript(body: string): Function {
+    let f = _scriptCache.get(body);
+    if (f) {
+        //move to end as most recently used
+        _scriptCache.delete(body);
+        _scriptCache.set(body, f);
+        return f;
+    }
+    /*jslint evil: true */
+    f = new Function('try { ' + body + '\n} catch (e) { if(this.getOption(\'showScriptErrors\')) this.error(e);}');
+    if (_scriptCache.size >= SCRIPT_CACHE_SIZE)
+        _scriptCache.delete(_scriptCache.keys().next().value);
+    _scriptCache.set(body, f);
+    return f;
+}
+
 const WindowVariables = ['$selectedword', '$selword', '$selectedurl', '$selurl', '$selectedline', '$selline', '$selected', '$character', '$copied', '$action', '$trigger', '$caption', '$characterid'];
 
 /**
@@ -207,6 +234,34 @@ class InvalidOptions extends Error {
     }
 }
 
+/**
+ * Match and execution counters collected for a trigger, alias or event while profiling
+ */
+export interface ProfileCounter {
+    type: string;
+    item: any;
+    parent: any;
+    attempts: number;
+    hits: number;
+    matchTime: number;
+    matchMax: number;
+    execTime: number;
+    execMax: number;
+}
+
+/**
+ * A command style body split in to its commands when it is plain text, commands is null when the body uses
+ * parse features or aliases and has to go through parseOutgoing
+ */
+interface CompiledCommand {
+    value: string;
+    options: string;
+    aliases: any[];
+    commands: string[];
+    ends: number[];
+    open: boolean;
+}
+
 /**
  * Command input parser
  * 
@@ -224,8 +279,18 @@ export class Input extends EventEmitter {
     private _tests: Tests;
     private _TriggerCache: Trigger[] = null;
     private _TriggerStates = {};
+    //timer for the next wait or duration state to expire and when it fires
+    private _TriggerStateTimer: NodeJS.Timeout = null;
+    private _TriggerStateTime: number = 0;
+    //triggers whose state changed since the last save/update
+    private _TriggerStateChanges: Set<Trigger> = new Set<Trigger>();
+    private _TriggerStateChangeTimer: NodeJS.Timeout = null;
     private _TriggerFunctionCache = {};
     private _TriggerRegExCache = {};
+    //candidate triggers for each executed type, rebuilt with the trigger cache
+    private _TriggerTypeIndex = {};
+    //compiled command style bodies by trigger, alias or macro, cleared on profile change
+    private _commandCache: WeakMap<any, CompiledCommand> = new WeakMap<any, CompiledCommand>();
     private _LastTriggered = '';
     private _LastTrigger = null;
     private _scrollLock: boolean = false;
@@ -243,12 +308,15 @@ export class Input extends EventEmitter {
     private _pathQueue = [];
     private _pathTimeout: NodeJS.Timeout = null;
     private _pathPaused: boolean = false;
+    //per item counters, only collected while profiling is enabled
+    private _profiling: boolean = false;
+    private _profile: Map<any, ProfileCounter> = new Map<any, ProfileCounter>();
 
     private _client: Client = null;
     private _display;
     private _commandInput;
     public enableParsing: boolean = true;
-    public enableTriggers: boolean = true;
+    private _enableTriggers: boolean = true;
 
     public getScope() {
         let scope: any = {};
@@ -365,6 +433,17 @@ export class Input extends EventEmitter {
         this._vStack.pop();
     }
 
+    get enableTriggers(): boolean {
+        return this._enableTriggers;
+    }
+    set enableTriggers(value: boolean) {
+        if (value === this._enableTriggers) return;
+        this._enableTriggers = value;
+        //timed states are not expired while disabled so restart the timer
+        if (value)
+            this.expireTriggerStates();
+    }
+
     get scrollLock(): boolean {
         return this._scrollLock;
     }
@@ -1526,15 +1605,17 @@ export class Input extends EventEmitter {
         });
 
         this._client.on('add-line', (data) => {
+            const start = this._client.tracer.enabled ? performance.now() : 0;
             this.ExecuteTriggers(TriggerTypes.Regular | TriggerTypes.Pattern | TriggerTypes.LoopExpression, data.line, data.raw, data.fragment, false, true);
+            if (start) this._client.tracer.record('triggers', TracePipeline.Output, start);
             if (this._gag > 0 && !data.fragment) {
                 data.gagged = true;
                 this._gag--;
             }
-            //if not fragment and not gagged count
+            //if not fragment and not gagged count, only active states are stored so this is not per trigger
             if (!data.fragment)
                 for (let state in this._TriggerStates) {
-                    if (this._TriggerStates[state].lineCount)
+                    if (this._TriggerStates[state] && this._TriggerStates[state].lineCount)
                         this._TriggerStates[state].lineCount--;
                     //if (data.remote && this._TriggerStates[state].remoteCount)
                     //this._TriggerStates[state].remoteCount--;
@@ -1648,7 +1729,10 @@ export class Input extends EventEmitter {
                         this._tabWords = null;
                         this._tabSearch = null
                         event.preventDefault();
+                        this._client.tracer.key(event.timeStamp);
                         this._client.sendCommand(null, null, this._getOption('allowCommentsFromCommand'));
+                        //nothing sent so do not time a later send from this key
+                        this._client.tracer.key(0);
                         this.emit('history-navigate', event);
                     }
                     event.preventDefault();
@@ -4110,7 +4194,7 @@ export class Input extends EventEmitter {
                 n = this._display.lines.length;
                 setTimeout(() => {
                     n = this.adjustLastLine(n);
-                    this._display.highlightSubStrByLine(n);
+                    this._display.queueLineEdit(n, { type: LineEditType.Highlight });
                 }, 0);
                 return null;
             case 'break':
@@ -7536,6 +7620,128 @@ export class Input extends EventEmitter {
         return null;
     }
 
+    /**
+     * Run the command style body of a trigger, alias or macro, plain text bodies are compiled once in to their
+     * commands so only command input triggers are run, anything else is parsed by parseOutgoing
+     * @param {object} item - The trigger, alias or macro
+     * @param {boolean} [append] - Append unused alias arguments
+     * @returns {string}
+     */
+    public executeCommand(item, append?: boolean) {
+        if (!this.enableParsing)
+            return this.parseOutgoing(item.value, null, null, append);
+        const options = this._commandOptions();
+        let compiled = this._commandCache.get(item);
+        if (!compiled || compiled.value !== item.value || compiled.options !== options || compiled.aliases !== this._client.aliases) {
+            compiled = this._compileCommand(item.value, options);
+            this._commandCache.set(item, compiled);
+        }
+        //unused arguments are appended to the last command, leave that to the parser
+        if (!compiled.commands || (append && this.stack.append && this.stack.args && this.stack.args.length > 1))
+            return this.parseOutgoing(item.value, null, null, append);
+        const commands = compiled.commands;
+        const cl = commands.length;
+        const last = compiled.open ? cl - 1 : cl;
+        let out = '';
+        let str;
+        for (let c = 0; c < cl; c++) {
+            str = this.ExecuteTriggers(TriggerTypes.CommandInputRegular | TriggerTypes.CommandInputPattern, commands[c], commands[c], false, true);
+            if (typeof str === 'number') {
+                if (str >= 0 && c < last)
+                    this.executeWait(item.value.substr(compiled.ends[c] + 1), str, this._client.aliases.length > 0, this._commandStacking(), append);
+                if (out.length === 0) return null;
+                return out;
+            }
+            if (str !== null)
+                out += c < last ? str + '\n' : str;
+            else if (c === last && out.length === 0)
+                return null;
+            if (this.stack.continue || this.stack.break) {
+                if (out.length === 0) return null;
+                return out;
+            }
+        }
+        return out;
+    }
+
+    private _commandStacking(): boolean {
+        return this._getOption('commandStacking') && this._getOption('commandStackingChar').length > 0;
+    }
+
+    /**
+     * Get the parse options a compiled command depends on, compiled commands are redone when they change
+     * @returns {string}
+     */
+    private _commandOptions(): string {
+        return [
+            this._commandStacking() ? this._getOption('commandStackingChar') : '',
+            this._getOption('allowEscape') ? this._getOption('escapeChar') : '',
+            this._getOption('enableParameters') ? this._getOption('parametersChar') : '',
+            this._getOption('enableNParameters') ? this._getOption('nParametersChar') : '',
+            this._getOption('enableCommands') ? this._getOption('commandChar') : '',
+            this._getOption('enableVerbatim') ? this._getOption('verbatimChar') : '',
+            this._getOption('enableSpeedpaths') ? this._getOption('speedpathsChar') : '',
+            this._getOption('parseDoubleQuotes') ? '"' : '',
+            this._getOption('parseSingleQuotes') ? '\'' : '',
+            this._getOption('enableInlineComments') ? this._getOption('inlineCommentString').charAt(0) : '',
+            this._getOption('enableBlockComments') ? this._getOption('blockCommentString').charAt(0) : '',
+            this._getOption('ignoreInputLeadingWhitespace') ? '1' : '0'
+        ].join('\x00');
+    }
+
+    /**
+     * Split a command style body in to its commands if it is plain text for the current options and aliases
+     * @param {string} value - The body
+     * @param {string} options - The parse options from _commandOptions
+     * @returns {CompiledCommand}
+     */
+    private _compileCommand(value: string, options: string): CompiledCommand {
+        const compiled: CompiledCommand = { value: value, options: options, aliases: this._client.aliases, commands: null, ends: null, open: false };
+        const chars = options.split('\x00');
+        const stackingChar = chars[0];
+        const bTrim = chars[11] === '1';
+        //any character that starts a parse feature means the parser is needed
+        for (let c = 1; c < 11; c++) {
+            if (chars[c].length && value.indexOf(chars[c]) !== -1)
+                return compiled;
+        }
+        const commands = [];
+        const ends = [];
+        const vl = value.length;
+        let start = 0;
+        for (let v = 0; v < vl; v++) {
+            if (value.charAt(v) === '\n' || (stackingChar.length && value.charAt(v) === stackingChar)) {
+                commands.push(value.substring(start, v));
+                ends.push(v);
+                start = v + 1;
+            }
+        }
+        if (start < vl) {
+            commands.push(value.substring(start));
+            ends.push(vl);
+            compiled.open = true;
+        }
+        //a command starting with an alias runs the alias so can not be plain text
+        const aliases = this._client.aliases;
+        const al = aliases.length;
+        if (al) {
+            const cl = commands.length;
+            for (let c = 0; c < cl; c++) {
+                let word = bTrim ? commands[c].trimStart() : commands[c];
+                const idx = word.indexOf(' ');
+                if (idx !== -1)
+                    word = word.substring(0, idx);
+                for (let a = 0; a < al; a++) {
+                    if (aliases[a].pattern === word)
+                        return compiled;
+                }
+            }
+        }
+        compiled.commands = commands;
+        compiled.ends = ends;
+        return compiled;
+    }
+
     public GetNamedArguments(str: string, args, append?: boolean) {
         if (str === '*')
             return args;
@@ -7569,11 +7775,17 @@ export class Input extends EventEmitter {
     public ExecuteAlias(alias, args) {
         if (!alias.enabled) return;
         let ret; // = '';
+        let start;
+        //aliases are matched by key so there is no match time, only the hit and script time
+        if (this._profiling) {
+            this._profileMatch('alias', alias, alias, performance.now());
+            start = performance.now();
+        }
         if (alias.value.length)
             switch (alias.style) {
                 case 1:
                     this._stack.push({ loops: [], args: args, named: this.GetNamedArguments(alias.params, args), append: alias.append, used: 0 });
-                    ret = this.parseOutgoing(alias.value, null, null, true);
+                    ret = this.executeCommand(alias, true);
                     this._stack.pop();
                     break;
                 case 2:
@@ -7584,8 +7796,7 @@ export class Input extends EventEmitter {
                         ret = Object.keys(named).map(v => `let ${v} = this.input.stack.named["${v}"];`).join('') + '\n';
                     else
                         ret = '';
-                    /*jslint evil: true */
-                    const f = new Function('try { ' + ret + alias.value + '\n} catch (e) { if(this.getOption(\'showScriptErrors\')) this.error(e);}');
+                    const f = _compileScript(ret + alias.value);
                     this._stack.push({ loops: [], args: args, named: named, append: alias.append, used: 0 });
                     try {
                         ret = f.apply(this._client, args);
@@ -7603,6 +7814,8 @@ export class Input extends EventEmitter {
                     ret = alias.value;
                     break;
             }
+        if (this._profiling)
+            this._profileExec('alias', alias, alias, start);
         if (ret == null || ret === undefined)
             return null;
         ret = this.ExecuteTriggers(TriggerTypes.CommandInputRegular | TriggerTypes.CommandInputPattern, ret, ret, false, true);
@@ -7653,7 +7866,7 @@ export class Input extends EventEmitter {
                 case 1:
                     this._stack.push({ loops: [], args: 0, named: 0, used: 0 });
                     try {
-                        ret = this.parseOutgoing(macro.value);
+                        ret = this.executeCommand(macro);
                     }
                     catch (e) {
                         throw e;
@@ -7665,8 +7878,7 @@ export class Input extends EventEmitter {
                 case 2:
                     if ((this._getOption('echo') & 2) === 2)
                         this._echo(macro.value, -7, -8, true, true);
-                    /*jslint evil: true */
-                    const f = new Function('try { ' + macro.value + '\n} catch (e) { if(this.getOption(\'showScriptErrors\')) this.error(e);}');
+                    const f = _compileScript(macro.value);
                     this._stack.push({ loops: [], args: 0, named: 0, used: 0 });
                     try {
                         ret = f.apply(this._client);
@@ -7909,6 +8121,42 @@ export class Input extends EventEmitter {
         return false;
     }
 
+    /**
+     * Get the triggers that can match a type as a jump table, next[i + 1] is the first candidate after index i and
+     * next[0] the first candidate, triggers with states are always candidates as their current type can change
+     *
+     * @param type The trigger types being executed
+     * @param subtypes Include sub trigger types
+     * @param triggers The triggers to index, only cached when they are the current trigger cache
+     */
+    private triggerTypeIndex(type: TriggerTypes, subtypes?: boolean, triggers?: any[]): Int32Array {
+        const key = subtypes ? 's' + type : '' + type;
+        const cached = !triggers || triggers === this._TriggerCache;
+        let next = cached ? this._TriggerTypeIndex[key] : null;
+        if (next) return next;
+        if (!triggers)
+            triggers = this._TriggerCache;
+        const tl = triggers.length;
+        next = new Int32Array(tl + 1);
+        let n = tl;
+        let tType;
+        for (let t = tl - 1; t >= 0; t--) {
+            next[t + 1] = n;
+            const trigger = triggers[t];
+            if (trigger.triggers && trigger.triggers.length)
+                n = t;
+            else if (trigger.type !== SubTriggerTypes.Manual) {
+                tType = this._getTriggerType(trigger.type);
+                if (trigger.type === undefined || (type & tType) === tType || (subtypes && this._isSubTriggerType(trigger.type)))
+                    n = t;
+            }
+        }
+        next[0] = n;
+        if (cached)
+            this._TriggerTypeIndex[key] = next;
+        return next;
+    }
+
     private _getTriggerType(type: TriggerType | SubTriggerTypes) {
         if (type === TriggerType.Regular)
             return TriggerTypes.Regular;
@@ -7928,13 +8176,18 @@ export class Input extends EventEmitter {
         let pattern;
         let changed = false;
         let val;
+        let start;
+        let matched;
         //scope to get performance
         const triggers = this._TriggerCache;
-        const tl = triggers.length;
+        let tl = triggers.length;
         const states = this._TriggerStates;
         const rCache = this._TriggerRegExCache;
+        //only visit triggers that can match the type, a reparse steps back one so next[t] is t again
+        let next = this.triggerTypeIndex(type, subtypes);
         let tType;
-        for (; t < tl; t++) {
+        for (t = next[0]; t < tl; t = next[t + 1]) {
+            const current = t;
             let trigger = triggers[t];
             const parent = trigger;
             //extra check in case error disabled it and do not want to keep triggering the error
@@ -7964,11 +8217,8 @@ export class Input extends EventEmitter {
                     changed = true;
                 }
                 //changed state save
-                if (changed) {
-                    if (this._getOption('saveTriggerStateChanges'))
-                        this._client.saveProfile(parent.profile.name, true, ProfileSaveType.Trigger);
-                    this._client.emit('item-updated', 'trigger', parent.profile.name, parent.profile.triggers.indexOf(parent), parent);
-                }
+                if (changed)
+                    this.triggerStateChanged(parent);
                 //last check to be 100% sure enabled
                 if (!trigger.enabled) continue;
             }
@@ -8052,7 +8302,10 @@ export class Input extends EventEmitter {
             }
             try {
                 if (trigger.type === TriggerType.LoopExpression) {
-                    if (this.evaluate(this.parseInline(trigger.pattern))) {
+                    if (this._profiling) start = performance.now();
+                    matched = this.evaluate(this.parseInline(trigger.pattern));
+                    if (this._profiling) this._profileMatch('trigger', trigger, parent, start);
+                    if (matched) {
                         if (!states[t]) {
                             const state = this.createTriggerState(trigger, false, parent);
                             if (state)
@@ -8070,15 +8323,13 @@ export class Input extends EventEmitter {
                     }
                 }
                 else if (trigger.verbatim) {
-                    if (!trigger.caseSensitive && (trigger.raw ? raw : line).toLowerCase() !== trigger.pattern.toLowerCase()) {
-                        //if reparse and if failed advance anyways
-                        if (!states[t] && (trigger.type === SubTriggerTypes.ReParse || trigger.type === SubTriggerTypes.ReParsePattern)) {
-                            this._advanceTrigger(trigger, parent, t);
-                            t = this.cleanUpTriggerState(t);
-                        }
-                        continue;
-                    }
-                    else if (trigger.caseSensitive && (trigger.raw ? raw : line) !== trigger.pattern) {
+                    if (this._profiling) start = performance.now();
+                    if (trigger.caseSensitive)
+                        matched = (trigger.raw ? raw : line) === trigger.pattern;
+                    else
+                        matched = (trigger.raw ? raw : line).toLowerCase() === trigger.pattern.toLowerCase();
+                    if (this._profiling) this._profileMatch('trigger', trigger, parent, start);
+                    if (!matched) {
                         //if reparse and if failed advance anyways
                         if (!states[t] && (trigger.type === SubTriggerTypes.ReParse || trigger.type === SubTriggerTypes.ReParsePattern)) {
                             this._advanceTrigger(trigger, parent, t);
@@ -8091,6 +8342,7 @@ export class Input extends EventEmitter {
                 }
                 else {
                     let re;
+                    if (this._profiling) start = performance.now();
                     if (trigger.type === TriggerType.Pattern || trigger.type === TriggerType.CommandInputPattern || trigger.type === SubTriggerTypes.ReParsePattern)
                         pattern = convertPattern(trigger.pattern, this._client);
                     else
@@ -8102,6 +8354,7 @@ export class Input extends EventEmitter {
                     //reset from last use always
                     re.lastIndex = 0;
                     const res = re.exec(trigger.raw ? raw : line);
+                    if (this._profiling) this._profileMatch('trigger', trigger, parent, start);
                     if (!res || !res.length) {
                         //if reparse and if failed advance anyways
                         if (!states[t] && (trigger.type === SubTriggerTypes.ReParse || trigger.type === SubTriggerTypes.ReParsePattern)) {
@@ -8144,6 +8397,13 @@ export class Input extends EventEmitter {
                 else
                     this._client.debug(e);
             }
+            //a temp trigger removed itself, rebuild the index and step back so the trigger that moved into its slot is next
+            if (triggers.length !== tl) {
+                tl = triggers.length;
+                //cache may have been rebuilt by the removal, keep working with the triggers this line started with
+                next = this.triggerTypeIndex(type, subtypes, triggers);
+                t = current - 1;
+            }
         }
         return line;
     }
@@ -8269,8 +8529,10 @@ export class Input extends EventEmitter {
                 }
             }
             else {
-                if (idx >= 0)
+                if (idx >= 0) {
                     this._TriggerCache.splice(idx, 1);
+                    this._TriggerTypeIndex = {};
+                }
                 if (this._TriggerStates[idx])
                     this.clearTriggerState(idx);
                 this._client.removeTrigger(parent);
@@ -8280,12 +8542,14 @@ export class Input extends EventEmitter {
             this._advanceTrigger(trigger, parent, idx);
         if ((this._getOption('echo') & 8) === 8)
             this._echo('Trigger fired: ' + trigger.pattern, -7, -8, true, true);
+        let start;
+        if (this._profiling) start = performance.now();
         if (trigger.value.length)
             switch (trigger.style) {
                 case 1:
                     this._stack.push({ loops: [], args: args, named: 0, used: 0, regex: regex });
                     try {
-                        ret = this.parseOutgoing(trigger.value);
+                        ret = this.executeCommand(trigger);
                     }
                     catch (e) {
                         throw e;
@@ -8297,10 +8561,9 @@ export class Input extends EventEmitter {
                 case 2:
                     if ((this._getOption('echo') & 2) === 2)
                         this._echo(trigger.value, -7, -8, true, true);
-                    //do not cache temp triggers
+                    //temp triggers are removed once fired so do not keep them by index
                     if (trigger.temp) {
-                        /*jslint evil: true */
-                        ret = new Function('try { ' + trigger.value + '\n} catch (e) { if(this.getOption(\'showScriptErrors\')) this.error(e);}');
+                        ret = _compileScript(trigger.value);
                         ret = ret.apply(this._client, args);
                     }
                     else {
@@ -8309,8 +8572,7 @@ export class Input extends EventEmitter {
                                 ret = Object.keys(named).map(v => `let ${v} = this.variables["${v}"];`).join('') + '\n';
                             else
                                 ret = '';
-                            /*jslint evil: true */
-                            this._TriggerFunctionCache[idx] = new Function('try { ' + ret + trigger.value + '\n} catch (e) { if(this.getOption(\'showScriptErrors\')) this.error(e);}');
+                            this._TriggerFunctionCache[idx] = _compileScript(ret + trigger.value);
                         }
                         this._stack.push({ loops: [], args: args, named: 0, used: 0, regex: regex, indices: args.indices });
                         try {
@@ -8330,6 +8592,8 @@ export class Input extends EventEmitter {
                     ret = trigger.value;
                     break;
             }
+        if (this._profiling)
+            this._profileExec(trigger.type === TriggerType.Event ? 'event' : 'trigger', trigger, parent, start);
         if (ret == null || ret === undefined)
             return null;
         if (r)
@@ -8382,9 +8646,7 @@ export class Input extends EventEmitter {
         if (parent.state > parent.triggers.length)
             parent.state = 0;
         //changed state save
-        if (this._getOption('saveTriggerStateChanges'))
-            this._client.saveProfile(parent.profile.name, true, ProfileSaveType.Trigger);
-        this._client.emit('item-updated', 'trigger', parent.profile.name, parent.profile.triggers.indexOf(parent), parent);
+        this.triggerStateChanged(parent);
         //is new subtype a reparse? if so reparse using current trigger instant
         if (parent.state !== 0) {
             const state = this.createTriggerState(parent.triggers[parent.state - 1]);
@@ -8412,6 +8674,7 @@ export class Input extends EventEmitter {
                 else
                     params = 0;
                 state = { time: Date.now() + params };
+                this.scheduleTriggerStates(state.time);
                 break;
             case SubTriggerTypes.WithinLines:
             case SubTriggerTypes.LoopLines:
@@ -8488,6 +8751,7 @@ export class Input extends EventEmitter {
                 else
                     params = 0;
                 this._TriggerStates[idx].time = Date.now() + params;
+                this.scheduleTriggerStates(this._TriggerStates[idx].time);
                 break;
             case SubTriggerTypes.WithinLines:
             case SubTriggerTypes.Skip:
@@ -8539,6 +8803,93 @@ export class Input extends EventEmitter {
         }
     }
 
+    /**
+     * Make sure the state timer fires by a time so wait and duration states
+     * expire on time instead of being checked on every line
+     *
+     * @param time The time a state expires
+     */
+    private scheduleTriggerStates(time: number) {
+        if (this._TriggerStateTimer) {
+            if (this._TriggerStateTime <= time)
+                return;
+            clearTimeout(this._TriggerStateTimer);
+        }
+        this._TriggerStateTime = time;
+        this._TriggerStateTimer = setTimeout(() => {
+            this._TriggerStateTimer = null;
+            this.expireTriggerStates();
+        }, Math.max(0, time - Date.now()));
+    }
+
+    /**
+     * End expired wait states, advance expired duration states, and schedule the next expire
+     */
+    private expireTriggerStates() {
+        //disabled so stop until enabled again, states are also checked when lines are processed
+        if (!this._enableTriggers) return;
+        this.buildTriggerCache();
+        const now = Date.now();
+        const states = this._TriggerStates;
+        let next = 0;
+        let idx;
+        let parent;
+        let trigger;
+        for (idx in states) {
+            if (!states.hasOwnProperty(idx) || !states[idx]) continue;
+            if (states[idx].type !== SubTriggerTypes.Wait && states[idx].type !== SubTriggerTypes.Duration) continue;
+            if (states[idx].time > now) {
+                if (!next || states[idx].time < next)
+                    next = states[idx].time;
+                continue;
+            }
+            if (states[idx].type === SubTriggerTypes.Wait) {
+                delete states[idx];
+                continue;
+            }
+            delete states[idx];
+            idx = +idx;
+            parent = this._TriggerCache[idx];
+            if (!parent || !parent.triggers || !parent.triggers.length) continue;
+            trigger = parent.state ? parent.triggers[parent.state - 1] : parent;
+            //state was changed some other way so nothing to advance
+            if (!trigger || trigger.type !== SubTriggerTypes.Duration) continue;
+            this._advanceTrigger(trigger, parent, idx);
+            //new state may be timed, scheduled by create
+        }
+        if (next)
+            this.scheduleTriggerStates(next);
+    }
+
+    /**
+     * Queue a trigger state change, saves and updates are done once for all changes
+     * after current processing so many lines advancing states do not save each time
+     *
+     * @param parent The trigger whose state changed
+     */
+    private triggerStateChanged(parent: Trigger) {
+        this._TriggerStateChanges.add(parent);
+        if (this._TriggerStateChangeTimer) return;
+        this._TriggerStateChangeTimer = setTimeout(() => {
+            const save = this._getOption('saveTriggerStateChanges');
+            const profiles = new Set<string>();
+            let idx;
+            this._TriggerStateChangeTimer = null;
+            for (const trigger of this._TriggerStateChanges) {
+                if (!trigger.profile) continue;
+                idx = trigger.profile.triggers.indexOf(trigger);
+                //removed since state changed
+                if (idx === -1) continue;
+                if (save)
+                    profiles.add(trigger.profile.name);
+                this._client.emit('item-updated', 'trigger', trigger.profile.name, idx, trigger);
+            }
+            this._TriggerStateChanges.clear();
+            for (const profile of profiles)
+                this._client.saveProfile(profile, true, ProfileSaveType.Trigger);
+        }, 0);
+    }
+
     public getTriggerState(idx) {
         return this._TriggerStates[idx];
     }
@@ -8566,7 +8917,110 @@ export class Input extends EventEmitter {
         this._TriggerStates[idx] = data;
     }
 
-    public clearTriggerCache() { this._TriggerCache = null; this._TriggerStates = {}; this._TriggerFunctionCache = {}; this._TriggerRegExCache = {}; }
+    /**
+     * Get input state that is not saved with profiles so another client can take over the session
+     */
+    public getSession() {
+        return { triggerStates: this._TriggerStates, commandHistory: this._commandHistory };
+    }
+
+    /**
+     * Restore input state from getSession
+     *
+     * @param state The state from getSession
+     */
+    public restoreSession(state) {
+        if (!state) return;
+        this._TriggerStates = state.triggerStates || {};
+        for (const idx in this._TriggerStates) {
+            if (!this._TriggerStates.hasOwnProperty(idx) || !this._TriggerStates[idx]) continue;
+            if (this._TriggerStates[idx].time)
+                this.scheduleTriggerStates(this._TriggerStates[idx].time);
+        }
+        this._commandHistory = state.commandHistory || [];
+        this._historyIdx = this._commandHistory.length;
+        this.emit('command-history-changed', this._commandHistory);
+    }
+
+    public clearTriggerCache() { this._TriggerCache = null; this._TriggerTypeIndex = {}; this._TriggerStates = {}; this._TriggerFunctionCache = {}; this._TriggerRegExCache = {}; }
+
+    public get profiling() { return this._profiling; }
+    public set profiling(value: boolean) { this._profiling = value; }
+
+    private _profileCounter(type: string, item, parent) {
+        let counter = this._profile.get(item);
+        if (!counter) {
+            counter = { type: type, item: item, parent: parent || item, attempts: 0, hits: 0, matchTime: 0, matchMax: 0, execTime: 0, execMax: 0 };
+            this._profile.set(item, counter);
+        }
+        return counter;
+    }
+
+    /**
+     * Record a match attempt for an item
+     *
+     * @param type The item type, trigger, event or alias
+     * @param item The trigger, trigger state or alias tested
+     * @param parent The parent trigger that owns the state
+     * @param start performance.now() when the match started
+     */
+    private _profileMatch(type: string, item, parent, start: number) {
+        const time = performance.now() - start;
+        const counter = this._profileCounter(type, item, parent);
+        counter.attempts++;
+        counter.matchTime += time;
+        if (time > counter.matchMax)
+            counter.matchMax = time;
+    }
+
+    /**
+     * Record a hit and the time spent executing the item's value
+     *
+     * @param type The item type, trigger, event or alias
+     * @param item The trigger, trigger state or alias executed
+     * @param parent The parent trigger that owns the state
+     * @param start performance.now() when execution started
+     */
+    private _profileExec(type: string, item, parent, start: number) {
+        const time = performance.now() - start;
+        const counter = this._profileCounter(type, item, parent);
+        counter.hits++;
+        counter.execTime += time;
+        if (time > counter.execMax)
+            counter.execMax = time;
+    }
+
+    public resetProfiling() {
+        this._profile.clear();
+    }
+
+    /**
+     * Get the profiling counters as plain rows, times are in milliseconds
+     *
+     * @returns Array of rows, one per profiled item
+     */
+    public getProfilingReport() {
+        const rows = [];
+        this._profile.forEach(counter => {
+            const parent = counter.parent;
+            rows.push({
+                type: counter.type,
+                profile: parent.profile ? parent.profile.name : '',
+                name: parent.name || '',
+                state: parent.triggers && parent !== counter.item ? parent.triggers.indexOf(counter.item) + 1 : 0,
+                pattern: counter.item.pattern,
+                attempts: counter.attempts,
+                hits: counter.hits,
+                matchTime: counter.matchTime,
+                matchMax: counter.matchMax,
+                matchAverage: counter.attempts ? counter.matchTime / counter.attempts : 0,
+                execTime: counter.execTime,
+                execMax: counter.execMax,
+                totalTime: counter.matchTime + counter.execTime
+            });
+        });
+        return rows;
+    }
 
     public resetTriggerState(idx, oldState, oldFire?) {
         if (idx === -1) return;
@@ -8629,9 +9083,11 @@ export class Input extends EventEmitter {
 
     public clearCaches() {
         this._TriggerCache = null;
+        this._TriggerTypeIndex = {};
         this._TriggerStates = {};
         this._TriggerFunctionCache = {};
         this._TriggerRegExCache = {};
+        this._commandCache = new WeakMap<any, CompiledCommand>();
         this._gamepadCaches = null;
         this._lastSuspend = -1;
         this._MacroCache = {};
@@ -8641,6 +9097,8 @@ export class Input extends EventEmitter {
         if (!this.enableTriggers) return;
         this.buildTriggerCache();
         let t = 0;
+        let start;
+        let matched;
         if (!args)
             args = [event];
         else if (!Array.isArray(args))
@@ -8694,8 +9152,17 @@ export class Input extends EventEmitter {
                 continue;
             }
             if (trigger.type !== TriggerType.Event) continue;
-            if (trigger.caseSensitive && event !== trigger.pattern) continue;
-            if (!trigger.caseSensitive && event.toLowerCase() !== trigger.pattern.toLowerCase()) continue;
+            if (this._profiling) {
+                start = performance.now();
+                if (trigger.caseSensitive)
+                    matched = event === trigger.pattern;
+                else
+                    matched = event.toLowerCase() === trigger.pattern.toLowerCase();
+                this._profileMatch('event', trigger, parent, start);
+                if (!matched) continue;
+            }
+            else if (trigger.caseSensitive && event !== trigger.pattern) continue;
+            else if (!trigger.caseSensitive && event.toLowerCase() !== trigger.pattern.toLowerCase()) continue;
             this._LastTriggered = event;
             this.ExecuteTrigger(trigger, args, false, t, 0, 0, parent);
             t = this.cleanUpTriggerState(t);
@@ -9211,7 +9678,7 @@ export class Input extends EventEmitter {
     private _colorPosition(n: number, fore, back, item) {
         n = this.adjustLastLine(n);
         if (!item.hasOwnProperty('yStart'))
-            this._display.colorSubStringByLine(n, fore, back, item.xStart, item.hasOwnProperty('xEnd') && item.xEnd >= 0 ? item.xEnd : null);
+            this._display.queueLineEdit(n, { type: LineEditType.Color, start: item.xStart, end: item.hasOwnProperty('xEnd') && item.xEnd >= 0 ? item.xEnd : null, fore: fore, back: back });
         else {
             const xEnd = item.hasOwnProperty('xEnd') && item.xEnd >= 0 ? item.xEnd : null;
             const xStart = item.xStart;
@@ -9220,7 +9687,7 @@ export class Input extends EventEmitter {
             if (item.hasOwnProperty('yEnd'))
                 end = n - item.yEnd;
             while (line <= end) {
-                this._display.colorSubStringByLine(line, fore, back, xStart, xEnd);
+                this._display.queueLineEdit(line, { type: LineEditType.Color, start: xStart, end: xEnd, fore: fore, back: back });
                 line++;
             }
         }
@@ -829,12 +829,48 @@ export function getTimeSpan(i: number): string {
     return tmp.join(', ');
 }
 
+//template tables from main, app paths do not change once running so only fetched once
+let _templates: { parse: [string, string][], paths: [string, string][] } = null;
+
+function templates() {
+    if (!_templates)
+        _templates = ipcRenderer.sendSync('get-templates');
+    return _templates;
+}
+
+/**
+ * Set the template tables directly for processes that can not ask main, eg the session host
+ *
+ * @param data The template tables built by main
+ */
+export function setTemplates(data: { parse: [string, string][], paths: [string, string][] }) {
+    _templates = data;
+}
+
 export function parseTemplate(str: string, data?) {
-    return ipcRenderer.sendSync('parseTemplate', str, data);
+    //custom data replacements are left to main
+    if (data)
+        return ipcRenderer.sendSync('parseTemplate', str, data);
+    if (!str) return str;
+    const t = templates().parse;
+    const tl = t.length;
+    for (let p = 0; p < tl; p++) {
+        if (str.indexOf(t[p][0]) !== -1)
+            str = str.split(t[p][0]).join(t[p][1]);
+    }
+    return str;
 }
 
 export function templatePath(p: string) {
-    return ipcRenderer.sendSync('templatePath', p);
+    if (!p) return p;
+    const t = templates().paths;
+    const tl = t.length;
+    const testPath = process.platform !== 'linux' ? p.toLowerCase() : p;
+    for (let s = 0; s < tl; s++) {
+        if (testPath.startsWith(t[s][1]))
+            return t[s][0] + p.substr(t[s][1].length);
+    }
+    return p;
 }
 
 export function naturalCompare(a, b) {
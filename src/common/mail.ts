@@ -18,6 +18,11 @@ const sqlite3 = require('better-sqlite3');
 
 const { ipcRenderer } = require('electron');
 
+//letters returned per page when listing a folder
+const PAGE_SIZE = 500;
+//letter bodies kept after being read
+const CACHE_SIZE = 50;
+
 export class Mail extends EventEmitter {
 
     private _list;
@@ -28,6 +33,8 @@ export class Mail extends EventEmitter {
     private _read = {};
     private _mark = {};
     private _data = {};
+    //letter bodies by id and format, oldest first so the first key is dropped when full
+    private _cache: Map<string, any> = new Map<string, any>();
 
     public sendSize = 3000;
 
@@ -58,6 +65,7 @@ export class Mail extends EventEmitter {
         }
         else
             this._db.close();
+        this._cache.clear();
         this.initializeDatabase();
         if (callback)
             callback();
@@ -70,6 +78,7 @@ export class Mail extends EventEmitter {
         }
         else
             this._db.close();
+        this._cache.clear();
         /*
         try {
             fs.unlinkSync(this._file + '.lock');
@@ -111,6 +120,23 @@ export class Mail extends EventEmitter {
         this._db.exec('CREATE UNIQUE INDEX IF NOT EXISTS ' + prefix + 'index_mailid on Mail (MailID);');
         this._db.exec('CREATE UNIQUE INDEX IF NOT EXISTS ' + prefix + 'index_nameid on Names (NameID);');
         this._db.exec('CREATE UNIQUE INDEX IF NOT EXISTS ' + prefix + 'index_groupid on Groups (GroupID);');
+        //newest first listing by folder
+        this._db.exec('CREATE INDEX IF NOT EXISTS ' + prefix + 'index_folder_date on Mail (Folder, [Date], MailID);');
+        //full text index of subject, sender and body, rows share the rowid of the letter
+        const indexed = this._db.prepare(`SELECT 1 FROM ${prefix}sqlite_master WHERE type = 'table' AND name = 'MailSearch'`).get();
+        this._db.exec('CREATE VIRTUAL TABLE IF NOT EXISTS ' + prefix + 'MailSearch USING fts5(Subject, [From], Body)');
+        this._db.exec(`CREATE TRIGGER IF NOT EXISTS ${prefix}Mail_Insert AFTER INSERT ON Mail BEGIN
+            INSERT INTO MailSearch (rowid, Subject, [From], Body) VALUES (new.rowid, new.Subject, (SELECT Name FROM Names WHERE NameID = new.[From]), new.Raw);
+            END`);
+        this._db.exec(`CREATE TRIGGER IF NOT EXISTS ${prefix}Mail_Update AFTER UPDATE OF Subject, [From], Raw ON Mail BEGIN
+            UPDATE MailSearch SET Subject = new.Subject, [From] = (SELECT Name FROM Names WHERE NameID = new.[From]), Body = new.Raw WHERE rowid = new.rowid;
+            END`);
+        this._db.exec(`CREATE TRIGGER IF NOT EXISTS ${prefix}Mail_Delete AFTER DELETE ON Mail BEGIN
+            DELETE FROM MailSearch WHERE rowid = old.rowid;
+            END`);
+        //index letters stored before the search table existed
+        if (!indexed)
+            this._db.exec(`INSERT INTO ${prefix}MailSearch (rowid, Subject, [From], Body) SELECT Mail.rowid, Subject, Names.Name, Raw FROM ${prefix}Mail LEFT JOIN ${prefix}Names ON Names.NameID = Mail.[From]`);
         //spell-checker:enable
     }
 
@@ -197,8 +223,11 @@ export class Mail extends EventEmitter {
                 this._list.push.apply(this._list, obj.letters);
                 if (obj.last) {
                     il = this._list.length;
-                    for (i = 0; i < il; i++)
-                        this.addOrUpdateLetter(this._list[i]);
+                    //one transaction so the search index is only written once
+                    this._db.transaction(() => {
+                        for (i = 0; i < il; i++)
+                            this.addOrUpdateLetter(this._list[i]);
+                    })();
                     if (this._gettingMail) {
                         this.emit('got-mail', this._gettingMail, this._list);
                         this._gettingMail = 0;
@@ -213,39 +242,34 @@ export class Mail extends EventEmitter {
 
     public addOrUpdateLetter(letter, callback?) {
         if (!letter) return;
-        this._db.prepare('INSERT OR REPLACE INTO Mail (MailID, Date, Subject, Read, Folder, Raw, Ansi) VALUES (?, ?, ?, ?, ?, (SELECT Raw FROM Mail WHERE MailID = ?), (SELECT Ansi FROM Mail WHERE MailID = ?))').run(
+        //update in place so stored bodies are kept and the search index row follows the letter
+        this._db.prepare('INSERT INTO Mail (MailID, Date, Subject, Read, Folder) VALUES (?, ?, ?, ?, ?) ON CONFLICT(MailID) DO UPDATE SET Date = excluded.Date, Subject = excluded.Subject, Read = excluded.Read, Folder = excluded.Folder').run(
             [
                 letter.id,
                 letter.date,
                 letter.subject,
                 letter.read,
-                letter.folder || MailFolders.inbox,
-                letter.id,
-                letter.id
+                letter.folder || MailFolders.inbox
             ]);
-        this._db.prepare('DELETE FROM CC WHERE MailID = ?', [letter.id]).run();
-        this._db.prepare('DELETE FROM [To] WHERE MailID = ?', [letter.id]).run();
+        this._db.prepare('DELETE FROM CC WHERE MailID = ?').run([letter.id]);
+        this._db.prepare('DELETE FROM [To] WHERE MailID = ?').run([letter.id]);
         let n;
         let nl;
-        let row;
         const stmt = this._db.prepare(`INSERT INTO Names(Name) SELECT $from WHERE NOT EXISTS(SELECT 1 FROM Names WHERE Name = $from);`);
-        stmt.run({ $from: letter.from });
-        row = this._db.prepare('SELECT NameID from Names WHERE Name = ?').get([letter.from]);
-        this._db.prepare('Update Mail SET [From] = ? WHERE MailID = ?').run([row.NameID, letter.id]);
+        const name = this._db.prepare('SELECT NameID from Names WHERE Name = ?');
+        stmt.run({ from: letter.from });
+        this._db.prepare('Update Mail SET [From] = ? WHERE MailID = ?').run([name.get([letter.from]).NameID, letter.id]);
 
-        nl = letter.cc.length;
+        nl = letter.cc ? letter.cc.length : 0;
         for (n = 0; n < nl; n++) {
-            stmt.run({ $from: letter.cc[n] }).run();
-            row = this._db.prepare('SELECT NameID from Names WHERE Name = ?').get([letter.from]);
-            this._db.prepare('INSERT INTO CC (MailID, NameID) VALUES (?, ?)').run([letter.id, row.NameID]);
+            stmt.run({ from: letter.cc[n] });
+            this._db.prepare('INSERT INTO CC (MailID, NameID) VALUES (?, ?)').run([letter.id, name.get([letter.cc[n]]).NameID]);
         }
-        nl = letter.to.length;
+        nl = letter.to ? letter.to.length : 0;
         for (n = 0; n < nl; n++) {
-            stmt.run({ $from: letter.to[n] });
-            row = this._db.prepare('SELECT NameID from Names WHERE Name = ?').get([letter.from]);
-            this._db.run('INSERT INTO [To] (MailID, NameID) VALUES (?, ?)').run([letter.id, row.NameID]);
+            stmt.run({ from: letter.to[n] });
+            this._db.prepare('INSERT INTO [To] (MailID, NameID) VALUES (?, ?)').run([letter.id, name.get([letter.to[n]]).NameID]);
         }
-        stmt.finalize();
         if (callback) callback();
         this._changed = true;
         this.emit('letter-add', letter);
@@ -263,6 +287,7 @@ export class Mail extends EventEmitter {
             else
                 sql = 'Update Mail SET Raw = ? WHERE MailID = ?';
             this._db.prepare(sql).run([letter.message, letter.id]);
+            this._cache.delete(letter.id + '-' + letter.format);
             if (callback)
                 callback();
         });
@@ -280,8 +305,39 @@ export class Mail extends EventEmitter {
         }
     }
 
-    public getLetterList(folder, callback) {
-        const rows = this._db.prepare('SELECT MailID as id, Names.Name as [from], [Date] as [date], Subject as subject, Read as read FROM Mail INNER JOIN Names on Names.NameID = Mail.[From] WHERE Folder = ?').all([folder]);
+    /**
+     * Get a page of letter headers from a folder, newest first
+     *
+     * @param folder The folder to list
+     * @param callback Called with the rows, pass the last row as after to get the next page
+     * @param after The last row of the previous page
+     * @param limit The max number of rows to return
+     */
+    public getLetterList(folder, callback, after?, limit?: number) {
+        let rows;
+        if (after)
+            rows = this._db.prepare('SELECT MailID as id, Names.Name as [from], [Date] as [date], Subject as subject, Read as read FROM Mail INNER JOIN Names on Names.NameID = Mail.[From] WHERE Folder = ? AND ([Date], MailID) < (?, ?) ORDER BY [Date] DESC, MailID DESC LIMIT ?').all([folder, after.date, after.id, limit || PAGE_SIZE]);
+        else
+            rows = this._db.prepare('SELECT MailID as id, Names.Name as [from], [Date] as [date], Subject as subject, Read as read FROM Mail INNER JOIN Names on Names.NameID = Mail.[From] WHERE Folder = ? ORDER BY [Date] DESC, MailID DESC LIMIT ?').all([folder, limit || PAGE_SIZE]);
+        if (callback)
+            callback(rows || []);
+    }
+
+    /**
+     * Search the subject, sender and body of letters in a folder, best matches first
+     *
+     * @param folder The folder to search
+     * @param text The words to search for, each word matches as a prefix
+     * @param callback Called with the matching rows
+     * @param limit The max number of rows to return
+     */
+    public search(folder, text: string, callback, limit?: number) {
+        const query = (text || '').split(/\s+/).filter(w => w.length).map(w => '"' + w.replace(/"/g, '""') + '"*').join(' ');
+        if (!query.length) {
+            this.getLetterList(folder, callback, null, limit);
+            return;
+        }
+        const rows = this._db.prepare('SELECT MailID as id, Names.Name as [from], [Date] as [date], Mail.Subject as subject, Read as read FROM MailSearch INNER JOIN Mail on Mail.rowid = MailSearch.rowid INNER JOIN Names on Names.NameID = Mail.[From] WHERE MailSearch MATCH ? AND Folder = ? ORDER BY rank LIMIT ?').all([query, folder, limit || PAGE_SIZE]);
         if (callback)
             callback(rows || []);
     }
@@ -310,6 +366,16 @@ export class Mail extends EventEmitter {
 
     public read(id, format: MailReadFormat, callback) {
         let sql;
+        const key = id + '-' + format;
+        if (this._cache.has(key)) {
+            const letter = this._cache.get(key);
+            //move to the end as most recently used
+            this._cache.delete(key);
+            this._cache.set(key, letter);
+            if (callback)
+                callback(Object.assign({}, letter));
+            return;
+        }
         if (format === MailReadFormat.ansi)
             sql = 'SELECT MailID as id, Names.Name as [from], [Date] as [date], Subject as subject, Read as read, Ansi as message FROM Mail INNER JOIN Names on Names.NameID = Mail.[From] WHERE MailID = ?';
         else if (format === MailReadFormat.html)
@@ -328,12 +394,14 @@ export class Mail extends EventEmitter {
         }
         else {
             const rows = this._db.prepare('SELECT Names.Name FROM CC INNER JOIN Names on Names.NameID = CC.NameID WHERE CC.MailID = ?').all([id]);
-            if (callback) {
-                row.cc = rows.map((obj) => {
-                    return obj.Name;
-                });
-                callback(row);
-            }
+            row.cc = rows.map((obj) => {
+                return obj.Name;
+            });
+            this._cache.set(key, row);
+            if (this._cache.size > CACHE_SIZE)
+                this._cache.delete(this._cache.keys().next().value);
+            if (callback)
+                callback(Object.assign({}, row));
         }
     }
 
@@ -341,6 +409,10 @@ export class Mail extends EventEmitter {
         if (!local)
             ipcRenderer.send('send-gmcp', `Post.mark {id:"${id}", read:${mark}}`);
         this._db.prepare('Update Mail SET Read = ? WHERE MailID = ?').run([mark, id]);
+        this._cache.forEach(letter => {
+            if (letter.id === id)
+                letter.read = mark;
+        });
         this.emit('mark-changed', id);
     }
 
@@ -90,6 +90,8 @@ export class Mapper extends EventEmitter {
     private $drawCache;
     private $focused = false;
     private _worker;
+    //edits made while a worker is writing to the map file, held for disk maps and applied again to reloaded memory maps
+    private _workerEdits: (() => void)[] = [];
 
     public current: Room;
     public active: Room;
@@ -158,7 +160,7 @@ export class Mapper extends EventEmitter {
     set memorySavePeriod(value: number) {
         if (value !== this._memorySavePeriod) {
             clearInterval(this._memoryPeriod);
-            if (this._memory)
+            if (this._memory && !this._worker)
                 this._memoryPeriod = setInterval(this.save, this.memorySavePeriod);
             this._memorySavePeriod = value;
         }
@@ -655,6 +657,7 @@ export class Mapper extends EventEmitter {
 
     public reload() {
         this._db.close();
+        clearInterval(this._memoryPeriod);
         this.initializeDatabase();
         this.doUpdate(UpdateType.draw);
     }
@@ -726,8 +729,11 @@ export class Mapper extends EventEmitter {
     }
 
     public removeRoom(room) {
-        this._db.prepare('DELETE FROM Rooms WHERE ID = ?').run([room.ID]);
-        this._db.prepare('DELETE FROM Exits WHERE ID = ?').run([room.ID]);
+        const id = room.ID;
+        this.edit(() => {
+            this._db.prepare('DELETE FROM Rooms WHERE ID = ?').run([id]);
+            this._db.prepare('DELETE FROM Exits WHERE ID = ?').run([id]);
+        });
         this.emit('remove-done', room);
         if (room.ID === this.current.ID) {
             this.current = new Room();
@@ -753,9 +759,12 @@ export class Mapper extends EventEmitter {
     }
 
     public clearArea() {
+        const area = this.active.area;
         try {
-            this._db.prepare('DELETE FROM Exits WHERE ID in (Select ID from Rooms WHERE Area = ?)').run([this.active.area]);
-            this._db.prepare('DELETE FROM Rooms WHERE Area = ?').run([this.active.area]);
+            this.edit(() => {
+                this._db.prepare('DELETE FROM Exits WHERE ID in (Select ID from Rooms WHERE Area = ?)').run([area]);
+                this._db.prepare('DELETE FROM Rooms WHERE Area = ?').run([area]);
+            });
         }
         catch (err) {
             this.emit('error', err);
@@ -768,8 +777,10 @@ export class Mapper extends EventEmitter {
 
     public clearAll() {
         try {
-            this._db.prepare('DELETE FROM Exits').run();
-            this._db.prepare('DELETE FROM Rooms').run();
+            this.edit(() => {
+                this._db.prepare('DELETE FROM Exits').run();
+                this._db.prepare('DELETE FROM Rooms').run();
+            });
         }
         catch (err) {
             this.emit('error', err);
@@ -982,6 +993,8 @@ export class Mapper extends EventEmitter {
             return;
         }
         room = this.normalizeRoom(room);
+        if (this.holdEdit(() => this.updateRoom(room)))
+            return;
         this._db.prepare('BEGIN').run();
         try {
             this._db.prepare('Update Rooms SET Area = ?, Details = ?, Name = ?, Env = ?, X = ?, Y = ?, Z = ?, Zone = ?, Indoors = ? WHERE ID = ?').run(
@@ -1013,6 +1026,7 @@ export class Mapper extends EventEmitter {
         }
         this._db.prepare('COMMIT').run();
         this._changed = true;
+        this.workerEdit(() => this.updateRoom(room));
     }
 
     public addOrUpdateRoom(room) {
@@ -1023,6 +1037,8 @@ export class Mapper extends EventEmitter {
             return;
         }
         room = this.normalizeRoom(room);
+        if (this.holdEdit(() => this.addOrUpdateRoom(room)))
+            return;
         this._db.prepare('BEGIN').run();
         try {
             this._db.prepare('INSERT OR REPLACE INTO Rooms (ID, Area, Details, Name, Env, X, Y, Z, Zone, Indoors, Background, Notes) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?) ').run(
@@ -1059,6 +1075,55 @@ export class Mapper extends EventEmitter {
         this._db.prepare('COMMIT').run();
         this.refresh();
         this._changed = true;
+        this.workerEdit(() => this.addOrUpdateRoom(room));
+    }
+
+    /**
+     * Apply a change to the map database, recording it if a worker is writing to the map file
+     *
+     * @param change The database change
+     */
+    private edit(change: () => void) {
+        if (this.holdEdit(change))
+            return;
+        change();
+        this.workerEdit(change);
+    }
+
+    /**
+     * Hold an edit to a disk map while a worker is writing to the map file, writing on a second
+     * connection during the worker's batches would block on the busy file
+     *
+     * @param change The edit to apply once the worker is done
+     * @returns True if the edit was held
+     */
+    private holdEdit(change: () => void): boolean {
+        if (!this._worker || this._memory)
+            return false;
+        this._workerEdits.push(change);
+        return true;
+    }
+
+    /**
+     * Record an edit made to a memory map while a worker is writing to the map file, the memory
+     * map is reloaded from the file once the worker is done and the edits are applied again
+     *
+     * @param change The edit to apply again
+     */
+    private workerEdit(change: () => void) {
+        if (this._worker && this._memory)
+            this._workerEdits.push(change);
+    }
+
+    /**
+     * Apply edits held or recorded while a worker was running
+     *
+     * @param edits The edits in the order they were made
+     */
+    private applyEdits(edits: (() => void)[]) {
+        const el = edits.length;
+        for (let e = 0; e < el; e++)
+            edits[e]();
     }
 
     public async processGMCP(mod: string, obj) {
@@ -2422,94 +2487,26 @@ export class Mapper extends EventEmitter {
         this.emit('send-commands', cmds.join('\n') + '\n');
     }
 
+    /**
+     * Import rooms in a background worker
+     *
+     * @param data The json map file to stream rooms from, or an object or array of rooms
+     * @param type Merge with or replace the current map
+     */
     public import(data, type?: ImportType) {
         if (!data) return;
-        if (type === ImportType.Replace) {
-            try {
-                this._db.prepare('DELETE FROM Exits').run();
-                this._db.prepare('DELETE FROM Rooms').run();
-            }
-            catch (err) {
-                this.emit('error', err);
-            }
-            this.emit('clear-done');
-            this.reset();
-        }
-        this._cancelImport = false;
-        let idx;
-        let r;
-        let rl;
-        let tl;
-        this._db.prepare('BEGIN').run();
-        this.emit('import-progress', 0);
-        try {
-            const stmt2 = this._db.prepare('INSERT OR REPLACE INTO Rooms (ID, Area, Details, Name, Env, X, Y, Z, Zone, Indoors, Background) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)');
-            const stmt = this._db.prepare('INSERT OR REPLACE INTO Exits VALUES (?, ?, ?, ?, ?)');
-            if (!Array.isArray(data))
-                data = Object.values(data);
-            rl = data.length;
-            tl = data.length;
-            idx = 1;
-            let room;
-            for (r = 0; r < rl; r++) {
-                if (this._cancelImport) {
-                    this._db.prepare('ROLLBACK').run();
-                    this.finishImport();
-                    this.emit('import-complete');
-                    return;
-                }
-                room = data[r];
-                if (!room) continue;
-                tl += Object.keys(room.exits).length;
-                room = this.normalizeRoom(room);
-                stmt2.run([
-                    room.ID,
-                    room.area,
-                    room.details,
-                    room.name,
-                    room.env,
-                    room.x,
-                    room.y,
-                    room.z,
-                    room.zone,
-                    room.indoors,
-                    room.background
-                ]);
-                if (this._cancelImport) {
-                    this._db.prepare('ROLLBACK').run();
-                    this.finishImport();
-                    this.emit('import-complete');
-                    return;
-                }
-                this.emit('import-progress', Math.floor(idx / tl * 100));
-                idx++;
-                let exit;
-                const exits = room.exits;
-                for (exit in exits) {
-                    if (!exits.hasOwnProperty(exit)) continue;
-                    stmt.run([room.ID, exit, exits[exit].num, exits[exit].isdoor, exits[exit].isclosed]);
-                    if (this._cancelImport) {
-                        this._db.prepare('ROLLBACK').run();
-                        this.finishImport();
-                        this.emit('import-complete');
-                        return;
-                    }
-                    this.emit('import-progress', Math.floor(idx / tl * 100));
-                    idx++;
-                }
-            }
-            this._cancelImport = true;
-        }
-        catch (err) {
-            this.emit('error', err);
-            this._db.prepare('ROLLBACK').run();
+        const options = { action: 'import', replace: type === ImportType.Replace, file: null, rooms: null };
+        if (typeof data === 'string')
+            options.file = data;
+        else
+            options.rooms = Array.isArray(data) ? data : Object.values(data);
+        this.startWorker(options, edits => {
+            //worker writes to the map file, so memory maps need to be reloaded from it, then edits made meanwhile are applied
+            if (this._memory)
+                this.reload();
+            this.applyEdits(edits);
             this.finishImport();
-            this.emit('import-complete');
-            return;
-        }
-        this._db.prepare('COMMIT').run();
-        this.finishImport();
-        this.emit('import-complete');
+        });
     }
 
     private finishImport() {
@@ -2519,190 +2516,70 @@ export class Mapper extends EventEmitter {
     }
 
     public exportArea(file: string) {
-        let rows;
-        this._cancelImport = false;
-        try {
-            rows = this._db.prepare('Select * FROM Rooms left join exits on Exits.ID = Rooms.ID WHERE Area = $area').all({
-                area: this.active.area || ''
-            });
-        }
-        catch (err) {
-            this.emit('error', err);
-        }
-        this._worker = new Worker('./js/mapper.background.js');
-        this._worker.onmessage = (e) => {
-            switch (e.data.event) {
-                case 'progress':
-                    this.emit('import-progress', e.data.percent);
-                    break;
-                case 'canceled':
-                    this._worker.terminate();
-                    this._worker = null;
-                    this.emit('import-complete');
-                    break;
-                case 'complete':
-                    this._worker.terminate();
-                    this._worker = null;
-                    this.exportRooms(file, e.data.rooms).then(() => {
-                        this.emit('import-complete');
-                    });
-                    break;
-            }
-
-        };
-        this._worker.onerror = (e) => {
-            this.emit('import-complete');
-        };
-        if (rows)
-            this._worker.postMessage({ action: 'export', rows: rows });
-        else {
-            this._worker.terminate();
-            this._worker = null;
-            this.emit('import-complete');
-        }
-        /*
-        const rooms = {};
-        if (rows) {
-            this._cancelImport = false;
-            const rl = rows.length;
-            this.emit('import-progress', 0);
-            for (let r = 0; r < rl; r++) {
-                if (this._cancelImport) {
-                    this.emit('import-complete');
-                    return;
-                }
-                rows[r].ID = parseInt(rows[r].ID, 10);
-                if (rooms[rows[r].ID]) {
-                    if (!rows[r].Exit) continue;
-                    rooms[rows[r].ID].exits[rows[r].Exit] = {
-                        num: parseInt(rows[r].DestID, 10),
-                        isdoor: rows[r].IsDoor,
-                        isclosed: rows[r].IsClosed
-                    };
-                }
-                else {
-                    rooms[rows[r].ID] = { num: rows[r].ID };
-                    let prop;
-                    for (prop in rows[r]) {
-                        if (prop === 'ID')
-                            continue;
-                        if (!rows[r].hasOwnProperty(prop)) {
-                            continue;
-                        }
-                        if (this._cancelImport) {
-                            this.emit('import-complete');
-                            return;
-                        }
-                        rooms[rows[r].ID][prop.toLowerCase()] = rows[r][prop];
-                    }
-                    rooms[rows[r].ID].exits = {};
-                    if (!rows[r].Exit) continue;
-                    rooms[rows[r].ID].exits[rows[r].Exit] = {
-                        num: parseInt(rows[r].DestID, 10),
-                        isdoor: rows[r].IsDoor,
-                        isclosed: rows[r].IsClosed
-                    };
-                }
-                this.emit('import-progress', Math.floor(r / rl * 100));
-            }
-            this.exportRooms(file, rooms);
-        }
-        this._cancelImport = false;
-        this.emit('import-complete');
-        */
+        this.startWorker({ action: 'export', file: file, area: this.active.area || '' });
     }
 
-    public async exportAll(file: string) {
-        let rows;
-        this._cancelImport = false;
-        try {
-            rows = this._db.prepare('Select * FROM Rooms left join exits on Exits.ID = Rooms.ID').all();
-        }
-        catch (err) {
-            this.emit('error', err);
-        }
-        this._worker = new Worker('./js/mapper.background.js');
-        this._worker.onmessage = (e) => {
-            switch (e.data.event) {
-                case 'progress':
-                    this.emit('import-progress', e.data.percent);
-                    break;
-                case 'canceled':
-                    this._worker.terminate();
-                    this._worker = null;
-                    this.emit('import-complete');
-                    break;
-                case 'complete':
-                    this._worker.terminate();
-                    this._worker = null;
-                    this.exportRooms(file, e.data.rooms).then(() => {
-                        this.emit('import-complete');
-                    });
-                    break;
-            }
+    public exportAll(file: string) {
+        this.startWorker({ action: 'export', file: file });
+    }
 
-        };
-        this._worker.onerror = (e) => {
-            this.emit('import-complete');
-        };
-        if (rows)
-            this._worker.postMessage({ action: 'export', rows: rows });
-        else {
-            this._worker.terminate();
-            this._worker = null;
-            this.emit('import-complete');
-        }
-        /*
-        const rooms = {};
+    /**
+     * Run an import or export in the background worker, the worker opens its own connection to the map file
+     * so memory maps are saved first and not saved again until it is done, and disk map edits are held
+     *
+     * @param options The worker action and options
+     * @param done Called with the edits made while the worker ran once it has finished or was canceled
+     */
+    private startWorker(options, done?: (edits: (() => void)[]) => void) {
         this._cancelImport = false;
-        if (rows) {
-            const rl = rows.length;
-            this.emit('import-progress', 0);
-            for (let r = 0; r < rl; r++) {
-                if (this._cancelImport) {
-                    this.emit('import-complete');
-                    return;
-                }
-                rows[r].ID = parseInt(rows[r].ID, 10);
-                if (rooms[rows[r].ID]) {
-                    if (!rows[r].Exit) continue;
-                    rooms[rows[r].ID].exits[rows[r].Exit] = {
-                        num: parseInt(rows[r].DestID, 10),
-                        isdoor: rows[r].IsDoor,
-                        isclosed: rows[r].IsClosed
-                    };
-                }
-                else {
-                    rooms[rows[r].ID] = { num: rows[r].ID };
-                    let prop;
-                    for (prop in rows[r]) {
-                        if (prop === 'ID')
-                            continue;
-                        if (!rows[r].hasOwnProperty(prop)) {
-                            continue;
-                        }
-                        if (this._cancelImport) {
-                            this.emit('import-complete');
-                            return;
-                        }
-                        rooms[rows[r].ID][prop.toLowerCase()] = rows[r][prop];
-                    }
-                    rooms[rows[r].ID].exits = {};
-                    if (!rows[r].Exit) continue;
-                    rooms[rows[r].ID].exits[rows[r].Exit] = {
-                        num: parseInt(rows[r].DestID, 10),
-                        isdoor: rows[r].IsDoor,
-                        isclosed: rows[r].IsClosed
-                    };
-                }
-                this.emit('import-progress', Math.floor(r / rl * 100));
-            }
-            this.exportRooms(file, rooms).then(() => {
-                this._cancelImport = false;
+        this.emit('import-progress', 0);
+        this.save(() => {
+            const finished = () => {
+                if (!this._worker) return;
+                this._worker.terminate();
+                this._worker = null;
+                this._cancelImport = true;
+                if (this._memory)
+                    this._memoryPeriod = setInterval(this.save, this.memorySavePeriod);
+                const edits = this._workerEdits;
+                this._workerEdits = [];
+                if (done)
+                    done(edits);
+                //memory map edits are already applied when nothing was reloaded
+                else if (!this._memory)
+                    this.applyEdits(edits);
                 this.emit('import-complete');
-            });
-        }
-        */
+            };
+            //periodic saves would write the memory map over the file the worker is using
+            clearInterval(this._memoryPeriod);
+            this._workerEdits = [];
+            options.map = this._mapFile;
+            this._worker = new Worker('./js/mapper.background.js');
+            this._worker.onmessage = (e) => {
+                switch (e.data.event) {
+                    case 'progress':
+                        this.emit('import-progress', e.data.percent);
+                        break;
+                    case 'cleared':
+                        this.emit('clear-done');
+                        this.reset();
+                        break;
+                    case 'error':
+                        this.emit('error', e.data.error);
+                        finished();
+                        break;
+                    case 'canceled':
+                    case 'complete':
+                        finished();
+                        break;
+                }
+            };
+            this._worker.onerror = (e) => {
+                this.emit('error', e.message);
+                finished();
+            };
+            this._worker.postMessage(options);
+        });
     }
 
     public async exportRooms(file: string, rooms) {
@@ -2718,16 +2595,15 @@ export class Mapper extends EventEmitter {
         if (this._cancelImport)
             return;
         this._cancelImport = true;
+        //worker stops after the current batch and sends canceled once its connection is closed
+        if (this._worker)
+            this._worker.postMessage({ action: 'cancel' });
         this.emit('import-progress', -1);
     }
 
     public cancelExport() {
-        if (this._worker) {
+        if (this._worker)
             this._worker.postMessage({ action: 'cancel' });
-            this._worker.terminate();
-            this._worker = null;
-            this.emit('import-complete');
-        }
     }
 
     public compact() {
@@ -2743,8 +2619,11 @@ export class Mapper extends EventEmitter {
 
     public executeCommand(cmd: string, callback?) {
         if (!cmd || cmd.length === 0) return;
+        if (this.holdEdit(() => this.executeCommand(cmd, callback)))
+            return;
         try {
             this._db.exec(cmd);
+            this.workerEdit(() => this.executeCommand(cmd));
         }
         catch (err) {
             this.emit('error', err);
@@ -2754,6 +2633,12 @@ export class Mapper extends EventEmitter {
     }
 
     public save(callback?) {
+        //worker is using the map file, edits are kept in memory and saved once it is done
+        if (this._worker) {
+            if (callback)
+                callback();
+            return;
+        }
         if (!this.ready) {
             setTimeout(() => {
                 this.save(callback);
@@ -1,4 +1,3 @@
-//TODO re-code to download sounds and store in proper folder format based on MSP spec
 // http://www.zuggsoft.com/zmud/msp.htm
 // http://amylaar.pages.de/doc/other/msp.htm
 // https://www.gammon.com.au/forum/bbshowpost.php?bbsubject_id=783
@@ -6,8 +5,11 @@
 // spell-checker:ignore fname
 //const buzz = require('buzz');
 import buzz from 'buzz';
-//const path = require('path');
-//const fs = require('fs');
+const path = require('path');
+const fs = require('fs');
+const http = require('http');
+const https = require('https');
+const { fileURLToPath, pathToFileURL } = require('url');
 import { EventEmitter } from 'events';
 import { stripQuotes } from './library';
 import { TelnetOption } from './telnet';
@@ -29,6 +31,375 @@ interface MSPData {
     continue?: boolean;
 }
 
+/**
+ * Stores fetched sound files under the save path in host/path folders and keeps
+ * decoded audio for recently played sounds
+ */
+export class SoundCache {
+    private _context: AudioContext;
+    private _files = new Map<string, Promise<ArrayBuffer>>();
+    private _decoding = new Map<string, Promise<AudioBuffer>>();
+    private _buffers = new Map<string, AudioBuffer>();
+    private _size: number = 0;
+    //saved files and their sizes, least recently used first, read from the save path on first use
+    private _disk: Map<string, number> = null;
+    private _diskSize: number = 0;
+    private _scanning: Promise<void> = null;
+
+    public savePath: string = '';
+    //max bytes of decoded audio to keep, least recently played are dropped first
+    public maxSize: number = 67108864;
+    //max bytes of saved files to keep, least recently used are deleted first
+    public maxDiskSize: number = 268435456;
+    //milliseconds to wait on a download before giving up
+    public timeout: number = 30000;
+
+    get context(): AudioContext {
+        if (!this._context)
+            this._context = new AudioContext();
+        return this._context;
+    }
+
+    /**
+     * Get the local file a url is saved as, or null if it can not be saved
+     *
+     * @param url The sound url
+     */
+    public localPath(url: URL): string {
+        if (!this.savePath || !this.savePath.length || (url.protocol !== 'http:' && url.protocol !== 'https:'))
+            return null;
+        let parts: string[];
+        try {
+            parts = decodeURIComponent(url.pathname).split(/[\\/]/).filter(p => p.length);
+        }
+        catch (e) {
+            //malformed escapes, just stream it
+            return null;
+        }
+        if (!parts.length || parts.some(p => p === '..' || p === '.' || /[:\0]/.test(p)))
+            return null;
+        //ipv6 hosts contain : and [] which are not valid in windows file names
+        const file = path.join(this.savePath, url.hostname.replace(/[:[\]]/g, '_') + (url.port ? '_' + url.port : ''), ...parts);
+        //never write outside of the save path
+        if (!path.resolve(file).startsWith(path.resolve(this.savePath) + path.sep))
+            return null;
+        return file;
+    }
+
+    /**
+     * Get the data for a sound, reading the local copy if there is one or
+     * fetching and saving it
+     *
+     * @param url The sound url
+     */
+    public file(url: string): Promise<ArrayBuffer> {
+        let request = this._files.get(url);
+        if (request)
+            return request;
+        request = this.load(url);
+        this._files.set(url, request);
+        //only keep in flight requests, finished ones are on disk or in the decoded cache
+        request.then(() => this._files.delete(url), () => this._files.delete(url));
+        return request;
+    }
+
+    private async load(url: string): Promise<ArrayBuffer> {
+        const location = new URL(url, window.location.href);
+        let data: Buffer;
+        if (location.protocol === 'file:') {
+            data = await fs.promises.readFile(fileURLToPath(location));
+            return data.buffer.slice(data.byteOffset, data.byteOffset + data.byteLength);
+        }
+        const file = this.localPath(location);
+        if (file) {
+            await this.index();
+            try {
+                data = await fs.promises.readFile(file);
+                this.touch(file, data.byteLength);
+                return data.buffer.slice(data.byteOffset, data.byteOffset + data.byteLength);
+            }
+            catch (e) {
+                if (e.code !== 'ENOENT') throw e;
+            }
+        }
+        data = await this.download(location);
+        if (file)
+            await this.save(file, data);
+        return data.buffer.slice(data.byteOffset, data.byteOffset + data.byteLength);
+    }
+
+    /**
+     * Download a url with node, the page is loaded from file: so a renderer fetch would be blocked by cors
+     *
+     * @param location The url to download
+     * @param redirects The number of redirects left to follow
+     */
+    private download(location: URL, redirects: number = 5): Promise<Buffer> {
+        return new Promise((resolve, reject) => {
+            if (location.protocol !== 'http:' && location.protocol !== 'https:') {
+                reject(new Error(`MSP - Source not supported: ${location.href}`));
+                return;
+            }
+            const request = (location.protocol === 'https:' ? https : http).get(location, response => {
+                const status = response.statusCode;
+                if (status >= 300 && status < 400 && response.headers.location && redirects > 0) {
+                    response.resume();
+                    resolve(this.download(new URL(response.headers.location, location), redirects - 1));
+                    return;
+                }
+                if (status !== 200) {
+                    response.resume();
+                    reject(new Error(`MSP - Network error: ${location.href} (${status})`));
+                    return;
+                }
+                const chunks = [];
+                response.on('data', chunk => chunks.push(chunk));
+                response.on('end', () => {
+                    if (response.complete)
+                        resolve(Buffer.concat(chunks));
+                    else
+                        reject(new Error(`MSP - Network error: ${location.href} (incomplete)`));
+                });
+                response.on('error', reject);
+            });
+            request.on('error', reject);
+            request.setTimeout(this.timeout, () => request.destroy(new Error(`MSP - Timed out: ${location.href}`)));
+        });
+    }
+
+    private async save(file: string, data: Buffer) {
+        //write to a temp file and rename so a partial file is never read back as the sound
+        const tmp = file + '.download';
+        try {
+            await fs.promises.mkdir(path.dirname(file), { recursive: true });
+            await fs.promises.writeFile(tmp, data);
+            await fs.promises.rename(tmp, file);
+        }
+        catch (e) {
+            fs.promises.unlink(tmp).catch(() => { });
+            return;
+        }
+        this.touch(file, data.byteLength);
+        this.trim(file);
+    }
+
+    /**
+     * Read the sizes and last used times of files already saved so the disk limit covers them
+     */
+    private index(): Promise<void> {
+        if (!this._scanning)
+            this._scanning = this.scan(this.savePath);
+        return this._scanning;
+    }
+
+    private async scan(root: string) {
+        const files = [];
+        const dirs = [root];
+        while (dirs.length) {
+            const dir = dirs.pop();
+            let entries;
+            try {
+                entries = await fs.promises.readdir(dir, { withFileTypes: true });
+            }
+            catch (e) {
+                continue;
+            }
+            for (let i = 0, il = entries.length; i < il; i++) {
+                const name = path.join(dir, entries[i].name);
+                if (entries[i].isDirectory())
+                    dirs.push(name);
+                else if (entries[i].isFile() && !name.endsWith('.download')) {
+                    try {
+                        const stat = await fs.promises.stat(name);
+                        files.push([name, stat.size, stat.mtimeMs]);
+                    }
+                    catch (e) { }
+                }
+            }
+        }
+        //save path changed while scanning
+        if (root !== this.savePath) return;
+        files.sort((a, b) => a[2] - b[2]);
+        this._disk = new Map<string, number>();
+        this._diskSize = 0;
+        for (let f = 0, fl = files.length; f < fl; f++)
+            this.touch(files[f][0], files[f][1], true);
+        this.trim();
+    }
+
+    /**
+     * Mark a saved file as most recently used, the modified time is updated so the order is kept between runs
+     *
+     * @param file The saved file
+     * @param size The file size in bytes
+     * @param scanned True if the file was just read from disk and the time does not need updating
+     */
+    private touch(file: string, size: number, scanned?: boolean) {
+        if (!this._disk)
+            this._disk = new Map<string, number>();
+        if (this._disk.has(file)) {
+            this._diskSize -= this._disk.get(file);
+            this._disk.delete(file);
+        }
+        this._disk.set(file, size);
+        this._diskSize += size;
+        if (scanned) return;
+        const now = new Date();
+        fs.promises.utimes(file, now, now).catch(() => { });
+    }
+
+    /**
+     * Delete the least recently used saved files until under the disk limit
+     *
+     * @param keep A file to never delete, the one just saved
+     */
+    private trim(keep?: string) {
+        if (!this._disk || this._diskSize <= this.maxDiskSize) return;
+        for (const [file, size] of this._disk) {
+            if (this._diskSize <= this.maxDiskSize) break;
+            if (file === keep) continue;
+            this._disk.delete(file);
+            this._diskSize -= size;
+            fs.promises.unlink(file).catch(() => { });
+        }
+    }
+
+    /**
+     * Get the decoded audio for a sound
+     *
+     * @param url The sound url
+     */
+    public decode(url: string): Promise<AudioBuffer> {
+        let buffer = this._buffers.get(url);
+        if (buffer) {
+            //move to the end as most recently used
+            this._buffers.delete(url);
+            this._buffers.set(url, buffer);
+            return Promise.resolve(buffer);
+        }
+        let request = this._decoding.get(url);
+        if (request)
+            return request;
+        //decodeAudioData detaches the data, so copy in case it is shared with another request
+        request = this.file(url).then(data => this.context.decodeAudioData(data.slice(0)));
+        this._decoding.set(url, request);
+        request.then(decoded => {
+            this._decoding.delete(url);
+            this.add(url, decoded);
+        }, () => this._decoding.delete(url));
+        return request;
+    }
+
+    /**
+     * Fetch and decode a sound ahead of it being played
+     *
+     * @param url The sound url
+     */
+    public preload(url: string) {
+        this.decode(url).catch(() => { });
+    }
+
+    private add(url: string, buffer: AudioBuffer) {
+        if (this._buffers.has(url)) return;
+        this._buffers.set(url, buffer);
+        this._size += buffer.length * buffer.numberOfChannels * 4;
+        for (const [key, old] of this._buffers) {
+            if (this._size <= this.maxSize || key === url) break;
+            this._buffers.delete(key);
+            this._size -= old.length * old.numberOfChannels * 4;
+        }
+    }
+
+    public clear() {
+        this._buffers.clear();
+        this._size = 0;
+        this._disk = null;
+        this._diskSize = 0;
+        this._scanning = null;
+    }
+}
+
+/**
+ * Play a decoded sound through a state's output node, supports the parts of
+ * the buzz sound api used by states and sound info
+ */
+class BufferedSound {
+    private _source: AudioBufferSourceNode;
+    private _started: number = 0;
+    private _ended: boolean = false;
+    private _events = [];
+
+    constructor(private _context: AudioContext, private _buffer: AudioBuffer, private _output: GainNode) {
+        this._source = this._context.createBufferSource();
+        this._source.buffer = this._buffer;
+        this._source.connect(this._output);
+        this._source.onended = (e) => {
+            this._ended = true;
+            this._source.disconnect();
+            this.trigger(e);
+        };
+    }
+
+    public setVolume(volume: number) {
+        this._output.gain.value = volume / 100;
+        return this;
+    }
+
+    public loop() {
+        this._source.loop = true;
+        return this;
+    }
+
+    public play() {
+        if (this._context.state === 'suspended')
+            this._context.resume();
+        this._started = this._context.currentTime;
+        this._source.start();
+        return this;
+    }
+
+    public stop() {
+        if (this._ended) return this;
+        this._ended = true;
+        this._events = [];
+        try {
+            this._source.stop();
+        }
+        catch (e) {
+            //never started
+        }
+        this._source.disconnect();
+        return this;
+    }
+
+    public bind(events: string, callback) {
+        if (events.split(' ').indexOf('ended') !== -1)
+            this._events.push(callback);
+        return this;
+    }
+
+    public isEnded() {
+        return this._ended;
+    }
+
+    public getTime() {
+        if (!this._started) return 0;
+        const time = this._context.currentTime - this._started;
+        return this._source.loop ? time % this._buffer.duration : Math.min(time, this._buffer.duration);
+    }
+
+    public getDuration() {
+        return this._buffer.duration;
+    }
+
+    private trigger(e) {
+        const events = this._events;
+        this._events = [];
+        for (let i = 0, il = events.length; i < il; i++)
+            events[i](e);
+    }
+}
+
 class SoundState extends EventEmitter {
     public _file: string = '';
     private _repeats: number = 1;
@@ -42,6 +413,17 @@ class SoundState extends EventEmitter {
     public url: string = '';
     public continue: boolean = true;
     public maxErrorRetries: number = 0;
+    public cache: SoundCache;
+    //play from decoded audio, when false the saved file is streamed by buzz, used for long music files
+    public buffered: boolean = false;
+    private _output: GainNode;
+    private _opening: number = 0;
+
+    constructor(cache: SoundCache, buffered?: boolean) {
+        super();
+        this.cache = cache;
+        this.buffered = buffered || false;
+    }
 
     set file(file: string) {
         if (!this.continue)
@@ -91,7 +473,9 @@ class SoundState extends EventEmitter {
         if (this._repeats > 0 && this.current < this._repeats) {
             this.current++;
             this.close();
-            this.open().then(() => {
+            this.open().then((opened) => {
+                //replaced by a newer sound while loading
+                if (!opened) return;
                 //reset to 0 as it was successful in prep of next sound
                 this._retries = 0;
                 this.sound.setVolume(this._volume).play();
@@ -122,7 +506,9 @@ class SoundState extends EventEmitter {
         }
         else if (this._repeats === -1) {
             this.close();
-            this.open().then(() => {
+            this.open().then((opened) => {
+                //replaced by a newer sound while loading
+                if (!opened) return;
                 //reset to 0 as it was successful in prep of next sound
                 this._retries = 0;
                 this.sound.setVolume(this._volume).loop().play();
@@ -144,9 +530,52 @@ class SoundState extends EventEmitter {
     }
 
     public async open() {
+        const url = this.url + this._file;
+        const id = ++this._opening;
+        let buffer: AudioBuffer = null;
         this.close();
+        if (this.buffered) {
+            try {
+                buffer = await this.cache.decode(url);
+            }
+            catch (err) {
+                //could not download or decode, let buzz stream it the same as music for the normal error handling
+            }
+            //opened again while loading, only the latest is played
+            if (id !== this._opening)
+                return 0;
+        }
+        if (buffer) {
+            if (!this._output) {
+                this._output = this.cache.context.createGain();
+                this._output.connect(this.cache.context.destination);
+            }
+            this.sound = new BufferedSound(this.cache.context, buffer, this._output);
+            this.emit('opened');
+            this.emit('playing', { file: this._file, sound: this.sound, state: this, duration: buzz.toTimer(buffer.duration) });
+            return 1;
+        }
+        //save a local copy then stream that file so music is never fetched twice
+        const location = new URL(url, window.location.href);
+        const file = this.cache.localPath(location);
+        let source = url;
+        if (file) {
+            //sounds already tried the cache when decoding
+            if (!this.buffered) {
+                try {
+                    await this.cache.file(url);
+                }
+                catch (err) {
+                    //fall back to letting buzz fetch it for the normal error handling
+                }
+                if (id !== this._opening)
+                    return 0;
+            }
+            if (fs.existsSync(file))
+                source = pathToFileURL(file).href;
+        }
         return new Promise((resolve, reject) => {
-            this.sound = new (buzz.sound as any)(this.url + this._file);
+            this.sound = new (buzz.sound as any)(source);
             this.sound.bind('loadeddata', (e) => {
                 this.emit('playing', { file: this._file, sound: this.sound, state: this, duration: buzz.toTimer(this.sound.getDuration()) });
                 resolve(1);
@@ -218,6 +647,7 @@ export interface MSPOptions {
  * @property {Object} [server=false]	- Weather the server willing to do MSP
  * @property {Object} [enabled=true]	- Is MSP module enabled
  * @property {string} savePath          - Where sounds will be saved
+ * @property {number} maxCacheSize      - Max bytes of saved sounds
  */
 export class MSP extends EventEmitter {
     private _enabled: boolean = true;
@@ -226,15 +656,15 @@ export class MSP extends EventEmitter {
     public server: boolean = false;
     public enableDebug: boolean = false;
 
-    public savePath: string = '';
+    private _cache: SoundCache = new SoundCache();
     public defaultSoundURL: string = '';
     public defaultMusicURL: string = '';
     public forcedDefaultMusicURL: string = 'http://' + window.location.hostname + '/sounds/';
     public forcedDefaultSoundURL: string = 'http://' + window.location.hostname + '/sounds/';
     public defaultSoundExt: string = '.m4a';
     public defaultMusicExt: string = '.m4a';
-    public MusicState: SoundState = new SoundState();
-    public SoundState: SoundState = new SoundState();
+    public MusicState: SoundState = new SoundState(this._cache);
+    public SoundState: SoundState = new SoundState(this._cache, true);
     public parseMode: ParseMode = ParseMode.default;
 
     constructor(options?: MSPOptions) {
@@ -265,6 +695,30 @@ export class MSP extends EventEmitter {
         this.SoundState.close();
     }
 
+    /**
+     * where sounds are saved, in host/path folders based on the sound url
+     *
+     * @type {string}
+     * @memberof MSP
+     */
+    get savePath() { return this._cache.savePath; }
+    set savePath(value) {
+        if (value === this._cache.savePath) return;
+        this._cache.savePath = value;
+        this._cache.clear();
+    }
+
+    /**
+     * max bytes of sounds to keep saved, least recently used are deleted first
+     *
+     * @type {number}
+     * @memberof MSP
+     */
+    get maxCacheSize() { return this._cache.maxDiskSize; }
+    set maxCacheSize(value) {
+        this._cache.maxDiskSize = value;
+    }
+
     /**
      * the number of retries to try before stopping when an error happens MSP
      *
@@ -601,6 +1055,7 @@ export class MSP extends EventEmitter {
      * @param {Object} data Client#received-GMCP data object
      */
     public async processGMCP(mod: string, data: any) {
+        let url;
         switch (mod) {
             case 'Client.Media.Default':
                 if (data.type === 'sound' || !data.type)
@@ -608,8 +1063,18 @@ export class MSP extends EventEmitter {
                 else if (data.type === 'music')
                     this.music({ off: true, url: data.url });
                 break;
-            //as we don't support loading and caching of media ignore this
+            //fetch, save and decode so a later play starts right away
             case 'Client.Media.Load':
+                if (!this.enabled || !this.enableSound || !data.name) break;
+                if (data.url && data.url.length > 0)
+                    url = data.url;
+                else if (this.forcedDefaultSoundURL && this.forcedDefaultSoundURL.length > 0)
+                    url = this.forcedDefaultSoundURL;
+                else
+                    url = this.defaultSoundURL || '';
+                if (url.length > 0 && !url.endsWith('/'))
+                    url += '/';
+                this._cache.preload(url + (data.name.lastIndexOf('.') === -1 ? data.name + this.defaultSoundExt : data.name));
                 break;
             case 'Client.Media.Play':
                 //start off with default values
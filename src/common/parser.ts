@@ -3,6 +3,7 @@ import { EventEmitter } from 'events';
 import RGBColor from 'rgbcolor';
 import { ParserLine, FormatType, ParserOptions, FontStyle, LineFormat, LinkFormat, ImageFormat, Size } from './types';
 import { stripQuotes, CharAllowedInURL, htmlDecode } from './library';
+import { Tracer, TracePipeline } from './tracer';
 
 interface MXPBlock {
     format: LineFormat | LinkFormat | ImageFormat;
@@ -257,20 +258,44 @@ class MXPStyle {
  * @property {Boolean} [enableFlashing=false]				- Enable/disable ansi blink
  * @property {Boolean} [emulateTerminal=false]			- Enable/disable Terminal IBM/OEM (code page 437) extended characters, will convert them to the correct unicode character in an attempt to display like classic terminal
  */
+/**
+ * Codes at or below this are 24 bit colors stored as -(TrueColor + rgb) so every
+ * ansi and mxp color is a number that GetColor can resolve
+ */
+export const TrueColor = 16777216;
+
 export class Parser extends EventEmitter {
 
     /** @private */
     private _parsing = [];
     /** @private */
+    /* Characters waiting in the parse queue */
+    private _backlog = 0;
+    /** @private */
+    private _sliceTimer = null;
+    /** @private */
+    private _paused = false;
+    /** @private */
+    private _sliceStats = { slices: 0, last: 0, max: 0, total: 0 };
+    /** @private */
     /* Web detection protocols that are just followed by a :*/
     private _protocols = [['m', 'a', 'i', 'l', 't', 'o'], ['s', 'k', 'y', 'p', 'e'], ['c', 'a', 'l', 'l', 't', 'o'], ['i', 'm'], ['i', 't', 'm', 's'], ['t', 'e', 'l'], ['t', 'e', 'l', 'n', 'e', 't']];
 
     /** @private */
     private _ColorTable: string[] = null;
     /** @private */
-    private _CurrentForeColor: (string | number) = 37;
+    private _CurrentForeColor: number = 37;
     /** @private */
-    private _CurrentBackColor: (string | number) = 40;
+    private _CurrentBackColor: number = 40;
+    /** @private */
+    /* css text for each true color code used */
+    private _trueColors: Map<number, string> = new Map<number, string>();
+    /** @private */
+    /* true color code for each mxp/css color used, or the text if not a valid color */
+    private _cssColors: Map<string, number | string> = new Map<string, number | string>();
+    /** @private */
+    /* adjusted bold, faint and high color codes keyed by code and adjustment */
+    private _adjustedColors: Map<string, number> = new Map<string, number>();
     /** @private */
     private _CurrentAttributes: FontStyle = FontStyle.None;
     /** @private */
@@ -317,6 +342,14 @@ export class Parser extends EventEmitter {
     }
 
     public busy = false;
+    public tracer: Tracer = null;
+    /* Milliseconds of queued text parsed before yielding to rendering and input */
+    public sliceBudget = 4;
+    /* Largest block of remote text parsed at once, larger blocks are split on line breaks */
+    public sliceSize = 8192;
+    /* Backlog in characters that pauses reading, reading resumes once it falls below the low mark */
+    public backlogHigh = 1048576;
+    public backlogLow = 262144;
 
     constructor(options?: ParserOptions) {
         super();
@@ -361,25 +394,25 @@ export class Parser extends EventEmitter {
         let bc: number = -1;
 
         if (mxp.fore.length > 0) {
+            f = this.ColorCode(mxp.fore);
             if ((this._CurrentAttributes & FontStyle.Bold) === FontStyle.Bold)
-                f = this.IncreaseColor(mxp.fore, 0.5);
+                f = this.AdjustColor(f, 0.5);
             else if ((this._CurrentAttributes & FontStyle.Faint) === FontStyle.Faint)
-                f = this.DecreaseColor(mxp.fore, 0.5);
-            else
-                f = mxp.fore;
+                f = this.AdjustColor(f, -0.5);
         }
-        else if (typeof this._CurrentForeColor === 'string')
-            f = 'rgb(' + this._CurrentForeColor.replace(/;/g, ',') + ')';
         else {
             f = this._CurrentForeColor;
-            if ((this._CurrentAttributes & FontStyle.Bold) === FontStyle.Bold) {
+            //true colors are not changed by bold or faint
+            if (f <= -TrueColor)
+                fc = -1;
+            else if ((this._CurrentAttributes & FontStyle.Bold) === FontStyle.Bold) {
                 if (f > 999)
                     f /= 1000;
                 if (f >= 0 && f < 99)
                     f *= 10;
                 fc = f;
                 if (f <= -16)
-                    f = this.IncreaseColor(this.GetColor(f), 0.5);
+                    f = this.AdjustColor(f, 0.5);
             }
             else if ((this._CurrentAttributes & FontStyle.Faint) === FontStyle.Faint) {
                 if (f > 99 && f < 999)
@@ -388,24 +421,20 @@ export class Parser extends EventEmitter {
                     f *= 100;
                 fc = f;
                 if (f <= -16)
-                    f = this.DecreaseColor(this.GetColor(f), 0.15);
+                    f = this.AdjustColor(f, -0.15);
             }
             else {
                 fc = f;
             }
         }
 
-        if (mxp.high) {
-            if (typeof f === 'number')
-                f = this.IncreaseColor(this.GetColor(f), 0.25);
-            else
-                f = this.IncreaseColor(f, 0.25);
-        }
+        if (mxp.high)
+            f = this.AdjustColor(f, 0.25);
 
         if (mxp.back.length > 0)
-            b = mxp.back;
-        else if (typeof this._CurrentBackColor === 'string')
-            b = 'rgb(' + this._CurrentBackColor.replace(/;/g, ',') + ')';
+            b = this.ColorCode(mxp.back);
+        else if (this._CurrentBackColor <= -TrueColor)
+            b = this._CurrentBackColor;
         else
             b = bc = this._CurrentBackColor;
 
@@ -414,6 +443,51 @@ export class Parser extends EventEmitter {
         return { fore: f, back: b, foreCode: fc, backCode: bc };
     }
 
+    /**
+     * Get the true color code for a css color, each color is only parsed once
+     *
+     * @param color The css or mxp color
+     * @returns The color code, or the color text if it is not a valid color
+     */
+    public ColorCode(color: string): (number | string) {
+        let code = this._cssColors.get(color);
+        if (code !== undefined)
+            return code;
+        const rgb = new RGBColor(color);
+        if (rgb.ok)
+            code = -(TrueColor + (rgb.r << 16 | rgb.g << 8 | rgb.b));
+        else
+            code = color;
+        //only keep a working set so generated gradients do not grow it forever
+        if (this._cssColors.size >= 4096)
+            this._cssColors.clear();
+        this._cssColors.set(color, code);
+        return code;
+    }
+
+    /**
+     * Get a lighter or darker version of a color as a true color code, results
+     * are kept so each color and amount is only computed once
+     *
+     * @param code The color code or text
+     * @param percent Amount to lighten, negative to darken
+     */
+    public AdjustColor(code: (number | string), percent: number): (number | string) {
+        const key = code + ':' + percent;
+        let adjusted: (number | string) = this._adjustedColors.get(key);
+        if (adjusted !== undefined)
+            return adjusted;
+        const color = typeof code === 'number' ? this.GetColor(code) : code;
+        adjusted = this.ColorCode(percent < 0 ? this.DecreaseColor(color, -percent) : this.IncreaseColor(color, percent));
+        //invalid colors are returned as is
+        if (typeof adjusted !== 'number')
+            return code;
+        if (this._adjustedColors.size >= 4096)
+            this._adjustedColors.clear();
+        this._adjustedColors.set(key, adjusted);
+        return adjusted;
+    }
+
     private _getFormatBlock(offset) {
         const mxp: MXPStyle = this._GetCurrentStyle();
         const colors = this._getColors(mxp);
@@ -439,7 +513,7 @@ export class Parser extends EventEmitter {
         let p: number = 0;
         const pl: number = params.length;
         let i: number;
-        let rgb: string;
+        let rgb: number;
         for (; p < pl; p++) {
             i = +params[p] || 0;
             switch (i) {
@@ -549,16 +623,15 @@ export class Parser extends EventEmitter {
                         i = +params[p + 2] || 0;
                         if (i < 0 || i > 255)
                             continue;
-                        rgb = i + ';';
+                        rgb = i << 16;
                         i = +params[p + 3] || 0;
                         if (i < 0 || i > 255)
                             continue;
-                        rgb += i + ';';
+                        rgb += i << 8;
                         i = +params[p + 4] || 0;
                         if (i < 0 || i > 255)
                             continue;
-                        rgb += i;
-                        this._CurrentForeColor = rgb;
+                        this._CurrentForeColor = -(TrueColor + rgb + i);
                         p += 4;
                     }
                     break;
@@ -593,16 +666,15 @@ export class Parser extends EventEmitter {
                         i = +params[p + 2] || 0;
                         if (i < 0 || i > 255)
                             continue;
-                        rgb = i + ';';
+                        rgb = i << 16;
                         i = +params[p + 3] || 0;
                         if (i < 0 || i > 255)
                             continue;
-                        rgb += i + ';';
+                        rgb += i << 8;
                         i = +params[p + 4] || 0;
                         if (i < 0 || i > 255)
                             continue;
-                        rgb += i;
-                        this._CurrentBackColor = rgb;
+                        this._CurrentBackColor = -(TrueColor + rgb + i);
                         p += 4;
                     }
                     break;
@@ -873,6 +945,17 @@ export class Parser extends EventEmitter {
             case 3700:  //set foreground color to white
                 return this._ColorTable[263];
             default:
+                if (code <= -TrueColor) {
+                    let color = this._trueColors.get(code);
+                    if (color === undefined) {
+                        const rgb = -code - TrueColor;
+                        color = `rgb(${rgb >> 16 & 255}, ${rgb >> 8 & 255}, ${rgb & 255})`;
+                        if (this._trueColors.size >= 4096)
+                            this._trueColors.clear();
+                        this._trueColors.set(code, color);
+                    }
+                    return color;
+                }
                 if (code <= -16) {
                     code += 16;
                     code *= -1;
@@ -891,6 +974,8 @@ export class Parser extends EventEmitter {
         color = new RGBColor(color);
         if (!color.ok) return;
         this._ColorTable[code] = color.toRGB();
+        //bold and faint versions of palette colors need to be recomputed
+        this._adjustedColors.clear();
     }
 
     private _AddLine(line: string, raw: string, fragment: boolean, skip: boolean, formats: LineFormat[], remote: boolean) {
@@ -2510,14 +2595,14 @@ export class Parser extends EventEmitter {
      */
     public CurrentAnsiCode() {
         let ansi = '\x1b[';
-        if (typeof this._CurrentForeColor === 'string')
-            ansi += '38;2;' + this._CurrentForeColor;
+        if (this._CurrentForeColor <= -TrueColor)
+            ansi += '38;2;' + (-this._CurrentForeColor - TrueColor >> 16 & 255) + ';' + (-this._CurrentForeColor - TrueColor >> 8 & 255) + ';' + (-this._CurrentForeColor - TrueColor & 255) + ';';
         else if (this._CurrentForeColor <= -16)
             ansi += '38;5;' + (this._CurrentForeColor * -1 - 16) + ';';
         else
             ansi += this._CurrentForeColor + ';';
-        if (typeof this._CurrentBackColor === 'string')
-            ansi += '48;2;' + this._CurrentBackColor;
+        if (this._CurrentBackColor <= -TrueColor)
+            ansi += '48;2;' + (-this._CurrentBackColor - TrueColor >> 16 & 255) + ';' + (-this._CurrentBackColor - TrueColor >> 8 & 255) + ';' + (-this._CurrentBackColor - TrueColor & 255) + ';';
         else if (this._CurrentBackColor <= -16)
             ansi += '38;5;' + (this._CurrentBackColor * -1 - 16) + ';';
         else
@@ -2557,15 +2642,45 @@ export class Parser extends EventEmitter {
         return false;
     }
 
+    /**
+     * Queue size and slice timings, times are in milliseconds
+     */
+    public get parseStats() {
+        return {
+            backlog: this._backlog,
+            queued: Math.max(0, this._parsing.length - (this.busy ? 1 : 0)),
+            paused: this._paused,
+            slices: this._sliceStats.slices,
+            lastSlice: this._sliceStats.last,
+            maxSlice: this._sliceStats.max,
+            averageSlice: this._sliceStats.slices ? this._sliceStats.total / this._sliceStats.slices : 0,
+            budget: this.sliceBudget
+        };
+    }
+
+    public resetParseStats() {
+        this._sliceStats = { slices: 0, last: 0, max: 0, total: 0 };
+    }
+
     public parse(text: string, remote?: boolean, force?: boolean, prependSplit?: boolean) {
         if (text == null || text.length === 0)
             return text;
         if (remote == null) remote = false;
         //query data in case already parsing
         if (this._parsing.length > 0 && !force) {
-            this._parsing.push([text, remote, prependSplit]);
+            this._queueParse(text, remote, prependSplit);
             return;
         }
+        const sliceStart = force ? 0 : performance.now();
+        const traceStart = this.tracer && this.tracer.enabled ? performance.now() : 0;
+        //only parse the first block of a large remote chunk now, the rest is parsed in later slices
+        if (!force && remote && text.length > this.sliceSize) {
+            const idx = text.lastIndexOf('\n', this.sliceSize);
+            if (idx !== -1 && idx < text.length - 1) {
+                this._queueParse(text.substring(idx + 1), remote, prependSplit);
+                text = text.substring(0, idx + 1);
+            }
+        }
         let _TermTitle = '';
         let _TermTitleType = null;
         let _AnsiParams = null;
@@ -4110,15 +4225,73 @@ export class Parser extends EventEmitter {
             if (this.enableDebug) this.emit('debug', ex);
         }
         this.busy = false;
+        if (traceStart) this.tracer.record('parse', TracePipeline.Output, traceStart);
         this.emit('parse-done');
         this._parsing.shift();
-        if (this._parsing.length > 0)
-            setTimeout(this._parseNext(), 0);
+        //forced parses are driven by the slice loop
+        if (!force && this._parsing.length > 0)
+            this._parseSlice(sliceStart);
+    }
+
+    /**
+     * Add text to the end of the parse queue, splitting large remote blocks on line breaks
+     * so each slice stays close to its time budget
+     *
+     * @param text The text to queue
+     * @param remote Is the text from the remote host
+     * @param prependSplit Prepend text to the split buffer instead of appending
+     */
+    private _queueParse(text: string, remote: boolean, prependSplit: boolean) {
+        let idx;
+        while (remote && text.length > this.sliceSize) {
+            idx = text.lastIndexOf('\n', this.sliceSize);
+            if (idx === -1 || idx === text.length - 1) break;
+            this._parsing.push([text.substring(0, idx + 1), remote, prependSplit]);
+            this._backlog += idx + 1;
+            text = text.substring(idx + 1);
+        }
+        this._parsing.push([text, remote, prependSplit]);
+        this._backlog += text.length;
+        this._updateBackpressure();
     }
 
-    private _parseNext() {
-        const iTmp = this._parsing.shift();
-        return () => { this.parse(iTmp[0], iTmp[1], true, iTmp[2]); };
+    /**
+     * Parse queued text until the slice budget is used, then yield so the display can paint
+     * and input can be handled before the next slice
+     *
+     * @param start The time the slice started
+     */
+    private _parseSlice(start: number) {
+        let iTmp;
+        let now = performance.now();
+        while (this._parsing.length > 0 && now - start < this.sliceBudget) {
+            iTmp = this._parsing.shift();
+            this._backlog -= iTmp[0].length;
+            this.parse(iTmp[0], iTmp[1], true, iTmp[2]);
+            now = performance.now();
+        }
+        this._sliceStats.slices++;
+        this._sliceStats.last = now - start;
+        this._sliceStats.total += this._sliceStats.last;
+        if (this._sliceStats.last > this._sliceStats.max)
+            this._sliceStats.max = this._sliceStats.last;
+        this._updateBackpressure();
+        if (this._parsing.length > 0 && !this._sliceTimer)
+            this._sliceTimer = setTimeout(() => {
+                this._sliceTimer = null;
+                this._parseSlice(performance.now());
+            }, 0);
+    }
+
+    private _updateBackpressure() {
+        if (!this._paused && this._backlog > this.backlogHigh) {
+            this._paused = true;
+            this.emit('backpressure', true, this._backlog);
+        }
+        else if (this._paused && this._backlog < this.backlogLow) {
+            this._paused = false;
+            this.emit('backpressure', false, this._backlog);
+        }
     }
 
     public updateWindow(width, height) {
@@ -1,6 +1,269 @@
 //spell-checker:words keycode
 import { EventEmitter } from 'events';
 
+/**
+ * Searchable item in a profile, text is the lower case fields always searched
+ * and value is the lower case item value only searched when values are enabled
+ */
+interface SearchEntry {
+    key: string;
+    parents?: string[];
+    state?: number;
+    sub?: boolean;
+    fields: string[];
+    value: string;
+    text: string;
+}
+
+/**
+ * Trigram index of all searchable items for a single profile
+ */
+class ProfileIndex {
+    public profile;
+    public entries: SearchEntry[] = [];
+    public grams = new Map<string, number[]>();
+    public valueGrams = new Map<string, number[]>();
+
+    constructor(profile, display: (item) => string) {
+        this.profile = profile;
+        const key = 'Profile' + profile.name.toLowerCase().replace(/^[^a-z]+|[^\w:.-]+/gi, '-');
+        let i;
+        let il;
+        let item;
+        this.add({ key: key }, [profile.name], '');
+        il = profile.aliases.length;
+        for (i = 0; i < il; i++) {
+            item = profile.aliases[i];
+            this.add({ key: key + 'aliases' + i, parents: [key, 'aliases'] }, [item.name, display(item), item.pattern], item.value);
+        }
+        il = profile.triggers.length;
+        for (i = 0; i < il; i++) {
+            item = profile.triggers[i];
+            this.add({ key: key + 'triggers' + i, state: 0, parents: [key, 'triggers'] }, [item.name, display(item), item.pattern], item.value);
+            for (let t = 0, tl = item.triggers.length; t < tl; t++)
+                this.add({ key: key + 'triggers' + i, state: t + 1, sub: true, parents: [key, 'triggers'] }, [item.triggers[t].name, display(item.triggers[t]), item.triggers[t].pattern], item.triggers[t].value);
+        }
+        il = profile.macros.length;
+        for (i = 0; i < il; i++) {
+            item = profile.macros[i];
+            this.add({ key: key + 'macros' + i, parents: [key, 'macros'] }, [item.name, display(item)], item.value);
+        }
+        il = profile.buttons.length;
+        for (i = 0; i < il; i++) {
+            item = profile.buttons[i];
+            this.add({ key: key + 'buttons' + i, parents: [key, 'buttons'] }, [item.name, display(item), item.caption], item.value);
+        }
+        il = profile.contexts.length;
+        for (i = 0; i < il; i++) {
+            item = profile.contexts[i];
+            this.add({ key: key + 'contexts' + i, parents: [key, 'contexts'] }, [item.name, display(item), item.caption], item.value);
+        }
+    }
+
+    private add(entry, fields: string[], value: string) {
+        const id = this.entries.length;
+        entry.fields = fields.map(f => typeof f === 'string' ? f : (f === null || f === undefined ? '' : '' + f));
+        entry.value = typeof value === 'string' ? value : (value === null || value === undefined ? '' : '' + value);
+        entry.text = entry.fields.join('\n').toLowerCase();
+        this.entries.push(entry);
+        addGrams(this.grams, entry.text, id);
+        if (entry.value.length)
+            addGrams(this.valueGrams, entry.value.toLowerCase(), id);
+    }
+
+    /**
+     * Get entry ids that could contain all literals, or null if the literals can not narrow the search
+     *
+     * @param literals lower case literal strings that must appear in a match
+     * @param values include item values
+     */
+    public candidates(literals: string[], values: boolean): number[] {
+        const gl = [];
+        for (let l = 0, ll = literals.length; l < ll; l++)
+            gl.push(...trigrams(literals[l]));
+        if (gl.length === 0)
+            return null;
+        const found = intersectGrams(this.grams, gl);
+        if (!values)
+            return found;
+        return mergeIds(found, intersectGrams(this.valueGrams, gl));
+    }
+}
+
+function trigrams(str: string): string[] {
+    const grams = [];
+    for (let i = 0, il = str.length - 2; i < il; i++)
+        grams.push(str.substr(i, 3));
+    return grams;
+}
+
+function addGrams(map: Map<string, number[]>, str: string, id: number) {
+    let list;
+    for (let i = 0, il = str.length - 2; i < il; i++) {
+        list = map.get(str.substr(i, 3));
+        if (!list)
+            map.set(str.substr(i, 3), [id]);
+        //ids are added in order so only need to check the last one to avoid duplicates
+        else if (list[list.length - 1] !== id)
+            list.push(id);
+    }
+}
+
+function intersectGrams(map: Map<string, number[]>, grams: string[]): number[] {
+    const lists = [];
+    for (let g = 0, gl = grams.length; g < gl; g++) {
+        const list = map.get(grams[g]);
+        if (!list) return [];
+        lists.push(list);
+    }
+    lists.sort((a, b) => a.length - b.length);
+    let result = lists[0];
+    for (let l = 1, ll = lists.length; l < ll && result.length; l++) {
+        const next = [];
+        const list = lists[l];
+        let i = 0;
+        let j = 0;
+        while (i < result.length && j < list.length) {
+            if (result[i] === list[j]) {
+                next.push(result[i]);
+                i++;
+                j++;
+            }
+            else if (result[i] < list[j])
+                i++;
+            else
+                j++;
+        }
+        result = next;
+    }
+    return result;
+}
+
+function mergeIds(a: number[], b: number[]): number[] {
+    if (!b.length) return a;
+    if (!a.length) return b;
+    const result = [];
+    let i = 0;
+    let j = 0;
+    while (i < a.length || j < b.length) {
+        if (j >= b.length || (i < a.length && a[i] < b[j]))
+            result.push(a[i++]);
+        else if (i >= a.length || b[j] < a[i])
+            result.push(b[j++]);
+        else {
+            result.push(a[i++]);
+            j++;
+        }
+    }
+    return result;
+}
+
+/**
+ * Get the literal strings that must appear in any match of a regular expression,
+ * returns an empty array if none can be safely determined
+ *
+ * @param pattern regular expression source
+ */
+export function regexLiterals(pattern: string): string[] {
+    const literals = [];
+    let current = '';
+    let depth = 0;
+    let c;
+    const pl = pattern.length;
+    const flush = () => {
+        if (current.length)
+            literals.push(current);
+        current = '';
+    };
+    for (let p = 0; p < pl; p++) {
+        c = pattern.charAt(p);
+        switch (c) {
+            case '\\':
+                p++;
+                c = pattern.charAt(p);
+                //escaped symbols are literals, anything else is a character class or reference
+                if (depth === 0 && c.length && !(/[a-zA-Z0-9]/).test(c)) {
+                    current += c;
+                    break;
+                }
+                flush();
+                //skip the payload of escapes that are more then one character so it is not read as literal text
+                switch (c) {
+                    case 'x':
+                        p += 2;
+                        break;
+                    case 'u':
+                        if (pattern.charAt(p + 1) === '{')
+                            while (p < pl && pattern.charAt(p) !== '}') p++;
+                        else
+                            p += 4;
+                        break;
+                    case 'c':
+                        p++;
+                        break;
+                    case 'k':
+                        if (pattern.charAt(p + 1) === '<')
+                            while (p < pl && pattern.charAt(p) !== '>') p++;
+                        break;
+                    case 'p':
+                    case 'P':
+                        if (pattern.charAt(p + 1) === '{')
+                            while (p < pl && pattern.charAt(p) !== '}') p++;
+                        break;
+                    default:
+                        //back references can be more then one digit
+                        if (c >= '1' && c <= '9')
+                            while (p + 1 < pl && (/[0-9]/).test(pattern.charAt(p + 1))) p++;
+                        break;
+                }
+                break;
+            case '|':
+                //alternation at top level means no literal is required
+                if (depth === 0)
+                    return [];
+                break;
+            case '[':
+                flush();
+                p++;
+                if (pattern.charAt(p) === ']') p++;
+                while (p < pl && pattern.charAt(p) !== ']') {
+                    if (pattern.charAt(p) === '\\') p++;
+                    p++;
+                }
+                break;
+            case '(':
+                flush();
+                depth++;
+                break;
+            case ')':
+                depth--;
+                break;
+            case '?':
+            case '*':
+            case '{':
+                //previous character is optional
+                if (current.length)
+                    current = current.substr(0, current.length - 1);
+                flush();
+                if (c === '{')
+                    while (p < pl && pattern.charAt(p) !== '}') p++;
+                break;
+            case '+':
+            case '.':
+            case '^':
+            case '$':
+                flush();
+                break;
+            default:
+                if (depth === 0)
+                    current += c;
+                break;
+        }
+    }
+    flush();
+    return literals;
+}
+
 /**
  * Simple search box dialog
  *
@@ -21,6 +284,10 @@ export class ProfileSearch extends EventEmitter {
     private _regex;
     private _key;
     private _value;
+    private _indexes = new Map<string, ProfileIndex>();
+    private _search = 0;
+    private _invalidate;
+    private _clientInvalidate;
     //private $profiles = [];
 
     public manager;
@@ -63,6 +330,16 @@ export class ProfileSearch extends EventEmitter {
         this.manager = manager;
         this.tree = tree;
         this.createControl();
+        this._invalidate = (profile?) => this.invalidate(profile);
+        this._clientInvalidate = (type, profile) => this.invalidate(profile);
+        if (this.manager.events)
+            this.manager.events.on('profile-changed', this._invalidate);
+        if (window.opener && window.opener.client) {
+            window.opener.client.on('profile-updated', this._invalidate);
+            window.opener.client.on('item-updated', this._clientInvalidate);
+        }
+        //build the index while idle so the first search does not have to
+        window.requestIdleCallback(() => this.updateIndex());
         this._key = (e) => {
             if (e.keyCode === 27) { // escape key maps to keycode `27`
                 this.hide();
@@ -256,8 +533,49 @@ export class ProfileSearch extends EventEmitter {
         });
     }
 
+    /**
+     * Mark a profile's index as out of date so it is rebuilt on the next search
+     *
+     * @param profile profile name or object, if not supplied all profiles are marked
+     */
+    public invalidate(profile?) {
+        if (!profile)
+            this._indexes.clear();
+        else
+            this._indexes.delete((typeof profile === 'string' ? profile : profile.name).toLowerCase());
+    }
+
+    /**
+     * Build indexes for any profile that is new or has changed
+     */
+    public updateIndex() {
+        if (!this.manager.profiles) return;
+        const profiles = Object.values<any>(this.manager.profiles.items);
+        for (let p = 0, pl = profiles.length; p < pl; p++)
+            this.getIndex(profiles[p]);
+        //remove deleted profiles
+        if (this._indexes.size > profiles.length) {
+            const names = new Set(profiles.map(profile => profile.name.toLowerCase()));
+            for (const name of this._indexes.keys())
+                if (!names.has(name))
+                    this._indexes.delete(name);
+        }
+    }
+
+    private getIndex(profile): ProfileIndex {
+        const name = profile.name.toLowerCase();
+        let index = this._indexes.get(name);
+        //profiles are recreated when refreshed so rebuild if no longer the same object
+        if (!index || index.profile !== profile) {
+            index = new ProfileIndex(profile, item => this.manager.GetDisplay(item));
+            this._indexes.set(name, index);
+        }
+        return index;
+    }
+
     public find(focus?: boolean) {
         const val = <string>$('input', this._control).val();
+        const search = ++this._search;
         this.clear();
         if (val.length === 0) {
             this.updateCount();
@@ -271,82 +589,89 @@ export class ProfileSearch extends EventEmitter {
             return;
         }
         let pattern;
-        if (this._regex)
+        let literals;
+        if (this._regex) {
             pattern = val;
-        else
+            literals = regexLiterals(val).map(l => l.toLowerCase());
+        }
+        else {
             pattern = val.replace(/[-\/\\^$*+?.()|[\]{}]/g, '\\$&');
+            literals = [val.toLowerCase()];
+        }
         let re;
         if (this._word)
             pattern = '\\b' + pattern + '\\b';
-        if (this._case)
-            re = new RegExp(pattern, 'g');
-        else
-            re = new RegExp(pattern, 'gi');
-        let items = [];
-        let m;
-        let i;
-        let il;
-        let item;
+        try {
+            if (this._case)
+                re = new RegExp(pattern);
+            else
+                re = new RegExp(pattern, 'i');
+        }
+        catch {
+            this.updateCount();
+            this.emit('found-results', this._results);
+            return;
+        }
         const profiles = Object.values<any>(this.manager.profiles.items);
-        for (let p = 0, pl = profiles.length; p < pl; p++) {
-            let profile = profiles[p];
-            m = re.exec(profile.name);
-            const key = 'Profile' + profile.name.toLowerCase().replace(/^[^a-z]+|[^\w:.-]+/gi, '-');
-            if (m) {
-                items.push({
-                    key: key,
-                });
-            }
-            il = profile.aliases.length;
-            for (i = 0; i < il; i++) {
-                item = profile.aliases[i];
-                if (this.matchItem(re, item) || re.exec(item.pattern))
-                    items.push({ key: key + 'aliases' + i, parents: [key, 'aliases'] });
-            }
-            il = profile.triggers.length;
-            for (i = 0; i < il; i++) {
-                item = profile.triggers[i];
-                if (this.matchItem(re, item) || re.exec(item.pattern))
-                    items.push({ key: key + 'triggers' + i, state: 0, parents: [key, 'triggers'] });
-                else if (item.triggers.length) {
-                    for (let t = 0, tl = item.triggers.length; t < tl; t++)
-                        if (this.matchItem(re, item.triggers[t]) || re.exec(item.triggers[t].pattern))
-                            items.push({ key: key + 'triggers' + i, state: t + 1, parents: [key, 'triggers'] });
-                }
-            }
-            il = profile.macros.length;
-            for (i = 0; i < il; i++) {
-                item = profile.macros[i];
-                if (this.matchItem(re, item))
-                    items.push({ key: key + 'macros' + i, parents: [key, 'macros'] });
+        const pl = profiles.length;
+        let p = 0;
+        //search a slice of profiles at a time so large sets do not block and results show as found
+        const next = () => {
+            if (search !== this._search) return;
+            const start = performance.now();
+            const count = this._results.length;
+            for (; p < pl && performance.now() - start < 8; p++)
+                this.findInIndex(this.getIndex(profiles[p]), re, literals);
+            if (p < pl) {
+                if (!this.Reverse && count === 0 && this._results.length)
+                    this.gotoResult(0, focus);
+                else
+                    this.updateCount();
+                this.updateButtons();
+                setTimeout(next, 0);
+                return;
             }
-            il = profile.buttons.length;
-            for (i = 0; i < il; i++) {
-                item = profile.buttons[i];
-                if (this.matchItem(re, item) || re.exec(item.caption))
-                    items.push({ key: key + 'buttons' + i, parents: [key, 'buttons'] });
-            }
-            il = profile.contexts.length;
-            for (i = 0; i < il; i++) {
-                item = profile.contexts[i];
-                if (this.matchItem(re, item) || re.exec(item.caption))
-                    items.push({ key: key + 'contexts' + i, parents: [key, 'contexts'] });
+            if (this.Reverse)
+                this._results.reverse();
+            if (this.Reverse || count === 0)
+                this.gotoResult(0, focus);
+            else {
+                this.updateCount();
+                this.updateButtons();
             }
-        }
-        this._results.push.apply(this._results, items);
+            this.emit('found-results', this._results);
+        };
+        next();
+    }
 
-        if (this.Reverse)
-            this._results.reverse();
-        this.gotoResult(0, focus);
-        this.emit('found-results', this._results);
+    private findInIndex(index: ProfileIndex, re: RegExp, literals: string[]) {
+        const entries = index.entries;
+        let ids = index.candidates(literals, this._value);
+        let matched;
+        let entry;
+        if (!ids)
+            ids = [...entries.keys()];
+        for (let i = 0, il = ids.length; i < il; i++) {
+            entry = entries[ids[i]];
+            //trigger states are only listed when the parent trigger did not match
+            if (entry.sub && matched === entry.key)
+                continue;
+            if (!this.matchEntry(re, entry))
+                continue;
+            if (!entry.sub)
+                matched = entry.key;
+            if (entry.parents)
+                this._results.push(typeof entry.state === 'number' ? { key: entry.key, state: entry.state, parents: entry.parents } : { key: entry.key, parents: entry.parents });
+            else
+                this._results.push({ key: entry.key });
+        }
     }
 
-    private matchItem(re, item) {
-        if (re.exec(item.name))
-            return true;
-        if (re.exec(this.manager.GetDisplay(item)))
-            return true;
-        if (this._value && re.exec(item.value))
+    private matchEntry(re: RegExp, entry: SearchEntry) {
+        for (let f = 0, fl = entry.fields.length; f < fl; f++)
+            if (re.test(entry.fields[f]))
+                return true;
+        if (this._value && re.test(entry.value))
             return true;
         return false;
     }
@@ -424,6 +749,13 @@ export class ProfileSearch extends EventEmitter {
     }
 
     public dispose() {
+        this._search++;
+        if (this.manager.events)
+            this.manager.events.off('profile-changed', this._invalidate);
+        if (window.opener && window.opener.client) {
+            window.opener.client.off('profile-updated', this._invalidate);
+            window.opener.client.off('item-updated', this._clientInvalidate);
+        }
         this._control.remove();
         window.document.removeEventListener('keyup', this._key);
     }
@@ -962,10 +962,14 @@ export class Profile {
                 profile.contexts.push(new Context(data.contexts[i], profile));
             }
         }
-        //copied or something as name does not match file so just change the name to file to prevent data loss.
-        if (path.basename(file, '.json') !== profile.name)
-            profile.name = path.basename(file, '.json');
-        profile.file = profile.name;
+        if (typeof file === 'string') {
+            //copied or something as name does not match file so just change the name to file to prevent data loss.
+            if (path.basename(file, '.json') !== profile.name)
+                profile.name = path.basename(file, '.json');
+            profile.file = profile.name;
+        }
+        else if (!profile.file)
+            profile.file = profile.name;
         return profile;
     }
 
@@ -981,6 +985,16 @@ export class Profile {
         }));
     }
 
+    /**
+     * Get a plain copy of the profile as it would be saved, used to move a loaded profile to another client
+     */
+    public toData() {
+        return JSON.parse(JSON.stringify(this, (key, value) => {
+            if (key === 'profile') return undefined;
+            return value;
+        }));
+    }
+
     public clone(version?: number) {
         let data;
         let i;
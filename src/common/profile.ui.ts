@@ -1,6 +1,7 @@
 //spell-checker:ignore dropdown, selectall, treeview, displaytype, uncheck, selectpicker, Profiledefault, askoncancel, triggernewline, triggerprompt, exportmenu
 //spell-checker:ignore gamepadconnected gamepaddisconnected
 import { ipcRenderer, nativeImage } from 'electron';
+import { EventEmitter } from 'events';
 const remote = require('@electron/remote');
 const { Menu, MenuItem } = remote;
 import { FilterArrayByKeyValue, parseTemplate, keyCodeToChar, clone, isFileSync, isDirSync, existsSync, htmlEncode, walkSync, isValidIdentifier } from './library';
@@ -21,6 +22,10 @@ declare global {
 }
 
 export let profiles = new ProfileCollection();
+/**
+ * Emits profile-changed with the profile name when a profile is edited, or no name when any profile may have changed
+ */
+export const events = new EventEmitter();
 export let noEditorFocus = false;
 let currentProfile;
 let currentNode;
@@ -60,6 +65,12 @@ let _iCommentsStr = ['/', '/'];
 let _bCommentsStr = ['/', '*'];
 
 let _saving = false;
+//tree node id index, cleared each time the treeview rebuilds its node list
+let _nodeIndex: Map<string, any> = null;
+//profile nodes waiting to be added/removed so bulk changes only rebuild the tree once
+let _treeAdd = [];
+let _treeRemove = [];
+let _treeTimer;
 export let options = getOptions();
 
 const _controllers = {};
@@ -318,6 +329,79 @@ function profileID(name) {
     return name.toLowerCase().replace(/^[^a-z]+|[^\w:.-]+/gi, '-');
 }
 
+/**
+ * Find a tree node by id, same result as treeview findNodes with an anchored id pattern but uses
+ * an id index instead of matching every node
+ *
+ * @param id The node id
+ * @returns Array containing the node if found
+ */
+function findNodesById(id: string) {
+    if (_treeAdd.length || _treeRemove.length)
+        flushTree();
+    const node = indexedNode(id);
+    return node ? [node] : [];
+}
+
+function indexedNode(id: string) {
+    let node;
+    if (_nodeIndex) {
+        node = _nodeIndex.get(id);
+        //updateNode replaces node objects, make sure the indexed one is still the one in the tree
+        if (!node || $('#profile-tree').data('treeview')._nodes[node.nodeId] === node)
+            return node;
+    }
+    _nodeIndex = new Map();
+    const nodes = $('#profile-tree').treeview('getNodes') || [];
+    const nl = nodes.length;
+    for (let n = 0; n < nl; n++)
+        _nodeIndex.set(nodes[n].id, nodes[n]);
+    return _nodeIndex.get(id);
+}
+
+/**
+ * Queue a profile node to be added to the tree, replacing the current node when it exists
+ *
+ * @param profile The profile to add
+ * @param replace Remove the current profile node
+ */
+function queueProfileNode(profile, replace?: boolean) {
+    const id = 'Profile' + profileID(profile.name);
+    const node = newProfileNode(profile);
+    if (replace) {
+        const queued = _treeAdd.findIndex(n => n.id === id);
+        if (queued !== -1)
+            _treeAdd.splice(queued, 1);
+        else {
+            //tree is unchanged until the queue is flushed so the index is still valid
+            const current = indexedNode(id);
+            if (current && _treeRemove.indexOf(current) === -1)
+                _treeRemove.push(current);
+        }
+    }
+    _treeAdd.push(node);
+    //imports flush when done, this only catches anything left behind
+    if (!_treeTimer)
+        _treeTimer = setTimeout(flushTree, 100);
+}
+
+/**
+ * Apply all queued profile node changes with one remove and one add
+ */
+function flushTree() {
+    clearTimeout(_treeTimer);
+    _treeTimer = 0;
+    const remove = _treeRemove;
+    const add = _treeAdd;
+    _treeRemove = [];
+    _treeAdd = [];
+    //treeview removes by index one node at a time, so remove from the end first to keep indexes valid
+    if (remove.length)
+        $('#profile-tree').treeview('removeNode', [remove.sort((a, b) => b.index - a.index), { silent: true }]);
+    if (add.length)
+        $('#profile-tree').treeview('addNode', [add, false, false]);
+}
+
 export function AddNewItem() {
     let t;
     if (currentNode) {
@@ -871,7 +955,7 @@ function addItem(type: string, key: string, item, idx?: number, profile?: Profil
     if (!idx && typeof idx !== 'number')
         idx = profile[key].length;
     type = type.toLowerCase();
-    const n = $('#profile-tree').treeview('findNodes', ['^Profile' + profileID(profile.name) + key + '$', 'id']);
+    const n = findNodesById('Profile' + profileID(profile.name) + key);
     $('#profile-tree').treeview('expandNode', [n, { levels: 1, silent: false }]);
     profile[key][idx] = item;
     const nodes = [newItemNode(item, idx, type, profile)];
@@ -898,7 +982,7 @@ export function UpdateEnabled() {
         case 'buttons':
         case 'contexts':
         case 'profile':
-            const parent = $('#profile-tree').treeview('findNodes', ['^Profile' + profileID(currentProfile.name) + '$', 'id']);
+            const parent = findNodesById('Profile' + profileID(currentProfile.name));
             if (!$('#editor-enabled').prop('checked') && _enabled.indexOf(currentProfile.name.toLowerCase()) !== -1) {
                 _enabled = _enabled.filter((a) => { return a !== currentProfile.name.toLowerCase(); });
                 if (_enabled.length === 0) {
@@ -919,17 +1003,17 @@ export function UpdateEnabled() {
             break;
         case 'alias':
             if ($('#editor-enabled').prop('checked'))
-                $('#profile-tree').treeview('checkNode', [$('#profile-tree').treeview('findNodes', ['^' + currentNode.id + '$', 'id']), { silent: true }]);
+                $('#profile-tree').treeview('checkNode', [findNodesById(currentNode.id), { silent: true }]);
             else
-                $('#profile-tree').treeview('uncheckNode', [$('#profile-tree').treeview('findNodes', ['^' + currentNode.id + '$', 'id']), { silent: true }]);
+                $('#profile-tree').treeview('uncheckNode', [findNodesById(currentNode.id), { silent: true }]);
             pushUndo({ action: 'update', type: t, item: currentNode.dataAttr.index, profile: currentProfile.name.toLowerCase(), data: { enabled: currentProfile.aliases[currentNode.dataAttr.index].enabled } });
             currentProfile.aliases[currentNode.dataAttr.index].enabled = $('#editor-enabled').prop('checked');
             break;
         case 'macro':
             if ($('#editor-enabled').prop('checked'))
-                $('#profile-tree').treeview('checkNode', [$('#profile-tree').treeview('findNodes', ['^' + currentNode.id + '$', 'id']), { silent: true }]);
+                $('#profile-tree').treeview('checkNode', [findNodesById(currentNode.id), { silent: true }]);
             else
-                $('#profile-tree').treeview('uncheckNode', [$('#profile-tree').treeview('findNodes', ['^' + currentNode.id + '$', 'id']), { silent: true }]);
+                $('#profile-tree').treeview('uncheckNode', [findNodesById(currentNode.id), { silent: true }]);
             pushUndo({ action: 'update', type: t, item: currentNode.dataAttr.index, profile: currentProfile.name.toLowerCase(), data: { enabled: currentProfile.macros[currentNode.dataAttr.index].enabled } });
             currentProfile.macros[currentNode.dataAttr.index].enabled = $('#editor-enabled').prop('checked');
             break;
@@ -937,9 +1021,9 @@ export function UpdateEnabled() {
             const state = getState();
             if (state === 0) {
                 if ($('#editor-enabled').prop('checked'))
-                    $('#profile-tree').treeview('checkNode', [$('#profile-tree').treeview('findNodes', ['^' + currentNode.id + '$', 'id']), { silent: true }]);
+                    $('#profile-tree').treeview('checkNode', [findNodesById(currentNode.id), { silent: true }]);
                 else
-                    $('#profile-tree').treeview('uncheckNode', [$('#profile-tree').treeview('findNodes', ['^' + currentNode.id + '$', 'id']), { silent: true }]);
+                    $('#profile-tree').treeview('uncheckNode', [findNodesById(currentNode.id), { silent: true }]);
                 pushUndo({ action: 'update', type: t, item: currentNode.dataAttr.index, profile: currentProfile.name.toLowerCase(), data: { enabled: currentProfile.triggers[currentNode.dataAttr.index].enabled } });
                 currentProfile.triggers[currentNode.dataAttr.index].enabled = $('#editor-enabled').prop('checked');
             }
@@ -950,17 +1034,17 @@ export function UpdateEnabled() {
             break;
         case 'button':
             if ($('#editor-enabled').prop('checked'))
-                $('#profile-tree').treeview('checkNode', [$('#profile-tree').treeview('findNodes', ['^' + currentNode.id + '$', 'id']), { silent: true }]);
+                $('#profile-tree').treeview('checkNode', [findNodesById(currentNode.id), { silent: true }]);
             else
-                $('#profile-tree').treeview('uncheckNode', [$('#profile-tree').treeview('findNodes', ['^' + currentNode.id + '$', 'id']), { silent: true }]);
+                $('#profile-tree').treeview('uncheckNode', [findNodesById(currentNode.id), { silent: true }]);
             pushUndo({ action: 'update', type: t, item: currentNode.dataAttr.index, profile: currentProfile.name.toLowerCase(), data: { enabled: currentProfile.buttons[currentNode.dataAttr.index].enabled } });
             currentProfile.buttons[currentNode.dataAttr.index].enabled = $('#editor-enabled').prop('checked');
             break;
         case 'context':
             if ($('#editor-enabled').prop('checked'))
-                $('#profile-tree').treeview('checkNode', [$('#profile-tree').treeview('findNodes', ['^' + currentNode.id + '$', 'id']), { silent: true }]);
+                $('#profile-tree').treeview('checkNode', [findNodesById(currentNode.id), { silent: true }]);
             else
-                $('#profile-tree').treeview('uncheckNode', [$('#profile-tree').treeview('findNodes', ['^' + currentNode.id + '$', 'id']), { silent: true }]);
+                $('#profile-tree').treeview('uncheckNode', [findNodesById(currentNode.id), { silent: true }]);
             pushUndo({ action: 'update', type: t, item: currentNode.dataAttr.index, profile: currentProfile.name.toLowerCase(), data: { enabled: currentProfile.contexts[currentNode.dataAttr.index].enabled } });
             currentProfile.contexts[currentNode.dataAttr.index].enabled = $('#editor-enabled').prop('checked');
             break;
@@ -972,7 +1056,7 @@ function UpdateItemNode(item, updateNode?, old?) {
     if (!updateNode)
         updateNode = currentNode;
     else if (typeof updateNode === 'string')
-        updateNode = $('#profile-tree').treeview('findNodes', ['^' + updateNode + '$', 'id'])[0];
+        updateNode = findNodesById(updateNode)[0];
     const selected = updateNode.state.selected || updateNode.id === currentNode.id;
     const key = getKey(updateNode.dataAttr.type);
     //clone node
@@ -989,14 +1073,14 @@ function UpdateItemNode(item, updateNode?, old?) {
     let n;
     if (newNode.dataAttr.type === 'context') {
         if (item.parent && item.parent.length > 0 && item.parent !== item.name) {
-            updateNode = $('#profile-tree').treeview('findNodes', ['^' + updateNode.id + '$', 'id'])[0];
+            updateNode = findNodesById(updateNode.id)[0];
             //remove node
             $('#profile-tree').treeview('removeNode', [updateNode, { silent: true }]);
             //find parent node
             n = $('#profile-tree').treeview('findNodes', ['^' + item.parent + '$', 'dataAttr.name']);
             //no parent use root
             if (!n.length) {
-                n = $('#profile-tree').treeview('findNodes', ['^Profile' + newNode.dataAttr.profile + key + '$', 'id']);
+                n = findNodesById('Profile' + newNode.dataAttr.profile + key);
                 $('#profile-tree').treeview('addNode', [cleanNode(newNode), n, false, { silent: true }]);
             }
             else {
@@ -1006,8 +1090,8 @@ function UpdateItemNode(item, updateNode?, old?) {
         }
         if (item.name !== old.name && item.name && item.name.length > 0) {
             //move old children to root
-            const root = $('#profile-tree').treeview('findNodes', ['^Profile' + newNode.dataAttr.profile + key + '$', 'id']);
-            updateNode = $('#profile-tree').treeview('findNodes', ['^' + updateNode.id + '$', 'id'])[0];
+            const root = findNodesById('Profile' + newNode.dataAttr.profile + key);
+            updateNode = findNodesById(updateNode.id)[0];
             let mn;
             if (old.name && old.name.length > 0) {
                 n = $('#profile-tree').treeview('findNodes', ['^' + old.name + '$', 'dataAttr.parent']);
@@ -1021,7 +1105,7 @@ function UpdateItemNode(item, updateNode?, old?) {
                 newNode = clone(updateNode);
                 delete newNode.nodes;
                 $('#profile-tree').treeview('updateNode', [updateNode, cleanNode(newNode)]);
-                updateNode = $('#profile-tree').treeview('findNodes', ['^' + updateNode.id + '$', 'id'])[0];
+                updateNode = findNodesById(updateNode.id)[0];
             }
             n = $('#profile-tree').treeview('findNodes', ['^' + item.name + '$', 'dataAttr.parent']);
             mn = [];
@@ -1035,7 +1119,7 @@ function UpdateItemNode(item, updateNode?, old?) {
         }
     }
     if (selected) {
-        updateNode = $('#profile-tree').treeview('findNodes', ['^' + updateNode.id + '$', 'id'])[0];
+        updateNode = findNodesById(updateNode.id)[0];
         $('#profile-tree').treeview('selectNode', [updateNode, { silent: true }]);
         if (updateNode.id === currentNode.id)
             currentNode = updateNode;
@@ -1277,7 +1361,7 @@ function UpdateProfileNode(profile?) {
     if (currentProfile.name === profile.name)
         $('#editor-title').text('Profile: ' + profile.name);
     const val = profile.name;
-    let node = $('#profile-tree').treeview('findNodes', ['^Profile' + profileID(val) + '$', 'id'])[0];
+    let node = findNodesById('Profile' + profileID(val))[0];
     const selected = node.state.selected;
     const expanded = node.state.expanded;
     const newNode = newProfileNode(profile);
@@ -1299,7 +1383,7 @@ function UpdateProfileNode(profile?) {
     }
     $('#profile-tree').treeview('updateNode', [node, newNode]);
     //re-select node to get the new object for proper data
-    node = $('#profile-tree').treeview('findNodes', ['^' + newNode.id + '$', 'id'])[0];
+    node = findNodesById(newNode.id)[0];
     //if was selected re-select
     if (selected) {
         $('#profile-tree').treeview('selectNode', [node, { silent: true }]);
@@ -1344,12 +1428,12 @@ function sortNodeChildren(node) {
     if (!node)
         return;
     else if (typeof node === 'string')
-        node = $('#profile-tree').treeview('findNodes', ['^' + node + '$', 'id'])[0];
+        node = findNodesById(node)[0];
     const newNode = cloneNode(node);
     newNode.nodes = newNode.nodes.sort(sortNodes);
     $('#profile-tree').treeview('updateNode', [node, newNode]);
     if (currentNode)
-        currentNode = $('#profile-tree').treeview('findNodes', ['^' + currentNode.id + '$', 'id'])[0];
+        currentNode = findNodesById(currentNode.id)[0];
 }
 
 function newItemNode(item, idx?: number, type?: string, profile?, p?: string) {
@@ -1554,14 +1638,14 @@ function UpdateProfile(customUndo?: boolean): UpdateState {
             _enabled = _enabled.filter((a) => { return a !== currentProfile.name.toLowerCase(); });
             _enabled.push(val.toLowerCase());
         }
-        let node = $('#profile-tree').treeview('findNodes', ['^Profile' + profileID(currentProfile.name) + '$', 'id'])[0];
+        let node = findNodesById('Profile' + profileID(currentProfile.name))[0];
         currentProfile.name = val;
         profiles.add(currentProfile);
         $('#editor-title').text('Profile: ' + currentProfile.name);
         $('#profile-tree').treeview('updateNode', [node, newProfileNode()]);
         if (type !== 'profile') {
-            const parent = $('#profile-tree').treeview('findNodes', ['^Profile' + profileID(val) + '$', 'id'])[0];
-            node = $('#profile-tree').treeview('findNodes', ['^Profile' + profileID(val) + type + '$', 'id']);
+            const parent = findNodesById('Profile' + profileID(val))[0];
+            node = findNodesById('Profile' + profileID(val) + type);
             if (expanded || selected)
                 $('#profile-tree').treeview('expandNode', [parent]);
             if (expanded)
@@ -1572,7 +1656,7 @@ function UpdateProfile(customUndo?: boolean): UpdateState {
             }
         }
         else {
-            node = $('#profile-tree').treeview('findNodes', ['^Profile' + profileID(val) + '$', 'id'])[0];
+            node = findNodesById('Profile' + profileID(val))[0];
             if (selected) {
                 $('#profile-tree').treeview('selectNode', [node, { silent: true }]);
                 currentNode = node;
@@ -1583,11 +1667,11 @@ function UpdateProfile(customUndo?: boolean): UpdateState {
         p = sortTree();
     }
     else if (changed) {
-        let node = $('#profile-tree').treeview('findNodes', ['^Profile' + profileID(val) + '$', 'id'])[0];
+        let node = findNodesById('Profile' + profileID(val))[0];
         $('#profile-tree').treeview('updateNode', [node, newProfileNode()]);
         if (type !== 'profile') {
-            const parent = $('#profile-tree').treeview('findNodes', ['^Profile' + profileID(val) + '$', 'id'])[0];
-            node = $('#profile-tree').treeview('findNodes', ['^Profile' + profileID(val) + type + '$', 'id']);
+            const parent = findNodesById('Profile' + profileID(val))[0];
+            node = findNodesById('Profile' + profileID(val) + type);
             if (expanded || selected)
                 $('#profile-tree').treeview('expandNode', [parent]);
             if (expanded)
@@ -1598,7 +1682,7 @@ function UpdateProfile(customUndo?: boolean): UpdateState {
             }
         }
         else {
-            node = $('#profile-tree').treeview('findNodes', ['^Profile' + profileID(val) + '$', 'id'])[0];
+            node = findNodesById('Profile' + profileID(val))[0];
             if (selected) {
                 $('#profile-tree').treeview('selectNode', [node, { silent: true }]);
                 currentNode = node;
@@ -1646,18 +1730,18 @@ function UpdateProfile(customUndo?: boolean): UpdateState {
             data.enabled = e;
             _enabled.push(currentProfile.name.toLowerCase());
             changed++;
-            $('#profile-tree').treeview('checkNode', [$('#profile-tree').treeview('findNodes', ['^' + currentNode.id + '$', 'id'])]);
+            $('#profile-tree').treeview('checkNode', [findNodesById(currentNode.id)]);
         }
         else {
             _enabled = _enabled.filter((a) => { return a !== currentProfile.name.toLowerCase(); });
             if (_enabled.length === 0) {
                 _enabled.push(currentProfile.name.toLowerCase());
                 $('#editor-enabled').prop('checked', true);
-                $('#profile-tree').treeview('checkNode', [$('#profile-tree').treeview('findNodes', ['^' + currentNode.id + '$', 'id'])]);
+                $('#profile-tree').treeview('checkNode', [findNodesById(currentNode.id)]);
             }
             else {
                 data.enabled = e;
-                $('#profile-tree').treeview('uncheckNode', [$('#profile-tree').treeview('findNodes', ['^' + currentNode.id + '$', 'id'])]);
+                $('#profile-tree').treeview('uncheckNode', [findNodesById(currentNode.id)]);
                 changed++;
             }
         }
@@ -1666,48 +1750,48 @@ function UpdateProfile(customUndo?: boolean): UpdateState {
         p.then(() => {
             val = profileID(currentProfile.name);
             if (currentProfile.enableAliases)
-                $('#profile-tree').treeview('checkNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + val + 'aliases$', 'id'])]);
+                $('#profile-tree').treeview('checkNode', [findNodesById('Profile' + val + 'aliases')]);
             else
-                $('#profile-tree').treeview('uncheckNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + val + 'aliases$', 'id'])]);
+                $('#profile-tree').treeview('uncheckNode', [findNodesById('Profile' + val + 'aliases')]);
             if (currentProfile.enableMacros)
-                $('#profile-tree').treeview('checkNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + val + 'macros$', 'id'])]);
+                $('#profile-tree').treeview('checkNode', [findNodesById('Profile' + val + 'macros')]);
             else
-                $('#profile-tree').treeview('uncheckNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + val + 'macros$', 'id'])]);
+                $('#profile-tree').treeview('uncheckNode', [findNodesById('Profile' + val + 'macros')]);
             if (currentProfile.enableTriggers)
-                $('#profile-tree').treeview('checkNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + val + 'triggers$', 'id'])]);
+                $('#profile-tree').treeview('checkNode', [findNodesById('Profile' + val + 'triggers')]);
             else
-                $('#profile-tree').treeview('uncheckNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + val + 'triggers$', 'id'])]);
+                $('#profile-tree').treeview('uncheckNode', [findNodesById('Profile' + val + 'triggers')]);
             if (currentProfile.enableButtons)
-                $('#profile-tree').treeview('checkNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + val + 'buttons$', 'id'])]);
+                $('#profile-tree').treeview('checkNode', [findNodesById('Profile' + val + 'buttons')]);
             else
-                $('#profile-tree').treeview('uncheckNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + val + 'buttons$', 'id'])]);
+                $('#profile-tree').treeview('uncheckNode', [findNodesById('Profile' + val + 'buttons')]);
             if (currentProfile.enableContexts)
-                $('#profile-tree').treeview('checkNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + val + 'contexts$', 'id'])]);
+                $('#profile-tree').treeview('checkNode', [findNodesById('Profile' + val + 'contexts')]);
             else
-                $('#profile-tree').treeview('uncheckNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + val + 'contexts$', 'id'])]);
+                $('#profile-tree').treeview('uncheckNode', [findNodesById('Profile' + val + 'contexts')]);
         });
     else {
         val = profileID(currentProfile.name);
         if (currentProfile.enableAliases)
-            $('#profile-tree').treeview('checkNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + val + 'aliases$', 'id'])]);
+            $('#profile-tree').treeview('checkNode', [findNodesById('Profile' + val + 'aliases')]);
         else
-            $('#profile-tree').treeview('uncheckNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + val + 'aliases$', 'id'])]);
+            $('#profile-tree').treeview('uncheckNode', [findNodesById('Profile' + val + 'aliases')]);
         if (currentProfile.enableMacros)
-            $('#profile-tree').treeview('checkNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + val + 'macros$', 'id'])]);
+            $('#profile-tree').treeview('checkNode', [findNodesById('Profile' + val + 'macros')]);
         else
-            $('#profile-tree').treeview('uncheckNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + val + 'macros$', 'id'])]);
+            $('#profile-tree').treeview('uncheckNode', [findNodesById('Profile' + val + 'macros')]);
         if (currentProfile.enableTriggers)
-            $('#profile-tree').treeview('checkNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + val + 'triggers$', 'id'])]);
+            $('#profile-tree').treeview('checkNode', [findNodesById('Profile' + val + 'triggers')]);
         else
-            $('#profile-tree').treeview('uncheckNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + val + 'triggers$', 'id'])]);
+            $('#profile-tree').treeview('uncheckNode', [findNodesById('Profile' + val + 'triggers')]);
         if (currentProfile.enableButtons)
-            $('#profile-tree').treeview('checkNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + val + 'buttons$', 'id'])]);
+            $('#profile-tree').treeview('checkNode', [findNodesById('Profile' + val + 'buttons')]);
         else
-            $('#profile-tree').treeview('uncheckNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + val + 'buttons$', 'id'])]);
+            $('#profile-tree').treeview('uncheckNode', [findNodesById('Profile' + val + 'buttons')]);
         if (currentProfile.enableContexts)
-            $('#profile-tree').treeview('checkNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + val + 'contexts$', 'id'])]);
+            $('#profile-tree').treeview('checkNode', [findNodesById('Profile' + val + 'contexts')]);
         else
-            $('#profile-tree').treeview('uncheckNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + val + 'contexts$', 'id'])]);
+            $('#profile-tree').treeview('uncheckNode', [findNodesById('Profile' + val + 'contexts')]);
     }
     if (changed > 0 && !customUndo) {
         pushUndo({ action: 'update', type: 'profile', profile: currentProfile.name.toLowerCase(), data: data });
@@ -1721,25 +1805,25 @@ export function updateProfileChecks() {
     const val = profileID(currentProfile.name);
 
     if ($('#profile-enableAliases').prop('checked'))
-        $('#profile-tree').treeview('checkNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + val + 'aliases$', 'id']), { silent: true }]);
+        $('#profile-tree').treeview('checkNode', [findNodesById('Profile' + val + 'aliases'), { silent: true }]);
     else
-        $('#profile-tree').treeview('uncheckNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + val + 'aliases$', 'id']), { silent: true }]);
+        $('#profile-tree').treeview('uncheckNode', [findNodesById('Profile' + val + 'aliases'), { silent: true }]);
     if ($('#profile-enableMacros').prop('checked'))
-        $('#profile-tree').treeview('checkNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + val + 'macros$', 'id']), { silent: true }]);
+        $('#profile-tree').treeview('checkNode', [findNodesById('Profile' + val + 'macros'), { silent: true }]);
     else
-        $('#profile-tree').treeview('uncheckNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + val + 'macros$', 'id']), { silent: true }]);
+        $('#profile-tree').treeview('uncheckNode', [findNodesById('Profile' + val + 'macros'), { silent: true }]);
     if ($('#profile-enableTriggers').prop('checked'))
-        $('#profile-tree').treeview('checkNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + val + 'triggers$', 'id']), { silent: true }]);
+        $('#profile-tree').treeview('checkNode', [findNodesById('Profile' + val + 'triggers'), { silent: true }]);
     else
-        $('#profile-tree').treeview('uncheckNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + val + 'triggers$', 'id']), { silent: true }]);
+        $('#profile-tree').treeview('uncheckNode', [findNodesById('Profile' + val + 'triggers'), { silent: true }]);
     if ($('#profile-enableButtons').prop('checked'))
-        $('#profile-tree').treeview('checkNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + val + 'buttons$', 'id']), { silent: true }]);
+        $('#profile-tree').treeview('checkNode', [findNodesById('Profile' + val + 'buttons'), { silent: true }]);
     else
-        $('#profile-tree').treeview('uncheckNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + val + 'buttons$', 'id']), { silent: true }]);
+        $('#profile-tree').treeview('uncheckNode', [findNodesById('Profile' + val + 'buttons'), { silent: true }]);
     if ($('#profile-enableContexts').prop('checked'))
-        $('#profile-tree').treeview('checkNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + val + 'contexts$', 'id']), { silent: true }]);
+        $('#profile-tree').treeview('checkNode', [findNodesById('Profile' + val + 'contexts'), { silent: true }]);
     else
-        $('#profile-tree').treeview('uncheckNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + val + 'contexts$', 'id']), { silent: true }]);
+        $('#profile-tree').treeview('uncheckNode', [findNodesById('Profile' + val + 'contexts'), { silent: true }]);
 
     _pUndo = false;
 }
@@ -1761,7 +1845,7 @@ function nodeCheckChanged(event, node) {
                 _enabled = _enabled.filter((a) => { return a !== node.dataAttr.profile; });
                 if (_enabled.length === 0) {
                     _enabled.push(node.dataAttr.profile);
-                    $('#profile-tree').treeview('checkNode', [$('#profile-tree').treeview('findNodes', ['^' + node.id + '$', 'id']), { silent: true }]);
+                    $('#profile-tree').treeview('checkNode', [findNodesById(node.id), { silent: true }]);
                     changed = 0;
                 }
                 else {
@@ -1929,7 +2013,7 @@ export function doUndo() {
 
     _pUndo = true;
     if (currentNode.id !== action.data) {
-        const s = $('#profile-tree').treeview('findNodes', ['^' + action.node + '$', 'id']);
+        const s = findNodesById(action.node);
         if (s.length > 0)
             $('#profile-tree').treeview('selectNode', s);
     }
@@ -2107,13 +2191,13 @@ export function doUndo() {
             const id = profileID(action.profile.name);
             const oldProfile = profiles.items[name];
             profiles.items[name] = action.profile;
-            let node = $('#profile-tree').treeview('findNodes', ['^Profile' + profileID(id) + '$', 'id'])[0];
+            let node = findNodesById('Profile' + profileID(id))[0];
             const newNode = newProfileNode(action.profile);
             const selected = node.state.selected;
             const expanded = node.state.expanded;
             $('#profile-tree').treeview('updateNode', [node, newNode]);
             //re-select node to get the new object for proper data
-            node = $('#profile-tree').treeview('findNodes', ['^' + newNode.id + '$', 'id'])[0];
+            node = findNodesById(newNode.id)[0];
             //if was selected re-select
             if (selected) {
                 $('#profile-tree').treeview('selectNode', [node, { silent: true }]);
@@ -2128,6 +2212,7 @@ export function doUndo() {
     _redo.push(action);
     updateUndoState();
     _pUndo = false;
+    events.emit('profile-changed', undoProfile(action));
 }
 
 export function doRedo() {
@@ -2137,7 +2222,7 @@ export function doRedo() {
 
     _pUndo = true;
     if (currentNode.id !== action.data) {
-        const s = $('#profile-tree').treeview('findNodes', ['^' + action.node + '$', 'id']);
+        const s = findNodesById(action.node);
         if (s.length > 0)
             $('#profile-tree').treeview('selectNode', s);
     }
@@ -2289,13 +2374,13 @@ export function doRedo() {
             const id = profileID(action.profile.name);
             const oldProfile = profiles.items[name];
             profiles.items[name] = action.profile;
-            let node = $('#profile-tree').treeview('findNodes', ['^Profile' + profileID(id) + '$', 'id'])[0];
+            let node = findNodesById('Profile' + profileID(id))[0];
             const newNode = newProfileNode(action.profile);
             const selected = node.state.selected;
             const expanded = node.state.expanded;
             $('#profile-tree').treeview('updateNode', [node, newNode]);
             //re-select node to get the new object for proper data
-            node = $('#profile-tree').treeview('findNodes', ['^' + newNode.id + '$', 'id'])[0];
+            node = findNodesById(newNode.id)[0];
             //if was selected re-select
             if (selected) {
                 $('#profile-tree').treeview('selectNode', [node, { silent: true }]);
@@ -2310,6 +2395,7 @@ export function doRedo() {
     _undo.push(action);
     updateUndoState();
     _pUndo = false;
+    events.emit('profile-changed', undoProfile(action));
 }
 
 export function doCut(node?) {
@@ -2740,10 +2826,11 @@ function buildTreeview(data, skipInit?) {
             },
             data: data,
             onInitialized: (event, nodes) => {
+                _nodeIndex = null;
                 if (!skipInit && !currentNode) {
                     if (!profiles.contains(_profileLoadSelect))
                         _profileLoadSelect = 'default';
-                    const n = $('#profile-tree').treeview('findNodes', ['^Profile' + profileID(_profileLoadSelect) + '$', 'id']);
+                    const n = findNodesById('Profile' + profileID(_profileLoadSelect));
                     if (_profileLoadExpand)
                         $('#profile-tree').treeview('expandNode', [n]);
                     $('#profile-tree').treeview('selectNode', [n]);
@@ -3507,7 +3594,7 @@ export function init() {
     });
     $('#profile-tree').on('dblclick', (event: JQueryEventObject) => {
         if (!event.target || event.target.nodeName !== 'LI' || !event.target.classList.contains('list-group-item')) return;
-        let n = $('#profile-tree').treeview('findNodes', ['^' + event.target.id + '$', 'id']);
+        let n = findNodesById(event.target.id);
         $('#profile-tree').treeview('toggleNodeExpanded', [n, { levels: 1, silent: false }]);
     });
     if (window.opener) {
@@ -3612,7 +3699,7 @@ export function sortTree(s?: boolean) {
 
     for (profile in profiles.items) {
         if (!profiles.items.hasOwnProperty(profile)) continue;
-        n = $('#profile-tree').treeview('findNodes', ['^Profile' + profileID(profile) + '$', 'id']);
+        n = findNodesById('Profile' + profileID(profile));
         n = cleanNode(n[0]);
         if (s) {
             cl = n.nodes.length;
@@ -3626,7 +3713,7 @@ export function sortTree(s?: boolean) {
     }
     data.sort(sortProfileNodes);
     /*
-    n = $('#profile-tree').treeview('findNodes', ['^Profiledefault$', 'id']);
+    n = findNodesById('Profiledefault');
     if (n.length > 0) {
         n = cleanNode(n[0]);
         if (s) {
@@ -3779,9 +3866,7 @@ function importProfiles() {
                                         if (p.enabled)
                                             _enabled.push(p.name.toLowerCase());
                                         names.push(p.clone());
-                                        const nodes = $('#profile-tree').treeview('findNodes', ['^Profile' + profileID(p.name) + '$', 'id']);
-                                        $('#profile-tree').treeview('removeNode', [nodes, { silent: true }]);
-                                        $('#profile-tree').treeview('addNode', [newProfileNode(p), false, false]);
+                                        queueProfileNode(p, true);
                                     }
                                     else if (all === 5) {
                                         n = profileCopyName(p.name);
@@ -3791,7 +3876,7 @@ function importProfiles() {
                                             _enabled.push(p.name.toLowerCase());
                                         profiles.add(p);
                                         names.push(p.clone());
-                                        $('#profile-tree').treeview('addNode', [newProfileNode(p), false, false]);
+                                        queueProfileNode(p);
                                     }
                                     else if (all !== 4) {
                                         const response = dialog.showMessageBoxSync({
@@ -3810,9 +3895,7 @@ function importProfiles() {
                                                 _enabled.push(p.name.toLowerCase());
 
                                             names.push(p.clone());
-                                            const nodes = $('#profile-tree').treeview('findNodes', ['^Profile' + profileID(p.name) + '$', 'id']);
-                                            $('#profile-tree').treeview('removeNode', [nodes, { silent: true }]);
-                                            $('#profile-tree').treeview('addNode', [newProfileNode(p), false, false]);
+                                            queueProfileNode(p, true);
                                         }
                                         else if (response === 2) {
                                             n = profileCopyName(p.name);
@@ -3822,7 +3905,7 @@ function importProfiles() {
                                             if (p.enabled)
                                                 _enabled.push(p.name.toLowerCase());
                                             names.push(p.clone());
-                                            $('#profile-tree').treeview('addNode', [newProfileNode(p), false, false]);
+                                            queueProfileNode(p);
                                         }
                                         else if (response > 2)
                                             all = response;
@@ -3831,7 +3914,7 @@ function importProfiles() {
                                 else {
                                     names.push(p.clone());
                                     profiles.add(p);
-                                    $('#profile-tree').treeview('addNode', [newProfileNode(p), false, false]);
+                                    queueProfileNode(p);
                                 }
                             });
                         });
@@ -3840,7 +3923,7 @@ function importProfiles() {
                             throw err2;
                         })
                         .once('close', () => {
-
+                            flushTree();
                         });
                 });
             }
@@ -3947,9 +4030,7 @@ function importProfiles() {
                                     if (p.enabled)
                                         _enabled.push(p.name.toLowerCase());
                                     names.push(p.clone());
-                                    const nodes = $('#profile-tree').treeview('findNodes', ['^Profile' + profileID(p.name) + '$', 'id']);
-                                    $('#profile-tree').treeview('removeNode', [nodes, { silent: true }]);
-                                    $('#profile-tree').treeview('addNode', [newProfileNode(p), false, false]);
+                                    queueProfileNode(p, true);
                                 }
                                 else if (all === 5) {
                                     n = profileCopyName(p.name);
@@ -3959,7 +4040,7 @@ function importProfiles() {
                                         _enabled.push(p.name.toLowerCase());
                                     profiles.add(p);
                                     names.push(p.clone());
-                                    $('#profile-tree').treeview('addNode', [newProfileNode(p), false, false]);
+                                    queueProfileNode(p);
                                 }
                                 else if (all !== 4) {
                                     const response = dialog.showMessageBoxSync({
@@ -3978,9 +4059,7 @@ function importProfiles() {
                                             _enabled.push(p.name.toLowerCase());
 
                                         names.push(p.clone());
-                                        const nodes = $('#profile-tree').treeview('findNodes', ['^Profile' + profileID(p.name) + '$', 'id']);
-                                        $('#profile-tree').treeview('removeNode', [nodes, { silent: true }]);
-                                        $('#profile-tree').treeview('addNode', [newProfileNode(p), false, false]);
+                                        queueProfileNode(p, true);
                                     }
                                     else if (response === 2) {
                                         n = profileCopyName(p.name);
@@ -3990,7 +4069,7 @@ function importProfiles() {
                                         if (p.enabled)
                                             _enabled.push(p.name.toLowerCase());
                                         names.push(p.clone());
-                                        $('#profile-tree').treeview('addNode', [newProfileNode(p), false, false]);
+                                        queueProfileNode(p);
                                     }
                                     else if (response > 2)
                                         all = response;
@@ -3999,10 +4078,11 @@ function importProfiles() {
                             else {
                                 names.push(p.clone());
                                 profiles.add(p);
-                                $('#profile-tree').treeview('addNode', [newProfileNode(p), false, false]);
+                                queueProfileNode(p);
                             }
                         }
                     }
+                    flushTree();
                     updateProgress({ value: -1, mode: 'normal' });
                 });
         }
@@ -4332,6 +4412,7 @@ function resetUndo() {
     _undo = [];
     _redo = [];
     updateUndoState();
+    events.emit('profile-changed');
 }
 
 function pushUndo(data) {
@@ -4340,6 +4421,15 @@ function pushUndo(data) {
     _undo.push(data);
     _redo = [];
     updateUndoState();
+    events.emit('profile-changed', undoProfile(data));
+}
+
+function undoProfile(action) {
+    if (action.profile)
+        return action.profile;
+    if (action.data && typeof action.data.profile === 'string')
+        return action.data.profile;
+    return null;
 }
 
 function updateUndoState() {
@@ -4367,19 +4457,19 @@ function DeleteProfile(profile, customUndo?: boolean) {
     _remove.push({ name: profile.name, file: profile.file || profile.name });
     if (!customUndo)
         pushUndo({ action: 'delete', type: 'profile', item: profile });
-    const nodes = $('#profile-tree').treeview('findNodes', ['^Profile' + profileID(profile.name) + '$', 'id']);
+    const nodes = findNodesById('Profile' + profileID(profile.name));
     $('#profile-tree').treeview('removeNode', [nodes, { silent: false }]);
     if (profile.name === currentProfile.name) {
         if (profile.name.toLowerCase() === 'default') {
             const ll = profiles.keys.length;
             for (let l = 0; l < ll; l++) {
                 if (profiles.keys[l] === 'default') continue;
-                $('#profile-tree').treeview('selectNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + profiles.keys[l] + '$', 'id'])]);
+                $('#profile-tree').treeview('selectNode', [findNodesById('Profile' + profiles.keys[l])]);
                 break;
             }
         }
         else
-            $('#profile-tree').treeview('selectNode', [$('#profile-tree').treeview('findNodes', ['^Profiledefault$', 'id'])]);
+            $('#profile-tree').treeview('selectNode', [findNodesById('Profiledefault')]);
     }
     profiles.remove(profile);
     _enabled = _enabled.filter((a) => { return a !== profile.name.toLowerCase(); });
@@ -4457,7 +4547,7 @@ function DeleteItem(type: string, key: string, idx: number, profile?: Profile, c
             }
         }
         if (selected) {
-            const n = $('#profile-tree').treeview('findNodes', ['^' + selected + '$', 'id'])[0];
+            const n = findNodesById(selected)[0];
             currentNode = n[0];
             $('#profile-tree').treeview('selectNode', [n]);
             //selectItem(n);
@@ -4465,7 +4555,7 @@ function DeleteItem(type: string, key: string, idx: number, profile?: Profile, c
         else if (wasSelected && profile[key].length > 0) {
             if (idx > 0)
                 idx--;
-            const n = $('#profile-tree').treeview('findNodes', ['^Profile' + name + key + idx + '$', 'id']);
+            const n = findNodesById('Profile' + name + key + idx);
             if (n.length > 0) {
                 currentNode = n[0][0];
                 $('#profile-tree').treeview('selectNode', n);
@@ -4552,7 +4642,7 @@ export function doReset(node) {
                     checked: profile.enableAliases
                 }
             };
-            o = $('#profile-tree').treeview('findNodes', ['^Profile' + profileID(profile.name) + 'aliases$', 'id']);
+            o = findNodesById('Profile' + profileID(profile.name) + 'aliases');
             $('#profile-tree').treeview('updateNode', [o[0], n]);
             n = {
                 text: 'Macros',
@@ -4566,7 +4656,7 @@ export function doReset(node) {
                     checked: profile.enableMacros
                 }
             };
-            o = $('#profile-tree').treeview('findNodes', ['^Profile' + profileID(profile.name) + 'macros$', 'id']);
+            o = findNodesById('Profile' + profileID(profile.name) + 'macros');
             $('#profile-tree').treeview('updateNode', [o[0], n]);
 
             n = {
@@ -4581,7 +4671,7 @@ export function doReset(node) {
                     checked: profile.enableTriggers
                 }
             };
-            o = $('#profile-tree').treeview('findNodes', ['^Profile' + profileID(profile.name) + 'triggers$', 'id']);
+            o = findNodesById('Profile' + profileID(profile.name) + 'triggers');
             $('#profile-tree').treeview('updateNode', [o[0], n]);
             n = {
                 text: 'Buttons',
@@ -4595,7 +4685,7 @@ export function doReset(node) {
                     checked: profile.enableButtons
                 }
             };
-            o = $('#profile-tree').treeview('findNodes', ['^Profile' + profileID(profile.name) + 'buttons$', 'id']);
+            o = findNodesById('Profile' + profileID(profile.name) + 'buttons');
             $('#profile-tree').treeview('updateNode', [o[0], n]);
 
             n = {
@@ -4610,7 +4700,7 @@ export function doReset(node) {
                     checked: profile.enableContexts
                 }
             };
-            o = $('#profile-tree').treeview('findNodes', ['^Profile' + profileID(profile.name) + 'contexts$', 'id']);
+            o = findNodesById('Profile' + profileID(profile.name) + 'contexts');
             $('#profile-tree').treeview('updateNode', [o[0], n]);
 
             profile.aliases = [];
@@ -4638,12 +4728,12 @@ export function doReset(node) {
                 $('#editor-enabled').prop('checked', true);
                 $('#profile-priority').val(currentProfile.priority);
             }
-            $('#profile-tree').treeview('checkNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + profileID(profile.name) + 'macros$', 'id'])]);
-            $('#profile-tree').treeview('checkNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + profileID(profile.name) + 'aliases$', 'id'])]);
-            $('#profile-tree').treeview('checkNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + profileID(profile.name) + 'triggers$', 'id'])]);
-            $('#profile-tree').treeview('checkNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + profileID(profile.name) + 'buttons$', 'id'])]);
-            $('#profile-tree').treeview('checkNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + profileID(profile.name) + 'contexts$', 'id'])]);
-            $('#profile-tree').treeview('checkNode', [$('#profile-tree').treeview('findNodes', ['^Profile' + profileID(profile.name) + '$', 'id'])]);
+            $('#profile-tree').treeview('checkNode', [findNodesById('Profile' + profileID(profile.name) + 'macros')]);
+            $('#profile-tree').treeview('checkNode', [findNodesById('Profile' + profileID(profile.name) + 'aliases')]);
+            $('#profile-tree').treeview('checkNode', [findNodesById('Profile' + profileID(profile.name) + 'triggers')]);
+            $('#profile-tree').treeview('checkNode', [findNodesById('Profile' + profileID(profile.name) + 'buttons')]);
+            $('#profile-tree').treeview('checkNode', [findNodesById('Profile' + profileID(profile.name) + 'contexts')]);
+            $('#profile-tree').treeview('checkNode', [findNodesById('Profile' + profileID(profile.name))]);
 
         }
     });
@@ -4720,7 +4810,7 @@ function insertItem(type: string, key: string, item, idx: number, profile?: Prof
     currentNode = null;
     type = type.toLowerCase();
     //fine parent node
-    const n = $('#profile-tree').treeview('findNodes', ['^Profile' + profileID(profile.name) + key + '$', 'id']);
+    const n = findNodesById('Profile' + profileID(profile.name) + key);
     $('#profile-tree').treeview('expandNode', [n, { levels: 1, silent: false }]);
     //create new node to be inserted
     const nodes = [newItemNode(item, idx, type, profile)];
@@ -4731,7 +4821,7 @@ function insertItem(type: string, key: string, item, idx: number, profile?: Prof
     //loop current nodes to grab data and update indexes
     for (let i = idx; i < il; i++) {
         //Find old node
-        node = $('#profile-tree').treeview('findNodes', ['^Profile' + profileID(profile.name) + key + i + '$', 'id'])[0];
+        node = findNodesById('Profile' + profileID(profile.name) + key + i)[0];
         //Push to remove it
         remove.push(node);
         //clone it, will remove invalid node data
@@ -4760,9 +4850,9 @@ function insertItem(type: string, key: string, item, idx: number, profile?: Prof
 
 export function editItem(profile, type, index) {
     if (!profile || !profiles.items[profile.toLowerCase()]) return;
-    let n = $('#profile-tree').treeview('findNodes', ['^Profile' + profileID(profile) + type + '$', 'id']);
+    let n = findNodesById('Profile' + profileID(profile) + type);
     $('#profile-tree').treeview('expandNode', [n, { levels: 1, silent: false }]);
-    n = $('#profile-tree').treeview('findNodes', ['^Profile' + profileID(profile) + type + index + '$', 'id']);
+    n = findNodesById('Profile' + profileID(profile) + type + index);
     $('#profile-tree').treeview('selectNode', [n, { silent: false }]);
 };
 
@@ -4796,7 +4886,7 @@ function profileUpdated(profile, noChanges, type) {
 };
 
 function profileToggled(profile, enabled) {
-    const parent = $('#profile-tree').treeview('findNodes', ['^Profile' + profileID(profile) + '$', 'id']);
+    const parent = findNodesById('Profile' + profileID(profile));
     if (!parent) return;
     _enabled.filter((a) => { return a !== profile.toLowerCase(); });
     if (enabled)
@@ -4958,7 +5048,7 @@ export function validateIdentifiers(el: HTMLInputElement, focus?) {
 
 function selectItem(id) {
     //setTimeout(() => {
-    const n = $('#profile-tree').treeview('findNodes', ['^' + id + '$', 'id']);
+    const n = findNodesById(id);
     n[0].$el[0].scrollIntoView({ block: 'center' });
     //}, 1000);
 }
\ No newline at end of file
@@ -0,0 +1,196 @@
+/**
+ * Scrollback store
+ *
+ * Page old display lines out in blocks to a temporary database that sqlite keeps on disk and
+ * removes when closed, lines left in the display are light weight stand ins that read their
+ * block back in when used
+ *
+ * @author William
+ */
+//spell-checker:words pragma
+const sqlite3 = require('better-sqlite3');
+
+//lines written per block
+export const SCROLLBACK_BLOCK_SIZE = 500;
+//blocks kept in memory once read back in
+const CACHE_SIZE = 8;
+
+interface ScrollbackBlock {
+    lines: any[];           //[text, raw, formats] for each line
+    dirty: boolean;         //changed since read and needs writing back
+}
+
+/**
+ * A line that has been paged out, text, raw and formats are read from the store when accessed
+ */
+export class ScrollbackLine {
+    public id: number;
+    public timestamp: number;
+    private _store: Scrollback;
+    private _block: number;
+    private _index: number;
+
+    constructor(store: Scrollback, block: number, index: number, id: number, timestamp: number) {
+        this._store = store;
+        this._block = block;
+        this._index = index;
+        this.id = id;
+        this.timestamp = timestamp;
+    }
+
+    get block(): number {
+        return this._block;
+    }
+
+    get text(): string {
+        return this._store.get(this._block, this._index)[0];
+    }
+
+    set text(value: string) {
+        this._store.set(this._block, this._index, 0, value);
+    }
+
+    get raw(): string {
+        return this._store.get(this._block, this._index)[1];
+    }
+
+    set raw(value: string) {
+        this._store.set(this._block, this._index, 1, value);
+    }
+
+    get formats(): any[] {
+        return this._store.get(this._block, this._index)[2];
+    }
+
+    set formats(value: any[]) {
+        this._store.set(this._block, this._index, 2, value);
+    }
+}
+
+export class Scrollback {
+    private _db = null;
+    private _next = 0;
+    private _insert;
+    private _select;
+    private _update;
+    private _delete;
+    //most recently used last
+    private _cache: Map<number, ScrollbackBlock> = new Map();
+    //lines of each block still in the display
+    private _counts: Map<number, number> = new Map();
+
+    get blocks(): number {
+        return this._counts.size;
+    }
+
+    private open() {
+        if (this._db) return;
+        //an empty name is a private temporary database, deleted by sqlite once closed
+        this._db = new sqlite3('');
+        //only a cache for this display, no need to survive a crash
+        this._db.pragma('journal_mode = OFF');
+        this._db.pragma('synchronous = OFF');
+        this._db.exec('CREATE TABLE IF NOT EXISTS Blocks (ID INTEGER PRIMARY KEY, Data TEXT)');
+        this._insert = this._db.prepare('INSERT INTO Blocks (ID, Data) VALUES (?, ?)');
+        this._select = this._db.prepare('SELECT Data FROM Blocks WHERE ID = ?');
+        this._update = this._db.prepare('UPDATE Blocks SET Data = ? WHERE ID = ?');
+        this._delete = this._db.prepare('DELETE FROM Blocks WHERE ID = ?');
+    }
+
+    /**
+     * Write lines to a new block and return stand ins for them
+     *
+     * @param lines The lines to page out
+     * @returns The lines to keep in the display in their place
+     */
+    public write(lines: any[]): ScrollbackLine[] {
+        this.open();
+        const block = this._next++;
+        const ll = lines.length;
+        const data = new Array(ll);
+        const stored = new Array(ll);
+        for (let l = 0; l < ll; l++) {
+            data[l] = [lines[l].text, lines[l].raw, lines[l].formats];
+            stored[l] = new ScrollbackLine(this, block, l, lines[l].id, lines[l].timestamp);
+        }
+        this._insert.run(block, JSON.stringify(data));
+        this._counts.set(block, ll);
+        return stored;
+    }
+
+    /**
+     * Get a paged out line as [text, raw, formats], reading its block in if needed
+     *
+     * @param block The block id
+     * @param index The line in the block
+     */
+    public get(block: number, index: number) {
+        let data = this._cache.get(block);
+        if (data) {
+            //move to most recently used
+            this._cache.delete(block);
+            this._cache.set(block, data);
+            return data.lines[index];
+        }
+        const row = this._db ? this._select.get(block) : null;
+        data = { lines: row ? JSON.parse(row.Data) : [], dirty: false };
+        this._cache.set(block, data);
+        if (this._cache.size > CACHE_SIZE)
+            this.evict(this._cache.keys().next().value);
+        return data.lines[index] || ['', '', []];
+    }
+
+    /**
+     * Change a field of a paged out line, the block is written back when it leaves the cache
+     *
+     * @param block The block id
+     * @param index The line in the block
+     * @param field 0 text, 1 raw, 2 formats
+     * @param value The new value
+     */
+    public set(block: number, index: number, field: number, value) {
+        const line = this.get(block, index);
+        line[field] = value;
+        this._cache.get(block).dirty = true;
+    }
+
+    /**
+     * Let the store know lines of a block were removed from the display, the block is deleted once
+     * none of its lines are left
+     *
+     * @param block The block id
+     * @param count The number of lines removed
+     */
+    public release(block: number, count?: number) {
+        if (!this._counts.has(block)) return;
+        const remaining = this._counts.get(block) - (count || 1);
+        if (remaining > 0) {
+            this._counts.set(block, remaining);
+            return;
+        }
+        this._counts.delete(block);
+        this._cache.delete(block);
+        this._delete.run(block);
+    }
+
+    private evict(block: number) {
+        const data = this._cache.get(block);
+        this._cache.delete(block);
+        if (data && data.dirty && this._counts.has(block))
+            this._update.run(JSON.stringify(data.lines), block);
+    }
+
+    /**
+     * Remove all blocks and close the temporary database
+     */
+    public close() {
+        this._cache.clear();
+        this._counts.clear();
+        if (!this._db) return;
+        try {
+            this._db.close();
+        }
+        catch (err) { }
+        this._db = null;
+    }
+}
@@ -0,0 +1,527 @@
+/**
+ * Session host
+ *
+ * Utility process that owns the connections for clients when the session host is enabled and runs hidden
+ * clients with out a page. A hidden client only keeps its model, parser, triggers and connection so each
+ * idle character costs a fraction of a renderer, when shown again the session is handed back to a page.
+ *
+ * @author William
+ */
+//spell-checker:ignore nbsp
+import { Socket } from 'net';
+import { SessionMessage, SessionSocket, MCCPInflater } from './session.socket';
+import { Settings } from './settings';
+const path = require('path');
+
+const _global: any = globalThis;
+//global settings and values from main, kept current by main
+let _settings = null;
+let _globals = {};
+
+//#region Page shims
+//client code expects a page, these give it the parts a session can use with out one
+function decodeEntities(value: string): string {
+    return value.replace(/&(#x[0-9a-f]+|#[0-9]+|[a-z]+);/gi, (match, entity: string) => {
+        if (entity[0] === '#')
+            return String.fromCodePoint(entity[1] === 'x' || entity[1] === 'X' ? parseInt(entity.substring(2), 16) : parseInt(entity.substring(1), 10));
+        switch (entity.toLowerCase()) {
+            case 'amp': return '&';
+            case 'lt': return '<';
+            case 'gt': return '>';
+            case 'quot': return '"';
+            case 'apos': return '\'';
+            case 'nbsp': return ' ';
+        }
+        return match;
+    });
+}
+
+function createElement(tag?: string) {
+    let text = '';
+    return {
+        tagName: (tag || 'div').toUpperCase(),
+        style: {},
+        dataset: {},
+        children: [],
+        value: '',
+        wrap: 'off',
+        selectionStart: 0,
+        selectionEnd: 0,
+        get textContent() { return text; },
+        set textContent(value: string) { text = value == null ? '' : '' + value; },
+        get innerHTML() { return text.replace(/&/g, '&amp;').replace(/</g, '&lt;').replace(/>/g, '&gt;').replace(/ /g, '&nbsp;'); },
+        set innerHTML(value: string) { text = decodeEntities(value == null ? '' : '' + value); },
+        focus: () => { },
+        blur: () => { },
+        select: () => { },
+        appendChild: child => child,
+        addEventListener: () => { },
+        removeEventListener: () => { }
+    };
+}
+
+_global.window = _global;
+_global.addEventListener = () => { };
+_global.removeEventListener = () => { };
+_global.requestAnimationFrame = callback => setTimeout(() => callback(performance.now()), 16);
+_global.cancelAnimationFrame = handle => clearTimeout(handle);
+_global.location = { href: 'file:///', hostname: '', protocol: 'file:' };
+_global.document = {
+    documentElement: createElement('html'),
+    body: createElement('body'),
+    activeElement: null,
+    createElement: createElement,
+    getElementById: () => null,
+    addEventListener: () => { },
+    removeEventListener: () => { }
+};
+Object.defineProperty(_global, 'navigator', { value: { getGamepads: () => [], userAgent: 'jiMUD' }, configurable: true, writable: true });
+_global.getGlobal = key => _globals[key] ?? null;
+_global.getSetting = key => {
+    const setting = _settings ? _settings.getValue(key) : undefined;
+    if (typeof setting === 'undefined')
+        return Settings.defaultValue(key);
+    return setting;
+};
+//#endregion
+
+//load after the shims as they are used when the modules load
+const { setTemplates } = require('./library');
+const { Client } = require('./client');
+const { HeadlessDisplay } = require('./display');
+const { Worker } = require('worker_threads');
+
+const parentPort = (<any>process).parentPort;
+
+/**
+ * Owns the socket for a client, output goes to the page port or a hosted session and is held while the
+ * session moves between them
+ */
+class SessionRelay {
+    private _socket: Socket = null;
+    private _inflater: MCCPInflater = null;
+    private _port = null;
+    private _receive: (msg: SessionMessage) => void = null;
+    private _held: boolean = false;
+    private _queue: SessionMessage[] = [];
+
+    public id: number;
+
+    constructor(id: number) {
+        this.id = id;
+    }
+
+    /**
+     * Send output to a page
+     *
+     * @param port The port connected to the page session socket
+     */
+    public attachPort(port) {
+        this._port = port;
+        this._receive = null;
+        port.on('message', e => this.handle(e.data));
+        port.on('close', () => {
+            if (this._port !== port) return;
+            this._port = null;
+            //page closed with out handing off the connection
+            if (!this._held) {
+                this.destroy();
+                if (_relays.get(this.id) === this)
+                    _relays.delete(this.id);
+            }
+        });
+        port.start();
+        this.release();
+    }
+
+    /**
+     * Send output to a hosted session
+     *
+     * @param receive The session socket receive function
+     */
+    public attachSession(receive: (msg: SessionMessage) => void) {
+        this._port = null;
+        this._receive = receive;
+        this.release();
+    }
+
+    /**
+     * Stop sending output until attached to a new page or session
+     */
+    public hold() {
+        this._held = true;
+        this._port = null;
+        this._receive = null;
+    }
+
+    public handle(msg: SessionMessage) {
+        if (!msg) return;
+        switch (msg.type) {
+            case 'connect':
+                this.destroy();
+                this._inflater = new MCCPInflater();
+                this._socket = new Socket({ allowHalfOpen: msg.allowHalfOpen });
+                this.bind(this._socket);
+                try {
+                    this._socket.connect(msg.port, msg.host);
+                }
+                catch (e) {
+                    this.send({ type: 'error', error: { message: e.message, code: e.code } });
+                }
+                break;
+            case 'write':
+                if (this._socket && !this._socket.destroyed)
+                    this._socket.write(Buffer.from(msg.data.buffer, msg.data.byteOffset, msg.data.byteLength));
+                break;
+            case 'pause':
+                if (this._socket) this._socket.pause();
+                break;
+            case 'resume':
+                if (this._socket) this._socket.resume();
+                break;
+            case 'keep-alive':
+                if (this._socket) this._socket.setKeepAlive(msg.enable, msg.delay);
+                break;
+            case 'end':
+                if (this._socket) this._socket.end();
+                break;
+            case 'destroy':
+                this.destroy();
+                break;
+            case 'hold':
+                //reply before holding so the page knows nothing else will be sent
+                this.send({ type: 'held' });
+                this._held = true;
+                break;
+            case 'release':
+                this.release();
+                break;
+        }
+    }
+
+    public destroy() {
+        if (!this._socket) return;
+        this._socket.removeAllListeners();
+        this._socket.on('error', () => { });
+        this._socket.destroy();
+        this._socket = null;
+        parentPort.postMessage({ type: 'connected', id: this.id, connected: false });
+    }
+
+    /**
+     * Close the connection and the page port when the relay is replaced or removed
+     */
+    public dispose() {
+        this.destroy();
+        if (!this._port) return;
+        const port = this._port;
+        this._port = null;
+        port.close();
+    }
+
+    private bind(socket: Socket) {
+        socket.on('connect', () => {
+            this.send({ type: 'connect' });
+            parentPort.postMessage({ type: 'connected', id: this.id, connected: true });
+        });
+        socket.on('data', (data: Buffer) => {
+            data = this._inflater.process(data);
+            this.send({ type: 'data', data: new Uint8Array(data.buffer, data.byteOffset, data.byteLength) });
+        });
+        socket.on('end', () => this.send({ type: 'end' }));
+        socket.on('timeout', () => this.send({ type: 'timeout' }));
+        socket.on('error', (err: any) => this.send({ type: 'error', error: { message: err.message, code: err.code } }));
+        socket.on('close', hadError => {
+            if (this._socket === socket)
+                this._socket = null;
+            this.send({ type: 'close', error: hadError });
+            parentPort.postMessage({ type: 'connected', id: this.id, connected: false });
+        });
+    }
+
+    private send(msg: SessionMessage) {
+        if (this._held || (!this._port && !this._receive)) {
+            this._queue.push(msg);
+            return;
+        }
+        if (this._port)
+            this._port.postMessage(msg);
+        else
+            this._receive(msg);
+    }
+
+    /**
+     * Stop holding and send anything queued while held
+     */
+    public release() {
+        this._held = false;
+        //new owner starts reading, any pause was from the old owner's parser
+        if (this._socket) this._socket.resume();
+        const queue = this._queue;
+        this._queue = [];
+        const ql = queue.length;
+        for (let q = 0; q < ql; q++)
+            this.send(queue[q]);
+    }
+}
+
+/**
+ * A client running in the host with out a page
+ */
+interface HostedSession {
+    id: number;
+    client: any;
+    socket: SessionSocket;
+    logger: any;
+    //connection closed while hosted, the page runs its disconnect handling when attached
+    closed: boolean;
+}
+
+const _relays = new Map<number, SessionRelay>();
+const _sessions = new Map<number, HostedSession>();
+
+function createLogger(session: HostedSession, state) {
+    const logger = new Worker(`const { parentPort } = require('worker_threads');
+globalThis.self = { addEventListener: (type, listener) => parentPort.on('message', data => listener({ data: data })) };
+globalThis.postMessage = data => parentPort.postMessage(data);
+require(${JSON.stringify(path.join(__dirname, 'logging.js'))});`, { eval: true });
+    logger.on('message', data => {
+        if (!data) return;
+        switch (data.event) {
+            case 'error':
+                session.client.error(data.args);
+                break;
+            case 'debug':
+                if (session.client.getOption('enableDebug'))
+                    session.client.debug(data.args);
+                break;
+            case 'toggled':
+                session.client.options.logEnabled = data.args;
+                break;
+            case 'startInternal':
+            case 'start':
+                logger.postMessage({ action: data.event, args: { lines: session.client.display.lines, fragment: session.client.display.EndOfLine || session.client.telnet.prompt } });
+                break;
+        }
+    });
+    logger.on('error', err => session.client.error(err));
+    if (state)
+        logger.postMessage({ action: 'restore', args: state });
+    return logger;
+}
+
+/**
+ * Get the logger state, used to hand the log back to a page
+ *
+ * @param logger The logger
+ * @returns The state
+ */
+function getLoggerState(logger): Promise<any> {
+    return new Promise(resolve => {
+        const done = data => {
+            if (!data || data.event !== 'state') return;
+            logger.off('message', done);
+            resolve(data.args);
+        };
+        logger.on('message', done);
+        logger.postMessage({ action: 'state' });
+    });
+}
+
+/**
+ * Apply settings the host can not use, sound needs a page and large GMCP is parsed inline as there is no frame to keep free
+ *
+ * @param client The client
+ */
+function hostOptions(client) {
+    client.gmcpWorkerSize = Infinity;
+    client.MSP.enableSound = false;
+}
+
+function park(id: number, data) {
+    const relay = _relays.get(id) || new SessionRelay(id);
+    _relays.set(id, relay);
+    const client = new Client(new HeadlessDisplay(), createElement('textarea'), data.settings);
+    const session: HostedSession = { id: id, client: client, socket: null, logger: null, closed: false };
+    hostOptions(client);
+    client.on('options-loaded', () => hostOptions(client));
+    client.id = () => id;
+    client.sendAll = (text, echo) => parentPort.postMessage({ type: 'execute-all-clients', id: id, code: `client.send(${JSON.stringify(text)},${echo});` });
+    client.sendAllRaw = text => parentPort.postMessage({ type: 'execute-all-clients', id: id, code: `client.raw(${JSON.stringify(text)});` });
+    client.sendAllCommand = (text, noEcho, comments) => parentPort.postMessage({ type: 'execute-all-clients', id: id, code: `client.sendCommand(${JSON.stringify(text)},${noEcho}, ${comments});` });
+    client.sendAllBackground = (text, noEcho, comments) => parentPort.postMessage({ type: 'execute-all-clients', id: id, code: `client.sendBackground(${JSON.stringify(text)},${noEcho}, ${comments});` });
+    client.sendTo = (to, text, echo) => parentPort.postMessage({ type: 'execute-client', id: to, code: `client.send(${JSON.stringify(text)},${echo});` });
+    client.sendToRaw = (to, text) => parentPort.postMessage({ type: 'execute-client', id: to, code: `client.raw(${JSON.stringify(text)});` });
+    client.sendToCommand = (to, text, noEcho, comments) => parentPort.postMessage({ type: 'execute-client', id: to, code: `client.sendCommand(${JSON.stringify(text)},${noEcho}, ${comments});` });
+    client.sendToBackground = (to, text, noEcho, comments) => parentPort.postMessage({ type: 'execute-client', id: to, code: `client.sendBackground(${JSON.stringify(text)},${noEcho}, ${comments});` });
+    client.on('notify', (title, message, options) => {
+        if (!client.getOption('enableNotifications')) return;
+        parentPort.postMessage({ type: 'notify', id: id, title: title, message: message, options: options });
+    });
+    client.on('add-line-done', line => {
+        if (client.getOption('logEnabled'))
+            session.logger.postMessage({ action: 'add-line', args: line });
+    });
+    client.on('cleared', () => session.logger.postMessage({ action: 'flush', args: true }));
+    client.on('connected', () => {
+        session.logger.postMessage({ action: 'connected', args: true });
+        session.logger.postMessage({ action: 'start', args: { lines: client.display.lines, fragment: client.display.EndOfLine || client.telnet.prompt } });
+    });
+    //the page handles reconnecting and disconnect dialogs so hand the session back
+    client.on('closed', () => {
+        session.closed = true;
+        session.logger.postMessage({ action: 'connected', args: false });
+        session.logger.postMessage({ action: 'stop' });
+        parentPort.postMessage({ type: 'closed', id: id });
+    });
+    //new connections still go through the relay so they can be handed back
+    client.telnet.createSocket = allowHalfOpen => {
+        session.socket = new SessionSocket(msg => relay.handle(msg));
+        session.socket.allowHalfOpen = allowHalfOpen;
+        relay.attachSession(msg => session.socket.receive(msg));
+        return session.socket;
+    };
+    session.logger = createLogger(session, data.logger);
+    session.socket = new SessionSocket(msg => relay.handle(msg));
+    client.restoreSession(data.session, session.socket);
+    _sessions.set(id, session);
+    relay.attachSession(msg => session.socket.receive(msg));
+}
+
+/**
+ * Wait for the parser to finish any queued text so nothing is lost when the session moves
+ *
+ * @param client The client
+ */
+function whenIdle(client): Promise<void> {
+    return new Promise(resolve => {
+        const check = () => {
+            if (client.display.parseQueueLength === 0)
+                resolve();
+            else
+                setTimeout(check, 10);
+        };
+        check();
+    });
+}
+
+async function attach(id: number) {
+    const session = _sessions.get(id);
+    if (!session) {
+        parentPort.postMessage({ type: 'attached', id: id, session: null });
+        return;
+    }
+    _sessions.delete(id);
+    const relay = _relays.get(id);
+    if (relay) relay.hold();
+    session.socket.detach();
+    await whenIdle(session.client);
+    const state = session.client.getSession();
+    const logger = await getLoggerState(session.logger);
+    session.logger.terminate();
+    session.client.dispose();
+    parentPort.postMessage({ type: 'attached', id: id, session: state, logger: logger, closed: session.closed });
+}
+
+function remove(id: number) {
+    const session = _sessions.get(id);
+    if (session) {
+        _sessions.delete(id);
+        session.client.removeAllListeners('closed');
+        if (session.client.connected)
+            session.client.close();
+        session.client.raise('closed');
+        session.logger.postMessage({ action: 'flush' });
+        //give the logger time to write before stopping it
+        setTimeout(() => session.logger.terminate(), 1000);
+        session.client.dispose();
+    }
+    const relay = _relays.get(id);
+    if (relay) {
+        relay.dispose();
+        _relays.delete(id);
+    }
+}
+
+function execute(session: HostedSession, code: string) {
+    try {
+        new Function('client', code)(session.client);
+    }
+    catch (e) {
+        session.client.error(e);
+    }
+}
+
+parentPort.on('message', e => {
+    const msg = e.data;
+    if (!msg) return;
+    let relay;
+    switch (msg.type) {
+        case 'init':
+            setTemplates(msg.templates);
+            _globals = msg.globals || {};
+            _settings = Object.assign(new Settings(), msg.settings);
+            break;
+        case 'globals':
+            _globals = msg.globals || {};
+            break;
+        case 'settings':
+            _settings = Object.assign(new Settings(), msg.settings);
+            for (const session of _sessions.values())
+                session.client.clearOptionCache();
+            break;
+        case 'socket':
+            relay = _relays.get(msg.id);
+            //a new connection replaces the old, an attach takes over the held one
+            if (!msg.attach || !relay) {
+                if (relay) relay.dispose();
+                relay = new SessionRelay(msg.id);
+                _relays.set(msg.id, relay);
+            }
+            relay.attachPort(e.ports[0]);
+            break;
+        case 'park':
+            park(msg.id, msg);
+            break;
+        case 'attach':
+            attach(msg.id);
+            break;
+        case 'remove':
+            remove(msg.id);
+            break;
+        case 'reload-options':
+            //same as a page, see reloadOptions in index.html
+            for (const session of _sessions.values()) {
+                if (msg.global)
+                    session.client.clearOptionCache();
+                if (msg.file !== session.client.settingsFile) {
+                    if (msg.global)
+                        session.client.loadOptions();
+                    continue;
+                }
+                session.client.loadOptions();
+                session.client.sendGMCP('Core.Hello { "client": "' + session.client.telnet.terminal + '", "version": "' + session.client.telnet.version + '" }');
+            }
+            break;
+        case 'reload-profiles':
+            for (const session of _sessions.values())
+                session.client.loadOptions();
+            break;
+        case 'execute':
+            if (msg.id) {
+                if (_sessions.has(msg.id))
+                    execute(_sessions.get(msg.id), msg.code);
+            }
+            else
+                for (const session of _sessions.values())
+                    execute(session, msg.code);
+            break;
+        case 'notify-clicked':
+        case 'notify-closed':
+            if (_sessions.has(msg.id)) {
+                _sessions.get(msg.id).client.emit(msg.type, msg.title, msg.message);
+                _sessions.get(msg.id).client.raise(msg.type, [msg.title, msg.message]);
+            }
+            break;
+    }
+});
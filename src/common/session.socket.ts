@@ -0,0 +1,229 @@
+/**
+ * Session socket
+ *
+ * Stand in for a net socket when the connection is owned by the session host, the host keeps the real
+ * socket and inflates MCCP so the connection can move between a client page and the host with out
+ * losing telnet or compression state
+ *
+ * @author William
+ */
+import { EventEmitter } from 'events';
+const ZLIB: any = require('./../../lib/inflate_stream.min.js').Zlib;
+
+/**
+ * Message passed between a session socket and the host relay
+ */
+export interface SessionMessage {
+    type: string;
+    [key: string]: any;
+}
+
+/**
+ * Socket that forwards to the session host, only the parts of net.Socket used by telnet are supported
+ */
+export class SessionSocket extends EventEmitter {
+    private _send: (msg: SessionMessage) => void = null;
+    private _queue: SessionMessage[] = [];
+    private _held: () => void = null;
+    private _closed: boolean = false;
+
+    /**
+     * Data has already been inflated by the host so telnet should not decompress it
+     */
+    public readonly inflated: boolean = true;
+
+    /**
+     * Passed to the host socket when connecting
+     */
+    public allowHalfOpen: boolean = false;
+
+    constructor(send?: (msg: SessionMessage) => void) {
+        super();
+        if (send)
+            this.attach(send);
+    }
+
+    /**
+     * Start sending to the host, anything sent before attached is queued
+     *
+     * @param send Function to send a message to the host
+     */
+    public attach(send: (msg: SessionMessage) => void) {
+        this._send = send;
+        const ql = this._queue.length;
+        for (let q = 0; q < ql; q++)
+            send(this._queue[q]);
+        this._queue = [];
+    }
+
+    /**
+     * Stop sending to the host with out closing the connection so another socket can take it over
+     */
+    public detach() {
+        this._send = null;
+        this._queue = [];
+        this._closed = true;
+    }
+
+    /**
+     * Ask the host to hold incoming data until the connection is attached again
+     *
+     * @param callback Called once the host has stopped sending
+     */
+    public hold(callback: () => void) {
+        this._held = callback;
+        this.post({ type: 'hold' });
+    }
+
+    /**
+     * Resume sending after a hold when the connection is not being handed off
+     */
+    public release() {
+        this._held = null;
+        this.post({ type: 'release' });
+    }
+
+    /**
+     * Handle a message from the host
+     *
+     * @param msg The message
+     */
+    public receive(msg: SessionMessage) {
+        if (!msg || this._closed) return;
+        switch (msg.type) {
+            case 'data':
+                this.emit('data', Buffer.from(msg.data.buffer, msg.data.byteOffset, msg.data.byteLength));
+                break;
+            case 'connect':
+            case 'end':
+            case 'timeout':
+                this.emit(msg.type);
+                break;
+            case 'close':
+                this.emit('close', msg.error);
+                break;
+            case 'error':
+                this.emit('error', msg.error);
+                break;
+            case 'held':
+                if (this._held) {
+                    const held = this._held;
+                    this._held = null;
+                    held();
+                }
+                break;
+        }
+    }
+
+    public connect(port: number, host: string) {
+        this.post({ type: 'connect', port: port, host: host, allowHalfOpen: this.allowHalfOpen });
+    }
+
+    public write(data, encoding?: BufferEncoding) {
+        if (!Buffer.isBuffer(data))
+            data = Buffer.from(data, encoding || 'binary');
+        //copy so only the written bytes are sent and not the whole pool buffer
+        this.post({ type: 'write', data: new Uint8Array(data) });
+        return true;
+    }
+
+    public pause() {
+        this.post({ type: 'pause' });
+    }
+
+    public resume() {
+        this.post({ type: 'resume' });
+    }
+
+    public setKeepAlive(enable: boolean, delay?: number) {
+        this.post({ type: 'keep-alive', enable: enable, delay: delay });
+    }
+
+    public end() {
+        this.post({ type: 'end' });
+    }
+
+    public destroy() {
+        this.post({ type: 'destroy' });
+        this.detach();
+    }
+
+    private post(msg: SessionMessage) {
+        if (this._closed) return;
+        if (this._send)
+            this._send(msg);
+        else
+            this._queue.push(msg);
+    }
+}
+
+/**
+ * Watches incoming telnet data for the start of MCCP and inflates everything after it, follows the same
+ * rules as telnet so both agree on where compression starts
+ */
+export class MCCPInflater {
+    private _state: number = 0;
+    private _stream = null;
+
+    /**
+     * If compression has started
+     */
+    get compressed(): boolean {
+        return this._stream !== null;
+    }
+
+    /**
+     * Process data received from the host
+     *
+     * @param data The raw data
+     * @returns The data with any compressed part inflated
+     */
+    public process(data: Buffer): Buffer {
+        if (this._stream)
+            return Buffer.from(this._stream.decompress(data), 'binary');
+        const dl = data.length;
+        for (let idx = 0; idx < dl; idx++) {
+            const i = data[idx];
+            switch (this._state) {
+                case 1: //IAC
+                    if (i === 250)
+                        this._state = 2;
+                    else if (i >= 251 && i <= 254)
+                        this._state = 5;
+                    else
+                        this._state = 0;
+                    break;
+                case 2: //IAC SB
+                    if (i === 85 || i === 86)
+                        this._state = 3;
+                    else
+                        this._state = 4;
+                    break;
+                case 3: //MCCP sub negotiation, telnet starts compression on the first SE
+                    if (i === 240) {
+                        this._state = 0;
+                        this._stream = new ZLIB.InflateStream();
+                        if (idx < dl - 1)
+                            return Buffer.concat([data.subarray(0, idx + 1), this.process(data.subarray(idx + 1))]);
+                        return data;
+                    }
+                    break;
+                case 4: //other sub negotiation
+                    if (i === 255)
+                        this._state = 6;
+                    break;
+                case 5: //option for WILL, WONT, DO, DONT
+                    this._state = 0;
+                    break;
+                case 6: //IAC in sub negotiation
+                    this._state = i === 240 ? 0 : 4;
+                    break;
+                default:
+                    if (i === 255)
+                        this._state = 1;
+                    break;
+            }
+        }
+        return data;
+    }
+}
@@ -82,135 +82,134 @@ export class Status extends EventEmitter {
             this.info['EXPERIENCE_NEED'] = this.info['EXPERIENCE_NEED_RAW'] - this.info['EXPERIENCE'];
         });
 
-        this.client.on('received-GMCP', async (mod, obj) => {
+        this.client.onGMCP('Char.Base', (mod, obj) => {
+            this.init();
+            this.info['name'] = obj.name;
+            this.setTitle(obj.name);
+        });
+        this.client.onGMCP('Char.Vitals', (mod, obj) => {
+            this.updateBar('hp-bar', obj.hp, obj.hpmax);
+            this.updateBar('sp-bar', obj.sp, obj.spmax);
+            this.updateBar('mp-bar', obj.mp, obj.mpmax);
+            this.info['hp'] = obj.hp;
+            this.info['hpmax'] = obj.hpmax;
+            this.info['sp'] = obj.sp;
+            this.info['spmax'] = obj.spmax;
+            this.info['mp'] = obj.mp;
+            this.info['mpmax'] = obj.mpmax;
+            this.doUpdate(UpdateType.overall);
+        });
+        this.client.onGMCP('Char.Experience', (mod, obj) => {
+            this.info['EXPERIENCE'] = obj.current;
+            this.info['EXPERIENCE_NEED_RAW'] = obj.need;
+            this.info['EXPERIENCE_NEED'] = obj.need - obj.current;
+            this.info['EXPERIENCE_NEED_P'] = obj.needPercent;
+            //if (this.info['EXPERIENCE_NEED'] < 0 && !this.client.getOption('allowNegativeNumberNeeded'))
+            //this.info['EXPERIENCE_NEED'] = 0;
+
+            this.info['EXPERIENCE_EARNED'] = obj.earned;
+            this.info['EXPERIENCE_BANKED'] = obj.banked;
+            this.doUpdate(UpdateType.xp);
+        });
+        this.client.onGMCP('oMUD.ac', (mod, obj) => {
             let limb;
-            switch (mod.toLowerCase()) {
-                case 'char.base':
-                    this.init();
-                    this.info['name'] = obj.name;
-                    this.setTitle(obj.name);
-                    break;
-                case 'char.vitals':
-                    this.updateBar('hp-bar', obj.hp, obj.hpmax);
-                    this.updateBar('sp-bar', obj.sp, obj.spmax);
-                    this.updateBar('mp-bar', obj.mp, obj.mpmax);
-                    this.info['hp'] = obj.hp;
-                    this.info['hpmax'] = obj.hpmax;
-                    this.info['sp'] = obj.sp;
-                    this.info['spmax'] = obj.spmax;
-                    this.info['mp'] = obj.mp;
-                    this.info['mpmax'] = obj.mpmax;
-                    this.doUpdate(UpdateType.overall);
-                    break;
-                case 'char.experience':
-                    this.info['EXPERIENCE'] = obj.current;
-                    this.info['EXPERIENCE_NEED_RAW'] = obj.need;
-                    this.info['EXPERIENCE_NEED'] = obj.need - obj.current;
-                    this.info['EXPERIENCE_NEED_P'] = obj.needPercent;
-                    //if (this.info['EXPERIENCE_NEED'] < 0 && !this.client.getOption('allowNegativeNumberNeeded'))
-                    //this.info['EXPERIENCE_NEED'] = 0;
-
-                    this.info['EXPERIENCE_EARNED'] = obj.earned;
-                    this.info['EXPERIENCE_BANKED'] = obj.banked;
-                    this.doUpdate(UpdateType.xp);
-                    break;
-                case 'omud.ac':
-                    for (limb in obj) {
-                        if (!obj.hasOwnProperty(limb)) continue;
-                        this.setLimbAC(limb, obj[limb]);
-                        this.updateLimb(limb);
-                    }
-                    break;
-                case 'omud.limb':
-                    for (limb in obj) {
-                        if (!obj.hasOwnProperty(limb)) continue;
-                        this.setLimbHealth(limb, obj[limb]);
-                        this.updateLimb(limb);
-                    }
-                    break;
-                case 'omud.weapons':
-                    for (limb in obj) {
-                        if (!obj.hasOwnProperty(limb)) continue;
-                        this.setWeapon(limb, obj[limb]);
-                    }
-                    break;
-                case 'omud.environment':
-                    if (obj.weather) {
-                        const env = document.getElementById('environment');
-                        //env.className = env.className.split(' ').filter(c => !c.match(/^(weather-.*|intensity-hard)$/)).join(' ');
-                        env.classList.remove('weather-' + this.info['WEATHER'], 'intensity-hard');
-                        this.info['WEATHER'] = obj.weather;
-                        this.info['WEATHER_INTENSITY'] = obj.weather_intensity;
-                        if (obj.weather !== '0' && obj.weather !== 'none')
-                            env.classList.add('weather-' + obj.weather);
-                        if (obj.weather_intensity > 6)
-                            env.classList.add('intensity-hard');
-                    }
-                    if (obj.tod) {
-                        const env = document.getElementById('environment');
-                        env.classList.remove('day', 'night', 'twilight', 'dawn');
-                        env.classList.add(obj.tod);
-                        $('#environment').removeClass((index, className) => {
-                            return (className.match(/(^|\s)moon\d-\S+/g) || []).join(' ');
-                        });
-                        if (obj.moons) {
-                            env.classList.add('moon1-' + obj.moons[0]);
-                            env.classList.add('moon2-' + obj.moons[1]);
-                            env.classList.add('moon3-' + obj.moons[2]);
-                        }
-                    }
-                    break;
-                case 'omud.combat':
-                    if (obj.action === 'leave') {
-                        this.clear('combat');
-                        this.emit('leave combat');
-                    }
-                    else if (obj.action === 'add')
-                        this.createIconBar('#combat', this.getID(obj, 'combat_'), obj.name, obj.hp, 100, this.livingClass(obj, 'monster-'), obj.order);
-                    else if (obj.action === 'update') {
-                        if (obj.hp === 0)
-                            this.removeBar(this.getID(obj, 'combat_'));
-                        else
-                            this.createIconBar('#combat', this.getID(obj, 'combat_'), obj.name, obj.hp, 100, this.livingClass(obj, 'monster-'), obj.order);
-                    }
-                    else if (obj.action === 'remove')
-                        this.removeBar(this.getID(obj, 'combat_'));
-                    break;
-                case 'omud.party':
-                    if (obj.action === 'leave') {
-                        this.clear('party');
-                        this.emit('leave party');
-                    }
-                    else if (obj.action === 'add') {
-                        this.createIconBar('#party', this.getID(obj, 'party_'), obj.name, obj.hp, 100, this.livingClass(obj, 'party-'), obj.name.replace('"', ''));
-                    }
-                    else if (obj.action === 'update') {
-                        if (obj.hp === 0)
-                            this.removeBar(this.getID(obj, 'party_'), true);
-                        else
-                            this.createIconBar('#party', this.getID(obj, 'party_'), obj.name, obj.hp, 100, this.livingClass(obj, 'party-'), obj.name.replace('"', ''));
-                    }
-                    else if (obj.action === 'remove')
-                        this.removeBar(this.getID(obj, 'party_'), true);
-
-                    if ((limb = document.getElementById('party')).children.length)
-                        limb.classList.add('hasmembers');
-                    else
-                        limb.classList.remove('hasmembers');
-                    break;
-                case 'omud.skill':
-                    if (obj.skill && obj.skill.length) {
-                        if (!this.info['skills'][obj.skill]) this.info['skills'][obj.skill] = { amount: 0, bonus: 0, percent: 0 };
-                        if (obj.hasOwnProperty('percent'))
-                            this.info['skills'][obj.skill].percent = obj.percent || 0;
-                        if (obj.hasOwnProperty('amount')) {
-                            this.info['skills'][obj.skill].amount = obj.amount;
-                            this.info['skills'][obj.skill].bonus = obj.bonus || 0;
-                            this.info['skills'][obj.skill].category = obj.category;
-                        }
-                        this.emit('skill updated', obj.skill, this.info['skills'][obj.skill]);
-                    }
-                    break;
+            for (limb in obj) {
+                if (!obj.hasOwnProperty(limb)) continue;
+                this.setLimbAC(limb, obj[limb]);
+                this.updateLimb(limb);
+            }
+        });
+        this.client.onGMCP('oMUD.limb', (mod, obj) => {
+            let limb;
+            for (limb in obj) {
+                if (!obj.hasOwnProperty(limb)) continue;
+                this.setLimbHealth(limb, obj[limb]);
+                this.updateLimb(limb);
+            }
+        });
+        this.client.onGMCP('oMUD.weapons', (mod, obj) => {
+            let limb;
+            for (limb in obj) {
+                if (!obj.hasOwnProperty(limb)) continue;
+                this.setWeapon(limb, obj[limb]);
+            }
+        });
+        this.client.onGMCP('oMUD.Environment', (mod, obj) => {
+            if (obj.weather) {
+                const env = document.getElementById('environment');
+                //env.className = env.className.split(' ').filter(c => !c.match(/^(weather-.*|intensity-hard)$/)).join(' ');
+                env.classList.remove('weather-' + this.info['WEATHER'], 'intensity-hard');
+                this.info['WEATHER'] = obj.weather;
+                this.info['WEATHER_INTENSITY'] = obj.weather_intensity;
+                if (obj.weather !== '0' && obj.weather !== 'none')
+                    env.classList.add('weather-' + obj.weather);
+                if (obj.weather_intensity > 6)
+                    env.classList.add('intensity-hard');
+            }
+            if (obj.tod) {
+                const env = document.getElementById('environment');
+                env.classList.remove('day', 'night', 'twilight', 'dawn');
+                env.classList.add(obj.tod);
+                $('#environment').removeClass((index, className) => {
+                    return (className.match(/(^|\s)moon\d-\S+/g) || []).join(' ');
+                });
+                if (obj.moons) {
+                    env.classList.add('moon1-' + obj.moons[0]);
+                    env.classList.add('moon2-' + obj.moons[1]);
+                    env.classList.add('moon3-' + obj.moons[2]);
+                }
+            }
+        });
+        this.client.onGMCP('oMUD.combat', (mod, obj) => {
+            if (obj.action === 'leave') {
+                this.clear('combat');
+                this.emit('leave combat');
+            }
+            else if (obj.action === 'add')
+                this.createIconBar('#combat', this.getID(obj, 'combat_'), obj.name, obj.hp, 100, this.livingClass(obj, 'monster-'), obj.order);
+            else if (obj.action === 'update') {
+                if (obj.hp === 0)
+                    this.removeBar(this.getID(obj, 'combat_'));
+                else
+                    this.createIconBar('#combat', this.getID(obj, 'combat_'), obj.name, obj.hp, 100, this.livingClass(obj, 'monster-'), obj.order);
+            }
+            else if (obj.action === 'remove')
+                this.removeBar(this.getID(obj, 'combat_'));
+        });
+        this.client.onGMCP('oMUD.party', (mod, obj) => {
+            let limb;
+            if (obj.action === 'leave') {
+                this.clear('party');
+                this.emit('leave party');
+            }
+            else if (obj.action === 'add') {
+                this.createIconBar('#party', this.getID(obj, 'party_'), obj.name, obj.hp, 100, this.livingClass(obj, 'party-'), obj.name.replace('"', ''));
+            }
+            else if (obj.action === 'update') {
+                if (obj.hp === 0)
+                    this.removeBar(this.getID(obj, 'party_'), true);
+                else
+                    this.createIconBar('#party', this.getID(obj, 'party_'), obj.name, obj.hp, 100, this.livingClass(obj, 'party-'), obj.name.replace('"', ''));
+            }
+            else if (obj.action === 'remove')
+                this.removeBar(this.getID(obj, 'party_'), true);
+
+            if ((limb = document.getElementById('party')).children.length)
+                limb.classList.add('hasmembers');
+            else
+                limb.classList.remove('hasmembers');
+        });
+        this.client.onGMCP('oMUD.skill', (mod, obj) => {
+            if (obj.skill && obj.skill.length) {
+                if (!this.info['skills'][obj.skill]) this.info['skills'][obj.skill] = { amount: 0, bonus: 0, percent: 0 };
+                if (obj.hasOwnProperty('percent'))
+                    this.info['skills'][obj.skill].percent = obj.percent || 0;
+                if (obj.hasOwnProperty('amount')) {
+                    this.info['skills'][obj.skill].amount = obj.amount;
+                    this.info['skills'][obj.skill].bonus = obj.bonus || 0;
+                    this.info['skills'][obj.skill].category = obj.category;
+                }
+                this.emit('skill updated', obj.skill, this.info['skills'][obj.skill]);
             }
         });
         $('#status-drag-bar').mousedown((e) => {
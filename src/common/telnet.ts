@@ -1,6 +1,7 @@
 // spell-checker:words TELOP, TERMINALTYPE, NEWENVIRON, Achaea, Webdings, ENDOFRECORD, USERVAR keepalive, DONT
 import { EventEmitter } from 'events';
 import { Socket } from 'net';
+import { Tracer, TracePipeline } from './tracer';
 
 const ZLIB: any = require('./../../lib/inflate_stream.min.js').Zlib;
 
@@ -121,6 +122,7 @@ export class Telnet extends EventEmitter {
     private _latencyTime: Date = null;
     private _doPing: boolean = false;
     private _closed: boolean = true;
+    private _paused: boolean = false;
     private _zlib: boolean = false;
     private _keepAlive: boolean = false;
     private _keepAliveDelay: number = 0;
@@ -145,6 +147,11 @@ export class Telnet extends EventEmitter {
     public enablePing: boolean = false;
     public GMCPSupports: string[] = ['Core 1', 'Char 1', 'Char.Vitals 1', 'Char.Experience 1'];
     public enableDebug: boolean = false;
+    public tracer: Tracer = null;
+    /**
+     * Creates the socket for a connection, when not set a net socket is used
+     */
+    public createSocket: (allowHalfOpen: boolean) => any = null;
 
     /**
      * Creates an instance of Telnet.
@@ -251,6 +258,55 @@ export class Telnet extends EventEmitter {
             this.emit('debug', 'Reset');
     }
 
+    /**
+     * @name Telnet#saveState
+     * @desc Get the state of the connection so another telnet can take it over
+     * @returns {Object} The connection state
+     */
+    public saveState() {
+        return {
+            host: this.host,
+            port: this.port,
+            server: Object.assign({}, this.server),
+            prompt: this.prompt,
+            echo: this.echo,
+            firstSent: this.firstSent,
+            firstReceived: this.firstReceived,
+            MSSP: this.MSSP,
+            MTTS: this._MTTS,
+            connected: this._connected,
+            closed: this._closed,
+            zlib: this._zlib
+        };
+    }
+
+    /**
+     * @name Telnet#restoreState
+     * @desc Take over a connection from another telnet
+     *
+     * @param {Object} state The state from saveState
+     * @param {object} socket The socket still connected to the host
+     */
+    public restoreState(state, socket?) {
+        this._destroySocket();
+        this.reset();
+        this.host = state.host;
+        this.port = state.port;
+        this.server = Object.assign(this.server, state.server);
+        this.prompt = state.prompt;
+        this.echo = state.echo;
+        this.firstSent = state.firstSent;
+        this.firstReceived = state.firstReceived;
+        this.MSSP = state.MSSP || {};
+        this._MTTS = state.MTTS;
+        this._connected = state.connected;
+        this._closed = state.closed;
+        this._zlib = state.zlib;
+        if (!socket) return;
+        this.socket = this._bindSocket(socket);
+        if (this._paused) socket.pause();
+    }
+
     /**
      * @name connect
      * @desc connect to target host
@@ -262,6 +318,8 @@ export class Telnet extends EventEmitter {
         this.reset();
         this.emit('connecting');
         this.socket = this._createSocket();
+        //a new connection starts reading, keep any pause from backpressure
+        if (this._paused && this.socket) this.socket.pause();
         try {
             this.socket.connect(this.port, this.host);
         }
@@ -288,6 +346,35 @@ export class Telnet extends EventEmitter {
             this.emit('debug', 'Closed');
     }
 
+    /**
+     * @name Telnet#pause
+     * @desc stop reading from the host, data stays buffered by the socket until resumed
+     */
+    public pause() {
+        this._paused = true;
+        if (this.socket) this.socket.pause();
+    }
+
+    /**
+     * @name Telnet#resume
+     * @desc resume reading from the host after a pause
+     */
+    public resume() {
+        this._paused = false;
+        if (this.socket) this.socket.resume();
+    }
+
+    /**
+     * @name paused
+     * @desc determine if reading from the host is paused
+     * @returns {Boolean} weather reading is paused
+     *
+     * @readonly
+     */
+    get paused(): boolean {
+        return this._paused;
+    }
+
     /**
      * @name Telnet#receivedData
      * @desc data that is received from the host to be processed
@@ -316,7 +403,9 @@ export class Telnet extends EventEmitter {
         }
         if (this.enableDebug)
             this.emit('debug', 'PreProcess:' + data, 1);
+        const start = this.tracer && this.tracer.enabled ? performance.now() : 0;
         data = this.processData(data, skipDecompress, false, prependSplit);
+        if (start) this.tracer.record('telnet', TracePipeline.Output, start);
         if (this.enableDebug)
             this.emit('debug', 'PostProcess:' + data, 1);
         this.emit('received-data', data);
@@ -385,7 +474,9 @@ export class Telnet extends EventEmitter {
                         data = Buffer.from(data, 'binary');
                     if (this.enableDebug)
                         this.emit('debug', 'sendData:' + data.toString('binary'), 2);
+                    const start = this.tracer && this.tracer.enabled ? performance.now() : 0;
                     this.socket.write(data, 'binary');
+                    if (start) this.tracer.sent(start);
                     if (!raw) this.firstSent = false;
                 }
 
@@ -1711,11 +1802,14 @@ export class Telnet extends EventEmitter {
      * @returns {String} The decompressed data or the original data i ZLIB is not found or compress state is off
      */
     private _decompressData(data) {
-        if (!this._zlib) return data;
+        //sockets from the session host inflate before sending
+        if (!this._zlib || (this.socket && this.socket.inflated)) return data;
         if (!this.zStream)
             this.zStream = new ZLIB.InflateStream();
         if (this.enableDebug) this.emit('debug', 'Pre decompress:' + data.toString('binary'), 1);
+        const start = this.tracer && this.tracer.enabled ? performance.now() : 0;
         data = this.zStream.decompress(data);
+        if (start) this.tracer.record('decompress', TracePipeline.Output, start);
         if (this.enableDebug) this.emit('debug', 'Post decompress:' + data.toString('binary'), 1);
         return Buffer.from(data, 'binary');
     }
@@ -1762,36 +1856,10 @@ export class Telnet extends EventEmitter {
      * @returns {object} returns the socket object
      */
     private _createSocket() {
-        let _socket;
         try {
-            _socket = new Socket({ allowHalfOpen: this._allowHalfOpen });
-            //_socket.setEncoding('binary');
-            _socket.on('close', err => {
-                if (err)
-                    this.emit('error', { message: 'Closed due to transmission error', err: err });
-                else
-                    this.close();
-            });
-            _socket.on('connect', () => {
-                //set first ot ensure event has correct value
-                this._connected = true;
-                _socket.setKeepAlive(this._keepAlive, this._keepAliveDelay * 1000);
-                this.emit('connect');
-            });
-            _socket.on('data', data => {
-                if (this.enableDebug) this.emit('debug', 'Data received: ' + data, 1);
-                this.receivedData(data);
-            });
-            _socket.on('end', () => {
-                this.close();
-            });
-            _socket.on('timeout', () => {
-                this.emit('error', 'Connection timed out.');
-            });
-            _socket.on('error', (err) => {
-                this.emit('error', err);
-            });
-            return _socket;
+            if (this.createSocket)
+                return this._bindSocket(this.createSocket(this._allowHalfOpen));
+            return this._bindSocket(new Socket({ allowHalfOpen: this._allowHalfOpen }));
         }
         catch (e) {
             this.emit('error', e);
@@ -1799,6 +1867,44 @@ export class Telnet extends EventEmitter {
         return null;
     }
 
+    /**
+     * @name Telnet#bindSocket
+     * @desc Assign the socket events
+     *
+     * @param {object} _socket the socket
+     * @returns {object} returns the socket object
+     */
+    private _bindSocket(_socket) {
+        //_socket.setEncoding('binary');
+        _socket.on('close', err => {
+            if (err)
+                this.emit('error', { message: 'Closed due to transmission error', err: err });
+            else
+                this.close();
+        });
+        _socket.on('connect', () => {
+            //set first ot ensure event has correct value
+            this._connected = true;
+            _socket.setKeepAlive(this._keepAlive, this._keepAliveDelay * 1000);
+            this.emit('connect');
+        });
+        _socket.on('data', data => {
+            if (this.enableDebug) this.emit('debug', 'Data received: ' + data, 1);
+            if (this.tracer) this.tracer.chunk(performance.now());
+            this.receivedData(data);
+        });
+        _socket.on('end', () => {
+            this.close();
+        });
+        _socket.on('timeout', () => {
+            this.emit('error', 'Connection timed out.');
+        });
+        _socket.on('error', (err) => {
+            this.emit('error', err);
+        });
+        return _socket;
+    }
+
     /**
     * @name Telnet#destroySocket
     * @desc Destroy the current websocket object by assigning all functions to be empty
@@ -1839,7 +1945,15 @@ export class Telnet extends EventEmitter {
     }
 
     private _fireReceiveGMCP(val) {
-        const data = { telnet: this, value: val, handled: false };
+        //module name ends at the first space or start of json
+        const idx = val.search(/[ {\[]/);
+        const data = {
+            telnet: this,
+            value: val,
+            module: (idx === -1 ? val : val.substring(0, idx)).trim(),
+            data: idx === -1 ? '' : val.substring(idx).trim(),
+            handled: false
+        };
         this.emit('received-GMCP', data);
         return data.handled;
     }
@@ -2,8 +2,11 @@
 import { EventEmitter } from 'events';
 import { Client } from './client';
 import { AnsiColorCode, Ansi } from './ansi';
-import { FunctionEvent } from './types';
+import { FunctionEvent, BackupSelection } from './types';
 import { isFileSync } from './library';
+import { regexLiterals } from './profile.search';
+import { Backup } from './backup';
+import { SoundCache } from './msp';
 /**
  * Client text functions
  *
@@ -498,7 +501,7 @@ export class Tests extends EventEmitter {
         };
 
         this.functions['testmapper'] = () => {
-            this.client.emit('received-GMCP', 'Room.Info', {
+            this.client.dispatchGMCP('Room.Info', {
                 details: [],
                 doors: {},
                 prevroom: { num: 0, dir: '', area: '' },
@@ -511,7 +514,7 @@ export class Tests extends EventEmitter {
                 num: 1968208336,
                 indoors: 0
             });
-            this.client.emit('received-GMCP', 'Room.Info', {
+            this.client.dispatchGMCP('Room.Info', {
                 details: [],
                 doors: {},
                 prevroom: { num: 1968208336, dir: 'east', area: 'Doc Build Samples Area' },
@@ -526,7 +529,7 @@ export class Tests extends EventEmitter {
                 num: -329701270,
                 indoors: 0
             });
-            this.client.emit('received-GMCP', 'Room.Info', {
+            this.client.dispatchGMCP('Room.Info', {
                 details: [],
                 doors: {},
                 prevroom: { num: -329701270, dir: 'east', area: 'Doc Build Samples Area' },
@@ -540,7 +543,7 @@ export class Tests extends EventEmitter {
                 num: -1688332036,
                 indoors: 0
             });
-            this.client.emit('received-GMCP', 'Room.Info', {
+            this.client.dispatchGMCP('Room.Info', {
                 details: [],
                 doors: {},
                 prevroom: { num: -1688332036, dir: 'south', area: 'Doc Build Samples Area' },
@@ -554,7 +557,7 @@ export class Tests extends EventEmitter {
                 num: -348853133,
                 indoors: 0
             });
-            this.client.emit('received-GMCP', 'Room.Info', {
+            this.client.dispatchGMCP('Room.Info', {
                 details: [],
                 doors: {},
                 prevroom: { num: -348853133, dir: 'west', area: 'Doc Build Samples Area' },
@@ -570,7 +573,7 @@ export class Tests extends EventEmitter {
                 num: 1916648905,
                 indoors: 1
             });
-            this.client.emit('received-GMCP', 'Room.Info', {
+            this.client.dispatchGMCP('Room.Info', {
                 details: [],
                 doors: {},
                 prevroom: { num: 1916648905, dir: 'west', area: 'Doc Build Samples Area' },
@@ -585,7 +588,7 @@ export class Tests extends EventEmitter {
                 num: 87723359,
                 indoors: 0
             });
-            this.client.emit('received-GMCP', 'Room.Info', {
+            this.client.dispatchGMCP('Room.Info', {
                 details: [],
                 doors: {},
                 prevroom: { num: 87723359, dir: 'south', area: 'Doc Build Samples Area' },
@@ -599,7 +602,7 @@ export class Tests extends EventEmitter {
                 num: -1674322715,
                 indoors: 0
             });
-            this.client.emit('received-GMCP', 'Room.Info', {
+            this.client.dispatchGMCP('Room.Info', {
                 details: [],
                 doors: {},
                 prevroom: { num: -1674322715, dir: 'east', area: 'Doc Build Samples Area' },
@@ -614,7 +617,7 @@ export class Tests extends EventEmitter {
                 num: 210551156,
                 indoors: 0
             });
-            this.client.emit('received-GMCP', 'Room.Info', {
+            this.client.dispatchGMCP('Room.Info', {
                 details: [],
                 doors: {},
                 prevroom: { num: 210551156, dir: 'east', area: 'Doc Build Samples Area' },
@@ -630,7 +633,7 @@ export class Tests extends EventEmitter {
         };
 
         this.functions['teststatus'] = data => {
-            this.client.emit('received-GMCP', 'Char.Base', {
+            this.client.dispatchGMCP('Char.Base', {
                 name: 'Tester',
                 class: 'fighter',
                 subclass: 'None',
@@ -638,7 +641,7 @@ export class Tests extends EventEmitter {
                 level: 1,
                 gender: 'male'
             });
-            this.client.emit('received-GMCP', 'Char.Vitals', {
+            this.client.dispatchGMCP('Char.Vitals', {
                 hp: 75,
                 hpmax: 100,
                 sp: 50,
@@ -646,14 +649,14 @@ export class Tests extends EventEmitter {
                 mp: 25,
                 mpmax: 100
             });
-            this.client.emit('received-GMCP', 'Char.Experience', {
+            this.client.dispatchGMCP('Char.Experience', {
                 current: 50,
                 need: 100,
                 needPercent: 50,
                 earned: 200,
                 banked: 300
             });
-            this.client.emit('received-GMCP', 'oMUD.limb', {
+            this.client.dispatchGMCP('oMUD.limb', {
                 head: 10,
                 torso: 20,
                 'left arm': 30,
@@ -668,7 +671,7 @@ export class Tests extends EventEmitter {
                 'right wing': 80,
                 tail: 70
             });
-            this.client.emit('received-GMCP', 'oMUD.ac', {
+            this.client.dispatchGMCP('oMUD.ac', {
                 head: 0,
                 torso: 1,
                 'left arm': 2,
@@ -684,32 +687,32 @@ export class Tests extends EventEmitter {
                 tail: 4,
                 overall: 4
             });
-            this.client.emit('received-GMCP', 'oMUD.weapons', {
+            this.client.dispatchGMCP('oMUD.weapons', {
                 'right hand': { 'name': 'knife', 'type': 'knife', 'subtype': 'dagger', 'material': 'iron', 'quality': 'poor', 'dominant': 1 },
                 'left hand': { 'name': 'club', 'type': 'blunt', 'subtype': 'club', 'material': 'wood', 'quality': 'ordinary', 'dominant': 0 }
             });
             if (data && data.args && data.args.indexOf('night') !== -1)
-                this.client.emit('received-GMCP', 'oMUD.Environment', { tod: 'night', moons: ['waning', 'full', 'waxing'] });
+                this.client.dispatchGMCP('oMUD.Environment', { tod: 'night', moons: ['waning', 'full', 'waxing'] });
             else
-                this.client.emit('received-GMCP', 'oMUD.Environment', { 'tod': 'day' });
-            this.client.emit('received-GMCP', 'oMUD.skill', { skill: 'knife', percent: 60 });
-            this.client.emit('received-GMCP', 'oMUD.skill', { skill: 'knife', amount: 100, bonus: 5, category: 'weapon' });
-            this.client.emit('received-GMCP', 'oMUD.skill', { skill: 'small sword', percent: 100 });
+                this.client.dispatchGMCP('oMUD.Environment', { 'tod': 'day' });
+            this.client.dispatchGMCP('oMUD.skill', { skill: 'knife', percent: 60 });
+            this.client.dispatchGMCP('oMUD.skill', { skill: 'knife', amount: 100, bonus: 5, category: 'weapon' });
+            this.client.dispatchGMCP('oMUD.skill', { skill: 'small sword', percent: 100 });
             let found = false;
-            this.client.emit('received-GMCP', 'oMUD.skill', { skill: 'small sword', amount: 1150, bonus: 0, category: 'weapon' });
+            this.client.dispatchGMCP('oMUD.skill', { skill: 'small sword', amount: 1150, bonus: 0, category: 'weapon' });
             if (data && data.args && data.args.length) {
                 data.args.forEach(arg => {
                     if (arg.startsWith('party:')) {
                         found = true;
                         let s = parseInt(arg.split(':')[1], 10);
                         for (let m = 0; m < s; m++)
-                            this.client.emit('received-GMCP', 'oMUD.party', { 'action': 'update', 'name': 'Party ' + (m + 1), 'hp': 50, race: 'human', 'id': m });
+                            this.client.dispatchGMCP('oMUD.party', { 'action': 'update', 'name': 'Party ' + (m + 1), 'hp': 50, race: 'human', 'id': m });
                     }
                 });
             }
             if (!found) {
-                this.client.emit('received-GMCP', 'oMUD.party', { 'action': 'update', 'name': 'Elf', 'hp': 50, race: 'elf', 'id': 1 });
-                this.client.emit('received-GMCP', 'oMUD.party', { 'action': 'update', 'name': 'Dwarf', 'hp': 100, race: 'dwarf', 'id': 2 });
+                this.client.dispatchGMCP('oMUD.party', { 'action': 'update', 'name': 'Elf', 'hp': 50, race: 'elf', 'id': 1 });
+                this.client.dispatchGMCP('oMUD.party', { 'action': 'update', 'name': 'Dwarf', 'hp': 100, race: 'dwarf', 'id': 2 });
             }
             found = false
             if (data && data.args && data.args.length) {
@@ -718,14 +721,14 @@ export class Tests extends EventEmitter {
                         found = true;
                         let s = parseInt(arg.split(':')[1], 10);
                         for (let m = 0; m < s; m++)
-                            this.client.emit('received-GMCP', 'oMUD.combat', { 'action': 'update', 'name': 'Monster ' + (m + 1), 'hp': 50, race: 'orc', 'id': m, order: 0 });
+                            this.client.dispatchGMCP('oMUD.combat', { 'action': 'update', 'name': 'Monster ' + (m + 1), 'hp': 50, race: 'orc', 'id': m, order: 0 });
                     }
                 });
             }
             if (!found) {
-                this.client.emit('received-GMCP', 'oMUD.combat', { 'action': 'update', 'name': 'Monster', 'hp': 50, race: 'orc', 'id': 3, order: 0 });
-                this.client.emit('received-GMCP', 'oMUD.combat', { 'action': 'update', 'name': "Monster 2", 'hp': 100, race: 'dragon', 'id': 4, order: 1 });
-                this.client.emit('received-GMCP', 'oMUD.combat', { 'action': 'update', 'name': 'Monster with extra super long name to test', 'hp': 100, race: 'dragon', 'id': 5, order: 2 });
+                this.client.dispatchGMCP('oMUD.combat', { 'action': 'update', 'name': 'Monster', 'hp': 50, race: 'orc', 'id': 3, order: 0 });
+                this.client.dispatchGMCP('oMUD.combat', { 'action': 'update', 'name': "Monster 2", 'hp': 100, race: 'dragon', 'id': 4, order: 1 });
+                this.client.dispatchGMCP('oMUD.combat', { 'action': 'update', 'name': 'Monster with extra super long name to test', 'hp': 100, race: 'dragon', 'id': 5, order: 2 });
             }
         };
 
@@ -956,6 +959,177 @@ Devanagari
                 sample += `Line: ${h}, LineID: ${id + h}\n`;
             this.client.print(sample, true);
         };
+        this.functions['testregexliterals'] = () => {
+            //pattern and the literals that must be found for it to match
+            const cases = [
+                ['hello', ['hello']],
+                ['ab\\.cd', ['ab.cd']],
+                ['ab\\dcd', ['ab', 'cd']],
+                ['ab?c', ['a', 'c']],
+                ['a|b', []],
+                ['a\\x41b', ['a', 'b']],
+                ['a\\x4', ['a']],
+                ['a\\u0041b', ['a', 'b']],
+                ['a\\u{1F600}b', ['a', 'b']],
+                ['a\\cJb', ['a', 'b']],
+                ['(?<n>x)ab\\k<n>cd', ['ab', 'cd']],
+                ['(a)bc\\12de', ['bc', 'de']],
+                ['ab\\p{L}cd', ['ab', 'cd']]
+            ];
+            let sample = '';
+            let failed = 0;
+            const cl = cases.length;
+            for (let c = 0; c < cl; c++) {
+                const result = JSON.stringify(regexLiterals(<string>cases[c][0]));
+                if (result === JSON.stringify(cases[c][1]))
+                    sample += '\x1b[32mPass\x1b[0m ' + cases[c][0] + '\n';
+                else {
+                    sample += '\x1b[31mFail\x1b[0m ' + cases[c][0] + ' got ' + result + ' expected ' + JSON.stringify(cases[c][1]) + '\n';
+                    failed++;
+                }
+            }
+            sample += (cl - failed) + ' of ' + cl + ' passed';
+            this.client.print(sample, true);
+        };
+        this.functions['testbackupupload'] = () => {
+            const http = require('http');
+            const querystring = require('querystring');
+            const zlib = require('zlib');
+            let stored = '';
+            let starts = 0;
+            let dropped = false;
+            //stand in for the backup endpoint that stores the second chunk but loses its response
+            const server = http.createServer((req, res) => {
+                let body = '';
+                req.on('data', chunk => body += chunk);
+                req.on('end', () => {
+                    const data = querystring.parse(body);
+                    res.setHeader('Access-Control-Allow-Origin', '*');
+                    if (data.a !== 'save') {
+                        res.end('{}');
+                        return;
+                    }
+                    if (data.append === '1')
+                        stored += data.data;
+                    else {
+                        stored = data.data;
+                        starts++;
+                    }
+                    if (data.c === '1' && !dropped) {
+                        dropped = true;
+                        req.socket.destroy();
+                        return;
+                    }
+                    res.setHeader('Content-Type', 'application/json');
+                    res.end(JSON.stringify({ msg: 'Successfully saved' }));
+                });
+            });
+            server.listen(0, '127.0.0.1', () => {
+                const backup = new Backup(this.client);
+                backup.URL = 'http://127.0.0.1:' + server.address().port;
+                backup.chunkSize = 300;
+                backup.saveSelection = BackupSelection.Settings;
+                const done = (err?) => {
+                    server.close();
+                    const supports = this.client.telnet.GMCPSupports.lastIndexOf('Client 1');
+                    if (supports !== -1)
+                        this.client.telnet.GMCPSupports.splice(supports, 1);
+                    let sample = 'Uploads started: ' + starts + ', response dropped: ' + dropped + '\n';
+                    let data;
+                    if (!err) {
+                        try {
+                            data = JSON.parse(zlib.inflateSync(Buffer.from(stored.substring(4), 'base64')).toString('utf8'));
+                        }
+                        catch (e) {
+                            err = e.message || e;
+                        }
+                    }
+                    if (err)
+                        sample += '\x1b[31mFail\x1b[0m ' + err;
+                    else if (!stored.startsWith('JZ1:') || starts !== 2 || !dropped || data.version !== 2 || !data.settings)
+                        sample += '\x1b[31mFail\x1b[0m stored backup did not match a single restarted upload';
+                    else
+                        sample += '\x1b[32mPass\x1b[0m stored backup decoded, version ' + data.version;
+                    this.client.print(sample, true);
+                };
+                backup.on('finish-save', () => done());
+                backup.on('abort', err => done(err || 'Aborted'));
+                backup.save(2);
+            });
+        };
+        this.functions['testmspcache'] = () => {
+            const http = require('http');
+            const fs = require('fs');
+            const path = require('path');
+            const os = require('os');
+            const requests = {};
+            //stand in sound server, moved redirects to a, missing is not found
+            const server = http.createServer((req, res) => {
+                requests[req.url] = (requests[req.url] || 0) + 1;
+                if (req.url === '/sounds/moved.wav') {
+                    res.writeHead(302, { Location: '/sounds/a.wav' });
+                    res.end();
+                    return;
+                }
+                if (!/^\/sounds\/[abc]\.wav$/.test(req.url)) {
+                    res.writeHead(404);
+                    res.end();
+                    return;
+                }
+                res.writeHead(200, { 'Content-Type': 'audio/wav' });
+                res.end(Buffer.alloc(1000, req.url.charCodeAt(8)));
+            });
+            server.listen(0, '127.0.0.1', async () => {
+                const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'jimud-msp-'));
+                const url = 'http://127.0.0.1:' + server.address().port + '/sounds/';
+                const cache = new SoundCache();
+                cache.savePath = dir;
+                cache.maxDiskSize = 2500;
+                const folder = path.join(dir, '127.0.0.1_' + server.address().port, 'sounds');
+                let sample = '';
+                let err;
+                try {
+                    const a = await cache.file(url + 'a.wav');
+                    await cache.file(url + 'a.wav');
+                    await cache.file(url + 'b.wav');
+                    await cache.file(url + 'a.wav');
+                    await cache.file(url + 'c.wav');
+                    const moved = await cache.file(url + 'moved.wav');
+                    let missing = false;
+                    try {
+                        await cache.file(url + 'missing.wav');
+                    }
+                    catch (e) {
+                        missing = true;
+                    }
+                    //give unlinks time to finish
+                    await new Promise(resolve => setTimeout(resolve, 100));
+                    const saved = ['a.wav', 'b.wav', 'c.wav', 'moved.wav'].filter(f => fs.existsSync(path.join(folder, f)));
+                    sample += 'Requests: ' + JSON.stringify(requests) + '\n';
+                    sample += 'Saved: ' + saved.join(', ') + '\n';
+                    if (a.byteLength !== 1000 || moved.byteLength !== 1000)
+                        err = 'downloaded size wrong';
+                    else if (requests['/sounds/a.wav'] !== 2 || requests['/sounds/b.wav'] !== 1 || requests['/sounds/c.wav'] !== 1)
+                        err = 'saved sounds were downloaded again';
+                    else if (!missing)
+                        err = 'missing sound did not fail';
+                    else if (saved.join(',') !== 'c.wav,moved.wav')
+                        err = 'least recently used sounds were not removed';
+                    else if (cache.localPath(new URL(url + '..%5C..%5C..%5Cevil.dll')) !== null || cache.localPath(new URL(url + '%E0%A4%A')) !== null)
+                        err = 'unsafe sound path was saved';
+                }
+                catch (e) {
+                    err = e.message || e;
+                }
+                server.close();
+                fs.rmSync(dir, { recursive: true, force: true });
+                if (err)
+                    sample += '\x1b[31mFail\x1b[0m ' + err;
+                else
+                    sample += '\x1b[32mPass\x1b[0m';
+                this.client.print(sample, true);
+            });
+        };
         this.functions['testscreen'] = () => {
             let sample = 'Window innerWidth: ' + window.innerWidth;
             sample += '\nWindow innerHeight: ' + window.innerHeight;
@@ -0,0 +1,203 @@
+/**
+ * Tracer
+ *
+ * Time each stage data passes through from the socket to the screen and from a key press
+ * to the socket, times are kept as histograms and recent spans can be exported as a chrome trace
+ *
+ * @author William
+ */
+
+//upper bound in milliseconds of each histogram bucket, last bucket is everything slower
+export const TRACE_BUCKETS = [0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 25, 50, 100, 250, 500, 1000, Infinity];
+//spans kept for exporting, oldest are dropped first
+const MAX_EVENTS = 100000;
+
+export enum TracePipeline {
+    Output = 'output',
+    Input = 'input'
+}
+
+interface TraceStage {
+    name: string;
+    pipeline: TracePipeline;
+    count: number;
+    total: number;
+    max: number;
+    buckets: number[];
+}
+
+export class Tracer {
+    private _enabled: boolean = false;
+    private _stages: Map<string, TraceStage> = new Map();
+    //spans as [name, pipeline, start, duration], used as a ring buffer once full
+    private _events = [];
+    private _next = 0;
+    //first chunk received since the last paint
+    private _chunk = 0;
+    //last key press that may send a command
+    private _key = 0;
+
+    get enabled(): boolean {
+        return this._enabled;
+    }
+
+    set enabled(value: boolean) {
+        this._enabled = value;
+        this._chunk = 0;
+        this._key = 0;
+    }
+
+    /**
+     * Record how long a stage took
+     *
+     * @param name The stage name
+     * @param pipeline The pipeline the stage is part of
+     * @param start The performance.now() time the stage started
+     * @param end The performance.now() time the stage ended, defaults to now
+     */
+    public record(name: string, pipeline: TracePipeline, start: number, end?: number) {
+        if (!this._enabled) return;
+        if (end === undefined) end = performance.now();
+        const duration = end - start;
+        let stage = this._stages.get(name);
+        if (!stage) {
+            stage = { name: name, pipeline: pipeline, count: 0, total: 0, max: 0, buckets: new Array(TRACE_BUCKETS.length).fill(0) };
+            this._stages.set(name, stage);
+        }
+        stage.count++;
+        stage.total += duration;
+        if (duration > stage.max)
+            stage.max = duration;
+        let b = 0;
+        while (duration > TRACE_BUCKETS[b])
+            b++;
+        stage.buckets[b]++;
+        if (this._events.length < MAX_EVENTS)
+            this._events.push([name, pipeline, start, duration]);
+        else {
+            this._events[this._next] = [name, pipeline, start, duration];
+            this._next = (this._next + 1) % MAX_EVENTS;
+        }
+    }
+
+    /**
+     * Note when a chunk arrived from the socket so the next paint can record how long it took to show
+     *
+     * @param start The performance.now() time the chunk arrived
+     */
+    public chunk(start: number) {
+        if (this._enabled && !this._chunk)
+            this._chunk = start;
+    }
+
+    /**
+     * Record a paint, and the time from the oldest chunk not yet shown
+     *
+     * @param start The performance.now() time the paint started
+     */
+    public painted(start: number) {
+        if (!this._enabled) return;
+        const end = performance.now();
+        this.record('paint', TracePipeline.Output, start, end);
+        if (!this._chunk) return;
+        this.record('socket to paint', TracePipeline.Output, this._chunk, end);
+        this._chunk = 0;
+    }
+
+    /**
+     * Note a key press that is sending a command
+     *
+     * @param time The event time stamp
+     */
+    public key(time: number) {
+        if (this._enabled)
+            this._key = time;
+    }
+
+    /**
+     * Record a write to the socket, and the time from the key press that sent it
+     *
+     * @param start The performance.now() time the write started
+     */
+    public sent(start: number) {
+        if (!this._enabled) return;
+        const end = performance.now();
+        this.record('send', TracePipeline.Input, start, end);
+        if (!this._key) return;
+        this.record('key to send', TracePipeline.Input, this._key, end);
+        this._key = 0;
+    }
+
+    public reset() {
+        this._stages.clear();
+        this._events = [];
+        this._next = 0;
+        this._chunk = 0;
+        this._key = 0;
+    }
+
+    /**
+     * Get the histogram of each stage with averages and percentiles estimated from the buckets
+     *
+     * @returns An array of stage rows, times are in milliseconds
+     */
+    public getReport() {
+        const rows = [];
+        this._stages.forEach(stage => {
+            rows.push({
+                name: stage.name,
+                pipeline: stage.pipeline,
+                count: stage.count,
+                average: stage.count ? stage.total / stage.count : 0,
+                p50: this.percentile(stage, 0.5),
+                p95: this.percentile(stage, 0.95),
+                p99: this.percentile(stage, 0.99),
+                max: stage.max,
+                total: stage.total,
+                buckets: stage.buckets.slice()
+            });
+        });
+        return rows;
+    }
+
+    private percentile(stage: TraceStage, percent: number) {
+        if (!stage.count) return 0;
+        const target = stage.count * percent;
+        const bl = stage.buckets.length;
+        let count = 0;
+        for (let b = 0; b < bl; b++) {
+            count += stage.buckets[b];
+            if (count >= target)
+                return Math.min(TRACE_BUCKETS[b], stage.max);
+        }
+        return stage.max;
+    }
+
+    /**
+     * Build a chrome trace of the recorded spans that can be loaded in chrome://tracing or perfetto
+     *
+     * @returns The trace object to save as json
+     */
+    public getChromeTrace() {
+        const origin = performance.timeOrigin || 0;
+        const events = this._next ? this._events.slice(this._next).concat(this._events.slice(0, this._next)) : this._events;
+        const el = events.length;
+        const traceEvents = new Array(el + 2);
+        //name the threads so output and input are shown as separate tracks
+        traceEvents[0] = { name: 'thread_name', ph: 'M', pid: process.pid, tid: 1, args: { name: 'Output' } };
+        traceEvents[1] = { name: 'thread_name', ph: 'M', pid: process.pid, tid: 2, args: { name: 'Input' } };
+        for (let e = 0; e < el; e++) {
+            const event = events[e];
+            traceEvents[e + 2] = {
+                name: event[0],
+                cat: event[1],
+                ph: 'X',
+                ts: Math.round((origin + event[2]) * 1000),
+                dur: Math.round(event[3] * 1000),
+                pid: process.pid,
+                tid: event[1] === TracePipeline.Output ? 1 : 2
+            };
+        }
+        return { traceEvents: traceEvents, displayTimeUnit: 'ms' };
+    }
+}
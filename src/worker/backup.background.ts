@@ -0,0 +1,250 @@
+/**
+ * Backup stream encoder/decoder
+ *
+ * Serialize, deflate and chunk backup data in a background thread, reading
+ * map rooms directly from the database so the full map is never held in memory
+ * @author William
+ */
+const fs = require('fs');
+const zlib = require('zlib');
+const sqlite3 = require('better-sqlite3');
+
+//marker prefixed to the first chunk so load can tell stream backups from LZString ones, must match backup.ts
+const STREAM_MARKER = 'JZ1:';
+//raw bytes per chunk, multiple of 3 so each chunk base64 encodes without padding and chunks can be joined as is
+const CHUNK_BYTES = 15000;
+//how many chunks may be produced ahead of the last one acknowledged by the server
+const CHUNK_WINDOW = 4;
+
+let _deflate;
+let _pending: Buffer[] = [];
+let _pendingSize = 0;
+let _index = 0;
+let _acked = -1;
+let _waiting = null;
+let _first = true;
+let _chunkBytes = CHUNK_BYTES;
+
+let _inflate;
+let _inflated: Buffer[] = [];
+let _carry = '';
+
+self.addEventListener('message', (e: MessageEvent) => {
+    if (!e.data) return;
+    switch (e.data.action) {
+        case 'save':
+            save(e.data).catch(err => {
+                postMessage({ event: 'error', error: err.message || err });
+            });
+            break;
+        case 'ack':
+            if (e.data.index > _acked)
+                _acked = e.data.index;
+            if (_waiting && _index - _acked <= CHUNK_WINDOW) {
+                const resolve = _waiting;
+                _waiting = null;
+                resolve();
+            }
+            break;
+        case 'inflate-start':
+            _inflated = [];
+            _carry = '';
+            _inflate = zlib.createInflate();
+            _inflate.on('data', chunk => _inflated.push(chunk));
+            _inflate.on('end', () => {
+                let data;
+                //parse here so the main thread only gets the finished object
+                try {
+                    data = JSON.parse(Buffer.concat(_inflated).toString('utf8'));
+                }
+                catch (err) {
+                    postMessage({ event: 'error', error: err.message });
+                    return;
+                }
+                finally {
+                    _inflated = [];
+                    _inflate = null;
+                }
+                postMessage({ event: 'inflated', data: data });
+            });
+            _inflate.on('error', err => postMessage({ event: 'error', error: err.message }));
+            break;
+        case 'inflate':
+            inflate(e.data.data || '', false);
+            break;
+        case 'inflate-end':
+            inflate('', true);
+            break;
+    }
+}, false);
+
+async function save(options) {
+    let p, pl;
+    _pending = [];
+    _pendingSize = 0;
+    _index = 0;
+    _acked = -1;
+    _first = true;
+    //keep chunks a multiple of 3 bytes so they still join as base64
+    _chunkBytes = options.chunkSize >= 3 ? options.chunkSize - options.chunkSize % 3 : CHUNK_BYTES;
+    _deflate = zlib.createDeflate();
+    _deflate.on('data', chunk => {
+        _pending.push(chunk);
+        _pendingSize += chunk.length;
+        flush(false);
+    });
+    _deflate.on('end', () => {
+        flush(true);
+        postMessage({ event: 'done', chunks: _index });
+    });
+    _deflate.on('error', err => postMessage({ event: 'error', error: err.message }));
+
+    await write('{');
+    for (p = 0, pl = options.sections.length; p < pl; p++)
+        await member(options.sections[p]);
+    if (options.profiles) {
+        await member('"profiles":{');
+        for (p = 0, pl = options.profiles.length; p < pl; p++) {
+            await write((p ? ',' : '') + options.profiles[p]);
+            postMessage({ event: 'progress', value: (p + 1) / pl * (options.map ? 0.1 : 1) });
+        }
+        await write('}');
+    }
+    if (options.map)
+        await writeMap(options.map);
+    await write('}');
+    if (_deflate)
+        _deflate.end();
+}
+
+async function writeMap(file: string) {
+    let room = null;
+    let count = 0;
+    let prop;
+    await member('"map":{');
+    if (!fs.existsSync(file)) {
+        await write('}');
+        return;
+    }
+    const _db = new sqlite3(file, { readonly: true });
+    try {
+        const total = _db.prepare('SELECT COUNT(*) as count FROM Rooms').get().count || 1;
+        //order by room so exits of the same room arrive together and each room can be written once complete
+        const rows = _db.prepare('Select * FROM Rooms left join exits on Exits.ID = Rooms.ID ORDER BY Rooms.ID').iterate();
+        for (const row of rows) {
+            if (!row.ID || row.ID.length === 0) continue;
+            row.ID = parseInt(row.ID, 10);
+            if (room && room.num === row.ID) {
+                room.exits[row.Exit] = {
+                    num: parseInt(row.DestID, 10),
+                    isdoor: row.IsDoor,
+                    isclosed: row.IsClosed
+                };
+                continue;
+            }
+            if (room) {
+                await write((count ? ',' : '') + '"' + room.num + '":' + JSON.stringify(room));
+                count++;
+                if (count % 500 === 0)
+                    postMessage({ event: 'progress', value: 0.1 + count / total * 0.9 });
+            }
+            room = { num: row.ID };
+            for (prop in row) {
+                if (prop === 'ID' || !row.hasOwnProperty(prop))
+                    continue;
+                room[prop.toLowerCase()] = row[prop];
+            }
+            room.exits = {};
+            if (row.Exit) {
+                room.exits[row.Exit] = {
+                    num: parseInt(row.DestID, 10),
+                    isdoor: row.IsDoor,
+                    isclosed: row.IsClosed
+                };
+            }
+        }
+        if (room) {
+            await write((count ? ',' : '') + '"' + room.num + '":' + JSON.stringify(room));
+            count++;
+        }
+        postMessage({ event: 'progress', value: 1, rooms: count });
+    }
+    finally {
+        _db.close();
+    }
+    await write('}');
+}
+
+/**
+ * Write an object member, adding the separator when not the first
+ *
+ * @param text The member text in "name":value form
+ */
+function member(text: string) {
+    if (_first) {
+        _first = false;
+        return write(text);
+    }
+    return write(',' + text);
+}
+
+/**
+ * Write text to the deflate stream, waiting when the stream or upload queue is full
+ *
+ * @param text The text to write
+ */
+function write(text: string): Promise<void> {
+    return new Promise(resolve => {
+        if (!_deflate) {
+            resolve();
+            return;
+        }
+        if (_deflate.write(text))
+            wait(resolve);
+        else
+            _deflate.once('drain', () => wait(resolve));
+    });
+}
+
+function wait(resolve) {
+    if (_index - _acked > CHUNK_WINDOW)
+        _waiting = resolve;
+    else
+        resolve();
+}
+
+/**
+ * Post any full chunks of compressed data, or all remaining data when finished
+ *
+ * @param end Post the remaining partial chunk
+ */
+function flush(end: boolean) {
+    while (_pendingSize >= _chunkBytes || (end && _pendingSize > 0)) {
+        const buffer = _pending.length === 1 ? _pending[0] : Buffer.concat(_pending);
+        const size = Math.min(_chunkBytes, buffer.length);
+        postMessage({ event: 'chunk', index: _index, data: (_index === 0 ? STREAM_MARKER : '') + buffer.toString('base64', 0, size) });
+        _index++;
+        _pending = size < buffer.length ? [buffer.subarray(size)] : [];
+        _pendingSize = buffer.length - size;
+    }
+}
+
+/**
+ * Decode base64 chunk data and feed it to the inflate stream, carrying partial
+ * base64 groups over to the next chunk
+ *
+ * @param data The base64 chunk text
+ * @param end Flush any carried data and end the stream
+ */
+function inflate(data: string, end: boolean) {
+    if (!_inflate) return;
+    if (data.startsWith(STREAM_MARKER))
+        data = data.substring(STREAM_MARKER.length);
+    data = _carry + data;
+    const cut = end ? data.length : data.length - data.length % 4;
+    _carry = data.substring(cut);
+    if (cut)
+        _inflate.write(Buffer.from(data.substring(0, cut), 'base64'));
+    if (end)
+        _inflate.end();
+}
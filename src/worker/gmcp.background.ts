@@ -0,0 +1,19 @@
+/**
+ * GMCP payload parser
+ *
+ * Parse large GMCP json payloads in a background thread
+ * @author William
+ */
+self.addEventListener('message', (e: MessageEvent) => {
+    if (!e.data) return;
+    switch (e.data.action) {
+        case 'parse':
+            try {
+                postMessage({ event: 'parsed', id: e.data.id, data: JSON.parse(e.data.data) });
+            }
+            catch (err) {
+                postMessage({ event: 'error', id: e.data.id, error: err.message || err });
+            }
+            break;
+    }
+}, false);
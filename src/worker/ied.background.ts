@@ -1,63 +1,114 @@
 /**
  * IED decode/encoder
  *
- * Encode/decode text blocks in background thread
+ * Encode/decode binary blocks in background thread, data is passed as transferable ArrayBuffers
  * @author William
  */
+const HEX = '0123456789abcdef';
+//per byte lookup tables, if byte needs @xx escaping and the hex digits to use
+const ESCAPE = new Uint8Array(256);
+const HEX_HIGH = new Uint8Array(256);
+const HEX_LOW = new Uint8Array(256);
+//hex digit value for each ascii character, 0 for invalid
+const HEX_VALUE = new Uint8Array(128);
+
+for (let i = 0; i < 256; i++) {
+    //control, space, non ascii, @, ^, \ and /
+    ESCAPE[i] = (i <= 32 || i >= 127 || i === 64 || i === 94 || i === 92 || i === 47) ? 1 : 0;
+    HEX_HIGH[i] = HEX.charCodeAt(i >> 4);
+    HEX_LOW[i] = HEX.charCodeAt(i & 15);
+}
+for (let i = 0; i < 16; i++) {
+    HEX_VALUE[HEX.charCodeAt(i)] = i;
+    HEX_VALUE[HEX.toUpperCase().charCodeAt(i)] = i;
+}
+
 self.addEventListener('message', (e: MessageEvent) => {
     if (!e.data) return;
+    let data;
     switch (e.data.action) {
         case 'decode-dir':
-            postMessage({ event: 'decoded-dir', path: e.data.path, data: decode(e.data.data), tag: e.data.tag, local: e.data.local });
+            data = decode(e.data.data);
+            postMessage({ event: 'decoded-dir', path: e.data.path, data: data, tag: e.data.tag, local: e.data.local }, [data]);
             break;
         case 'decode':
-            postMessage({ event: 'decoded', file: e.data.file, data: decode(e.data.data), last: e.data.last, download: e.data.download });
+            data = decode(e.data.data);
+            postMessage({ event: 'decoded', file: e.data.file, data: data, last: e.data.last, download: e.data.download }, [data]);
             break;
         case 'encode':
-            postMessage({ event: 'encoded', file: e.data.file, data: encode(e.data.data), last: e.data.last, download: e.data.download, compressed: e.data.compress });
+            postMessage({ event: 'encoded', file: e.data.file, tag: e.data.tag, data: encode(e.data.data), last: e.data.last, download: e.data.download, compressed: e.data.compress, size: e.data.size });
             break;
     }
 }, false);
 
-function decode(data: string) {
-    let decoded: string[];
+/**
+ * Decode @xx escaped text into raw bytes
+ *
+ * @param data The escaped text
+ * @returns ArrayBuffer of the decoded bytes
+ */
+function decode(data: string): ArrayBuffer {
+    let o = 0;
     let c;
+    let e;
+    let bytes;
+    let grown;
     if (!data || data.length === 0)
-        return '';
-    decoded = [];
+        return new ArrayBuffer(0);
     const dl = data.length;
+    let decoded = new Uint8Array(dl);
     for (let d = 0; d < dl; d++) {
-        c = data.charAt(d);
-        if (c === '@') {
-            decoded.push(String.fromCharCode(parseInt(data.substr(d + 1, 2), 16)));
+        c = data.charCodeAt(d);
+        if (c === 64) {
+            decoded[o++] = (HEX_VALUE[data.charCodeAt(d + 1) & 127] << 4) | HEX_VALUE[data.charCodeAt(d + 2) & 127];
             d += 2;
         }
+        else if (c > 255) {
+            //only unescaped text can be past a byte, write it as utf8 instead of truncating it
+            e = d + 1;
+            while (e < dl && data.charCodeAt(e) > 255)
+                e++;
+            bytes = Buffer.from(data.substring(d, e), 'utf8');
+            if (o + bytes.length + dl - e > decoded.length) {
+                grown = new Uint8Array(o + bytes.length + dl - e);
+                grown.set(decoded.subarray(0, o));
+                decoded = grown;
+            }
+            decoded.set(bytes, o);
+            o += bytes.length;
+            d = e - 1;
+        }
         else
-            decoded.push(c);
+            decoded[o++] = c;
     }
-
-    return decoded.join('');
+    if (o === decoded.length)
+        return decoded.buffer;
+    return decoded.buffer.slice(0, o);
 }
 
-function encode(data: string) {
-    let encoded: string[];
-    let c;
-    let i;
-    if (!data || data.length === 0)
+/**
+ * Encode raw bytes as @xx escaped text
+ *
+ * @param data ArrayBuffer of the bytes to encode
+ * @returns The escaped text
+ */
+function encode(data: ArrayBuffer): string {
+    let o = 0;
+    let b;
+    if (!data || data.byteLength === 0)
         return '';
-
-    encoded = [];
-    const dl = data.length;
-    for (let d = 0; d < dl; d++) {
-        c = data.charAt(d);
-        i = data.charCodeAt(d);
-        if (i <= 32 || i >= 127 || c === '@' || c === '^' || c === '\\' || c === '/') {
-            c = i.toString(16);
-            if (c.length === 1)
-                c = '0' + c;
-            c = '@' + c;
+    const bytes = new Uint8Array(data);
+    const bl = bytes.length;
+    const encoded = new Uint8Array(bl * 3);
+    for (let d = 0; d < bl; d++) {
+        b = bytes[d];
+        if (ESCAPE[b]) {
+            encoded[o++] = 64;
+            encoded[o++] = HEX_HIGH[b];
+            encoded[o++] = HEX_LOW[b];
         }
-        encoded.push(c);
+        else
+            encoded[o++] = b;
     }
-    return encoded.join('');
+    return Buffer.from(encoded.buffer, 0, o).toString('latin1');
 }
@@ -202,6 +202,42 @@ self.addEventListener('message', (e: MessageEvent) => {
         case 'logging':
             postMessage({ event: 'logging', args: logging });
             break;
+        case 'state':
+            postMessage({
+                event: 'state', args: {
+                    options: options,
+                    connected: connected,
+                    timeStamp: timeStamp,
+                    fTimeStamp: fTimeStamp,
+                    logging: logging,
+                    currentFile: currentFile,
+                    colors: colors,
+                    colorsCnt: colorsCnt,
+                    backgrounds: backgrounds,
+                    backgroundsCnt: backgroundsCnt,
+                    flushBuffer: flushBuffer,
+                    colorTable: colorTable
+                }
+            });
+            break;
+        case 'restore':
+            //take over the log from another logger, keeps the same file and does not start a new one
+            c = e.data.args;
+            if (!c) break;
+            options = c.options;
+            connected = c.connected;
+            timeStamp = c.timeStamp;
+            fTimeStamp = c.fTimeStamp;
+            logging = c.logging;
+            currentFile = c.currentFile;
+            colors = c.colors;
+            colorsCnt = c.colorsCnt;
+            backgrounds = c.backgrounds;
+            backgroundsCnt = c.backgroundsCnt;
+            flushBuffer = c.flushBuffer;
+            colorTable = c.colorTable;
+            postMessage({ event: 'logging', args: logging });
+            break;
         case 'toggle':
             toggle();
             break;
@@ -921,6 +957,11 @@ function GetColor(code) {
         case 3700:  //set foreground color to white
             return colorTable[263];
         default:
+            //24 bit color stored as -(TrueColor + rgb), must match parser.ts
+            if (code <= -16777216) {
+                code = -code - 16777216;
+                return `rgb(${code >> 16 & 255}, ${code >> 8 & 255}, ${code & 255})`;
+            }
             if (code <= -16) {
                 code += 16;
                 code *= -1;
@@ -1,10 +1,31 @@
+/**
+ * Map import/export
+ *
+ * Stream rooms between json map files and the map database in a background thread
+ * using its own database connection, rooms are never all held in memory
+ * @author William
+ */
+const fs = require('fs');
+const sqlite3 = require('better-sqlite3');
+
+//rooms written per transaction when importing
+const BATCH_SIZE = 1000;
+//characters buffered before writing to the export file
+const WRITE_SIZE = 65536;
+
 let _canceled = false;
+let _percent = -1;
 
 self.addEventListener('message', (e: MessageEvent) => {
     if (!e.data) return;
     switch (e.data.action) {
         case 'export':
-            _export(e.data.rows);
+            _canceled = false;
+            _export(e.data).catch(failed);
+            break;
+        case 'import':
+            _canceled = false;
+            _import(e.data).catch(failed);
             break;
         case 'cancel':
             _canceled = true;
@@ -12,49 +33,314 @@ self.addEventListener('message', (e: MessageEvent) => {
     }
 }, false);
 
-function _export(rows) {
-    _canceled = false;
-    const rooms = {};
-    const rl = rows.length;
-    postMessage({ event: 'progress', percent: 0 });
-    for (let r = 0; r < rl; r++) {
-        if (_canceled) {
+/**
+ * Post progress only when the whole percent changes
+ *
+ * @param percent The percent done
+ */
+function progress(percent: number) {
+    percent = Math.floor(percent);
+    if (percent === _percent) return;
+    _percent = percent;
+    postMessage({ event: 'progress', percent: percent });
+}
+
+/**
+ * Report an error, the mapper treats an error as the end of the import or export so nothing else is posted
+ *
+ * @param err The error
+ */
+function failed(err) {
+    postMessage({ event: 'error', error: err.message || err });
+}
+
+function yieldThread(): Promise<void> {
+    return new Promise(resolve => setTimeout(resolve, 0));
+}
+
+async function _export(options) {
+    let room;
+    let id;
+    let rows;
+    let r;
+    let rl;
+    let count = 0;
+    let prop;
+    let buffer = '{';
+    let error = null;
+    const tmp = options.file + '.tmp';
+    const db = new sqlite3(options.map, { readonly: true, fileMustExist: true });
+    const stream = fs.createWriteStream(tmp, { encoding: 'utf8' });
+    const write = (text: string) => new Promise<void>((resolve, reject) => {
+        stream.write(text, err => err ? reject(err) : resolve());
+    });
+    _percent = -1;
+    progress(0);
+    try {
+        const params = { last: '', area: options.area };
+        const where = options.area !== undefined && options.area !== null ? ' AND Area = $area' : '';
+        if (!where)
+            delete params.area;
+        const total = db.prepare('SELECT COUNT(*) as count FROM Rooms WHERE ID > $last' + where).get(params).count || 1;
+        //page by room id so the database is only locked while each page is read, exit columns are named so
+        //the exit ID does not replace the room ID for rooms without exits
+        const page = db.prepare(`SELECT Rooms.*, Exits.Exit as Exit, Exits.DestID as DestID, Exits.IsDoor as IsDoor, Exits.IsClosed as IsClosed
+            FROM (SELECT * FROM Rooms WHERE ID > $last${where} ORDER BY ID LIMIT ${BATCH_SIZE}) as Rooms
+            LEFT JOIN Exits ON Exits.ID = Rooms.ID ORDER BY Rooms.ID`);
+        while (!_canceled) {
+            rows = page.all(params);
+            rl = rows.length;
+            if (!rl) break;
+            room = null;
+            id = null;
+            for (r = 0; r < rl; r++) {
+                const row = rows[r];
+                if (row.ID !== id) {
+                    if (room)
+                        buffer += (count++ ? ',' : '') + '"' + room.num + '":' + JSON.stringify(room);
+                    id = row.ID;
+                    room = { num: parseInt(row.ID, 10) };
+                    for (prop in row) {
+                        if (prop === 'ID' || prop === 'Exit' || prop === 'DestID' || prop === 'IsDoor' || prop === 'IsClosed' || !row.hasOwnProperty(prop))
+                            continue;
+                        room[prop.toLowerCase()] = row[prop];
+                    }
+                    room.exits = {};
+                }
+                if (row.Exit)
+                    room.exits[row.Exit] = {
+                        num: parseInt(row.DestID, 10),
+                        isdoor: row.IsDoor,
+                        isclosed: row.IsClosed
+                    };
+            }
+            buffer += (count++ ? ',' : '') + '"' + room.num + '":' + JSON.stringify(room);
+            params.last = id;
+            if (buffer.length >= WRITE_SIZE) {
+                await write(buffer);
+                buffer = '';
+            }
+            progress(Math.min(count / total * 100, 99));
+            await yieldThread();
+        }
+        if (!_canceled)
+            await write(buffer + '}');
+    }
+    catch (err) {
+        error = err;
+    }
+    finally {
+        db.close();
+    }
+    await new Promise(resolve => stream.end(resolve));
+    //only replace the target once the whole file has been written
+    if (error || _canceled) {
+        fs.unlink(tmp, () => { });
+        if (error)
+            failed(error);
+        else
             postMessage({ event: 'canceled' });
-            return;
+        return;
+    }
+    fs.renameSync(tmp, options.file);
+    progress(100);
+    postMessage({ event: 'complete' });
+}
+
+async function _import(options) {
+    let total = 0;
+    let error = null;
+    const db = new sqlite3(options.map);
+    db.exec('CREATE TABLE IF NOT EXISTS Rooms (ID TEXT PRIMARY KEY ASC, Area TEXT, Details INTEGER, Name TEXT, Env TEXT, X INTEGER, Y INTEGER, Z INTEGER, Zone INTEGER, Indoors INTEGER, Background TEXT, Notes TEXT)')
+        .exec('CREATE TABLE IF NOT EXISTS Exits (ID TEXT, Exit TEXT, DestID TEXT, IsDoor INTEGER, IsClosed INTEGER)');
+    const insertRoom = db.prepare('INSERT OR REPLACE INTO Rooms (ID, Area, Details, Name, Env, X, Y, Z, Zone, Indoors, Background, Notes) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)');
+    const insertExit = db.prepare('INSERT OR REPLACE INTO Exits VALUES (?, ?, ?, ?, ?)');
+    const commit = db.transaction((rooms) => {
+        const rl = rooms.length;
+        for (let r = 0; r < rl; r++) {
+            const room = normalizeRoom(rooms[r]);
+            insertRoom.run([room.ID, room.area, room.details, room.name, room.env, room.x, room.y, room.z, room.zone, room.indoors, room.background, room.notes]);
+            let exit;
+            const exits = room.exits;
+            for (exit in exits) {
+                if (!exits.hasOwnProperty(exit)) continue;
+                insertExit.run([room.ID, exit, exits[exit].num, exits[exit].isdoor, exits[exit].isclosed]);
+            }
         }
-        rows[r].ID = parseInt(rows[r].ID, 10);
-        if (rooms[rows[r].ID]) {
-            if (!rows[r].Exit) continue;
-            rooms[rows[r].ID].exits[rows[r].Exit] = {
-                num: parseInt(rows[r].DestID, 10),
-                isdoor: rows[r].IsDoor,
-                isclosed: rows[r].IsClosed
-            };
+    });
+    _percent = -1;
+    progress(0);
+    try {
+        if (options.replace) {
+            db.transaction(() => {
+                db.prepare('DELETE FROM Exits').run();
+                db.prepare('DELETE FROM Rooms').run();
+            })();
+            postMessage({ event: 'cleared' });
+        }
+        if (options.rooms) {
+            const rooms = options.rooms;
+            const rl = rooms.length;
+            for (let r = 0; r < rl && !_canceled; r += BATCH_SIZE) {
+                commit(rooms.slice(r, r + BATCH_SIZE).filter(room => room));
+                progress(Math.min(r + BATCH_SIZE, rl) / rl * 100);
+                await yieldThread();
+            }
         }
         else {
-            rooms[rows[r].ID] = { num: rows[r].ID };
-            let prop;
-            for (prop in rows[r]) {
-                if (prop === 'ID')
-                    continue;
-                if (!rows[r].hasOwnProperty(prop)) {
+            total = fs.statSync(options.file).size || 1;
+            await readRooms(options.file, async (rooms, position) => {
+                commit(rooms);
+                progress(Math.min(position / total * 100, 99));
+                await yieldThread();
+                return !_canceled;
+            });
+        }
+    }
+    catch (err) {
+        error = err;
+    }
+    finally {
+        db.close();
+    }
+    if (error) {
+        failed(error);
+        return;
+    }
+    if (_canceled) {
+        postMessage({ event: 'canceled' });
+        return;
+    }
+    progress(100);
+    postMessage({ event: 'complete' });
+}
+
+/**
+ * Read a json map file, either an object of rooms or an array of rooms, and pass the rooms
+ * to a callback in batches as each one is read
+ *
+ * @param file The file to read
+ * @param callback Called with each batch of rooms and the characters read so far, returning false stops reading
+ */
+function readRooms(file: string, callback: (rooms: any[], position: number) => Promise<boolean>): Promise<void> {
+    return new Promise((resolve, reject) => {
+        let depth = 0;
+        let inString = false;
+        let escaped = false;
+        let partial = '';
+        let start = -1;
+        let position = 0;
+        let rooms = [];
+        let done = false;
+        const stream = fs.createReadStream(file, { encoding: 'utf8', highWaterMark: 1048576 });
+        const finish = (err?) => {
+            if (done) return;
+            done = true;
+            stream.destroy();
+            if (err)
+                reject(err);
+            else
+                resolve();
+        };
+        stream.on('data', (chunk: string) => {
+            let c;
+            const cl = chunk.length;
+            for (let i = 0; i < cl; i++) {
+                c = chunk.charCodeAt(i);
+                if (inString) {
+                    if (escaped)
+                        escaped = false;
+                    //\
+                    else if (c === 92)
+                        escaped = true;
+                    //"
+                    else if (c === 34)
+                        inString = false;
                     continue;
                 }
-                if (_canceled) {
-                    postMessage({ event: 'canceled' });
-                    return;
+                //"
+                if (c === 34)
+                    inString = true;
+                //{ or [
+                else if (c === 123 || c === 91) {
+                    depth++;
+                    //a room starts inside the outer object or array
+                    if (depth === 2)
+                        start = i;
                 }
-                rooms[rows[r].ID][prop.toLowerCase()] = rows[r][prop];
-            }
-            rooms[rows[r].ID].exits = {};
-            if (!rows[r].Exit) continue;
-            rooms[rows[r].ID].exits[rows[r].Exit] = {
-                num: parseInt(rows[r].DestID, 10),
-                isdoor: rows[r].IsDoor,
-                isclosed: rows[r].IsClosed
-            };
-        }
-        postMessage({ event: 'progress', percent: Math.floor(r / rl * 100) });
+                //} or ]
+                else if (c === 125 || c === 93) {
+                    depth--;
+                    if (depth === 1 && start !== -1) {
+                        try {
+                            rooms.push(JSON.parse(partial + chunk.substring(start, i + 1)));
+                        }
+                        catch (err) {
+                            finish(err);
+                            return;
+                        }
+                        partial = '';
+                        start = -1;
+                    }
+                }
+            }
+            position += cl;
+            //carry the unfinished room over to the next chunk
+            if (start !== -1) {
+                partial += chunk.substring(start);
+                start = 0;
+            }
+            if (rooms.length >= BATCH_SIZE) {
+                const batch = rooms;
+                rooms = [];
+                stream.pause();
+                callback(batch, position).then(more => {
+                    if (more)
+                        stream.resume();
+                    else
+                        finish();
+                }).catch(finish);
+            }
+        });
+        stream.on('end', () => {
+            if (done) return;
+            if (start !== -1 || depth !== 0) {
+                finish(new Error('Invalid map data unable to process.'));
+                return;
+            }
+            callback(rooms, position).then(() => finish()).catch(finish);
+        });
+        stream.on('error', finish);
+    });
+}
+
+function normalizeRoom(r) {
+    const id = r.ID || r.num;
+    const room = {
+        area: r.Area || r.area || '',
+        details: r.Details || r.details || 0,
+        name: r.Name || r.name || '',
+        env: r.Env || r.env || r.environment || '',
+        x: +r.X || +r.x || 0,
+        y: +r.Y || +r.y || 0,
+        z: +r.Z || +r.z || 0,
+        zone: +r.Zone || +r.zone || 0,
+        indoors: +r.Indoors || +r.indoors || 0,
+        background: r.Background || r.background || '',
+        notes: r.Notes || r.notes || '',
+        ID: id ? '' + id : null,
+        exits: r.exits || {}
+    };
+    let exit;
+    let dest;
+    for (exit in room.exits) {
+        if (!room.exits.hasOwnProperty(exit)) continue;
+        dest = room.exits[exit].DestID || room.exits[exit].num || null;
+        room.exits[exit] = {
+            num: dest ? '' + dest : null,
+            isdoor: +room.exits[exit].IsDoor || +room.exits[exit].isdoor || null,
+            isclosed: +room.exits[exit].IsClosed || +room.exits[exit].isclosed || null
+        };
     }
-    postMessage({ event: 'complete', rooms: rooms });
-}
\ No newline at end of file
+    return room;
+}
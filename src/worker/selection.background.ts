@@ -0,0 +1,454 @@
+/**
+ * Selection export
+ *
+ * Build the text, html and ansi versions of a large display selection in a background thread,
+ * lines are passed as text and formats with numeric colors already resolved by the display
+ * @author William
+ */
+//spellchecker:ignore ismap rgbcolor
+const RGBColor = require('rgbcolor');
+
+enum FormatType {
+    Normal = 0,
+    Link = 1,
+    LinkEnd = 2,
+    MXPLink = 3,
+    MXPLinkEnd = 4,
+    Image = 5,
+    WordBreak = 6,
+    MXPSend = 7,
+    MXPSendEnd = 8,
+    MXPExpired = 9,
+    MXPSkip = 10
+}
+
+enum FontStyle {
+    None = 0,
+    Bold = 1,
+    Faint = 2,
+    Italic = 4,
+    Underline = 8,
+    Slow = 16,
+    Rapid = 32,
+    Inverse = 64,
+    Hidden = 128,
+    Strikeout = 256,
+    DoubleUnderline = 512,
+    Overline = 1024
+}
+
+//parts joined into a chunk once this many are buffered
+const CHUNK_PARTS = 4096;
+//lines processed between progress messages
+const PROGRESS_LINES = 1000;
+
+/**
+ * Collect output as chunks so large results are not built by repeated concatenation
+ */
+class Builder {
+    private _chunks: string[] = [];
+    private _parts: string[] = [];
+    public length: number = 0;
+
+    public push(...text: string[]) {
+        const tl = text.length;
+        for (let t = 0; t < tl; t++) {
+            this._parts.push(text[t]);
+            this.length += text[t].length;
+        }
+        if (this._parts.length >= CHUNK_PARTS) {
+            this._chunks.push(this._parts.join(''));
+            this._parts = [];
+        }
+    }
+
+    public toString() {
+        if (this._parts.length) {
+            this._chunks.push(this._parts.join(''));
+            this._parts = [];
+        }
+        return this._chunks.join('');
+    }
+}
+
+let _colors = {};
+const _rgb = new Map<string, string>();
+
+self.addEventListener('message', (e: MessageEvent) => {
+    if (!e.data) return;
+    switch (e.data.action) {
+        case 'export':
+            try {
+                postMessage(Object.assign({ event: 'done', id: e.data.id }, exportLines(e.data)));
+            }
+            catch (err) {
+                postMessage({ event: 'error', id: e.data.id, error: err.message || err });
+            }
+            break;
+    }
+}, false);
+
+/**
+ * Build the requested outputs for the selected lines
+ *
+ * @param options The lines, selection offsets, resolved colors and what to build
+ * @returns The text and optional html and ansi, with truncated set if the size limit was reached
+ */
+function exportLines(options) {
+    const lines = options.lines;
+    const ll = lines.length;
+    const text = new Builder();
+    const html = options.html ? new Builder() : null;
+    const ansi = options.ansi ? new Builder() : null;
+    const max = options.max || 0;
+    let truncated = false;
+    _colors = options.colors || {};
+    for (let l = 0; l < ll; l++) {
+        const start = l === 0 ? options.start : 0;
+        const end = l === ll - 1 ? options.end : lines[l].text.length;
+        if (l) {
+            text.push('\n');
+            if (html) html.push('\n');
+            if (ansi) ansi.push('\n');
+        }
+        if (lines[l].formats.length && lines[l].formats[0].hr)
+            text.push('---');
+        else
+            text.push(lines[l].text.substring(start, end));
+        if (html)
+            lineHTML(html, lines[l], start, end, options);
+        if (ansi)
+            lineAnsi(ansi, lines[l], start, end);
+        if (max && (text.length > max || (html && html.length > max) || (ansi && ansi.length > max))) {
+            truncated = l < ll - 1;
+            break;
+        }
+        if (l && l % PROGRESS_LINES === 0)
+            postMessage({ event: 'progress', id: options.id, percent: Math.floor(l / ll * 100) });
+    }
+    return {
+        text: text.toString(),
+        html: html ? html.toString() : undefined,
+        ansi: ansi ? ansi.toString() : undefined,
+        truncated: truncated
+    };
+}
+
+function getColor(color) {
+    if (typeof color === 'number')
+        return _colors[color];
+    return color;
+}
+
+function htmlEncode(text: string) {
+    return text
+        .replace(/&/g, '&amp;')
+        .replace(/</g, '&lt;')
+        .replace(/>/g, '&gt;');
+}
+
+function formatUnit(str, ch?) {
+    if (!str) return str;
+    if (/^\d+c$/.test(str)) {
+        if (ch)
+            return (parseInt(str, 10) * ch) + 'px';
+        return str + 'h';
+    }
+    if (/^\d+$/.test(str))
+        return parseInt(str, 10) + 'px';
+    return str;
+}
+
+/**
+ * Write a line as html, must match Display.getLineHTML
+ */
+function lineHTML(builder: Builder, line, start: number, len: number, options) {
+    const parts = [];
+    let offset = 0;
+    let style: any = '';
+    let fCls: any = '';
+    const text = line.text;
+    const formats = line.formats;
+    const fLen = formats.length;
+    let right = false;
+    let link = false;
+    for (let f = 0; f < fLen; f++) {
+        const format = formats[f];
+        //rest of the line is after the selection, any open link is closed below
+        if (format.offset > len)
+            break;
+        let nFormat;
+        let end;
+        const td = [];
+        if (f < fLen - 1) {
+            nFormat = formats[f + 1];
+            //skip empty blocks
+            if (format.offset === nFormat.offset && nFormat.formatType === format.formatType)
+                continue;
+            end = nFormat.offset;
+        }
+        else
+            end = text.length;
+        offset = format.offset;
+
+        if (end > len)
+            end = len;
+        if (offset < start)
+            offset = start;
+
+        if (format.formatType === FormatType.Normal) {
+            style = [];
+            fCls = [];
+            if (typeof format.background === 'number' || format.background)
+                style.push('background:', getColor(format.background), ';');
+            if (typeof format.color === 'number' || format.color)
+                style.push('color:', getColor(format.color), ';');
+            if (format.font)
+                style.push('font-family: ', format.font, ';');
+            if (format.size)
+                style.push('font-size: ', format.size, ';');
+            if (format.style !== FontStyle.None) {
+                if ((format.style & FontStyle.Bold) === FontStyle.Bold)
+                    style.push('font-weight: bold;');
+                if ((format.style & FontStyle.Italic) === FontStyle.Italic)
+                    style.push('font-style: italic;');
+                if ((format.style & FontStyle.Overline) === FontStyle.Overline)
+                    td.push('overline ');
+                if ((format.style & FontStyle.DoubleUnderline) === FontStyle.DoubleUnderline || (format.style & FontStyle.Underline) === FontStyle.Underline)
+                    td.push('underline ');
+                if ((format.style & FontStyle.DoubleUnderline) === FontStyle.DoubleUnderline)
+                    style.push('border-bottom: 1px solid ', getColor(format.color), ';');
+                else
+                    style.push('padding-bottom: 1px;');
+                if ((format.style & FontStyle.Rapid) === FontStyle.Rapid || (format.style & FontStyle.Slow) === FontStyle.Slow) {
+                    if (options.enableFlashing)
+                        fCls.push(' ansi-blink');
+                    else if ((format.style & FontStyle.DoubleUnderline) !== FontStyle.DoubleUnderline && (format.style & FontStyle.Underline) !== FontStyle.Underline)
+                        td.push('underline ');
+                }
+                if ((format.style & FontStyle.Strikeout) === FontStyle.Strikeout)
+                    td.push('line-through ');
+                if (td.length > 0)
+                    style.push('text-decoration:', td.join('').trim(), ';');
+            }
+            else
+                style.push('padding-bottom: 1px;');
+            if (offset < start || end < start)
+                continue;
+            style = style.join('').trim();
+            if (fCls.length !== 0)
+                fCls = ' class="' + fCls.join('').trim() + '"';
+            else
+                fCls = '';
+            if (format.hr)
+                parts.push('<span style="', style, 'min-width:100%;width:100%;"', fCls, '><div style="position:relative;top: 50%;transform: translateY(-50%);height:4px;width:100%; background-color:', getColor(format.color), '"></div></span>');
+            else if (end - offset !== 0)
+                parts.push('<span style="', style, '"', fCls, '>', htmlEncode(text.substring(offset, end)), '</span>');
+        }
+        else if (format.formatType === FormatType.Link) {
+            if (offset < start || end < start)
+                continue;
+            link = true;
+            parts.push('<a draggable="false" class="URLLink" href="javascript:void(0);" title="');
+            parts.push(format.href.replace(/"/g, '&quot;'));
+            parts.push('" onclick="', options.linkFunction, '(\'', format.href.replace(/\\/g, '\\\\').replace(/"/g, '&quot;'), '\');return false;">');
+            if (end - offset === 0) continue;
+            parts.push('<span style="', style, '"', fCls, '>');
+            parts.push(htmlEncode(text.substring(offset, end)));
+            parts.push('</span>');
+        }
+        else if (format.formatType === FormatType.LinkEnd || format.formatType === FormatType.MXPLinkEnd || format.formatType === FormatType.MXPSendEnd) {
+            if (offset < start || end < start)
+                continue;
+            link = false;
+            parts.push('</a>');
+        }
+        else if (format.formatType === FormatType.MXPLink) {
+            if (offset < start || end < start)
+                continue;
+            link = true;
+            parts.push('<a draggable="false" class="MXPLink" href="javascript:void(0);" title="');
+            parts.push(format.href.replace(/"/g, '&quot;'));
+            parts.push('"');
+            parts.push('onclick="', options.mxpLinkFunction, '(this, \'', format.href.replace(/\\/g, '\\\\').replace(/"/g, '&quot;'), '\');return false;">');
+            if (end - offset === 0) continue;
+            parts.push('<span style="', style, '"', fCls, '>');
+            parts.push(htmlEncode(text.substring(offset, end)));
+            parts.push('</span>');
+        }
+        else if (format.formatType === FormatType.MXPSend) {
+            if (offset < start || end < start)
+                continue;
+            link = true;
+            parts.push('<a draggable="false" class="MXPLink" href="javascript:void(0);" title="');
+            parts.push(format.hint.replace(/"/g, '&quot;'));
+            parts.push('"');
+            parts.push(' onmouseover="', options.mxpTooltipFunction, '(this);"');
+            parts.push(' onclick="', options.mxpSendFunction, '(event||window.event, this, ', format.href.replace(/\\/g, '\\\\').replace(/"/g, '&quot;'), ', ', format.prompt ? 1 : 0, ', ', format.tt.replace(/\\/g, '\\\\').replace(/"/g, '&quot;'), ');return false;">');
+            if (end - offset === 0) continue;
+            parts.push('<span style="', style, '"', fCls, '>');
+            parts.push(htmlEncode(text.substring(offset, end)));
+            parts.push('</span>');
+        }
+        else if (format.formatType === FormatType.MXPExpired && end - offset !== 0) {
+            if (offset < start || end < start)
+                continue;
+            parts.push('<span style="', style, '"', fCls, '>');
+            parts.push(htmlEncode(text.substring(offset, end)));
+            parts.push('</span>');
+        }
+        else if (format.formatType === FormatType.Image) {
+            if (offset < start || end < start)
+                continue;
+            let tmp = '';
+            parts.push('<img src="');
+            if (format.url.length > 0) {
+                parts.push(format.url);
+                tmp += format.url;
+                if (!format.url.endsWith('/')) {
+                    parts.push('/');
+                    tmp += '/';
+                }
+            }
+            if (format.t.length > 0) {
+                parts.push(format.t);
+                tmp += format.t;
+                if (!format.t.endsWith('/')) {
+                    parts.push('/');
+                    tmp += '/';
+                }
+            }
+            tmp += format.name;
+            parts.push(format.name, '"  style="');
+            if (format.w.length > 0)
+                parts.push('width:', formatUnit(format.w, options.charWidth), ';');
+            if (format.h.length > 0)
+                parts.push('height:', formatUnit(format.h, options.charHeight), ';');
+            switch (format.align.toLowerCase()) {
+                case 'left':
+                    parts.push('float:left;');
+                    break;
+                case 'right':
+                    parts.push('float:right;');
+                    right = true;
+                    break;
+                case 'top':
+                case 'middle':
+                case 'bottom':
+                    parts.push('vertical-align:', format.align, ';');
+                    break;
+            }
+            if (format.hspace.length > 0 && format.vspace.length > 0) {
+                parts.push('margin:');
+                parts.push(formatUnit(format.vspace, options.charWidth), ' ');
+                parts.push(formatUnit(format.hspace, options.charHeight), ';');
+            }
+            else if (format.hspace.length > 0) {
+                parts.push('margin:');
+                parts.push('0px ', formatUnit(format.hspace, options.charHeight), ';');
+            }
+            else if (format.vspace.length > 0) {
+                parts.push('margin:');
+                parts.push(formatUnit(format.vspace, options.charWidth), ' 0px;');
+            }
+            parts.push('"');
+            if (format.ismap) parts.push(' ismap onclick="return false;"');
+            parts.push(`src="${tmp}"/>`);
+        }
+    }
+    if (link)
+        parts.push('</a>');
+    builder.push(right ? '<span class="line" style="min-width:100%">' : '<span class="line">', parts.join(''), len < text.length ? '</span>' : '<br></span>');
+}
+
+/**
+ * Convert a css color to an ansi 24 bit color parameter list
+ *
+ * @param color The css color
+ * @returns The r;g;b parameters or an empty string if not a valid color
+ */
+function rgbParameters(color: string) {
+    if (!color) return '';
+    let rgb = _rgb.get(color);
+    if (rgb === undefined) {
+        const c = new RGBColor(color);
+        rgb = c.ok ? `${c.r};${c.g};${c.b}` : '';
+        _rgb.set(color, rgb);
+    }
+    return rgb;
+}
+
+/**
+ * Write a line as ansi escaped text using 24 bit colors so custom color tables and mxp colors are kept
+ */
+function lineAnsi(builder: Builder, line, start: number, len: number) {
+    const text = line.text;
+    const formats = line.formats;
+    const fLen = formats.length;
+    let last = '';
+    for (let f = 0; f < fLen; f++) {
+        const format = formats[f];
+        if (format.formatType !== FormatType.Normal && format.formatType !== FormatType.MXPExpired)
+            continue;
+        let offset = format.offset;
+        let end = text.length;
+        let replaced = false;
+        //text runs until the next format that starts later, a later text format at the same offset replaces this one
+        for (let n = f + 1; n < fLen; n++) {
+            if (formats[n].offset !== offset) {
+                end = formats[n].offset;
+                break;
+            }
+            if (formats[n].formatType === FormatType.Normal || formats[n].formatType === FormatType.MXPExpired) {
+                replaced = true;
+                break;
+            }
+        }
+        if (replaced)
+            continue;
+        if (end > len)
+            end = len;
+        if (offset < start)
+            offset = start;
+        if (end <= offset)
+            continue;
+        const codes = ['0'];
+        const style = format.style || FontStyle.None;
+        let color = rgbParameters(getColor(format.color));
+        if (color)
+            codes.push('38;2;' + color);
+        color = rgbParameters(getColor(format.background));
+        if (color)
+            codes.push('48;2;' + color);
+        if ((style & FontStyle.Bold) === FontStyle.Bold)
+            codes.push('1');
+        if ((style & FontStyle.Faint) === FontStyle.Faint)
+            codes.push('2');
+        if ((style & FontStyle.Italic) === FontStyle.Italic)
+            codes.push('3');
+        if ((style & FontStyle.Underline) === FontStyle.Underline)
+            codes.push('4');
+        if ((style & FontStyle.Slow) === FontStyle.Slow)
+            codes.push('5');
+        if ((style & FontStyle.Rapid) === FontStyle.Rapid)
+            codes.push('6');
+        if ((style & FontStyle.Inverse) === FontStyle.Inverse)
+            codes.push('7');
+        if ((style & FontStyle.Hidden) === FontStyle.Hidden)
+            codes.push('8');
+        if ((style & FontStyle.Strikeout) === FontStyle.Strikeout)
+            codes.push('9');
+        if ((style & FontStyle.DoubleUnderline) === FontStyle.DoubleUnderline)
+            codes.push('21');
+        if ((style & FontStyle.Overline) === FontStyle.Overline)
+            codes.push('53');
+        const sgr = '\x1b[' + codes.join(';') + 'm';
+        //only change attributes when they differ from the last block
+        if (sgr !== last)
+            builder.push(sgr);
+        last = sgr;
+        builder.push(text.substring(offset, end));
+    }
+    if (last)
+        builder.push('\x1b[0m');
+}